@@ -0,0 +1,127 @@
+#version 450
+
+// one thread per meshlet of a mesh, writes the indexed indirect command that draws it,
+// culled meshlets get no instances
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+const uint CULL_FRUSTUM = 1;
+const uint CULL_BACKFACE = 2;
+const uint CULL_OCCLUSION = 4;
+
+layout (set = 0, binding = 0) uniform CullData {
+  mat4 proj_view;
+  // the depth pyramid was built with this one, last frame's
+  mat4 pyramid_proj_view;
+  // world space, normals point inside
+  vec4 planes[6];
+  vec3 camera_position;
+  uint flags;
+  vec2 pyramid_size;
+  float pyramid_levels;
+  float _; // padding
+} cull;
+
+struct DrawCommand {
+  uint index_count;
+  uint instance_count;
+  uint first_index;
+  int vertex_offset;
+  uint first_instance;
+};
+
+layout (set = 0, binding = 1) writeonly buffer Commands {
+  DrawCommand commands[];
+};
+
+// the farthest depth in each texel's footprint
+layout (set = 0, binding = 2) uniform sampler2D depth_pyramid;
+
+// see assets/meshes/meshlets.hpp
+struct Meshlet {
+  vec3 center;
+  float radius;
+  vec3 cone_axis;
+  float cone_cutoff;
+  uint first_index;
+  uint index_count;
+  uint _0;
+  uint _1;
+};
+
+layout (set = 1, binding = 0) readonly buffer Meshlets {
+  Meshlet meshlets[];
+};
+
+layout (push_constant) uniform constants {
+  mat4 model;
+  uint first_command;
+  uint meshlets_count;
+} push;
+
+bool occluded(vec3 center, float radius) {
+  // the corners of the sphere's box in last frame's screen space
+  vec2 uv_min = vec2(1);
+  vec2 uv_max = vec2(0);
+  float nearest = 1.0;
+  for (uint i = 0; i < 8; i++) {
+    vec3 corner = center + radius * vec3(
+        (i & 1u) != 0 ? 1.0 : -1.0, (i & 2u) != 0 ? 1.0 : -1.0, (i & 4u) != 0 ? 1.0 : -1.0);
+    vec4 clip = cull.pyramid_proj_view * vec4(corner, 1.0);
+    // crosses the near plane, can't be projected
+    if (clip.w <= 0.0 || clip.z <= 0.0) return false;
+
+    vec3 ndc = clip.xyz / clip.w;
+    uv_min = min(uv_min, ndc.xy * 0.5 + 0.5);
+    uv_max = max(uv_max, ndc.xy * 0.5 + 0.5);
+    nearest = min(nearest, ndc.z);
+  }
+
+  uv_min = clamp(uv_min, 0.0, 1.0);
+  uv_max = clamp(uv_max, 0.0, 1.0);
+
+  // the level where the box covers at most two texels a side, its corners reach all of them
+  vec2 size = (uv_max - uv_min) * cull.pyramid_size;
+  float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, cull.pyramid_levels - 1.0);
+
+  float depth = max(
+      max(textureLod(depth_pyramid, uv_min, level).r,
+          textureLod(depth_pyramid, vec2(uv_max.x, uv_min.y), level).r),
+      max(textureLod(depth_pyramid, vec2(uv_min.x, uv_max.y), level).r,
+          textureLod(depth_pyramid, uv_max, level).r));
+
+  return nearest > depth;
+}
+
+void main() {
+  uint id = gl_GlobalInvocationID.x;
+  if (id >= push.meshlets_count) return;
+
+  Meshlet meshlet = meshlets[id];
+
+  mat3 basis = mat3(push.model);
+  vec3 scale = vec3(length(basis[0]), length(basis[1]), length(basis[2]));
+  float max_scale = max(scale.x, max(scale.y, scale.z));
+  vec3 center = (push.model * vec4(meshlet.center, 1.0)).xyz;
+  float radius = meshlet.radius * max_scale;
+
+  bool visible = true;
+
+  if ((cull.flags & CULL_FRUSTUM) != 0) {
+    for (uint i = 0; i < 6; i++)
+      visible = visible && dot(cull.planes[i].xyz, center) + cull.planes[i].w > -radius;
+  }
+
+  // the cone only survives rotations and uniform scales
+  bool uniform_scale = max_scale < min(scale.x, min(scale.y, scale.z)) * 1.01;
+  if (visible && (cull.flags & CULL_BACKFACE) != 0 && uniform_scale && meshlet.cone_cutoff < 1.0) {
+    vec3 axis = normalize(basis * meshlet.cone_axis);
+    vec3 view = center - cull.camera_position;
+    visible = dot(view, axis) < meshlet.cone_cutoff * length(view) + radius;
+  }
+
+  if (visible && (cull.flags & CULL_OCCLUSION) != 0)
+    visible = !occluded(center, radius);
+
+  commands[push.first_command + id] = DrawCommand(
+      meshlet.index_count, visible ? 1u : 0u, meshlet.first_index, 0, 0u);
+}
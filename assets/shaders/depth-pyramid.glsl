@@ -0,0 +1,31 @@
+#version 450
+
+// one level of the depth pyramid from the level above it (or the depth buffer), every texel
+// keeps the farthest depth of the source texels it covers
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+layout (set = 0, binding = 0) uniform sampler2D src;
+layout (set = 0, binding = 1, r32f) uniform writeonly image2D dst;
+
+layout (push_constant) uniform constants {
+  uvec2 src_size;
+  uvec2 dst_size;
+} push;
+
+void main() {
+  uvec2 texel = gl_GlobalInvocationID.xy;
+  if (any(greaterThanEqual(texel, push.dst_size))) return;
+
+  // the first level is a power of two smaller than the depth buffer, its footprint
+  // can be up to three texels wide
+  uvec2 begin = texel * push.src_size / push.dst_size;
+  uvec2 end = (texel + 1u) * push.src_size;
+  end = min((end + push.dst_size - 1u) / push.dst_size, push.src_size);
+
+  float depth = 0.0;
+  for (uint y = begin.y; y < end.y; y++)
+    for (uint x = begin.x; x < end.x; x++)
+      depth = max(depth, texelFetch(src, ivec2(x, y), 0).r);
+
+  imageStore(dst, ivec2(texel), vec4(depth));
+}
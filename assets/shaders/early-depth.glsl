@@ -1,14 +1,7 @@
 #version 450
 
 #extension GL_EXT_debug_printf : enable
-struct VertexData {
-	float x, y, z;
-	float nx, ny, nz;
-	float tx, ty, tz;
-	float u, v;
-	float _x, _y; // padding not used currently
-};
-
+// same set numbering as pbr.glsl, the per draw geometry lives in set 2
 layout (set = 0, binding = 0) uniform GlobalUbo {
 	mat4 proj_view;
 } gubo;
@@ -18,21 +11,33 @@ layout (push_constant) uniform constants {
 	mat4 norm_mat;
 } push;
 
-layout (set = 1, binding = 0) readonly buffer Vertices {
-	VertexData data[];
+// same vertex range as pbr.glsl, only the position is read
+layout (set = 2, binding = 0) readonly buffer Vertices {
+	vec3 position_offset;
+	uint format;
+	vec3 position_scale;
+	uint index_size;
+	uint words[];
 } vertices;
 
-layout (set = 1, binding = 1) readonly buffer Indices {
-	uint data[];
-} indices;
-
 #ifdef VERTEX_SHADER
 
+const uint VERTEX_FORMAT_QUANTIZED = 1;
+
+vec3 fetch_position(uint idx) {
+	if (vertices.format == VERTEX_FORMAT_QUANTIZED) {
+		vec2 xy = unpackUnorm2x16(vertices.words[idx * 5]);
+		float z = unpackUnorm2x16(vertices.words[idx * 5 + 1]).x;
+		return vertices.position_offset + vec3(xy, z) * vertices.position_scale;
+	}
+
+	uint base = idx * 13;
+	return uintBitsToFloat(uvec3(vertices.words[base], vertices.words[base + 1], vertices.words[base + 2]));
+}
+
 void main() {
 	//const array of positions for the triangle
-	uint idx = indices.data[gl_VertexIndex];
-	VertexData vtx = vertices.data[idx];
-	vec4 world_space_pos = push.model_mat * vec4(vtx.x, vtx.y, vtx.z, 1.0f);
+	vec4 world_space_pos = push.model_mat * vec4(fetch_position(gl_VertexIndex), 1.0f);
 
 	gl_Position = gubo.proj_view * world_space_pos;
 }
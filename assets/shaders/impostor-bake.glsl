@@ -0,0 +1,129 @@
+#version 450
+
+// renders a mesh into one frame of its impostor atlas with pbr.glsl's material and vertex
+// range, the frame keeps what the impostor is lit with when it's drawn (impostor.glsl)
+// set 0 is unused, the material and the geometry keep pbr.glsl's set numbers
+
+layout (set = 1, binding = 0) uniform MaterialUbo {
+  vec4 color_factor;
+  vec4 emissive_factor;
+  float metallic_factor;
+  float roughness_factor;
+  float ao;
+  float _; // padding
+} mubo;
+
+layout (set = 1, binding = 1) uniform sampler2D tex_albedo;
+layout (set = 1, binding = 2) uniform sampler2D tex_metalic_roughness;
+layout (set = 1, binding = 3) uniform sampler2D tex_normal;
+layout (set = 1, binding = 4) uniform sampler2D tex_emissive;
+
+// same vertex range as pbr.glsl
+layout (set = 2, binding = 0) readonly buffer Vertices {
+  vec3 position_offset;
+  uint format;
+  vec3 position_scale;
+  uint index_size;
+  uint words[];
+} vertices;
+
+// an orthographic view of the mesh's bounding sphere, everything is in mesh space
+layout (push_constant) uniform constants {
+  vec4 center_radius;
+  vec4 right;
+  vec4 up;
+  // from the mesh towards the viewer
+  vec4 forward;
+} push;
+
+#ifdef VERTEX_SHADER
+
+const uint VERTEX_FORMAT_QUANTIZED = 1;
+
+struct VertexData {
+  vec3 pos;
+  vec3 normal;
+  vec3 tangent;
+  vec2 uv;
+};
+
+vec3 oct_decode(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+vec3 read_vec3(uint word) {
+  return uintBitsToFloat(uvec3(vertices.words[word], vertices.words[word + 1], vertices.words[word + 2]));
+}
+
+VertexData fetch_vertex(uint idx) {
+  VertexData vtx;
+  if (vertices.format == VERTEX_FORMAT_QUANTIZED) {
+    uint base = idx * 5;
+    vec2 xy = unpackUnorm2x16(vertices.words[base]);
+    float z = unpackUnorm2x16(vertices.words[base + 1]).x;
+    vtx.pos = vertices.position_offset + vec3(xy, z) * vertices.position_scale;
+    vtx.normal = oct_decode(unpackSnorm2x16(vertices.words[base + 2]));
+    vtx.tangent = oct_decode(unpackSnorm2x16(vertices.words[base + 3]));
+    vtx.uv = unpackHalf2x16(vertices.words[base + 4]);
+  } else {
+    uint base = idx * 13;
+    vtx.pos = read_vec3(base);
+    vtx.normal = read_vec3(base + 3);
+    vtx.tangent = read_vec3(base + 6);
+    vtx.uv = uintBitsToFloat(uvec2(vertices.words[base + 9], vertices.words[base + 10]));
+  }
+  return vtx;
+}
+
+layout (location = 0) out vec3 o_norm;
+layout (location = 1) out vec3 o_tan;
+layout (location = 2) out vec3 o_bitan;
+layout (location = 3) out vec2 o_uv;
+
+void main() {
+  VertexData vtx = fetch_vertex(gl_VertexIndex);
+  // the sphere fills the frame
+  vec3 p = (vtx.pos - push.center_radius.xyz) / push.center_radius.w;
+
+  o_norm = vtx.normal;
+  o_tan = vtx.tangent;
+  o_bitan = cross(o_norm, o_tan);
+  o_uv = vtx.uv;
+  // y down like the other passes' projections, the depth goes from 0 on the side facing
+  // the viewer to 1 on the far side
+  gl_Position = vec4(
+      dot(p, push.right.xyz), -dot(p, push.up.xyz), 0.5 - 0.5 * dot(p, push.forward.xyz), 1.0);
+}
+
+#endif
+#ifdef FRAGMENT_SHADER
+
+layout (location = 0) in vec3 i_norm;
+layout (location = 1) in vec3 i_tan;
+layout (location = 2) in vec3 i_bitan;
+layout (location = 3) in vec2 i_uv;
+
+// alpha is the coverage
+layout (location = 0) out vec4 o_albedo;
+// mesh space, packed to [0, 1]
+layout (location = 1) out vec4 o_normal;
+layout (location = 2) out float o_depth;
+
+void main() {
+  // same normal mapping as pbr.glsl
+  mat3 tanspace_to_mesh = mat3(normalize(i_tan), normalize(i_bitan), normalize(i_norm));
+  vec3 N;
+  N.xy = texture(tex_normal, i_uv).rg * 2.0f - 1.0f;
+  N.z = sqrt(max(1.0f - dot(N.xy, N.xy), 0.0f));
+  N = normalize(tanspace_to_mesh * N);
+
+  o_albedo = vec4(vec3(texture(tex_albedo, i_uv) * mubo.color_factor), 1.0);
+  o_normal = vec4(N * 0.5 + 0.5, 1.0);
+  o_depth = gl_FragCoord.z;
+}
+
+#endif
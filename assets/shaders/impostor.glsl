@@ -0,0 +1,127 @@
+#version 450
+
+// a distant mesh as one quad, the quad faces the frame of the atlas that was baked from the
+// direction closest to the camera (impostor-bake.glsl) and writes the depth of the surface
+// that frame saw so it intersects the rest of the scene like the mesh would
+
+#define PI 3.14159265358979323846264338327950
+
+// frames per side of the atlas, k_impostor_frames in vulkan/impostor-pass.hpp
+const float FRAMES = 8.0;
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+  mat4 proj_view;
+  vec4 cam_pos;
+} gubo;
+
+layout (set = 0, binding = 1) uniform sampler2D tex_dprefilter;
+
+layout (set = 1, binding = 0) uniform sampler2D tex_albedo;
+layout (set = 1, binding = 1) uniform sampler2D tex_normal;
+layout (set = 1, binding = 2) uniform sampler2D tex_depth;
+
+layout (push_constant) uniform constants {
+  mat4 model_mat;
+  // the mesh's bounding sphere in mesh space
+  vec4 center_radius;
+} push;
+
+#ifdef VERTEX_SHADER
+
+// the upper hemisphere to the [-1, 1] square and back
+vec2 hemi_oct_encode(vec3 d) {
+  d.y = max(d.y, 0.0);
+  d /= abs(d.x) + abs(d.y) + abs(d.z) + 1e-6;
+  return vec2(d.x + d.z, d.x - d.z);
+}
+
+vec3 hemi_oct_decode(vec2 e) {
+  vec3 d = vec3((e.x + e.y) * 0.5, 0.0, (e.x - e.y) * 0.5);
+  d.y = 1.0 - abs(d.x) - abs(d.z);
+  return normalize(d);
+}
+
+// a triangle strip
+const vec2 corners[4] = vec2[](vec2(-1, -1), vec2(1, -1), vec2(-1, 1), vec2(1, 1));
+
+layout (location = 0) out vec2 o_uv;
+layout (location = 1) out vec3 o_mesh_pos;
+layout (location = 2) flat out vec2 o_frame;
+layout (location = 3) flat out vec3 o_forward;
+layout (location = 4) flat out mat3 o_norm_mat;
+
+void main() {
+  vec3 center = push.center_radius.xyz;
+  float radius = push.center_radius.w;
+  mat3 basis = mat3(push.model_mat);
+  mat3 inverse_basis = inverse(basis);
+
+  // the frame is picked in mesh space so rotated entities still see the right side
+  vec3 camera = (inverse(push.model_mat) * vec4(gubo.cam_pos.xyz, 1.0)).xyz;
+  vec2 grid = (hemi_oct_encode(normalize(camera - center)) * 0.5 + 0.5) * FRAMES;
+  o_frame = clamp(floor(grid), 0.0, FRAMES - 1.0);
+  vec3 forward = hemi_oct_decode((o_frame + 0.5) / FRAMES * 2.0 - 1.0);
+
+  // the same basis the frame was baked with
+  vec3 right = normalize(cross(vec3(0, 1, 0), forward));
+  vec3 up = cross(forward, right);
+
+  vec2 corner = corners[gl_VertexIndex];
+  o_uv = vec2(corner.x, -corner.y) * 0.5 + 0.5;
+  o_mesh_pos = center + (corner.x * right + corner.y * up) * radius;
+  o_forward = forward;
+  o_norm_mat = transpose(inverse_basis);
+
+  gl_Position = gubo.proj_view * push.model_mat * vec4(o_mesh_pos, 1.0);
+}
+
+#endif
+#ifdef FRAGMENT_SHADER
+
+layout (location = 0) in vec2 i_uv;
+layout (location = 1) in vec3 i_mesh_pos;
+layout (location = 2) flat in vec2 i_frame;
+layout (location = 3) flat in vec3 i_forward;
+layout (location = 4) flat in mat3 i_norm_mat;
+
+layout (location = 0) out vec4 outFragColor;
+
+// same as pbr.glsl
+vec2 direction_to_spherical_envmap(vec3 dir) {
+  float phi = atan(dir.z, dir.x);
+  float theta = acos(dir.y);
+  float u = 0.5 - phi / (2.0 * PI);
+  float v = 1.0 - theta / PI;
+  return vec2(u, -v);
+}
+
+vec3 ACESFilm(vec3 color) {
+  float a = 2.51f;
+  float b = 0.03f;
+  float c = 2.43f;
+  float d = 0.59f;
+  float e = 0.14f;
+  return (color * (a * color + b)) / (color * (c * color + d) + e);
+}
+
+void main() {
+  vec2 atlas_uv = (i_frame + clamp(i_uv, 0.0, 1.0)) / FRAMES;
+  vec4 albedo = texture(tex_albedo, atlas_uv);
+  if (albedo.a < 0.5) discard;
+
+  // back to the surface the frame saw, the baked depth is 0 at the radius towards the viewer
+  float depth = texture(tex_depth, atlas_uv).r;
+  vec3 mesh_pos = i_mesh_pos + i_forward * push.center_radius.w * (1.0 - 2.0 * depth);
+  vec4 clip = gubo.proj_view * push.model_mat * vec4(mesh_pos, 1.0);
+  gl_FragDepth = clip.z / clip.w;
+
+  vec3 N = normalize(i_norm_mat * (texture(tex_normal, atlas_uv).xyz * 2.0 - 1.0));
+
+  // only pbr.glsl's diffuse image based lighting, the atlas has no metalness or roughness and
+  // the specular doesn't show at this size
+  vec3 radiance = albedo.rgb * texture(tex_dprefilter, direction_to_spherical_envmap(N)).rgb;
+  radiance = ACESFilm(radiance);
+  outFragColor = vec4(pow(radiance, vec3(1.0 / 2.2)), 1.0f);
+}
+
+#endif
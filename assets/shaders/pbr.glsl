@@ -10,14 +10,6 @@
           debugPrintfEXT( value );                    \
         }
 
-struct VertexData {
-  float x, y, z;
-  float nx, ny, nz;
-  float tx, ty, tz;
-  float u, v;
-  float _x, _y; // padding not used currently
-};
-
 struct Light {
   vec3 pos;
   vec4 color;
@@ -25,6 +17,8 @@ struct Light {
 
 const uint MAX_NUM_OF_LIGHTS = 100;
 
+// sets are grouped by update frequency
+// set 0: per frame, set 1: per material, set 2: per draw
 layout (set = 0, binding = 0) uniform GlobalUbo {
   mat4 proj;
   mat4 view;
@@ -36,32 +30,35 @@ layout (set = 0, binding = 0) uniform GlobalUbo {
   vec4 skylight_color;
 } gubo;
 
-layout (set = 1, binding = 0) uniform ObjectUbo {
+layout (set = 0, binding = 1) uniform sampler2D tex_dprefilter;
+layout (set = 0, binding = 2) uniform sampler2D tex_sprefilter;
+layout (set = 0, binding = 3) uniform sampler2D tex_BRDFlut;
+
+layout (set = 1, binding = 0) uniform MaterialUbo {
   vec4 color_factor;
   vec4 emissive_factor;
   float metallic_factor;
   float roughness_factor;
   float ao;
   float _; // padding
-} oubo;
+} mubo;
+
+layout (set = 1, binding = 1) uniform sampler2D tex_albedo;
+layout (set = 1, binding = 2) uniform sampler2D tex_metalic_roughness;
+layout (set = 1, binding = 3) uniform sampler2D tex_normal;
+layout (set = 1, binding = 4) uniform sampler2D tex_emissive;
 
+// the vertex range starts with how to read the mesh, meshes keep either full vertices
+// (13 floats) or quantized ones (5 words), see assets/meshes/vertex-format.hpp
+// the indices come from the bound index buffer
 layout (set = 2, binding = 0) readonly buffer Vertices {
-  VertexData data[];
+  vec3 position_offset;
+  uint format;
+  vec3 position_scale;
+  uint index_size;
+  uint words[];
 } vertices;
 
-layout (set = 2, binding = 1) readonly buffer Indices {
-  uint data[];
-} indices;
-
-layout (set = 3, binding = 0) uniform sampler2D tex_albedo;
-layout (set = 4, binding = 0) uniform sampler2D tex_metalic_roughness;
-layout (set = 5, binding = 0) uniform sampler2D tex_normal;
-layout (set = 6, binding = 0) uniform sampler2D tex_emissive;
-
-layout (set = 7, binding = 0) uniform sampler2D tex_dprefilter;
-layout (set = 8, binding = 0) uniform sampler2D tex_sprefilter;
-layout (set = 9, binding = 0) uniform sampler2D tex_BRDFlut;
-
 
 layout (push_constant) uniform constants {
   mat4 model_mat;
@@ -71,6 +68,47 @@ layout (push_constant) uniform constants {
 
 #ifdef VERTEX_SHADER
 
+const uint VERTEX_FORMAT_QUANTIZED = 1;
+
+struct VertexData {
+  vec3 pos;
+  vec3 normal;
+  vec3 tangent;
+  vec2 uv;
+};
+
+vec3 oct_decode(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+vec3 read_vec3(uint word) {
+  return uintBitsToFloat(uvec3(vertices.words[word], vertices.words[word + 1], vertices.words[word + 2]));
+}
+
+VertexData fetch_vertex(uint idx) {
+  VertexData vtx;
+  if (vertices.format == VERTEX_FORMAT_QUANTIZED) {
+    uint base = idx * 5;
+    vec2 xy = unpackUnorm2x16(vertices.words[base]);
+    float z = unpackUnorm2x16(vertices.words[base + 1]).x;
+    vtx.pos = vertices.position_offset + vec3(xy, z) * vertices.position_scale;
+    vtx.normal = oct_decode(unpackSnorm2x16(vertices.words[base + 2]));
+    vtx.tangent = oct_decode(unpackSnorm2x16(vertices.words[base + 3]));
+    vtx.uv = unpackHalf2x16(vertices.words[base + 4]);
+  } else {
+    uint base = idx * 13;
+    vtx.pos = read_vec3(base);
+    vtx.normal = read_vec3(base + 3);
+    vtx.tangent = read_vec3(base + 6);
+    vtx.uv = uintBitsToFloat(uvec2(vertices.words[base + 9], vertices.words[base + 10]));
+  }
+  return vtx;
+}
+
 layout (location = 0) out vec3 o_norm;
 layout (location = 1) out vec3 o_tan;
 layout (location = 2) out vec3 o_bitan;
@@ -80,18 +118,18 @@ layout (location = 4) out vec2 o_uv;
 // vertex shader
 void main() {
   //const array of positions for the triangle
-  uint idx = indices.data[gl_VertexIndex];
-  VertexData vtx = vertices.data[idx];
-  vec4 world_space_pos = push.model_mat * vec4(vtx.x, vtx.y, vtx.z, 1.0f);
+  // indexed draws, gl_VertexIndex is already the index buffer's value
+  VertexData vtx = fetch_vertex(gl_VertexIndex);
+  vec4 world_space_pos = push.model_mat * vec4(vtx.pos, 1.0f);
   
   
   //output the position of each vertex
-  o_norm = vec3(vec4(vtx.nx, vtx.ny, vtx.nz, 1.0f) * push.norm_mat);
-  o_tan =  vec3(vec4(vtx.tx, vtx.ty, vtx.tz, 1.0f) * push.model_mat);
+  o_norm = vec3(vec4(vtx.normal, 1.0f) * push.norm_mat);
+  o_tan =  vec3(vec4(vtx.tangent, 1.0f) * push.model_mat);
   o_bitan = cross(o_norm, o_tan);
   // Euclidean space
   o_pos = world_space_pos.xyz / world_space_pos.w;
-  o_uv = vec2(vtx.u, vtx.v);
+  o_uv = vtx.uv;
   gl_Position = gubo.proj_view * world_space_pos;
 }
 
@@ -213,17 +251,18 @@ void main() {
   vec3 bitan = normalize(i_world_bitan);
   mat3 tanspace_to_world = mat3(tan, bitan, norm);
   
-  // unpacking normal
-  vec3 N = texture(tex_normal, i_uv).rgb;
-  N = normalize(N * 2.0f - 1.0f);
-  N = tanspace_to_world * N;
+  // unpacking normal, z is rebuilt so two channel (bc5) maps work too
+  vec3 N;
+  N.xy = texture(tex_normal, i_uv).rg * 2.0f - 1.0f;
+  N.z = sqrt(max(1.0f - dot(N.xy, N.xy), 0.0f));
+  N = normalize(tanspace_to_world * N);
   
-  vec3 base_color = vec3(texture(tex_albedo, i_uv).rgba * oubo.color_factor);
-  vec3 emission = vec3(texture(tex_emissive, i_uv).rgba * oubo.emissive_factor);
+  vec3 base_color = vec3(texture(tex_albedo, i_uv).rgba * mubo.color_factor);
+  vec3 emission = vec3(texture(tex_emissive, i_uv).rgba * mubo.emissive_factor);
 
   // https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#_material_pbrmetallicroughness_metallicroughnesstexture
-  float metallicness = texture(tex_metalic_roughness, i_uv).b * oubo.metallic_factor;
-  float roughness = texture(tex_metalic_roughness, i_uv).g * oubo.roughness_factor;
+  float metallicness = texture(tex_metalic_roughness, i_uv).b * mubo.metallic_factor;
+  float roughness = texture(tex_metalic_roughness, i_uv).g * mubo.roughness_factor;
 
   vec3 view_dir = normalize(gubo.cam_pos - i_world_pos);
   vec3 skylight_dir = normalize(gubo.skylight_dir.xyz);
@@ -233,7 +272,7 @@ void main() {
 
  // skylight
  // direct lighting
- // vec3 brdf = microfacetBRDF(skylight_dir, view_dir, N, base_color, metallicness, oubo.ao, roughness);
+ // vec3 brdf = microfacetBRDF(skylight_dir, view_dir, N, base_color, metallicness, mubo.ao, roughness);
  // radiance += brdf * skylight_color;
 
  //  // sum of all point lights
@@ -247,7 +286,7 @@ void main() {
  //    float irradiance = max(dot(light_dir, N), 0.0);
  //    if(irradiance > 0.0) {
  //      // avoid calculating brdf if light doesn't contribute
- //      vec3 brdf = microfacetBRDF(light_dir, view_dir, N, base_color, metallicness, oubo.ao, roughness);
+ //      vec3 brdf = microfacetBRDF(light_dir, view_dir, N, base_color, metallicness, mubo.ao, roughness);
  //      radiance += irradiance * brdf * light.color.rgb * attenuation;
  //    }
  //  }
@@ -256,7 +295,7 @@ void main() {
   vec2 env_uv = direction_to_spherical_envmap(N);
   vec3 rhoD = (1.0 - metallicness) * base_color;
 
-  vec3 F0 = vec3(0.16 * oubo.ao * oubo.ao);
+  vec3 F0 = vec3(0.16 * mubo.ao * mubo.ao);
   F0 = mix(F0, base_color, metallicness);
   // rhoD *= vec3(1.0) - F0; 
 
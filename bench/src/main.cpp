@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "pch.hpp"
+#include "assets/accessors.hpp"
+#include "assets/meshes/vertex-format.hpp"
+
+// geg-bench [runs]
+// decodes the same primitive with the importer's accessor path and the loop it replaced,
+// the numbers only mean something with optimizations on, a debug build measures the asserts
+namespace {
+  using geg::vulkan::Vertex;
+
+  struct Attributes {
+    size_t count = 0;
+    std::vector<float> positions;
+    std::vector<float> normals;
+    // xyzw, the importer drops w
+    std::vector<float> tangents;
+    std::vector<float> uvs;
+  };
+
+  struct Quantized {
+    std::vector<int16_t> positions;
+    std::vector<int8_t> normals;
+    std::vector<int8_t> tangents;
+    std::vector<uint16_t> uvs;
+  };
+
+  Attributes make_attributes(size_t count) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    Attributes attributes{.count = count};
+    const auto fill = [&](std::vector<float>& values, size_t components, bool normalize) {
+      values.resize(count * components);
+      for (size_t i = 0; i < count; i++) {
+        float* v = values.data() + i * components;
+        float length2 = 0.0f;
+        for (size_t c = 0; c < components; c++) {
+          v[c] = unit(rng);
+          length2 += v[c] * v[c];
+        }
+        if (normalize)
+          for (size_t c = 0; c < components; c++)
+            v[c] /= std::sqrt(length2);
+      }
+    };
+
+    fill(attributes.positions, 3, false);
+    fill(attributes.normals, 3, true);
+    fill(attributes.tangents, 4, true);
+    fill(attributes.uvs, 2, false);
+    return attributes;
+  }
+
+  // the same values as KHR_mesh_quantization stores them
+  Quantized quantize(const Attributes& attributes) {
+    Quantized quantized;
+    for (float v : attributes.positions)
+      quantized.positions.push_back(static_cast<int16_t>(std::lround(v * 32767.0f)));
+    for (float v : attributes.normals)
+      quantized.normals.push_back(static_cast<int8_t>(std::lround(v * 127.0f)));
+    for (float v : attributes.tangents)
+      quantized.tangents.push_back(static_cast<int8_t>(std::lround(v * 127.0f)));
+    for (float v : attributes.uvs)
+      quantized.uvs.push_back(static_cast<uint16_t>(std::lround((v * 0.5f + 0.5f) * 65535.0f)));
+    return quantized;
+  }
+
+  geg::AccessorSource source(
+      const void* data, size_t count, geg::ComponentType type, uint32_t components) {
+    const size_t stride = components * geg::component_size(type);
+    return {
+        .data = static_cast<const std::byte*>(data),
+        .count = count,
+        .stride = stride,
+        .type = type,
+        .components = components,
+        .normalized = type != geg::ComponentType::Float,
+    };
+  }
+
+  // how read_primitive decoded tightly packed float attributes before the accessors
+  void decode_old(const Attributes& a, std::vector<Vertex>& verts) {
+    verts.resize(a.count);
+
+    uint32_t i = 0;
+    for (auto& vert : verts) {
+      const float* position = &a.positions[i * 3];
+      const float* normal = &a.normals[i * 3];
+      const float* tangent = &a.tangents[i * 4];
+      vert.position = glm::vec3{position[0], position[1], position[2]};
+      vert.normal = glm::normalize(glm::vec3{normal[0], normal[1], normal[2]});
+      vert.tangent = glm::vec3{tangent[0], tangent[1], tangent[2]};
+      vert.tex_coord = glm::vec2{a.uvs[i * 2], a.uvs[i * 2 + 1]};
+      i++;
+    }
+  }
+
+  void decode(
+      std::span<const geg::AccessorTarget> targets, size_t count, std::vector<Vertex>& verts) {
+    verts.resize(count);
+    geg::decode_vertex_stream(
+        targets, count, reinterpret_cast<std::byte*>(verts.data()), sizeof(Vertex));
+  }
+
+  // min over the runs, every run decodes into a fresh vector like the importer does
+  template<typename Fn>
+  double min_ms(uint32_t runs, Fn&& fn) {
+    double best = 1e30;
+    for (uint32_t i = 0; i < runs; i++) {
+      std::vector<Vertex> verts;
+      const auto start = std::chrono::steady_clock::now();
+      fn(verts);
+      const auto end = std::chrono::steady_clock::now();
+      best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+  }
+
+  void run(size_t count, uint32_t runs) {
+    using geg::ComponentType;
+
+    const auto attributes = make_attributes(count);
+    const auto quantized = quantize(attributes);
+
+    const geg::AccessorTarget floats[] = {
+        {.source = source(attributes.positions.data(), count, ComponentType::Float, 3),
+         .offset = offsetof(Vertex, position),
+         .components = 3},
+        {.source = source(attributes.normals.data(), count, ComponentType::Float, 3),
+         .offset = offsetof(Vertex, normal),
+         .components = 3},
+        {.source = source(attributes.tangents.data(), count, ComponentType::Float, 4),
+         .offset = offsetof(Vertex, tangent),
+         .components = 3},
+        {.source = source(attributes.uvs.data(), count, ComponentType::Float, 2),
+         .offset = offsetof(Vertex, tex_coord),
+         .components = 2},
+    };
+
+    const geg::AccessorTarget packed[] = {
+        {.source = source(quantized.positions.data(), count, ComponentType::Short, 3),
+         .offset = offsetof(Vertex, position),
+         .components = 3},
+        {.source = source(quantized.normals.data(), count, ComponentType::Byte, 3),
+         .offset = offsetof(Vertex, normal),
+         .components = 3,
+         .renormalize = true},
+        {.source = source(quantized.tangents.data(), count, ComponentType::Byte, 4),
+         .offset = offsetof(Vertex, tangent),
+         .components = 3},
+        {.source = source(quantized.uvs.data(), count, ComponentType::UnsignedShort, 2),
+         .offset = offsetof(Vertex, tex_coord),
+         .components = 2},
+    };
+
+    const double old_ms = min_ms(runs, [&](auto& verts) { decode_old(attributes, verts); });
+    const double new_ms = min_ms(runs, [&](auto& verts) { decode(floats, count, verts); });
+    const double quantized_ms = min_ms(runs, [&](auto& verts) { decode(packed, count, verts); });
+
+    GEG_CORE_INFO(
+        "{} vertices: old loop {:.3f} ms, accessors {:.3f} ms, quantized accessors {:.3f} ms",
+        count,
+        old_ms,
+        new_ms,
+        quantized_ms);
+  }
+}    // namespace
+
+auto main(int argc, char** argv) -> int {
+  geg::Logger::init();
+
+  const uint32_t runs = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 200;
+  run(32 * 1024, runs);
+  run(1024 * 1024, runs);
+  return 0;
+}
@@ -0,0 +1,471 @@
+#include "block-compression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include "assets/cooked-assets.hpp"
+#include "core/job-system.hpp"
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+namespace geg::cook {
+  namespace {
+    template<int N>
+    using Texels = std::array<glm::vec<N, float>, 16>;
+
+    // bc7 and bc6h interpolation weights out of 64
+    constexpr std::array<uint32_t, 16> k_weights4 = {
+        0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // bits are written from the lowest bit of the first byte up
+    struct BitWriter {
+      uint8_t* out;
+      uint32_t bit = 0;
+
+      void put(uint32_t value, uint32_t bits) {
+        for (uint32_t i = 0; i < bits; i++, bit++)
+          out[bit / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (bit % 8));
+      }
+    };
+
+    template<int N>
+    void bounding_box(const Texels<N>& texels, glm::vec<N, float>& lo, glm::vec<N, float>& hi) {
+      lo = hi = texels[0];
+      for (const auto& texel : texels) {
+        lo = glm::min(lo, texel);
+        hi = glm::max(hi, texel);
+      }
+    }
+
+    // the segment the texels lie closest to, the principal axis through their mean clipped to
+    // the texels' projections
+    template<int N>
+    void fit_endpoints(const Texels<N>& texels, glm::vec<N, float>& lo, glm::vec<N, float>& hi) {
+      using Vec = glm::vec<N, float>;
+
+      Vec mean(0);
+      for (const auto& texel : texels)
+        mean += texel;
+      mean /= 16.0f;
+
+      glm::mat<N, N, float> covariance(0);
+      for (const auto& texel : texels) {
+        const auto d = texel - mean;
+        covariance += glm::outerProduct(d, d);
+      }
+
+      // power iteration, starting from the bounding box diagonal
+      Vec min_texel, max_texel;
+      bounding_box(texels, min_texel, max_texel);
+      Vec axis = max_texel - min_texel;
+      for (uint32_t i = 0; i < 8; i++) {
+        const auto next = covariance * axis;
+        const auto length = glm::length(next);
+        if (length < 1e-8f) break;
+        axis = next / length;
+      }
+
+      const auto length = glm::length(axis);
+      if (length < 1e-8f) {
+        lo = hi = mean;
+        return;
+      }
+      axis /= length;
+
+      float t_min = 0, t_max = 0;
+      for (const auto& texel : texels) {
+        const auto t = glm::dot(texel - mean, axis);
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+      }
+
+      lo = mean + axis * t_min;
+      hi = mean + axis * t_max;
+    }
+
+    // least squares endpoints for fixed weights (0-64), false when the weights don't span the
+    // segment
+    template<int N>
+    bool refine_endpoints(
+        const Texels<N>& texels,
+        const std::array<uint32_t, 16>& weights,
+        glm::vec<N, float>& lo,
+        glm::vec<N, float>& hi) {
+      float aa = 0, ab = 0, bb = 0;
+      glm::vec<N, float> ax(0), bx(0);
+      for (uint32_t i = 0; i < 16; i++) {
+        const auto b = weights[i] / 64.0f;
+        const auto a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ax += a * texels[i];
+        bx += b * texels[i];
+      }
+
+      const auto det = aa * bb - ab * ab;
+      if (std::abs(det) < 1e-6f) return false;
+
+      lo = (ax * bb - bx * ab) / det;
+      hi = (bx * aa - ax * ab) / det;
+      return true;
+    }
+
+    // every encoder quantizes these and keeps the one with the least error: the principal
+    // axis, the bounding box (better when an outlier bends the axis) and a least squares
+    // refit of the best of those two
+    template<int N, typename Candidate, typename Quantize>
+    Candidate best_candidate(
+        const Texels<N>& texels, const std::array<uint32_t, 16>& weights, Quantize&& quantize) {
+      std::array<glm::vec<N, float>, 2> pca, box;
+      fit_endpoints(texels, pca[0], pca[1]);
+      bounding_box(texels, box[0], box[1]);
+
+      Candidate best;
+      quantize(texels, pca[0], pca[1], best);
+      quantize(texels, box[0], box[1], best);
+
+      std::array<uint32_t, 16> fitted;
+      for (uint32_t i = 0; i < 16; i++)
+        fitted[i] = weights[best.indices[i]];
+
+      auto refined = pca;
+      if (refine_endpoints(texels, fitted, refined[0], refined[1]))
+        quantize(texels, refined[0], refined[1], best);
+
+      return best;
+    }
+
+    template<typename T>
+    void fetch_block(
+        const T* texels,
+        uint32_t width,
+        uint32_t height,
+        uint32_t bx,
+        uint32_t by,
+        std::array<glm::vec4, 16>& block) {
+      for (uint32_t y = 0; y < 4; y++) {
+        const auto sy = std::min(by * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+          const auto sx = std::min(bx * 4 + x, width - 1);
+          const auto* texel = texels + (size_t(sy) * width + sx) * 4;
+          block[y * 4 + x] = {texel[0], texel[1], texel[2], texel[3]};
+        }
+      }
+    }
+
+    // ---------------------------------------- bc1 ---------------------------------------
+    uint16_t pack_565(const glm::vec3& color) {
+      const auto c = glm::clamp(color, 0.0f, 255.0f);
+      const auto r = static_cast<uint16_t>(std::lround(c.r * 31 / 255.0f));
+      const auto g = static_cast<uint16_t>(std::lround(c.g * 63 / 255.0f));
+      const auto b = static_cast<uint16_t>(std::lround(c.b * 31 / 255.0f));
+      return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    glm::vec3 unpack_565(uint16_t color) {
+      const uint32_t r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+      return {float(r << 3 | r >> 2), float(g << 2 | g >> 4), float(b << 3 | b >> 2)};
+    }
+
+    // weights of the four colors out of 64, the thirds rounded, only the first 4 are used
+    constexpr std::array<uint32_t, 16> k_bc1_weights = {0, 64, 21, 43};
+
+    struct Bc1Candidate {
+      uint16_t c0 = 0, c1 = 0;
+      std::array<uint32_t, 16> indices{};
+      float error = INFINITY;
+    };
+
+    void quantize_bc1(
+        const Texels<3>& texels, const glm::vec3& a, const glm::vec3& b, Bc1Candidate& best) {
+      Bc1Candidate candidate{.c0 = pack_565(a), .c1 = pack_565(b), .error = 0};
+      // the four color mode needs c0 > c1, equal endpoints just use index 0
+      if (candidate.c0 < candidate.c1) std::swap(candidate.c0, candidate.c1);
+
+      const auto p0 = unpack_565(candidate.c0), p1 = unpack_565(candidate.c1);
+      std::array<glm::vec3, 4> palette = {p0, p1, (2.0f * p0 + p1) / 3.0f, (p0 + 2.0f * p1) / 3.0f};
+      const uint32_t colors = candidate.c0 == candidate.c1 ? 1 : 4;
+
+      for (uint32_t i = 0; i < 16; i++) {
+        float best_error = INFINITY;
+        for (uint32_t p = 0; p < colors; p++) {
+          const auto d = texels[i] - palette[p];
+          if (const auto error = glm::dot(d, d); error < best_error) {
+            best_error = error;
+            candidate.indices[i] = p;
+          }
+        }
+        candidate.error += best_error;
+      }
+
+      if (candidate.error < best.error) best = candidate;
+    }
+
+    void encode_bc1(const std::array<glm::vec4, 16>& block, uint8_t* out) {
+      Texels<3> texels;
+      for (uint32_t i = 0; i < 16; i++)
+        texels[i] = glm::vec3(block[i]);
+
+      const auto best = best_candidate<3, Bc1Candidate>(texels, k_bc1_weights, quantize_bc1);
+
+      uint32_t indices = 0;
+      for (uint32_t i = 0; i < 16; i++)
+        indices |= best.indices[i] << (i * 2);
+
+      std::memcpy(out, &best.c0, 2);
+      std::memcpy(out + 2, &best.c1, 2);
+      std::memcpy(out + 4, &indices, 4);
+    }
+
+    // ------------------------------------- bc4 / bc5 ------------------------------------
+    void encode_bc4(const std::array<glm::vec4, 16>& block, uint32_t channel, uint8_t* out) {
+      float lo = 255, hi = 0;
+      for (const auto& texel : block) {
+        lo = std::min(lo, texel[channel]);
+        hi = std::max(hi, texel[channel]);
+      }
+
+      // a0 > a1 selects the 8 value mode
+      const auto a0 = static_cast<uint8_t>(std::lround(hi));
+      const auto a1 = static_cast<uint8_t>(std::lround(lo));
+      out[0] = a0;
+      out[1] = a1;
+
+      uint64_t indices = 0;
+      if (a0 > a1) {
+        std::array<float, 8> palette = {float(a0), float(a1)};
+        for (uint32_t i = 2; i < 8; i++)
+          palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+
+        for (uint32_t i = 0; i < 16; i++) {
+          uint64_t best = 0;
+          float best_error = INFINITY;
+          for (uint32_t p = 0; p < 8; p++) {
+            if (const auto error = std::abs(block[i][channel] - palette[p]); error < best_error) {
+              best_error = error;
+              best = p;
+            }
+          }
+          indices |= best << (i * 3);
+        }
+      }
+
+      std::memcpy(out + 2, &indices, 6);
+    }
+
+    void encode_bc5(const std::array<glm::vec4, 16>& block, uint8_t* out) {
+      encode_bc4(block, 0, out);
+      encode_bc4(block, 1, out + 8);
+    }
+
+    // ------------------------------------- bc7 mode 6 -----------------------------------
+    struct Bc7Candidate {
+      std::array<glm::uvec4, 2> endpoints;
+      std::array<uint32_t, 2> pbits;
+      std::array<uint32_t, 16> indices;
+      float error = INFINITY;
+    };
+
+    // 7 bit endpoints plus a shared low bit each, every pbit pair is tried
+    void quantize_bc7(
+        const Texels<4>& texels, const glm::vec4& lo, const glm::vec4& hi, Bc7Candidate& best) {
+      for (uint32_t p = 0; p < 4; p++) {
+        Bc7Candidate candidate{.pbits = {p & 1, p >> 1}, .error = 0};
+        std::array<glm::vec4, 2> colors;
+        for (uint32_t e = 0; e < 2; e++) {
+          const auto value = glm::clamp(e == 0 ? lo : hi, 0.0f, 255.0f);
+          const auto q = glm::clamp(
+              glm::round((value - float(candidate.pbits[e])) / 2.0f), 0.0f, 127.0f);
+          candidate.endpoints[e] = glm::uvec4(q);
+          colors[e] = glm::vec4(candidate.endpoints[e] << 1u | candidate.pbits[e]);
+        }
+
+        std::array<glm::vec4, 16> palette;
+        for (uint32_t w = 0; w < 16; w++)
+          palette[w] = glm::floor(
+              ((64.0f - k_weights4[w]) * colors[0] + float(k_weights4[w]) * colors[1] + 32.0f) /
+              64.0f);
+
+        for (uint32_t i = 0; i < 16; i++) {
+          float best_error = INFINITY;
+          for (uint32_t w = 0; w < 16; w++) {
+            const auto d = texels[i] - palette[w];
+            if (const auto error = glm::dot(d, d); error < best_error) {
+              best_error = error;
+              candidate.indices[i] = w;
+            }
+          }
+          candidate.error += best_error;
+        }
+
+        if (candidate.error < best.error) best = candidate;
+      }
+    }
+
+    void encode_bc7(const Texels<4>& texels, uint8_t* out) {
+      auto best = best_candidate<4, Bc7Candidate>(texels, k_weights4, quantize_bc7);
+
+      // the first index drops its top bit, it has to be in the lower half
+      if (best.indices[0] & 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.pbits[0], best.pbits[1]);
+        for (auto& index : best.indices)
+          index = 15 - index;
+      }
+
+      std::memset(out, 0, 16);
+      BitWriter bits{out};
+      bits.put(1 << 6, 7);
+      for (uint32_t c = 0; c < 4; c++)
+        for (uint32_t e = 0; e < 2; e++)
+          bits.put(best.endpoints[e][c], 7);
+      bits.put(best.pbits[0], 1);
+      bits.put(best.pbits[1], 1);
+      for (uint32_t i = 0; i < 16; i++)
+        bits.put(best.indices[i], i == 0 ? 3 : 4);
+    }
+
+    // ------------------------------------ bc6h mode 11 ----------------------------------
+    // the endpoints are fitted in the space the decoder interpolates in, the bits of the half
+    // floats scaled by 64 / 31
+    float to_bc6h_space(float value) {
+      const auto half = glm::packHalf1x16(std::clamp(value, 0.0f, 65504.0f));
+      return half * 64.0f / 31.0f;
+    }
+
+    // errors are measured on log2(1 + x) of the decoded values, linear for dark texels and
+    // logarithmic for bright ones, the bits alone would make exact zeros outweigh everything
+    float bc6h_error_space(float value) { return std::log2(1.0f + std::max(value, 0.0f)); }
+
+    uint32_t unquantize_bc6h(uint32_t q) {
+      if (q == 0) return 0;
+      if (q == 1023) return 0xFFFF;
+      return ((q << 16) + 0x8000) >> 10;
+    }
+
+    struct Bc6hCandidate {
+      std::array<glm::uvec3, 2> endpoints;
+      std::array<uint32_t, 16> indices;
+      float error = INFINITY;
+    };
+
+    struct Bc6hBlock {
+      // in bc6h space, what the endpoints are fitted to
+      Texels<3> texels;
+      // in error space
+      Texels<3> targets;
+    };
+
+    void quantize_bc6h(
+        const Bc6hBlock& block, const glm::vec3& lo, const glm::vec3& hi, Bc6hCandidate& best) {
+      Bc6hCandidate candidate{.error = 0};
+      std::array<glm::uvec3, 2> colors;
+      for (uint32_t e = 0; e < 2; e++) {
+        const auto value = e == 0 ? lo : hi;
+        for (uint32_t c = 0; c < 3; c++) {
+          candidate.endpoints[e][c] = static_cast<uint32_t>(
+              std::clamp(std::round((value[c] - 32.0f) / 64.0f), 0.0f, 1023.0f));
+          colors[e][c] = unquantize_bc6h(candidate.endpoints[e][c]);
+        }
+      }
+
+      std::array<glm::vec3, 16> palette;
+      for (uint32_t w = 0; w < 16; w++) {
+        for (uint32_t c = 0; c < 3; c++) {
+          const auto bits =
+              ((64 - k_weights4[w]) * colors[0][c] + k_weights4[w] * colors[1][c] + 32) >> 6;
+          palette[w][c] =
+              bc6h_error_space(glm::unpackHalf1x16(static_cast<uint16_t>((bits * 31) >> 6)));
+        }
+      }
+
+      for (uint32_t i = 0; i < 16; i++) {
+        float best_error = INFINITY;
+        for (uint32_t w = 0; w < 16; w++) {
+          const auto d = block.targets[i] - palette[w];
+          if (const auto error = glm::dot(d, d); error < best_error) {
+            best_error = error;
+            candidate.indices[i] = w;
+          }
+        }
+        candidate.error += best_error;
+      }
+
+      if (candidate.error < best.error) best = candidate;
+    }
+
+    void encode_bc6h(const std::array<glm::vec4, 16>& block, uint8_t* out) {
+      Bc6hBlock bc6h;
+      for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t c = 0; c < 3; c++) {
+          bc6h.texels[i][c] = to_bc6h_space(block[i][c]);
+          bc6h.targets[i][c] = bc6h_error_space(block[i][c]);
+        }
+      }
+
+      auto best = best_candidate<3, Bc6hCandidate>(
+          bc6h.texels,
+          k_weights4,
+          [&](const Texels<3>&, const glm::vec3& lo, const glm::vec3& hi, Bc6hCandidate& best) {
+            quantize_bc6h(bc6h, lo, hi, best);
+          });
+
+      // the first index drops its top bit, it has to be in the lower half
+      if (best.indices[0] & 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        for (auto& index : best.indices)
+          index = 15 - index;
+      }
+
+      std::memset(out, 0, 16);
+      BitWriter bits{out};
+      bits.put(0x03, 5);
+      for (uint32_t e = 0; e < 2; e++)
+        for (uint32_t c = 0; c < 3; c++)
+          bits.put(best.endpoints[e][c], 10);
+      for (uint32_t i = 0; i < 16; i++)
+        bits.put(best.indices[i], i == 0 ? 3 : 4);
+    }
+  }    // namespace
+
+  std::vector<uint8_t> compress_level(
+      vk::Format format, const std::vector<uint8_t>& level, uint32_t width, uint32_t height) {
+    const auto blocks_x = (width + 3) / 4;
+    const auto blocks_y = (height + 3) / 4;
+    const auto block_size = cooked::block_size(format);
+    std::vector<uint8_t> out(size_t(blocks_x) * blocks_y * block_size);
+
+    void (*encode)(const std::array<glm::vec4, 16>&, uint8_t*) = nullptr;
+    switch (format) {
+      case vk::Format::eBc1RgbUnormBlock:
+      case vk::Format::eBc1RgbSrgbBlock: encode = encode_bc1; break;
+      case vk::Format::eBc5UnormBlock: encode = encode_bc5; break;
+      case vk::Format::eBc6HUfloatBlock: encode = encode_bc6h; break;
+      case vk::Format::eBc7UnormBlock:
+      case vk::Format::eBc7SrgbBlock: encode = encode_bc7; break;
+      default: GEG_CORE_ASSERT(false, "no encoder for {}", vk::to_string(format));
+    }
+
+    const bool is_float = format == vk::Format::eBc6HUfloatBlock;
+    // big levels are split over the workers by rows of blocks
+    JobSystem::get().parallel_for(blocks_y, 4, [&](uint32_t begin, uint32_t end) {
+      std::array<glm::vec4, 16> block;
+      for (uint32_t by = begin; by < end; by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+          if (is_float)
+            fetch_block(
+                reinterpret_cast<const float*>(level.data()), width, height, bx, by, block);
+          else
+            fetch_block(level.data(), width, height, bx, by, block);
+
+          encode(block, out.data() + (size_t(by) * blocks_x + bx) * block_size);
+        }
+      }
+    });
+
+    return out;
+  }
+}    // namespace geg::cook
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include "pch.hpp"
+#include "vulkan/geg-vulkan.hpp"
+
+namespace geg::cook {
+  // cpu encoders for the bc formats the cooker writes, one fixed mode each:
+  //   bc1  opaque color, 4 color mode
+  //   bc5  two bc4 channels, red and green
+  //   bc7  mode 6, one subset with rgba endpoints
+  //   bc6h mode 11, one region with 10 bit unsigned endpoints
+  // the endpoints are fitted along the principal axis of the block and refined once
+
+  // level is rgba8 for bc1, bc5 and bc7 and rgba32f for bc6h, edge blocks of sizes that aren't
+  // multiples of 4 repeat the last row and column
+  std::vector<uint8_t> compress_level(
+      vk::Format format, const std::vector<uint8_t>& level, uint32_t width, uint32_t height);
+}    // namespace geg::cook
@@ -0,0 +1,331 @@
+#include "cooker.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include "assets/cooked-assets.hpp"
+#include "assets/importers.hpp"
+#include "assets/scene-file.hpp"
+#include "core/job-system.hpp"
+#include "ecs/entity.hpp"
+#include "texture-cooker.hpp"
+#include "utils/hash.hpp"
+
+namespace geg::cook {
+  namespace {
+    // bump when a cook step writes something different so every output is cooked again
+    constexpr uint64_t k_cooker_version = 6;
+
+    std::string extension_of(const fs::path& path) {
+      auto extension = path.extension().string();
+      std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+      });
+      return extension;
+    }
+
+    std::string texture_ref(const TextureSource& texture) {
+      return std::to_string(static_cast<int32_t>(texture.format)) + " " + texture.path.string();
+    }
+
+    TextureSource parse_texture_ref(const std::string& ref) {
+      const auto space = ref.find(' ');
+      if (space == std::string::npos) return {};
+
+      return {
+          .path = ref.substr(space + 1),
+          .format = static_cast<vk::Format>(std::stoi(ref.substr(0, space))),
+      };
+    }
+
+    // the scene writer's view of a scene that only exists in the cooker, the handles index
+    // the vectors directly
+    class SceneAssets final : public SceneFileAssets {
+    public:
+      // the lods are built here so loading the scene doesn't have to
+      MeshId add_mesh(std::span<const vulkan::Vertex> vertices, vulkan::IndexView indices) {
+        vulkan::Indices chain;
+        auto& mesh = m_meshs.emplace_back();
+        mesh.lods = vulkan::build_lods(vertices, indices, chain);
+        mesh.vertices_size = vertices.size_bytes();
+        mesh.index_type = chain.type;
+        mesh.data.resize(vertices.size_bytes() + chain.data.size());
+        std::memcpy(mesh.data.data(), vertices.data(), vertices.size_bytes());
+        std::memcpy(
+            mesh.data.data() + vertices.size_bytes(), chain.data.data(), chain.data.size());
+
+        return {.index = static_cast<uint32_t>(m_meshs.size() - 1), .generation = 1};
+      }
+
+      TextureId add_texture(AssetManager::TextureInfo info) {
+        m_textures.push_back(std::move(info));
+        return {.index = static_cast<uint32_t>(m_textures.size() - 1), .generation = 1};
+      }
+
+      MaterialId add_material(const Material& material) {
+        m_materials.push_back(material);
+        return {.index = static_cast<uint32_t>(m_materials.size() - 1), .generation = 1};
+      }
+
+      // the writer asks for every mesh once
+      SceneFileMesh mesh(MeshId id) override { return std::move(m_meshs[id.index]); }
+      AssetManager::TextureInfo texture(TextureId id) override { return m_textures[id.index]; }
+      Material material(MaterialId id) override { return m_materials[id.index]; }
+
+    private:
+      std::vector<SceneFileMesh> m_meshs;
+      std::vector<AssetManager::TextureInfo> m_textures;
+      std::vector<Material> m_materials;
+    };
+  }    // namespace
+
+  Cooker::Cooker(CookSettings settings):
+      m_settings(std::move(settings)),
+      m_manifest_path(m_settings.output_root / "cook-manifest.txt") {}
+
+  bool Cooker::run() {
+    if (!fs::is_directory(m_settings.source_root)) {
+      GEG_CORE_ERROR("{} isn't a directory", m_settings.source_root.string());
+      return false;
+    }
+
+    if (!m_settings.force) m_manifest.load(m_manifest_path);
+
+    std::vector<Item> items;
+    gather(items);
+
+    // scenes and models first, they tell which textures have to be cooked in which format
+    std::vector<Item> textures;
+    std::vector<std::vector<std::string>> refs(items.size());
+    std::erase_if(items, [&](const Item& item) {
+      if (item.kind != Kind::Texture) return false;
+      textures.push_back(item);
+      return true;
+    });
+
+    const auto items_count = static_cast<uint32_t>(items.size());
+    JobSystem::get().parallel_for(items_count, 1, [&](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; i++)
+        cook(items[i], refs[i]);
+    });
+
+    // a texture used by several scenes, or a scene and the tree, is cooked once per format
+    std::unordered_map<std::string, size_t> texture_indices;
+    std::vector<Item> unique_textures;
+    const auto add_texture = [&](Item item) {
+      if (texture_indices.try_emplace(item.output.string(), unique_textures.size()).second)
+        unique_textures.push_back(std::move(item));
+    };
+
+    for (const auto& scene_refs : refs)
+      for (const auto& ref : scene_refs)
+        if (const auto texture = parse_texture_ref(ref))
+          add_texture(texture_item(texture.path, texture.format));
+    for (auto& texture : textures)
+      add_texture(std::move(texture));
+
+    const auto textures_count = static_cast<uint32_t>(unique_textures.size());
+    JobSystem::get().parallel_for(textures_count, 1, [&](uint32_t begin, uint32_t end) {
+      std::vector<std::string> unused;
+      for (uint32_t i = begin; i < end; i++)
+        cook(unique_textures[i], unused);
+    });
+
+    if (const auto pruned = m_manifest.prune())
+      GEG_CORE_INFO("dropped {} outputs of removed sources from the manifest", pruned);
+    m_manifest.save(m_manifest_path);
+    GEG_CORE_INFO(
+        "cooked {} assets, {} up to date, {} failed",
+        m_cooked.load(),
+        m_skipped.load(),
+        m_failed.load());
+
+    return m_failed == 0;
+  }
+
+  void Cooker::gather(std::vector<Item>& items) const {
+    const auto output_root = fs::weakly_canonical(m_settings.output_root);
+
+    auto it = fs::recursive_directory_iterator(m_settings.source_root);
+    for (; it != fs::recursive_directory_iterator(); ++it) {
+      const auto& entry = *it;
+      if (entry.is_directory()) {
+        // cooking into a folder of the source tree must not pick up its own outputs
+        if (fs::weakly_canonical(entry.path()) == output_root) it.disable_recursion_pending();
+        continue;
+      }
+      if (!entry.is_regular_file()) continue;
+
+      const auto& path = entry.path();
+      const auto extension = extension_of(path);
+      if (extension == ".gltf" || extension == ".glb")
+        items.push_back({
+            .kind = Kind::Scene,
+            .source = path,
+            .output = output_path(path, path.filename().replace_extension(".gegs")),
+        });
+      else if (extension == ".obj" || extension == ".fbx")
+        items.push_back({
+            .kind = Kind::Model,
+            .source = path,
+            .output = output_path(path, path.filename().string() + ".gegm"),
+        });
+      else if (extension == ".hdr")
+        items.push_back(
+            texture_item(path, target_format(vk::Format::eR32G32B32A32Sfloat, false)));
+      else if (
+          extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+          extension == ".tga")
+        items.push_back(texture_item(path, target_format(vk::Format::eR8G8B8A8Srgb, false)));
+    }
+  }
+
+  fs::path Cooker::output_path(const fs::path& source, const fs::path& file_name) const {
+    const auto canonical = fs::weakly_canonical(source);
+    const auto root = fs::weakly_canonical(m_settings.source_root);
+    const auto relative = canonical.lexically_relative(root);
+    if (!relative.empty() && *relative.begin() != "..")
+      return m_settings.output_root / relative.parent_path() / file_name;
+
+    // scenes can reference files outside the tree, they get a folder per source folder
+    const auto folder = canonical.parent_path().string();
+    return m_settings.output_root / "external" /
+           fmt::format("{:016x}", hash_string(folder)) / file_name;
+  }
+
+  Cooker::Item Cooker::texture_item(const fs::path& source, vk::Format format) const {
+    return {
+        .kind = Kind::Texture,
+        .source = source,
+        .output = output_path(source, cooked::texture_file_name(source, format)),
+        .format = format,
+    };
+  }
+
+  vk::Format Cooker::target_format(vk::Format source_format, bool normal_map) const {
+    if (!m_settings.compress) return source_format;
+
+    switch (source_format) {
+      case vk::Format::eR32G32B32A32Sfloat: return vk::Format::eBc6HUfloatBlock;
+      case vk::Format::eR8G8B8A8Srgb:
+        return m_settings.bc1_color ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc7SrgbBlock;
+      default:
+        if (normal_map) return vk::Format::eBc5UnormBlock;
+        return m_settings.bc1_color ? vk::Format::eBc1RgbUnormBlock : vk::Format::eBc7UnormBlock;
+    }
+  }
+
+  uint64_t Cooker::settings_hash(const Item& item) {
+    const uint32_t settings[] = {
+        static_cast<uint32_t>(item.kind),
+        static_cast<uint32_t>(item.format),
+    };
+    return hash_bytes(settings, sizeof(settings), k_cooker_version);
+  }
+
+  bool Cooker::cook(const Item& item, std::vector<std::string>& refs) {
+    const auto settings = settings_hash(item);
+    if (!m_settings.force)
+      if (const auto* entry = m_manifest.up_to_date(item.output, settings)) {
+        refs = entry->refs;
+        m_skipped++;
+        return true;
+      }
+
+    bool res = false;
+    switch (item.kind) {
+      case Kind::Scene: res = cook_scene(item, refs); break;
+      case Kind::Model: res = cook_model(item); break;
+      case Kind::Texture: res = cook_texture(item); break;
+    }
+
+    if (!res) {
+      GEG_CORE_ERROR("failed to cook {}", item.source.string());
+      m_failed++;
+      return false;
+    }
+
+    GEG_CORE_INFO("cooked {} -> {}", item.source.string(), item.output.string());
+    m_cooked++;
+    return true;
+  }
+
+  bool Cooker::cook_scene(const Item& item, std::vector<std::string>& refs) {
+    ImportedScene imported;
+    if (!import_gltf(item.source, imported)) return false;
+
+    SceneAssets assets;
+    Scene scene;
+
+    // same sharing as AssetManager::load_scene, the textures point at their cooked files
+    std::vector<MaterialId> materials(imported.materials.size());
+    const auto material_id = [&](int32_t index) {
+      if (index < 0) return assets.add_material(Material{});
+      if (materials[index]) return materials[index];
+
+      const auto& source = imported.materials[index];
+      auto material = source.material;
+      for (size_t i = 0; i < source.textures.size(); i++) {
+        if (!source.textures[i]) continue;
+
+        // normal maps only keep x and y, the shader rebuilds z
+        const bool normal_map = k_material_textures[i] == &Material::normal_map;
+        const TextureSource texture = {
+            .path = source.textures[i].path,
+            .format = target_format(source.textures[i].format, normal_map),
+        };
+
+        refs.push_back(texture_ref(texture));
+        // the cooked file brings its own mip chain
+        material.*k_material_textures[i] = assets.add_texture({
+            .path = texture_item(texture.path, texture.format).output,
+            .mip_maps = 1,
+            .format = texture.format,
+        });
+      }
+
+      return materials[index] = assets.add_material(material);
+    };
+
+    for (const auto& primitive : imported.primitives) {
+      Entity entt = scene.create_entity(primitive.name);
+      entt.add_component<components::Material>(material_id(primitive.material));
+      entt.get_component<components::Transform>() = primitive.transform;
+      entt.add_component<components::Mesh>(assets.add_mesh(primitive.vertices, primitive.indices));
+      // like load_scene, whoever loads the file bakes the batches
+      entt.add_component<components::Static>();
+    }
+
+    if (!save_scene_file(scene, item.output, assets)) return false;
+
+    auto dependencies = imported.buffers;
+    dependencies.insert(dependencies.begin(), item.source);
+    return m_manifest.record(item.output, settings_hash(item), dependencies, refs);
+  }
+
+  bool Cooker::cook_model(const Item& item) {
+    std::vector<vulkan::Vertex> vertices;
+    vulkan::Indices indices;
+    if (!import_mesh(item.source, vertices, indices)) return false;
+
+    const auto content_id =
+        vulkan::Mesh::content_hash(std::as_bytes(std::span(vertices)), indices.data);
+    vulkan::Indices chain;
+    const auto lods = vulkan::build_lods(vertices, indices, chain);
+    if (!cooked::write_mesh(item.output, vertices, chain, lods, content_id)) return false;
+
+    return m_manifest.record(item.output, settings_hash(item), {item.source});
+  }
+
+  bool Cooker::cook_texture(const Item& item) {
+    CookedImage image;
+    if (!cook_image(item.source, item.format, image)) return false;
+    if (!cooked::write_texture(item.output, image.format, image.width, image.height, image.levels))
+      return false;
+
+    return m_manifest.record(item.output, settings_hash(item), {item.source});
+  }
+}    // namespace geg::cook
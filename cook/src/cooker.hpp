@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "pch.hpp"
+#include "manifest.hpp"
+#include "vulkan/geg-vulkan.hpp"
+
+namespace geg::cook {
+  struct CookSettings {
+    fs::path source_root;
+    // cooked scenes reference their textures by this path, it should be relative to the
+    // directory the game runs in
+    fs::path output_root;
+    // ignores the manifest and cooks everything
+    bool force = false;
+    // bc7 for color, bc5 for normal maps and bc6h for hdr, otherwise rgba8 and rgba32f
+    bool compress = true;
+    // bc1 instead of bc7 for color, half the size, drops the alpha
+    bool bc1_color = false;
+  };
+
+  // mirrors the source tree into the output:
+  //   .gltf .glb -> .gegs with inline meshes, the textures they use are cooked too
+  //   .obj .fbx  -> .gegm, the first mesh like the runtime importer
+  //   .hdr       -> hdr .ktx2
+  //   .png .jpg .jpeg .tga -> srgb color .ktx2, unless a scene uses them in another way
+  // every texture gets its whole mip chain, JobSystem::init must be called first
+  class Cooker {
+  public:
+    explicit Cooker(CookSettings settings);
+
+    // false if any asset failed, the others are still cooked
+    bool run();
+
+  private:
+    enum class Kind : uint32_t { Scene, Model, Texture };
+
+    struct Item {
+      Kind kind;
+      fs::path source;
+      fs::path output;
+      vk::Format format = vk::Format::eUndefined;
+    };
+
+    void gather(std::vector<Item>& items) const;
+    fs::path output_path(const fs::path& source, const fs::path& file_name) const;
+    Item texture_item(const fs::path& source, vk::Format format) const;
+    // what a texture loaded as source_format is cooked to
+    vk::Format target_format(vk::Format source_format, bool normal_map) const;
+    static uint64_t settings_hash(const Item& item);
+
+    // refs get the textures the item needs, format then path
+    bool cook(const Item& item, std::vector<std::string>& refs);
+    bool cook_scene(const Item& item, std::vector<std::string>& refs);
+    bool cook_model(const Item& item);
+    bool cook_texture(const Item& item);
+
+    CookSettings m_settings;
+    Manifest m_manifest;
+    fs::path m_manifest_path;
+
+    std::atomic<uint32_t> m_cooked = 0;
+    std::atomic<uint32_t> m_skipped = 0;
+    std::atomic<uint32_t> m_failed = 0;
+  };
+}    // namespace geg::cook
@@ -0,0 +1,39 @@
+#include <cstring>
+
+#include "pch.hpp"
+#include "core/job-system.hpp"
+#include "cooker.hpp"
+
+// geg-cook <source dir> <output dir> [--force] [--uncompressed] [--bc1]
+// run it from the directory the game runs in, the cooked scenes reference their textures
+// by <output dir>/...
+auto main(int argc, char** argv) -> int {
+  geg::Logger::init();
+
+  geg::cook::CookSettings settings;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--force") == 0)
+      settings.force = true;
+    else if (std::strcmp(argv[i], "--uncompressed") == 0)
+      settings.compress = false;
+    else if (std::strcmp(argv[i], "--bc1") == 0)
+      settings.bc1_color = true;
+    else
+      paths.push_back(argv[i]);
+  }
+
+  if (paths.size() != 2) {
+    GEG_CORE_ERROR("usage: geg-cook <source dir> <output dir> [--force] [--uncompressed] [--bc1]");
+    return 1;
+  }
+
+  settings.source_root = paths[0];
+  settings.output_root = paths[1];
+
+  geg::JobSystem::init();
+  const bool res = geg::cook::Cooker(settings).run();
+  geg::JobSystem::get().deinit();
+
+  return res ? 0 : 1;
+}
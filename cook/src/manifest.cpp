@@ -0,0 +1,153 @@
+#include "manifest.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include "utils/hash.hpp"
+#include "utils/mapped-file.hpp"
+
+namespace geg::cook {
+  namespace {
+    constexpr std::string_view k_header = "# geg-cook manifest v1";
+
+    std::string key(const fs::path& path) { return fs::absolute(path).lexically_normal().string(); }
+
+    std::string rest_of(std::istringstream& line) {
+      std::string rest;
+      std::getline(line >> std::ws, rest);
+      return rest;
+    }
+  }    // namespace
+
+  // one block per output:
+  //   output <path>
+  //   settings <hex>
+  //   dep <size> <mtime> <hash hex> <path>
+  //   ref <string>
+  // paths go last so they can hold spaces
+  bool Manifest::load(const fs::path& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    if (!std::getline(file, line) || line != k_header) {
+      GEG_CORE_WARN("{} isn't a cook manifest, cooking everything", path.string());
+      return false;
+    }
+
+    std::lock_guard lock(m_mutex);
+    Entry* entry = nullptr;
+    while (std::getline(file, line)) {
+      std::istringstream stream(line);
+      std::string tag;
+      stream >> tag;
+
+      if (tag == "output") {
+        entry = &m_entries[rest_of(stream)];
+        *entry = {};
+      } else if (!entry) {
+        continue;
+      } else if (tag == "settings") {
+        stream >> std::hex >> entry->settings;
+      } else if (tag == "dep") {
+        Dependency dependency;
+        stream >> dependency.size >> dependency.mtime >> std::hex >> dependency.hash;
+        dependency.path = rest_of(stream);
+        entry->dependencies.push_back(std::move(dependency));
+      } else if (tag == "ref") {
+        entry->refs.push_back(rest_of(stream));
+      }
+    }
+
+    return true;
+  }
+
+  bool Manifest::save(const fs::path& path) const {
+    fs::create_directories(fs::absolute(path).parent_path());
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+      GEG_CORE_ERROR("can't write the cook manifest {}", path.string());
+      return false;
+    }
+
+    std::lock_guard lock(m_mutex);
+    file << k_header << '\n';
+    for (const auto& [output, entry] : m_entries) {
+      file << "output " << output << '\n';
+      file << "settings " << std::hex << entry.settings << std::dec << '\n';
+      for (const auto& dependency : entry.dependencies)
+        file << "dep " << dependency.size << ' ' << dependency.mtime << ' ' << std::hex
+             << dependency.hash << std::dec << ' ' << dependency.path.string() << '\n';
+      for (const auto& ref : entry.refs)
+        file << "ref " << ref << '\n';
+    }
+
+    return file.good();
+  }
+
+  Manifest::Entry* Manifest::find(const fs::path& output) {
+    auto output_key = key(output);
+    std::lock_guard lock(m_mutex);
+    const auto it = m_entries.find(output_key);
+    m_visited.insert(std::move(output_key));
+    return it == m_entries.end() ? nullptr : &it->second;
+  }
+
+  const Manifest::Entry* Manifest::up_to_date(const fs::path& output, uint64_t settings) {
+    auto* entry = find(output);
+    if (!entry || entry->settings != settings || !fs::exists(output)) return nullptr;
+
+    for (auto& dependency : entry->dependencies) {
+      std::error_code error;
+      const auto size = fs::file_size(dependency.path, error);
+      if (error || size != dependency.size) return nullptr;
+
+      const auto mtime = fs::last_write_time(dependency.path, error).time_since_epoch().count();
+      if (error) return nullptr;
+      if (mtime == dependency.mtime) continue;
+
+      Dependency current;
+      if (!stamp(dependency.path, current) || current.hash != dependency.hash) return nullptr;
+      dependency.mtime = current.mtime;
+    }
+
+    return entry;
+  }
+
+  bool Manifest::record(
+      const fs::path& output,
+      uint64_t settings,
+      const std::vector<fs::path>& dependencies,
+      std::vector<std::string> refs) {
+    Entry entry{.settings = settings, .refs = std::move(refs)};
+    for (const auto& path : dependencies) {
+      auto& dependency = entry.dependencies.emplace_back();
+      if (!stamp(path, dependency)) return false;
+    }
+
+    auto output_key = key(output);
+    std::lock_guard lock(m_mutex);
+    m_entries[output_key] = std::move(entry);
+    m_visited.insert(std::move(output_key));
+    return true;
+  }
+
+  size_t Manifest::prune() {
+    std::lock_guard lock(m_mutex);
+    return std::erase_if(
+        m_entries, [this](const auto& entry) { return !m_visited.contains(entry.first); });
+  }
+
+  bool Manifest::stamp(const fs::path& path, Dependency& dependency) {
+    MappedFile file(path);
+    if (!file.is_open()) return false;
+
+    std::error_code error;
+    dependency.path = fs::absolute(path).lexically_normal();
+    dependency.size = file.size();
+    dependency.mtime = fs::last_write_time(path, error).time_since_epoch().count();
+    dependency.hash = hash_bytes(file.data(), file.size());
+
+    return !error;
+  }
+}    // namespace geg::cook
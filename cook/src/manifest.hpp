@@ -0,0 +1,61 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "pch.hpp"
+
+namespace geg::cook {
+  // what every output was cooked from, lets a run skip the outputs whose sources didn't change
+  // a source counts as unchanged when its size and mtime match, when only the mtime moved
+  // (checkout, copy) its content hash decides and the new mtime is remembered
+  // up_to_date and record can be called from any thread, one output per thread at a time
+  class Manifest {
+  public:
+    struct Dependency {
+      fs::path path;
+      uint64_t size = 0;
+      int64_t mtime = 0;
+      uint64_t hash = 0;
+    };
+
+    struct Entry {
+      // the cooker version and the settings the output was cooked with
+      uint64_t settings = 0;
+      std::vector<Dependency> dependencies;
+      // whatever the cook step wants back when it's skipped, scenes keep the textures they use
+      std::vector<std::string> refs;
+    };
+
+    bool load(const fs::path& path);
+    bool save(const fs::path& path) const;
+
+    // null when the output has to be cooked again
+    const Entry* up_to_date(const fs::path& output, uint64_t settings);
+    // stamps the dependencies, false if one of them can't be read
+    bool record(
+        const fs::path& output,
+        uint64_t settings,
+        const std::vector<fs::path>& dependencies,
+        std::vector<std::string> refs = {});
+
+    // drops the outputs no up_to_date or record call asked about since load, their sources
+    // were removed or renamed, returns how many
+    size_t prune();
+
+    size_t entries_count() const { return m_entries.size(); }
+
+  private:
+    static bool stamp(const fs::path& path, Dependency& dependency);
+    // the entry pointers stay valid while other threads insert
+    // marks the output visited
+    Entry* find(const fs::path& output);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::unordered_set<std::string> m_visited;
+  };
+}    // namespace geg::cook
@@ -0,0 +1,160 @@
+#include "texture-cooker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include "assets/cooked-assets.hpp"
+#include "block-compression.hpp"
+#include "stb_image.h"
+
+namespace geg::cook {
+  namespace {
+    float srgb_to_linear(float c) {
+      return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linear_to_srgb(float c) {
+      return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    const std::array<float, 256>& srgb_table() {
+      static const auto table = [] {
+        std::array<float, 256> t;
+        for (uint32_t i = 0; i < 256; i++)
+          t[i] = srgb_to_linear(i / 255.0f);
+        return t;
+      }();
+
+      return table;
+    }
+
+    uint8_t to_unorm8(float c) {
+      return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    // the four texels that fold into (x, y) of the next level, edges are clamped so odd
+    // sizes repeat their last row or column
+    template<typename Fn>
+    void box_filter(uint32_t width, uint32_t height, Fn&& fn) {
+      const auto next_width = std::max(width / 2, 1u);
+      const auto next_height = std::max(height / 2, 1u);
+
+      for (uint32_t y = 0; y < next_height; y++) {
+        const auto y0 = std::min(y * 2, height - 1);
+        const auto y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < next_width; x++) {
+          const auto x0 = std::min(x * 2, width - 1);
+          const auto x1 = std::min(x * 2 + 1, width - 1);
+          fn(y * next_width + x,
+             std::array<uint32_t, 4>{
+                 y0 * width + x0, y0 * width + x1, y1 * width + x0, y1 * width + x1});
+        }
+      }
+    }
+
+    std::vector<uint8_t> downsample_unorm(
+        const std::vector<uint8_t>& level, uint32_t width, uint32_t height, bool srgb) {
+      const auto& table = srgb_table();
+      std::vector<uint8_t> next(
+          size_t(std::max(width / 2, 1u)) * std::max(height / 2, 1u) * 4);
+
+      box_filter(width, height, [&](uint32_t out, const std::array<uint32_t, 4>& in) {
+        for (uint32_t c = 0; c < 4; c++) {
+          // alpha is always linear
+          if (srgb && c < 3) {
+            float sum = 0;
+            for (const auto texel : in)
+              sum += table[level[texel * 4 + c]];
+            next[out * 4 + c] = to_unorm8(linear_to_srgb(sum * 0.25f));
+          } else {
+            uint32_t sum = 2;
+            for (const auto texel : in)
+              sum += level[texel * 4 + c];
+            next[out * 4 + c] = static_cast<uint8_t>(sum / 4);
+          }
+        }
+      });
+
+      return next;
+    }
+
+    std::vector<uint8_t> downsample_float(
+        const std::vector<uint8_t>& level, uint32_t width, uint32_t height) {
+      const auto* texels = reinterpret_cast<const float*>(level.data());
+      std::vector<uint8_t> next(
+          size_t(std::max(width / 2, 1u)) * std::max(height / 2, 1u) * 4 * sizeof(float));
+      auto* out_texels = reinterpret_cast<float*>(next.data());
+
+      box_filter(width, height, [&](uint32_t out, const std::array<uint32_t, 4>& in) {
+        for (uint32_t c = 0; c < 4; c++) {
+          float sum = 0;
+          for (const auto texel : in)
+            sum += texels[texel * 4 + c];
+          out_texels[out * 4 + c] = sum * 0.25f;
+        }
+      });
+
+      return next;
+    }
+  }    // namespace
+
+  bool is_cookable_format(vk::Format format) {
+    return format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eR8G8B8A8Unorm ||
+           format == vk::Format::eR32G32B32A32Sfloat || cooked::is_block_compressed(format);
+  }
+
+  bool cook_image(const fs::path& source, vk::Format format, CookedImage& image) {
+    if (!is_cookable_format(format)) {
+      GEG_CORE_ERROR("can't cook {} as {}", source.string(), vk::to_string(format));
+      return false;
+    }
+
+    const bool is_float =
+        format == vk::Format::eR32G32B32A32Sfloat || format == vk::Format::eBc6HUfloatBlock;
+    const bool is_srgb = format == vk::Format::eR8G8B8A8Srgb ||
+                         format == vk::Format::eBc7SrgbBlock ||
+                         format == vk::Format::eBc1RgbSrgbBlock;
+    int width, height, channels;
+    void* pixels = is_float ?
+                       static_cast<void*>(stbi_loadf(
+                           source.string().c_str(), &width, &height, &channels, STBI_rgb_alpha)) :
+                       static_cast<void*>(stbi_load(
+                           source.string().c_str(), &width, &height, &channels, STBI_rgb_alpha));
+    if (!pixels) {
+      GEG_CORE_ERROR("can't decode {}: {}", source.string(), stbi_failure_reason());
+      return false;
+    }
+
+    image.format = format;
+    image.width = static_cast<uint32_t>(width);
+    image.height = static_cast<uint32_t>(height);
+    image.levels.clear();
+
+    const size_t texel_size = is_float ? 4 * sizeof(float) : 4;
+    auto& base = image.levels.emplace_back(size_t(width) * height * texel_size);
+    std::memcpy(base.data(), pixels, base.size());
+    stbi_image_free(pixels);
+
+    uint32_t w = image.width, h = image.height;
+    while ((w > 1 || h > 1) && image.levels.size() < cooked::k_max_levels) {
+      auto next = is_float ? downsample_float(image.levels.back(), w, h) :
+                             downsample_unorm(image.levels.back(), w, h, is_srgb);
+      image.levels.push_back(std::move(next));
+      w = std::max(w / 2, 1u);
+      h = std::max(h / 2, 1u);
+    }
+
+    // every level is filtered from the uncompressed one above it
+    if (cooked::is_block_compressed(format))
+      for (uint32_t i = 0; i < image.levels.size(); i++)
+        image.levels[i] = compress_level(
+            format,
+            image.levels[i],
+            std::max(image.width >> i, 1u),
+            std::max(image.height >> i, 1u));
+
+    return true;
+  }
+}    // namespace geg::cook
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "pch.hpp"
+#include "vulkan/geg-vulkan.hpp"
+
+namespace geg::cook {
+  // a decoded image and its mip chain, largest level first, encoded in format
+  struct CookedImage {
+    vk::Format format = vk::Format::eUndefined;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::vector<uint8_t>> levels;
+  };
+
+  // rgba8 (srgb and unorm), rgba32f and the bc formats block-compression.hpp encodes
+  bool is_cookable_format(vk::Format format);
+
+  // decodes the image and box filters it down to 1x1 before encoding every level, srgb images
+  // are filtered in linear
+  bool cook_image(const fs::path& source, vk::Format format, CookedImage& image);
+}    // namespace geg::cook
@@ -0,0 +1,345 @@
+#include "accessors.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define GEG_ACCESSORS_SSE2
+#elif defined(__ARM_NEON)
+  #include <arm_neon.h>
+  #define GEG_ACCESSORS_NEON
+#endif
+
+namespace geg {
+  namespace {
+    // vertices decoded per target before moving to the next one
+    constexpr size_t k_chunk_size = 256;
+    // 4 components of 4 bytes
+    constexpr size_t k_max_element_size = 16;
+
+    template<typename T>
+    T load(const std::byte* src) {
+      T value;
+      std::memcpy(&value, src, sizeof(T));
+      return value;
+    }
+
+    // converting kernels, n scalars of one component type to floats times scale, signed
+    // normalized values clamp at -1 like the spec asks
+    // the sources come straight from the file and may not be aligned
+
+#if defined(GEG_ACCESSORS_SSE2)
+    void store(float* dst, __m128i v, __m128 scale, bool clamp) {
+      __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+      if (clamp) f = _mm_max_ps(f, _mm_set1_ps(-1.0f));
+      _mm_storeu_ps(dst, f);
+    }
+#elif defined(GEG_ACCESSORS_NEON)
+    void store(float* dst, float32x4_t f, float scale, bool clamp) {
+      f = vmulq_n_f32(f, scale);
+      if (clamp) f = vmaxq_f32(f, vdupq_n_f32(-1.0f));
+      vst1q_f32(dst, f);
+    }
+#endif
+
+    template<typename T>
+    void convert_tail(
+        const std::byte* src, size_t i, size_t n, float scale, bool clamp, float* dst) {
+      for (; i < n; i++) {
+        const float f = static_cast<float>(load<T>(src + i * sizeof(T))) * scale;
+        dst[i] = clamp ? std::max(f, -1.0f) : f;
+      }
+    }
+
+    void convert_u8(const std::byte* src, size_t n, float scale, float* dst) {
+      size_t i = 0;
+#if defined(GEG_ACCESSORS_SSE2)
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 s = _mm_set1_ps(scale);
+      for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(v, zero);
+        const __m128i hi = _mm_unpackhi_epi8(v, zero);
+        store(dst + i, _mm_unpacklo_epi16(lo, zero), s, false);
+        store(dst + i + 4, _mm_unpackhi_epi16(lo, zero), s, false);
+        store(dst + i + 8, _mm_unpacklo_epi16(hi, zero), s, false);
+        store(dst + i + 12, _mm_unpackhi_epi16(hi, zero), s, false);
+      }
+#elif defined(GEG_ACCESSORS_NEON)
+      for (; i + 16 <= n; i += 16) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+        store(dst + i, vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale, false);
+        store(dst + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale, false);
+        store(dst + i + 8, vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale, false);
+        store(dst + i + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale, false);
+      }
+#endif
+      convert_tail<uint8_t>(src, i, n, scale, false, dst);
+    }
+
+    void convert_i8(const std::byte* src, size_t n, float scale, bool clamp, float* dst) {
+      size_t i = 0;
+#if defined(GEG_ACCESSORS_SSE2)
+      const __m128 s = _mm_set1_ps(scale);
+      for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // sign extension without sse4.1, the byte lands in the high half and shifts back
+        const __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+        const __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+        store(dst + i, _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16), s, clamp);
+        store(dst + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16), s, clamp);
+        store(dst + i + 8, _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16), s, clamp);
+        store(dst + i + 12, _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16), s, clamp);
+      }
+#elif defined(GEG_ACCESSORS_NEON)
+      for (; i + 16 <= n; i += 16) {
+        const int8x16_t v = vld1q_s8(reinterpret_cast<const int8_t*>(src + i));
+        const int16x8_t lo = vmovl_s8(vget_low_s8(v));
+        const int16x8_t hi = vmovl_s8(vget_high_s8(v));
+        store(dst + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), scale, clamp);
+        store(dst + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))), scale, clamp);
+        store(dst + i + 8, vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), scale, clamp);
+        store(dst + i + 12, vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))), scale, clamp);
+      }
+#endif
+      convert_tail<int8_t>(src, i, n, scale, clamp, dst);
+    }
+
+    void convert_u16(const std::byte* src, size_t n, float scale, float* dst) {
+      size_t i = 0;
+#if defined(GEG_ACCESSORS_SSE2)
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 s = _mm_set1_ps(scale);
+      for (; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        store(dst + i, _mm_unpacklo_epi16(v, zero), s, false);
+        store(dst + i + 4, _mm_unpackhi_epi16(v, zero), s, false);
+      }
+#elif defined(GEG_ACCESSORS_NEON)
+      for (; i + 8 <= n; i += 8) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(src + i * 2);
+        const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(bytes));
+        store(dst + i, vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale, false);
+        store(dst + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale, false);
+      }
+#endif
+      convert_tail<uint16_t>(src, i, n, scale, false, dst);
+    }
+
+    void convert_i16(const std::byte* src, size_t n, float scale, bool clamp, float* dst) {
+      size_t i = 0;
+#if defined(GEG_ACCESSORS_SSE2)
+      const __m128 s = _mm_set1_ps(scale);
+      for (; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        store(dst + i, _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), s, clamp);
+        store(dst + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), s, clamp);
+      }
+#elif defined(GEG_ACCESSORS_NEON)
+      for (; i + 8 <= n; i += 8) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(src + i * 2);
+        const int16x8_t v = vreinterpretq_s16_u8(vld1q_u8(bytes));
+        store(dst + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale, clamp);
+        store(dst + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale, clamp);
+      }
+#endif
+      convert_tail<int16_t>(src, i, n, scale, clamp, dst);
+    }
+
+    // n scalars, the layout is the source's with the stride removed
+    void convert(
+        const std::byte* src, size_t n, ComponentType type, bool normalized, float* dst) {
+      switch (type) {
+        case ComponentType::Float: std::memcpy(dst, src, n * sizeof(float)); break;
+        case ComponentType::UnsignedByte:
+          convert_u8(src, n, normalized ? 1.0f / 255.0f : 1.0f, dst);
+          break;
+        case ComponentType::Byte:
+          convert_i8(src, n, normalized ? 1.0f / 127.0f : 1.0f, normalized, dst);
+          break;
+        case ComponentType::UnsignedShort:
+          convert_u16(src, n, normalized ? 1.0f / 65535.0f : 1.0f, dst);
+          break;
+        case ComponentType::Short:
+          convert_i16(src, n, normalized ? 1.0f / 32767.0f : 1.0f, normalized, dst);
+          break;
+        case ComponentType::UnsignedInt:
+          convert_tail<uint32_t>(
+              src, 0, n, normalized ? 1.0f / 4294967295.0f : 1.0f, false, dst);
+          break;
+      }
+    }
+
+    // fixed sizes so the copies compile down to a few moves
+    template<size_t Size>
+    void gather(const std::byte* src, size_t stride, size_t n, std::byte* dst) {
+      for (size_t i = 0; i < n; i++)
+        std::memcpy(dst + i * Size, src + i * stride, Size);
+    }
+
+    // elements [begin, begin + n) as floats, returns where they are and how far apart
+    // float sources are read in place, the others are packed into gathered and converted
+    std::pair<const std::byte*, size_t> decode_range(
+        const AccessorSource& source, size_t begin, size_t n, std::byte* gathered, float* dst) {
+      const size_t scalars = n * source.components;
+      const size_t dst_stride = source.components * sizeof(float);
+      if (!source.data) {
+        std::fill_n(dst, scalars, 0.0f);
+        return {reinterpret_cast<const std::byte*>(dst), dst_stride};
+      }
+
+      const std::byte* elements = source.data + begin * source.stride;
+      if (source.type == ComponentType::Float) return {elements, source.stride};
+
+      // strided elements are packed first so the kernels see one flat array
+      const size_t element_size = source.components * component_size(source.type);
+      if (source.stride != element_size) {
+        switch (element_size) {
+          case 2: gather<2>(elements, source.stride, n, gathered); break;
+          case 3: gather<3>(elements, source.stride, n, gathered); break;
+          case 4: gather<4>(elements, source.stride, n, gathered); break;
+          case 6: gather<6>(elements, source.stride, n, gathered); break;
+          case 8: gather<8>(elements, source.stride, n, gathered); break;
+          case 12: gather<12>(elements, source.stride, n, gathered); break;
+          default:
+            for (size_t i = 0; i < n; i++)
+              std::memcpy(gathered + i * element_size, elements + i * source.stride, element_size);
+        }
+        elements = gathered;
+      }
+
+      convert(elements, scalars, source.type, source.normalized, dst);
+      return {reinterpret_cast<const std::byte*>(dst), dst_stride};
+    }
+
+    template<uint32_t Components, bool Renormalize>
+    void write_vertex(const std::byte* value, std::byte* dst) {
+      // a float at a time, wider moves straddle cache lines at the vertex stride
+      float v[Components];
+      for (uint32_t c = 0; c < Components; c++)
+        std::memcpy(&v[c], value + c * sizeof(float), sizeof(float));
+
+      if constexpr (Renormalize) {
+        float length2 = 0.0f;
+        for (uint32_t c = 0; c < Components; c++)
+          length2 += v[c] * v[c];
+        if (length2 > 0.0f) {
+          const float inverse = 1.0f / std::sqrt(length2);
+          for (uint32_t c = 0; c < Components; c++)
+            v[c] *= inverse;
+        }
+      }
+
+      for (uint32_t c = 0; c < Components; c++)
+        std::memcpy(dst + c * sizeof(float), &v[c], sizeof(float));
+    }
+
+    // n decoded elements into the stream
+    template<uint32_t Components>
+    void scatter(
+        const AccessorTarget& target,
+        const std::byte* src,
+        size_t src_stride,
+        size_t n,
+        std::byte* dst,
+        size_t dst_stride) {
+      dst += target.offset;
+      if (target.renormalize)
+        for (size_t i = 0; i < n; i++)
+          write_vertex<Components, true>(src + i * src_stride, dst + i * dst_stride);
+      else
+        for (size_t i = 0; i < n; i++)
+          write_vertex<Components, false>(src + i * src_stride, dst + i * dst_stride);
+    }
+
+    void scatter(
+        const AccessorTarget& target,
+        const std::byte* src,
+        size_t src_stride,
+        size_t n,
+        std::byte* dst,
+        size_t dst_stride) {
+      switch (target.components) {
+        case 1: scatter<1>(target, src, src_stride, n, dst, dst_stride); break;
+        case 2: scatter<2>(target, src, src_stride, n, dst, dst_stride); break;
+        case 3: scatter<3>(target, src, src_stride, n, dst, dst_stride); break;
+        case 4: scatter<4>(target, src, src_stride, n, dst, dst_stride); break;
+        default: break;
+      }
+    }
+
+    size_t sparse_index(const AccessorSource& source, size_t i) {
+      const std::byte* indices = source.sparse_indices;
+      switch (source.sparse_index_type) {
+        case ComponentType::UnsignedByte: return load<uint8_t>(indices + i);
+        case ComponentType::UnsignedShort: return load<uint16_t>(indices + i * 2);
+        default: return load<uint32_t>(indices + i * 4);
+      }
+    }
+  }    // namespace
+
+  uint32_t component_size(ComponentType type) {
+    switch (type) {
+      case ComponentType::Byte:
+      case ComponentType::UnsignedByte: return 1;
+      case ComponentType::Short:
+      case ComponentType::UnsignedShort: return 2;
+      case ComponentType::UnsignedInt:
+      case ComponentType::Float: return 4;
+    }
+    return 0;
+  }
+
+  void decode_vertex_stream(
+      std::span<const AccessorTarget> targets, size_t count, std::byte* dst, size_t dst_stride) {
+    std::vector<std::byte> gathered(k_chunk_size * k_max_element_size);
+    std::vector<float> floats(k_chunk_size * 4);
+
+    for (const auto& target : targets)
+      GEG_CORE_ASSERT(
+          target.components <= target.source.components && target.source.components <= 4 &&
+              target.source.count >= count,
+          "accessor doesn't fit the vertex stream");
+
+    for (size_t begin = 0; begin < count; begin += k_chunk_size) {
+      const size_t n = std::min(k_chunk_size, count - begin);
+
+      for (const auto& target : targets) {
+        const auto [values, values_stride] =
+            decode_range(target.source, begin, n, gathered.data(), floats.data());
+        scatter(target, values, values_stride, n, dst + begin * dst_stride, dst_stride);
+      }
+    }
+
+    for (const auto& target : targets) {
+      const auto& source = target.source;
+      const size_t element_size = source.components * component_size(source.type);
+
+      for (size_t i = 0; i < source.sparse_count; i++) {
+        const size_t index = sparse_index(source, i);
+        if (index >= count) continue;
+
+        float value[4];
+        convert(
+            source.sparse_values + i * element_size,
+            source.components,
+            source.type,
+            source.normalized,
+            value);
+        scatter(
+            target,
+            reinterpret_cast<const std::byte*>(value),
+            sizeof(value),
+            1,
+            dst + index * dst_stride,
+            dst_stride);
+      }
+    }
+  }
+}    // namespace geg
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace geg {
+  // glTF accessor decoding without the loader's types, the importer resolves the buffer
+  // views and this turns the elements into floats
+
+  // the values are the ones in the files
+  enum class ComponentType : int32_t {
+    Byte = 5120,
+    UnsignedByte = 5121,
+    Short = 5122,
+    UnsignedShort = 5123,
+    UnsignedInt = 5125,
+    Float = 5126,
+  };
+
+  // zero for unknown types
+  uint32_t component_size(ComponentType type);
+
+  struct AccessorSource {
+    // first element, null when the accessor has no buffer view and starts out zero
+    const std::byte* data = nullptr;
+    size_t count = 0;
+    // bytes between elements
+    size_t stride = 0;
+    ComponentType type = ComponentType::Float;
+    uint32_t components = 0;
+    // integers map to [0, 1] or [-1, 1], otherwise they keep their value
+    // (KHR_mesh_quantization)
+    bool normalized = false;
+
+    // sparse accessors replace some elements, the values are tightly packed
+    size_t sparse_count = 0;
+    const std::byte* sparse_indices = nullptr;
+    ComponentType sparse_index_type = ComponentType::UnsignedInt;
+    const std::byte* sparse_values = nullptr;
+  };
+
+  // where an accessor lands in an interleaved vertex stream
+  struct AccessorTarget {
+    AccessorSource source;
+    // bytes from the start of a vertex
+    size_t offset = 0;
+    // floats written per vertex, at most the source's components
+    uint32_t components = 0;
+    // rescales to unit length, quantized normals lose it
+    bool renormalize = false;
+  };
+
+  // fills count vertices dst_stride bytes apart, the targets are decoded a chunk of
+  // vertices at a time so the stream is written in one pass while it's in cache
+  // sparse indices past count are ignored
+  void decode_vertex_stream(
+      std::span<const AccessorTarget> targets, size_t count, std::byte* dst, size_t dst_stride);
+}    // namespace geg
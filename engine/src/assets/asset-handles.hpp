@@ -0,0 +1,16 @@
+#pragma once
+
+#include "assets/asset-pool.hpp"
+
+namespace geg {
+  namespace vulkan {
+    class Mesh;
+    class Texture;
+  }    // namespace vulkan
+  struct Material;
+
+  // generational, a handle to an unloaded asset never resolves to whatever reuses its slot
+  using MeshId = AssetHandle<vulkan::Mesh>;
+  using TextureId = AssetHandle<vulkan::Texture>;
+  using MaterialId = AssetHandle<Material>;
+}    // namespace geg
@@ -4,206 +4,253 @@
 #include "core/logger.hpp"
 #include "ecs/components.hpp"
 #include "ecs/entity.hpp"
-#include "tiny_gltf.h"
-#include "glm/gtc/quaternion.hpp"
+#include "assets/cooked-assets.hpp"
+#include "assets/importers.hpp"
+#include "utils/hash.hpp"
+#include "utils/mapped-file.hpp"
 
 namespace geg {
   AssetManager AssetManager::m_instance{};
 
-  void AssetManager::load_scene(Scene* scene, fs::path path) {
-    tinygltf::Model file;
-    tinygltf::TinyGLTF loader;
-    std::string warn;
-    std::string err;
-
-    bool res = loader.LoadASCIIFromFile(&file, &err, &warn, path);
-    if (!err.empty()) { GEG_CORE_ERROR("{}", err); }
-    if (!warn.empty()) { GEG_CORE_ERROR("{}", warn); }
-    GEG_CORE_ASSERT(res, "can't load gltf scene");
+  TextureId AssetManager::enqueue_texture(
+      fs::path texture_path, vk::Format format, uint32_t mip_maps) {
+    std::error_code ec;
+    auto canonical = fs::weakly_canonical(texture_path, ec);
+    if (ec) canonical = texture_path;
+
+    // the load settings are part of the key, the same image as srgb and unorm is two textures
+    const auto settings = hash_bytes(&mip_maps, sizeof(mip_maps), static_cast<uint64_t>(format));
+    const auto path_key = hash_string(canonical.string(), settings);
+
+    {
+      std::lock_guard lock(m_queue_mutex);
+      if (const auto it = m_textures_by_path.find(path_key); it != m_textures_by_path.end()) {
+        share_texture(it->second);
+        return it->second;
+      }
+    }
+
+    // hashing the file is cheap next to decoding and uploading it, it's done outside the
+    // lock so other threads can keep enqueueing
+    uint64_t content_id = 0;
+    size_t file_size = 0;
+    if (MappedFile file(canonical); file.is_open()) {
+      content_id = hash_bytes(file.data(), file.size(), settings);
+      file_size = file.size();
+    }
+
+    std::lock_guard lock(m_queue_mutex);
+    if (const auto it = m_textures_by_path.find(path_key); it != m_textures_by_path.end()) {
+      share_texture(it->second);
+      return it->second;
+    }
+
+    // a copy of an image that is already known under another path
+    if (const auto it = m_textures_by_content.find(content_id);
+        content_id && it != m_textures_by_content.end()) {
+      m_textures_by_path[path_key] = it->second;
+      share_texture(it->second);
+      return it->second;
+    }
+
+    const auto id = m_textures.reserve();
+    const TextureInfo info{
+        .path = texture_path,
+        .mip_maps = mip_maps,
+        .format = format,
+        .content_id = content_id,
+        .file_size = file_size,
+    };
+    texture_slot(id) = info;
+    m_textures_by_path[path_key] = id;
+    if (content_id) m_textures_by_content[content_id] = id;
+    m_textures_to_load.push_back({id, info});
+
+    return id;
+  }
 
-    tinygltf::Scene gltf_scene = file.scenes[file.defaultScene];
+  void AssetManager::share_texture(TextureId id) {
+    auto& source = m_texture_sources[id.index];
+    source.shared++;
 
-    components::Transform transform_c;
-    for (const int ni : gltf_scene.nodes) {
-      tinygltf::Node node = file.nodes[ni];
+    m_dedup_stats.textures++;
+    m_dedup_stats.source_bytes += source.file_size;
+    // still queued textures are counted once they are loaded
+    if (const auto* texture = m_textures.get(id)) m_dedup_stats.gpu_bytes += texture->size();
+  }
 
-      if (!node.rotation.empty()) {
-        glm::quat rotation(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-        transform_c.rotation = glm::eulerAngles(rotation);
+  void AssetManager::load_meshs() {
+    std::lock_guard lock(m_queue_mutex);
+    for (auto& [id, mesh_path] : m_meshs_to_load) {
+      uint64_t content_id = 0;
+      if (cooked::is_cooked_mesh(mesh_path)) {
+        const MappedFile file(mesh_path);
+        const auto mesh = cooked::read_mesh(file);
+        GEG_CORE_ASSERT(mesh, "can't read cooked mesh {}", mesh_path.string());
+        m_meshs.construct(
+            id, m_device, mesh->vertices, mesh->indices, m_vertex_format, mesh->lods);
+        content_id = mesh->content_id;
+      } else {
+        m_meshs.construct(id, mesh_path, m_device, m_vertex_format);
       }
 
-      // if(!node.translation.empty())
-      //   transform_c.translation = glm::vec3(node.translation[0], node.translation[1],
-      //   node.translation[2]);
-
-      if (node.mesh < 0) continue;
-      tinygltf::Mesh mesh = file.meshes[node.mesh];
-
-      uint32_t i = 0;
-      for (auto& p : mesh.primitives) {
-        GEG_CORE_INFO("Loading mesh {} out of {}", i, mesh.primitives.size());
-        i++;
-        components::PBR pbr_c;
-
-        if (p.material >= 0) {
-          tinygltf::Material mat = file.materials[p.material];
-          pbr_c.color_factor.r = mat.pbrMetallicRoughness.baseColorFactor[0];
-          pbr_c.color_factor.g = mat.pbrMetallicRoughness.baseColorFactor[1];
-          pbr_c.color_factor.b = mat.pbrMetallicRoughness.baseColorFactor[2];
-          pbr_c.emissive_factor.r = mat.emissiveFactor[0];
-          pbr_c.emissive_factor.g = mat.emissiveFactor[1];
-          pbr_c.emissive_factor.b = mat.emissiveFactor[2];
-          pbr_c.metallic_factor = mat.pbrMetallicRoughness.metallicFactor;
-          pbr_c.roughness_factor = mat.pbrMetallicRoughness.roughnessFactor;
-
-          if (mat.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0) {
-            tinygltf::Texture mt =
-                file.textures[mat.pbrMetallicRoughness.metallicRoughnessTexture.index];
-            tinygltf::Image mr_img = file.images[mt.source];
-            path.replace_filename(mr_img.uri);
-            pbr_c.metallic_roughness = enqueue_texture(path, vk::Format::eR8G8B8A8Unorm);
-          }
-
-          if (mat.pbrMetallicRoughness.baseColorTexture.index >= 0) {
-            tinygltf::Texture bct = file.textures[mat.pbrMetallicRoughness.baseColorTexture.index];
-            tinygltf::Image bc_img = file.images[bct.source];
-            path.replace_filename(bc_img.uri);
-            pbr_c.albedo = enqueue_texture(path, vk::Format::eR8G8B8A8Srgb);
-          }
-
-          if (mat.normalTexture.index >= 0) {
-            tinygltf::Texture nmt = file.textures[mat.normalTexture.index];
-            tinygltf::Image nm_img = file.images[nmt.source];
-            path.replace_filename(nm_img.uri);
-            pbr_c.normal_map = enqueue_texture(path, vk::Format::eR8G8B8A8Unorm);
-          }
-
-          if (mat.emissiveTexture.index >= 0) {
-            tinygltf::Texture emt = file.textures[mat.emissiveTexture.index];
-            tinygltf::Image em_img = file.images[emt.source];
-            path.replace_filename(em_img.uri);
-            pbr_c.emissive_map = enqueue_texture(path, vk::Format::eR8G8B8A8Srgb);
-          }
-        }
-
-        Entity entt = scene->create_entity(node.name);
-        entt.add_component<components::PBR>(pbr_c);
-        entt.get_component<components::Transform>() = transform_c;
-
-        std::vector<vulkan::Vertex> verts;
-        std::vector<uint32_t> inds;
-
-        const float* pos_buf = nullptr;
-        const float* norm_buf = nullptr;
-        const float* uv_buf = nullptr;
-        const float* tan_buf = nullptr;
-
-        const auto attr = p.attributes;
-        if (attr.find("POSITION") != attr.end()) {
-          const tinygltf::Accessor& accessor = file.accessors[attr.find("POSITION")->second];
-          const tinygltf::BufferView& view = file.bufferViews[accessor.bufferView];
-          pos_buf = reinterpret_cast<const float*>(
-              &(file.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-
-          verts.resize(accessor.count);
-        }
-
-        if (attr.find("NORMAL") != attr.end()) {
-          const tinygltf::Accessor& accessor = file.accessors[attr.find("NORMAL")->second];
-          const tinygltf::BufferView& view = file.bufferViews[accessor.bufferView];
-          norm_buf = reinterpret_cast<const float*>(
-              &(file.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-        }
-
-        if (attr.find("TANGENT") != attr.end()) {
-          const tinygltf::Accessor& accessor = file.accessors[attr.find("TANGENT")->second];
-          const tinygltf::BufferView& view = file.bufferViews[accessor.bufferView];
-          if (accessor.type == TINYGLTF_TYPE_VEC4) { GEG_CORE_TRACE("{}: vec4", i); }
-          if (accessor.type == TINYGLTF_TYPE_VEC3) { GEG_CORE_TRACE("{}: vec3", i); }
-          tan_buf = reinterpret_cast<const float*>(
-              &(file.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-        }
-
-        if (attr.find("TEXCOORD_0") != attr.end()) {
-          const tinygltf::Accessor& accessor = file.accessors[attr.find("TEXCOORD_0")->second];
-          const tinygltf::BufferView& view = file.bufferViews[accessor.bufferView];
-          uv_buf = reinterpret_cast<const float*>(
-              &(file.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-        }
-
-        uint32_t i = 0;
-        for (auto& vert : verts) {
-          vert.position = glm::vec3{
-              pos_buf[i * 3],
-              // converting to my cam coords
-              pos_buf[(i * 3) + 1],
-              pos_buf[(i * 3) + 2],
-          };
-
-          vert.normal = !norm_buf ? glm::vec3{0} :
-                                    glm::normalize(glm::vec3{
-                                        norm_buf[i * 3],
-                                        norm_buf[(i * 3) + 1],
-                                        norm_buf[(i * 3) + 2],
-                                    });
-
-          vert.tangent = !tan_buf ? glm::vec3{0} :
-                                    glm::vec3{
-                                        tan_buf[i * 4],
-                                        tan_buf[(i * 4) + 1],
-                                        tan_buf[(i * 4) + 2],
-                                    };
-
-          vert.tex_coord = !uv_buf ? glm::vec2{0} :
-                                     glm::vec2{
-                                         uv_buf[i * 2],
-                                         uv_buf[(i * 2) + 1],
-                                     };
-          i++;
-        }
-
-        const tinygltf::Accessor& accessor = file.accessors[p.indices];
-        const tinygltf::BufferView& bufferView = file.bufferViews[accessor.bufferView];
-        const tinygltf::Buffer& buffer = file.buffers[bufferView.buffer];
-
-        auto indexCount = static_cast<uint32_t>(accessor.count);
-
-        // glTF supports different component types of indices
-        switch (accessor.componentType) {
-          case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-            const uint32_t* buf = reinterpret_cast<const uint32_t*>(
-                &buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-            for (size_t index = 0; index < accessor.count; index++) {
-              inds.push_back(buf[index]);
-            }
-            break;
-          }
-          case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-            const uint16_t* buf = reinterpret_cast<const uint16_t*>(
-                &buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-            for (size_t index = 0; index < accessor.count; index++) {
-              inds.push_back(buf[index]);
-            }
-            break;
-          }
-          case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-            const uint8_t* buf = reinterpret_cast<const uint8_t*>(
-                &buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-            for (size_t index = 0; index < accessor.count; index++) {
-              inds.push_back(buf[index]);
-            }
-            break;
-          }
-          default: GEG_CORE_ASSERT(false, "unsupported index");
-        }
-
-        auto mesh = new vulkan::Mesh(m_device, verts, inds);
-        m_meshs.push_back(mesh);
-        entt.add_component<components::Mesh>(++m_curr_mesh);
-        GEG_CORE_INFO("Mesh id: {}", m_curr_mesh);
-
-        load_textures();
+      mesh_slot(id) = {content_id, mesh_path.filename().string()};
+      if (content_id) m_meshs_by_content.try_emplace(content_id, id);
+    }
+
+    m_meshs_to_load.clear();
+  }
+
+  vulkan::Texture& AssetManager::construct_texture(TextureId id, const TextureInfo& info) {
+    const auto name = info.path.filename().string();
+    if (!cooked::is_cooked_texture(info.path))
+      return m_textures.construct(id, m_device, info.path, name, info.format, info.mip_maps);
+
+    const MappedFile file(info.path);
+    const auto texture = cooked::read_texture(file);
+    GEG_CORE_ASSERT(texture, "can't read cooked texture {}", info.path.string());
+    GEG_CORE_ASSERT(
+        !cooked::is_block_compressed(texture->format) || m_device->texture_compression_bc,
+        "{} is bc compressed and the gpu can't sample it",
+        info.path.string());
+    return m_textures.construct(id, m_device, *texture, name);
+  }
+
+  void AssetManager::load_textures() {
+    std::vector<std::pair<TextureId, TextureInfo>> to_load;
+    {
+      std::lock_guard lock(m_queue_mutex);
+      to_load.swap(m_textures_to_load);
+    }
+
+    for (auto& [id, tex_info] : to_load) {
+      const auto& texture = construct_texture(id, tex_info);
+
+      std::lock_guard lock(m_queue_mutex);
+      m_dedup_stats.gpu_bytes += texture.size() * m_texture_sources[id.index].shared;
+    }
+  }
+
+  void AssetManager::unload_texture(TextureId id) {
+    if (!m_textures.contains(id)) return;
+
+    {
+      std::lock_guard lock(m_queue_mutex);
+      if (auto& source = m_texture_sources[id.index]; source.shared > 0) {
+        source.shared--;
+        return;
       }
+
+      std::erase_if(m_textures_by_path, [&](const auto& entry) { return entry.second == id; });
+      std::erase_if(m_textures_by_content, [&](const auto& entry) { return entry.second == id; });
+      m_texture_sources[id.index] = {};
     }
+
+    m_textures.remove(id);
+  }
+
+  const std::string AssetManager::get_texture_name(TextureId id) {
+    if (!m_textures.contains(id)) return "No texture";
+
+    {
+      std::lock_guard lock(m_queue_mutex);
+      if (id.index < m_texture_sources.size() && !m_texture_sources[id.index].path.empty())
+        return m_texture_sources[id.index].path.filename().string();
+    }
+
+    // added directly, those are never evicted
+    const auto* texture = m_textures.get(id);
+    return texture ? texture->name() : "Loading";
+  }
+
+  bool AssetManager::evict_mesh(MeshId id) {
+    auto* mesh = m_meshs.get(id);
+    if (!mesh) return false;
+
+    // meshes keep their buffer in system memory, nothing is read back from the gpu
+    m_evicted_meshs[id.index] = mesh->take_contents();
+    m_meshs.reset(id);
+
+    return true;
+  }
+
+  bool AssetManager::restore_mesh(MeshId id) {
+    const auto it = m_evicted_meshs.find(id.index);
+    if (it == m_evicted_meshs.end() || !m_meshs.contains(id)) return false;
+
+    m_meshs.construct(id, m_device, std::move(it->second));
+    m_evicted_meshs.erase(it);
+
+    return true;
+  }
+
+  bool AssetManager::evict_texture(TextureId id) {
+    if (!m_textures.get(id)) return false;
+
+    std::lock_guard lock(m_queue_mutex);
+    if (m_texture_sources[id.index].path.empty()) return false;
+    m_textures.reset(id);
+
+    return true;
+  }
+
+  bool AssetManager::restore_texture(TextureId id) {
+    TextureInfo info;
+    {
+      std::lock_guard lock(m_queue_mutex);
+      if (!m_textures.contains(id) || m_texture_sources[id.index].path.empty()) return false;
+      info = m_texture_sources[id.index];
+    }
+
+    construct_texture(id, info);
+
+    return true;
+  }
+
+  void AssetManager::log_dedup_stats() const {
+    GEG_CORE_INFO(
+        "asset dedup: {} textures and {} meshes shared, {:.2f} MiB of source data and "
+        "{:.2f} MiB of gpu memory saved",
+        m_dedup_stats.textures,
+        m_dedup_stats.meshes,
+        m_dedup_stats.source_bytes / (1024.0 * 1024.0),
+        m_dedup_stats.gpu_bytes / (1024.0 * 1024.0));
+  }
+
+  void AssetManager::load_scene(Scene* scene, fs::path path) {
+    ImportedScene imported;
+    const bool res = import_gltf(path, imported);
+    GEG_CORE_ASSERT(res, "can't load gltf scene");
+
+    // primitives sharing a gltf material share the asset and its textures
+    std::vector<MaterialId> materials(imported.materials.size());
+    const auto material_id = [&](int32_t index) {
+      if (index < 0) return add_material(Material{});
+      if (materials[index]) return materials[index];
+
+      const auto& source = imported.materials[index];
+      auto material = source.material;
+      for (size_t i = 0; i < source.textures.size(); i++)
+        if (const auto& texture = source.textures[i])
+          material.*k_material_textures[i] = enqueue_texture(texture.path, texture.format);
+
+      return materials[index] = add_material(material);
+    };
+
+    for (const auto& primitive : imported.primitives) {
+      Entity entt = scene->create_entity(primitive.name);
+      entt.add_component<components::Material>(material_id(primitive.material));
+      entt.get_component<components::Transform>() = primitive.transform;
+      // the nodes' transforms are baked in the file, bake_static_batches can merge them
+      entt.add_component<components::Static>();
+
+      const auto mesh_id = load_mesh(primitive.vertices, primitive.indices);
+      entt.add_component<components::Mesh>(mesh_id);
+      GEG_CORE_INFO("Mesh id: {}", mesh_id.index);
+    }
+
+    // every texture of the file is decoded and uploaded once, after the meshes
+    load_textures();
+    log_dedup_stats();
   };
 }    // namespace geg
@@ -1,17 +1,70 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+#include "assets/asset-handles.hpp"
+#include "assets/asset-pool.hpp"
+#include "assets/residency-manager.hpp"
 #include "ecs/scene.hpp"
 #include "meshes/meshes.hpp"
+#include "glm/glm.hpp"
+#include "utils/hash.hpp"
 #include "vulkan/device.hpp"
 #include "vulkan/texture.hpp"
 
 namespace geg {
-  using MeshId = int32_t;
-  using TextureId = int32_t;
+  // shared by every entity that references it, plain data so it hashes and copies as bytes
+  struct Material {
+    TextureId albedo;
+    TextureId metallic_roughness;
+    TextureId normal_map;
+    TextureId emissive_map;
+
+    glm::vec3 color_factor{1};
+    glm::vec3 emissive_factor{0};
+    float metallic_factor = 0;
+    float roughness_factor = 0;
+
+    float AO = 0.0f;
+
+    bool operator==(const Material&) const = default;
+    uint64_t content_hash() const { return hash_bytes(this, sizeof(*this)); }
+  };
 
+  // the assets live in pools, get_* is lock free and can be called from any thread
+  // adding, loading and unloading happens on the main thread, enqueueing from anywhere
+  // while the renderer runs it reaches meshes and textures through residency(), they may
+  // have been evicted and get_mesh/get_texture would assert
   class AssetManager {
+    friend class ResidencyManager;
+
   public:
+    // where a texture was loaded from, kept so the texture can be referenced on disk
+    struct TextureInfo {
+      fs::path path;
+      uint32_t mip_maps;
+      vk::Format format;
+      // hash of the file and the load settings, zero if the file couldn't be read
+      uint64_t content_id = 0;
+      size_t file_size = 0;
+      // enqueues that got this texture instead of loading a copy, each holds a reference
+      // that unload_texture drops before the texture goes
+      uint32_t shared = 0;
+    };
+
+    // what deduplication saved since init
+    struct DedupStats {
+      uint32_t textures = 0;
+      uint32_t meshes = 0;
+      // source data that wasn't read, decoded or copied again
+      size_t source_bytes = 0;
+      // device memory that wasn't allocated again
+      size_t gpu_bytes = 0;
+    };
+
     AssetManager(AssetManager&) = delete;
 
     static void init(std::shared_ptr<vulkan::Device> device) {
@@ -23,106 +76,299 @@ namespace geg {
     static AssetManager& get() { return m_instance; };
 
     void deinit() {
-      for (auto mesh : m_meshs)
-        delete mesh;
+      m_residency.clear();
 
       m_meshs.clear();
       m_meshs_to_load.clear();
-      m_curr_mesh = -1;
-
-      for (auto tex : m_textures)
-        delete tex;
+      m_mesh_infos.clear();
+      m_evicted_meshs.clear();
+      m_meshs_by_content.clear();
 
       m_textures.clear();
       m_textures_to_load.clear();
-      m_curr_tex = -1;
+      m_texture_sources.clear();
+      m_textures_by_path.clear();
+      m_textures_by_content.clear();
+
+      m_dedup_stats = {};
+
+      m_materials.clear();
+      m_materials_by_content.clear();
+      m_materials_shared.clear();
 
       m_device = nullptr;
       m_inited = false;
     }
 
+    // the handle is valid right away, it resolves once load_meshs ran
     MeshId enqueue_mesh(fs::path mesh_path) {
-      m_meshs_to_load.push_back(mesh_path);
-      return ++m_curr_mesh;
+      const auto id = m_meshs.reserve();
+      std::lock_guard lock(m_queue_mutex);
+      m_meshs_to_load.push_back({id, mesh_path});
+
+      return id;
     };
 
-    TextureId enqueue_texture(fs::path texture_path, vk::Format format, uint32_t mip_maps = 1) {
-      m_textures_to_load.push_back({
-          .path = texture_path,
-          .mip_maps = mip_maps,
-          .format = format,
-      });
+    // the handle is valid right away, it resolves once load_textures ran
+    // cooked .ktx2 files bring their own format and mips, the arguments only key the dedup
+    // a file that was already enqueued, under the same path or with the same bytes and
+    // settings, returns the existing texture instead of loading it again
+    TextureId enqueue_texture(fs::path texture_path, vk::Format format, uint32_t mip_maps = 1);
 
-      return ++m_curr_tex;
-    };
+    // constructed in place, the texture has no source so it isn't saved with scenes
+    template<typename... Args>
+    TextureId add_texture(Args&&... args) {
+      const auto id = m_textures.emplace(std::forward<Args>(args)...);
+      std::lock_guard lock(m_queue_mutex);
+      texture_slot(id) = {};
 
-    TextureId add_texture(vulkan::Texture* texture) {
-      m_textures.push_back(texture);
-      return ++m_curr_tex;
+      return id;
     }
 
-    void load_scene(Scene* scene, fs::path);
+    // a non zero content id makes the mesh findable with find_mesh
+    template<typename... Args>
+    MeshId add_mesh(uint64_t content_id, Args&&... args) {
+      const auto id = m_meshs.emplace(std::forward<Args>(args)...);
+      mesh_slot(id) = {content_id, m_meshs.get(id)->name()};
+      if (content_id) m_meshs_by_content[content_id] = id;
+
+      return id;
+    }
 
-    void load_textures() {
-      for (auto& tex_info : m_textures_to_load) {
-        auto* texture = new vulkan::Texture(
-            m_device,
-            tex_info.path,
-            tex_info.path.filename().string(),
-            tex_info.format,
-            tex_info.mip_maps);
-        m_textures.push_back(texture);
+    // uploads the mesh unless one with the same content is already loaded, indices holds
+    // every lod when lods isn't empty
+    MeshId load_mesh(
+        std::span<const vulkan::Vertex> vertices,
+        vulkan::IndexView indices,
+        uint64_t content_id = 0,
+        std::span<const vulkan::MeshLod> lods = {}) {
+      if (!content_id)
+        content_id = vulkan::Mesh::content_hash(std::as_bytes(vertices), indices.data);
+
+      if (const auto id = find_mesh(content_id)) {
+        m_mesh_infos[id.index].shared++;
+        std::lock_guard lock(m_queue_mutex);
+        m_dedup_stats.meshes++;
+        m_dedup_stats.source_bytes += vertices.size_bytes() + indices.data.size();
+        m_dedup_stats.gpu_bytes += get_mesh(id).size;
+        return id;
       }
 
-      m_textures_to_load.clear();
-    };
+      return add_mesh(content_id, m_device, vertices, indices, m_vertex_format, lods);
+    }
+
+    MeshId find_mesh(uint64_t content_id) const {
+      const auto it = m_meshs_by_content.find(content_id);
+      return it == m_meshs_by_content.end() ? MeshId{} : it->second;
+    }
+
+    // zero for meshes that were loaded from a path
+    uint64_t mesh_content_id(MeshId id) const {
+      GEG_CORE_ASSERT(m_meshs.contains(id), "invalid mesh handle");
+      return m_mesh_infos[id.index].content_id;
+    }
 
-    void load_meshs() {
-      for (auto& mesh_path : m_meshs_to_load) {
-        auto* mesh = new vulkan::Mesh(mesh_path, m_device);
-        m_meshs.push_back(mesh);
+    // deduplicated assets are shared, an unload drops one reference and the asset only goes
+    // with the last one
+    // the slots are reused by later loads, frames in flight may still use the gpu objects,
+    // the device destroys them once they are done
+    void unload_mesh(MeshId id) {
+      if (!m_meshs.contains(id)) return;
+      if (auto& info = m_mesh_infos[id.index]; info.shared > 0) {
+        info.shared--;
+        return;
       }
 
-      m_curr_mesh += m_meshs_to_load.size() - 1;
-      m_meshs_to_load.clear();
-    };
+      if (const auto it = m_meshs_by_content.find(m_mesh_infos[id.index].content_id);
+          it != m_meshs_by_content.end() && it->second == id)
+        m_meshs_by_content.erase(it);
+      m_evicted_meshs.erase(id.index);
+      m_meshs.remove(id);
+    }
+    void unload_texture(TextureId id);
+
+    // returns the existing material when one with the same content was already added
+    MaterialId add_material(const Material& material) {
+      const auto content_id = material.content_hash();
+      if (const auto it = m_materials_by_content.find(content_id);
+          it != m_materials_by_content.end()) {
+        material_slot(it->second)++;
+        return it->second;
+      }
+
+      return m_materials_by_content[content_id] = create_material(material);
+    }
+
+    // always a new material, for the editor, its edits shouldn't show up anywhere else
+    MaterialId create_material(const Material& material) {
+      const auto id = m_materials.emplace(material);
+      material_slot(id) = 0;
+
+      return id;
+    }
+
+    // main thread only, every entity referencing the handle sees the change
+    // a material add_material handed to more than one caller is copied instead, the others
+    // keep the old content and the returned handle is the edited copy
+    [[nodiscard]] MaterialId update_material(MaterialId id, const Material& material) {
+      auto* stored = m_materials.get(id);
+      GEG_CORE_ASSERT(stored, "invalid material handle");
+
+      if (auto& shared = material_slot(id); shared > 0) {
+        shared--;
+        return create_material(material);
+      }
+
+      if (const auto it = m_materials_by_content.find(stored->content_hash());
+          it != m_materials_by_content.end() && it->second == id)
+        m_materials_by_content.erase(it);
+
+      *stored = material;
+      m_materials_by_content.try_emplace(material.content_hash(), id);
+      return id;
+    }
+
+    // drops one reference like unload_mesh
+    void remove_material(MaterialId id) {
+      const auto* stored = m_materials.get(id);
+      if (!stored) return;
+      if (auto& shared = material_slot(id); shared > 0) {
+        shared--;
+        return;
+      }
+
+      if (const auto it = m_materials_by_content.find(stored->content_hash());
+          it != m_materials_by_content.end() && it->second == id)
+        m_materials_by_content.erase(it);
+      m_materials.remove(id);
+    }
+
+    void load_scene(Scene* scene, fs::path);
+
+    void load_textures();
+
+    // cooked .gegm files are uploaded from the mapping, anything else goes through assimp
+    void load_meshs();
 
     void load_all() {
       load_meshs();
       load_textures();
     }
 
-    const vulkan::Mesh& get_mesh(MeshId id) { return *m_meshs[id]; }
-    vulkan::Texture& get_texture(TextureId id) { return *m_textures[id]; }
+    const vulkan::Mesh& get_mesh(MeshId id) const {
+      const auto* mesh = m_meshs.get(id);
+      GEG_CORE_ASSERT(mesh, "invalid or unloaded mesh handle");
+      return *mesh;
+    }
+    vulkan::Texture& get_texture(TextureId id) const {
+      auto* texture = m_textures.get(id);
+      GEG_CORE_ASSERT(texture, "invalid or unloaded texture handle");
+      return *texture;
+    }
+    // null while the texture is still queued or after it was unloaded
+    vulkan::Texture* try_get_texture(TextureId id) const { return m_textures.get(id); }
+    const Material& get_material(MaterialId id) const {
+      const auto* material = m_materials.get(id);
+      GEG_CORE_ASSERT(material, "invalid material handle");
+      return *material;
+    }
+
+    // false once unloaded, evicted meshes still count, safe from the render thread
+    bool has_mesh(MeshId id) const { return m_meshs.contains(id); }
+    bool has_material(MaterialId id) const { return m_materials.contains(id); }
+
+    // kept per slot, the asset itself may be evicted by the render thread
     const std::string get_mesh_name(MeshId id) const {
-      if (id < 0) return "No mesh";
+      return m_meshs.contains(id) && id.index < m_mesh_infos.size() ?
+                 m_mesh_infos[id.index].name :
+                 "No mesh";
+    }
+    const std::string get_texture_name(TextureId id);
 
-      return m_meshs[id]->name();
+    // indexed by MaterialId::index, the renderer reads this copy and never the pool
+    void copy_materials(std::vector<Material>& materials) {
+      materials.resize(m_materials.capacity());
+      m_materials.each([&](MaterialId id, const Material& material) {
+        materials[id.index] = material;
+      });
     }
-    const std::string get_texture_name(TextureId id) const {
-      if (id < 0) return "No texture";
-      return m_textures[id]->name();
+
+    // empty path for textures that were added directly
+    TextureInfo get_texture_source(TextureId id) {
+      GEG_CORE_ASSERT(m_textures.contains(id), "invalid texture handle");
+      std::lock_guard lock(m_queue_mutex);
+      return m_texture_sources[id.index];
     }
 
+    ResidencyManager& residency() { return m_residency; }
+
+    // how meshes loaded from now on keep their vertices on the gpu, quantized meshes take
+    // less than half the memory and bandwidth for a little precision
+    void set_vertex_format(vulkan::VertexFormat format) { m_vertex_format = format; }
+    vulkan::VertexFormat vertex_format() const { return m_vertex_format; }
+
+    const DedupStats& dedup_stats() const { return m_dedup_stats; }
+    void log_dedup_stats() const;
+
   private:
     AssetManager() = default;
     bool m_inited = false;
     static AssetManager m_instance;
 
-    struct TextureInfo {
-      fs::path path;
-      uint32_t mip_maps;
-      vk::Format format;
+    struct MeshInfo {
+      uint64_t content_id = 0;
+      std::string name;
+      // loads that got this mesh instead of uploading a copy, like TextureInfo::shared
+      uint32_t shared = 0;
     };
 
-    TextureId m_curr_tex = -1;
-    TextureId m_curr_mesh = -1;
+    MeshInfo& mesh_slot(MeshId id) {
+      if (m_mesh_infos.size() <= id.index) m_mesh_infos.resize(id.index + 1);
+      return m_mesh_infos[id.index];
+    }
+    uint32_t& material_slot(MaterialId id) {
+      if (m_materials_shared.size() <= id.index) m_materials_shared.resize(id.index + 1);
+      return m_materials_shared[id.index];
+    }
+    TextureInfo& texture_slot(TextureId id) {
+      if (m_texture_sources.size() <= id.index) m_texture_sources.resize(id.index + 1);
+      return m_texture_sources[id.index];
+    }
+
+    AssetPool<vulkan::Mesh> m_meshs;
+    AssetPool<vulkan::Texture> m_textures;
+    AssetPool<Material> m_materials;
+
+    void share_texture(TextureId id);
+    vulkan::Texture& construct_texture(TextureId id, const TextureInfo& info);
+
+    // called by the residency manager on the render thread, the handles stay valid
+    bool evict_mesh(MeshId id);
+    bool restore_mesh(MeshId id);
+    bool evict_texture(TextureId id);
+    bool restore_texture(TextureId id);
+
+    // the system memory copy of the meshes that aren't on the gpu, keyed by slot
+    std::unordered_map<uint32_t, vulkan::Mesh::Contents> m_evicted_meshs;
+    ResidencyManager m_residency;
+
+    // per slot, indexed by the handle's index
+    std::vector<MeshInfo> m_mesh_infos;
+    std::unordered_map<uint64_t, MeshId> m_meshs_by_content;
+    std::unordered_map<uint64_t, MaterialId> m_materials_by_content;
+    // add_material calls that got the material instead of adding a copy, per slot
+    std::vector<uint32_t> m_materials_shared;
+
+    // guards the texture sources and lookups too, textures are enqueued from any thread
+    std::mutex m_queue_mutex;
+    std::vector<TextureInfo> m_texture_sources;
+    std::unordered_map<uint64_t, TextureId> m_textures_by_path;
+    std::unordered_map<uint64_t, TextureId> m_textures_by_content;
+    DedupStats m_dedup_stats;
+    vulkan::VertexFormat m_vertex_format = vulkan::VertexFormat::Full;
 
-    // to do make this big continuos buffer
-    std::vector<fs::path> m_meshs_to_load;
-    std::vector<vulkan::Mesh*> m_meshs;
-    std::vector<TextureInfo> m_textures_to_load;
-    std::vector<vulkan::Texture*> m_textures;
+    std::vector<std::pair<MeshId, fs::path>> m_meshs_to_load;
+    std::vector<std::pair<TextureId, TextureInfo>> m_textures_to_load;
     std::shared_ptr<vulkan::Device> m_device;
   };
 }    // namespace geg
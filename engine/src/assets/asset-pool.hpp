@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "pch.hpp"
+
+namespace geg {
+  // index into an AssetPool plus the generation of the slot when the handle was made,
+  // a handle to an unloaded asset stops resolving even after its slot is reused
+  // generation 0 is never handed out so a default constructed handle is invalid
+  template<typename T>
+  struct AssetHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0;
+
+    explicit operator bool() const { return generation != 0; }
+    bool operator==(const AssetHandle&) const = default;
+
+    // for hashing and sorting, unique per pool
+    uint64_t key() const { return (uint64_t(generation) << 32) | index; }
+  };
+
+  // fixed size pages of slots, the objects never move so pointers stay valid until they are
+  // removed and the page table never grows so readers don't need a lock
+  // adding and removing is serialized, get() can run on any thread concurrently with them
+  // as long as the asset it reads isn't the one being removed
+  template<typename T, uint32_t PageSize = 256, uint32_t MaxPages = 256>
+  class AssetPool {
+  public:
+    using Handle = AssetHandle<T>;
+
+    AssetPool() = default;
+    ~AssetPool() { clear(); }
+
+    AssetPool(const AssetPool&) = delete;
+    AssetPool& operator=(const AssetPool&) = delete;
+
+    // takes a slot without constructing anything, get() returns null until construct()
+    // lets a handle be given out before the asset is loaded
+    Handle reserve() {
+      std::lock_guard lock(m_mutex);
+
+      uint32_t index;
+      if (!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+      } else {
+        GEG_CORE_ASSERT(m_size < PageSize * MaxPages, "asset pool is full");
+        index = m_size++;
+        if (index % PageSize == 0)
+          m_pages[index / PageSize].store(new Page(), std::memory_order_release);
+      }
+
+      auto& s = slot(index);
+      const auto generation = s.generation.load(std::memory_order_relaxed) + 1;
+      s.generation.store(generation, std::memory_order_release);
+
+      return {.index = index, .generation = generation};
+    }
+
+    template<typename... Args>
+    T& construct(Handle handle, Args&&... args) {
+      auto& s = slot(handle.index);
+      GEG_CORE_ASSERT(
+          s.generation.load(std::memory_order_relaxed) == handle.generation, "stale asset handle");
+      GEG_CORE_ASSERT(!s.alive.load(std::memory_order_relaxed), "asset constructed twice");
+
+      auto* object = new (s.storage) T(std::forward<Args>(args)...);
+      s.alive.store(true, std::memory_order_release);
+
+      return *object;
+    }
+
+    template<typename... Args>
+    Handle emplace(Args&&... args) {
+      const auto handle = reserve();
+      construct(handle, std::forward<Args>(args)...);
+
+      return handle;
+    }
+
+    // destroys the asset but keeps the slot and the handle, get() returns null until it's
+    // constructed again
+    void reset(Handle handle) {
+      std::lock_guard lock(m_mutex);
+      if (!contains(handle)) return;
+
+      auto& s = slot(handle.index);
+      if (s.alive.exchange(false, std::memory_order_acq_rel))
+        std::launder(reinterpret_cast<T*>(s.storage))->~T();
+    }
+
+    // the slot's generation moves on so every outstanding handle stops resolving
+    void remove(Handle handle) {
+      std::lock_guard lock(m_mutex);
+      if (!contains(handle)) return;
+
+      auto& s = slot(handle.index);
+      if (s.alive.exchange(false, std::memory_order_acq_rel))
+        std::launder(reinterpret_cast<T*>(s.storage))->~T();
+
+      s.generation.fetch_add(1, std::memory_order_release);
+      m_free.push_back(handle.index);
+    }
+
+    void clear() {
+      std::lock_guard lock(m_mutex);
+
+      for (uint32_t i = 0; i < m_size; i++) {
+        auto& s = slot(i);
+        if (s.alive.exchange(false, std::memory_order_acq_rel))
+          std::launder(reinterpret_cast<T*>(s.storage))->~T();
+      }
+
+      for (auto& page : m_pages)
+        delete page.exchange(nullptr, std::memory_order_acq_rel);
+
+      m_free.clear();
+      m_size = 0;
+    }
+
+    // the handle was handed out by this pool and its asset wasn't removed since
+    bool contains(Handle handle) const {
+      if (!handle || handle.index >= PageSize * MaxPages) return false;
+
+      const auto* page = m_pages[handle.index / PageSize].load(std::memory_order_acquire);
+      return page &&
+             page->slots[handle.index % PageSize].generation.load(std::memory_order_acquire) ==
+                 handle.generation;
+    }
+
+    // null for stale handles and for reserved slots that weren't constructed yet
+    T* get(Handle handle) const {
+      if (!contains(handle)) return nullptr;
+
+      auto& s = slot(handle.index);
+      if (!s.alive.load(std::memory_order_acquire)) return nullptr;
+
+      return std::launder(reinterpret_cast<T*>(s.storage));
+    }
+
+    // index of the highest slot ever used plus one, slots below it may be empty
+    uint32_t capacity() const { return m_size; }
+
+    // fn(Handle, T&) for every constructed asset, main thread only
+    template<typename Fn>
+    void each(Fn&& fn) {
+      for (uint32_t i = 0; i < m_size; i++) {
+        auto& s = slot(i);
+        if (!s.alive.load(std::memory_order_acquire)) continue;
+
+        fn(Handle{.index = i, .generation = s.generation.load(std::memory_order_relaxed)},
+           *std::launder(reinterpret_cast<T*>(s.storage)));
+      }
+    }
+
+  private:
+    struct Slot {
+      alignas(T) std::byte storage[sizeof(T)];
+      std::atomic<uint32_t> generation = 0;
+      std::atomic<bool> alive = false;
+    };
+
+    struct Page {
+      std::array<Slot, PageSize> slots;
+    };
+
+    Slot& slot(uint32_t index) const {
+      return m_pages[index / PageSize].load(std::memory_order_acquire)->slots[index % PageSize];
+    }
+
+    std::array<std::atomic<Page*>, MaxPages> m_pages{};
+    std::vector<uint32_t> m_free;
+    uint32_t m_size = 0;
+    std::mutex m_mutex;
+  };
+}    // namespace geg
+
+template<typename T>
+struct std::hash<geg::AssetHandle<T>> {
+  size_t operator()(const geg::AssetHandle<T>& handle) const {
+    return std::hash<uint64_t>{}(handle.key());
+  }
+};
@@ -0,0 +1,337 @@
+#include "cooked-assets.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+namespace geg::cooked {
+  namespace {
+    constexpr size_t k_alignment = 16;
+
+    size_t align(size_t offset) { return (offset + k_alignment - 1) & ~(k_alignment - 1); }
+
+    bool write_file(const fs::path& path, const std::vector<uint8_t>& bytes) {
+      fs::create_directories(fs::absolute(path).parent_path());
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      if (!file) {
+        GEG_CORE_ERROR("can't open {} for writing", path.string());
+        return false;
+      }
+
+      file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+      return file.good();
+    }
+
+    // null when the range doesn't fit in the file or isn't aligned for T
+    template<typename T>
+    const T* array(const MappedFile& file, uint64_t offset, uint64_t count) {
+      if (offset % alignof(T) != 0 || offset > file.size() ||
+          count > (file.size() - offset) / sizeof(T))
+        return nullptr;
+
+      return reinterpret_cast<const T*>(file.data() + offset);
+    }
+
+    template<typename Header>
+    std::optional<Header> read_header(const MappedFile& file, const char (&magic)[4]) {
+      Header header;
+      if (file.size() < sizeof(header)) return {};
+      std::memcpy(&header, file.data(), sizeof(header));
+      if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != k_version)
+        return {};
+
+      return header;
+    }
+
+    // https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+    constexpr uint8_t k_ktx2_identifier[12] = {
+        0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct Ktx2Header {
+      uint8_t identifier[12];
+      uint32_t vk_format;
+      uint32_t type_size;
+      uint32_t pixel_width;
+      uint32_t pixel_height;
+      uint32_t pixel_depth;
+      uint32_t layer_count;
+      uint32_t face_count;
+      uint32_t level_count;
+      uint32_t supercompression_scheme;
+      uint32_t dfd_offset;
+      uint32_t dfd_size;
+      uint32_t kvd_offset;
+      uint32_t kvd_size;
+      uint64_t sgd_offset;
+      uint64_t sgd_size;
+    };
+
+    struct Ktx2Level {
+      uint64_t offset;
+      uint64_t size;
+      uint64_t uncompressed_size;
+    };
+
+    // the basic data format descriptor, the loader ignores it but other tools need it to
+    // make sense of the texels
+    std::vector<uint32_t> data_format_descriptor(vk::Format format) {
+      enum : uint32_t {
+        k_model_rgbsda = 1,
+        k_model_bc1a = 128,
+        k_model_bc5 = 132,
+        k_model_bc6h = 133,
+        k_model_bc7 = 134,
+      };
+      constexpr uint32_t k_alpha = 15;
+      constexpr uint32_t k_linear = 0x10;
+      constexpr uint32_t k_signed = 0x40;
+      constexpr uint32_t k_float = 0x80;
+      constexpr uint32_t k_one = 0x3F800000;
+      constexpr uint32_t k_minus_one = 0xBF800000;
+
+      struct Sample {
+        uint32_t offset, bits, channel, lower, upper;
+      };
+
+      uint32_t model = k_model_rgbsda;
+      bool srgb = false;
+      std::vector<Sample> samples;
+      switch (format) {
+        case vk::Format::eR8G8B8A8Srgb: srgb = true; [[fallthrough]];
+        case vk::Format::eR8G8B8A8Unorm:
+          for (uint32_t c = 0; c < 4; c++)
+            samples.push_back({c * 8, 8, c == 3 ? k_alpha : c, 0, 255});
+          break;
+        case vk::Format::eR32G32B32A32Sfloat:
+          for (uint32_t c = 0; c < 4; c++)
+            samples.push_back(
+                {c * 32, 32, (c == 3 ? k_alpha : c) | k_float | k_signed, k_minus_one, k_one});
+          break;
+        case vk::Format::eBc1RgbSrgbBlock: srgb = true; [[fallthrough]];
+        case vk::Format::eBc1RgbUnormBlock:
+          model = k_model_bc1a;
+          samples.push_back({0, 64, 0, 0, ~0u});
+          break;
+        case vk::Format::eBc5UnormBlock:
+          model = k_model_bc5;
+          samples.push_back({0, 64, 0, 0, ~0u});
+          samples.push_back({64, 64, 1, 0, ~0u});
+          break;
+        case vk::Format::eBc6HUfloatBlock:
+          model = k_model_bc6h;
+          samples.push_back({0, 128, k_float, 0, k_one});
+          break;
+        case vk::Format::eBc7SrgbBlock: srgb = true; [[fallthrough]];
+        case vk::Format::eBc7UnormBlock:
+          model = k_model_bc7;
+          samples.push_back({0, 128, 0, 0, ~0u});
+          break;
+        default: GEG_CORE_ASSERT(false, "no ktx2 descriptor for {}", vk::to_string(format));
+      }
+
+      const auto block_words = static_cast<uint32_t>(6 + samples.size() * 4);
+      const uint32_t block_dimensions = is_block_compressed(format) ? 3 | 3 << 8 : 0;
+      std::vector<uint32_t> dfd = {
+          (block_words + 1) * 4,
+          // khronos, basic descriptor
+          0,
+          // version 1.3
+          2 | (block_words * 4) << 16,
+          // bt709 primaries, srgb or linear transfer
+          model | 1 << 8 | (srgb ? 2 : 1) << 16,
+          block_dimensions,
+          block_size(format),
+          0,
+      };
+
+      for (const auto& sample : samples) {
+        // the alpha of srgb formats isn't encoded
+        const auto channel = sample.channel | (srgb && sample.channel == k_alpha ? k_linear : 0);
+        dfd.push_back(sample.offset | (sample.bits - 1) << 16 | channel << 24);
+        dfd.push_back(0);
+        dfd.push_back(sample.lower);
+        dfd.push_back(sample.upper);
+      }
+
+      return dfd;
+    }
+  }    // namespace
+
+  bool is_block_compressed(vk::Format format) {
+    switch (format) {
+      case vk::Format::eBc1RgbUnormBlock:
+      case vk::Format::eBc1RgbSrgbBlock:
+      case vk::Format::eBc5UnormBlock:
+      case vk::Format::eBc6HUfloatBlock:
+      case vk::Format::eBc7UnormBlock:
+      case vk::Format::eBc7SrgbBlock: return true;
+      default: return false;
+    }
+  }
+
+  uint32_t block_size(vk::Format format) {
+    switch (format) {
+      case vk::Format::eR8G8B8A8Unorm:
+      case vk::Format::eR8G8B8A8Srgb: return 4;
+      case vk::Format::eBc1RgbUnormBlock:
+      case vk::Format::eBc1RgbSrgbBlock: return 8;
+      default: return 16;
+    }
+  }
+
+  fs::path texture_file_name(const fs::path& source, vk::Format format) {
+    const char* tag = "unorm";
+    switch (format) {
+      case vk::Format::eR8G8B8A8Srgb: tag = "srgb"; break;
+      case vk::Format::eR32G32B32A32Sfloat: tag = "float"; break;
+      case vk::Format::eBc1RgbUnormBlock: tag = "bc1"; break;
+      case vk::Format::eBc1RgbSrgbBlock: tag = "bc1-srgb"; break;
+      case vk::Format::eBc5UnormBlock: tag = "bc5"; break;
+      case vk::Format::eBc6HUfloatBlock: tag = "bc6h"; break;
+      case vk::Format::eBc7UnormBlock: tag = "bc7"; break;
+      case vk::Format::eBc7SrgbBlock: tag = "bc7-srgb"; break;
+      default: break;
+    }
+
+    return source.filename().string() + "." + tag + ".ktx2";
+  }
+
+  bool write_mesh(
+      const fs::path& path,
+      std::span<const vulkan::Vertex> vertices,
+      vulkan::IndexView indices,
+      std::span<const vulkan::MeshLod> lods,
+      uint64_t content_id) {
+    MeshHeader header{
+        .magic = {k_mesh_magic[0], k_mesh_magic[1], k_mesh_magic[2], k_mesh_magic[3]},
+        .version = k_version,
+        .content_id = content_id,
+        .vertices_count = static_cast<uint32_t>(vertices.size()),
+        .indices_count = indices.count(),
+        .lods_count = static_cast<uint32_t>(lods.size()),
+        .index_size = vulkan::index_size(indices.type),
+    };
+    header.vertices_offset = align(sizeof(header));
+    header.indices_offset = align(header.vertices_offset + vertices.size_bytes());
+    header.lods_offset = align(header.indices_offset + indices.data.size());
+
+    std::vector<uint8_t> bytes(header.lods_offset + lods.size_bytes());
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    if (!vertices.empty())
+      std::memcpy(bytes.data() + header.vertices_offset, vertices.data(), vertices.size_bytes());
+    if (!indices.empty())
+      std::memcpy(
+          bytes.data() + header.indices_offset, indices.data.data(), indices.data.size());
+    if (!lods.empty())
+      std::memcpy(bytes.data() + header.lods_offset, lods.data(), lods.size_bytes());
+
+    return write_file(path, bytes);
+  }
+
+  bool write_texture(
+      const fs::path& path,
+      vk::Format format,
+      uint32_t width,
+      uint32_t height,
+      std::span<const std::vector<uint8_t>> levels) {
+    GEG_CORE_ASSERT(!levels.empty() && levels.size() <= k_max_levels, "bad mip chain");
+
+    const auto dfd = data_format_descriptor(format);
+    Ktx2Header header{
+        .vk_format = static_cast<uint32_t>(format),
+        .type_size = format == vk::Format::eR32G32B32A32Sfloat ? 4u : 1u,
+        .pixel_width = width,
+        .pixel_height = height,
+        .face_count = 1,
+        .level_count = static_cast<uint32_t>(levels.size()),
+    };
+    std::memcpy(header.identifier, k_ktx2_identifier, sizeof(k_ktx2_identifier));
+    header.dfd_offset = sizeof(header) + sizeof(Ktx2Level) * levels.size();
+    header.dfd_size = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+    // the smallest level comes first in the file, the index lists the largest first
+    const size_t padding = std::lcm<size_t>(block_size(format), 4);
+    std::vector<Ktx2Level> index(levels.size());
+    size_t size = header.dfd_offset + header.dfd_size;
+    for (size_t i = levels.size(); i-- > 0;) {
+      size = (size + padding - 1) / padding * padding;
+      index[i] = {.offset = size, .size = levels[i].size(), .uncompressed_size = levels[i].size()};
+      size += levels[i].size();
+    }
+
+    std::vector<uint8_t> bytes(size);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), index.data(), index.size() * sizeof(Ktx2Level));
+    std::memcpy(bytes.data() + header.dfd_offset, dfd.data(), header.dfd_size);
+    for (size_t i = 0; i < levels.size(); i++)
+      std::memcpy(bytes.data() + index[i].offset, levels[i].data(), levels[i].size());
+
+    return write_file(path, bytes);
+  }
+
+  std::optional<MeshView> read_mesh(const MappedFile& file) {
+    const auto header = read_header<MeshHeader>(file, k_mesh_magic);
+    if (!header) return {};
+
+    const auto* vertices =
+        array<vulkan::Vertex>(file, header->vertices_offset, header->vertices_count);
+    if (header->index_size != 2 && header->index_size != 4) return {};
+    const auto indices_size = uint64_t(header->indices_count) * header->index_size;
+    const auto* indices = array<std::byte>(file, header->indices_offset, indices_size);
+    const auto* lods = array<vulkan::MeshLod>(file, header->lods_offset, header->lods_count);
+    if (!vertices || !indices || !lods) return {};
+    if (!vulkan::lods_fit({lods, header->lods_count}, header->indices_count)) return {};
+
+    const auto index_type =
+        header->index_size == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+    return MeshView{
+        .content_id = header->content_id,
+        .vertices = {vertices, header->vertices_count},
+        .indices = {index_type, {indices, indices_size}},
+        .lods = {lods, header->lods_count},
+    };
+  }
+
+  std::optional<TextureView> read_texture(const MappedFile& file) {
+    Ktx2Header header;
+    if (file.size() < sizeof(header)) return {};
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.identifier, k_ktx2_identifier, sizeof(k_ktx2_identifier)) != 0)
+      return {};
+
+    if (header.supercompression_scheme != 0 || header.vk_format == 0 || header.pixel_depth > 1 ||
+        header.layer_count > 1 || header.face_count != 1 || header.level_count > k_max_levels) {
+      GEG_CORE_ERROR("only plain 2d ktx2 textures are supported");
+      return {};
+    }
+
+    // zero levels asks the loader to generate the mips, the base level is still there
+    const auto levels_count = std::max(header.level_count, 1u);
+    const auto* index = array<Ktx2Level>(file, sizeof(header), levels_count);
+    if (!index) return {};
+
+    TextureView view{
+        .format = static_cast<vk::Format>(header.vk_format),
+        .width = header.pixel_width,
+        .height = header.pixel_height,
+        .data = std::as_bytes(file.bytes()),
+    };
+
+    view.levels.reserve(levels_count);
+    for (uint32_t i = 0; i < levels_count; i++) {
+      if (index[i].offset > file.size() || index[i].size > file.size() - index[i].offset)
+        return {};
+
+      view.levels.push_back({
+          .offset = index[i].offset,
+          .size = index[i].size,
+          .width = std::max(header.pixel_width >> i, 1u),
+          .height = std::max(header.pixel_height >> i, 1u),
+      });
+    }
+
+    return view;
+  }
+}    // namespace geg::cooked
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "pch.hpp"
+#include "assets/meshes/meshes.hpp"
+#include "utils/mapped-file.hpp"
+#include "vulkan/geg-vulkan.hpp"
+
+namespace geg::cooked {
+  // the formats geg-cook writes, laid out so the runtime uploads straight from the mapping
+  // meshes are .gegm files, every array starts 16 bytes aligned and all offsets are from the
+  // start of the file
+  // textures are standard KTX2 files so other tools can produce and inspect them, only
+  // 2d images without supercompression are read
+
+  constexpr char k_mesh_magic[4] = {'G', 'E', 'G', 'M'};
+  constexpr uint32_t k_version = 3;
+  constexpr uint32_t k_max_levels = 16;
+
+  struct MeshHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t content_id;
+    uint32_t vertices_count;
+    uint32_t indices_count;
+    uint64_t vertices_offset;
+    // every lod, indices_count covers them all
+    uint64_t indices_offset;
+    uint64_t lods_offset;
+    uint32_t lods_count;
+    // 2 or 4
+    uint32_t index_size;
+  };
+
+  struct TextureLevel {
+    // from the start of TextureView::data
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+  };
+
+  struct MeshView {
+    uint64_t content_id;
+    std::span<const vulkan::Vertex> vertices;
+    vulkan::IndexView indices;
+    std::span<const vulkan::MeshLod> lods;
+  };
+
+  struct TextureView {
+    vk::Format format;
+    uint32_t width;
+    uint32_t height;
+    // largest first
+    std::vector<TextureLevel> levels;
+    std::span<const std::byte> data;
+  };
+
+  // .gegm and .ktx2, what the asset manager checks to pick the loader
+  inline bool is_cooked_mesh(const fs::path& path) { return path.extension() == ".gegm"; }
+  inline bool is_cooked_texture(const fs::path& path) { return path.extension() == ".ktx2"; }
+
+  // the bc formats the cooker encodes, their texels are 4x4 blocks
+  bool is_block_compressed(vk::Format format);
+  // bytes of one texel, or of one block for the compressed formats
+  uint32_t block_size(vk::Format format);
+
+  // <source file name>.<format tag>.ktx2, one source can be cooked in several formats
+  fs::path texture_file_name(const fs::path& source, vk::Format format);
+
+  // indices holds every lod
+  bool write_mesh(
+      const fs::path& path,
+      std::span<const vulkan::Vertex> vertices,
+      vulkan::IndexView indices,
+      std::span<const vulkan::MeshLod> lods,
+      uint64_t content_id);
+  // levels are the mip chain, largest first, already encoded in format
+  bool write_texture(
+      const fs::path& path,
+      vk::Format format,
+      uint32_t width,
+      uint32_t height,
+      std::span<const std::vector<uint8_t>> levels);
+
+  // the views point into the file, empty for malformed files
+  std::optional<MeshView> read_mesh(const MappedFile& file);
+  std::optional<TextureView> read_texture(const MappedFile& file);
+}    // namespace geg::cooked
@@ -0,0 +1,350 @@
+#include "importers.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "assets/accessors.hpp"
+#include "assimp/Importer.hpp"
+#include "assimp/postprocess.h"
+#include "assimp/scene.h"
+#include "tiny_gltf.h"
+#include "glm/gtc/quaternion.hpp"
+
+namespace geg {
+  namespace {
+    // false when the accessor points outside its buffers
+    bool accessor_source(const tinygltf::Model& file, int32_t index, AccessorSource& source) {
+      if (index < 0 || size_t(index) >= file.accessors.size()) return false;
+      const tinygltf::Accessor& accessor = file.accessors[index];
+
+      const int32_t components = tinygltf::GetNumComponentsInType(accessor.type);
+      source.type = static_cast<ComponentType>(accessor.componentType);
+      source.components = static_cast<uint32_t>(components);
+      source.count = accessor.count;
+      source.normalized = accessor.normalized;
+
+      const size_t element_size = source.components * component_size(source.type);
+      if (components < 1 || components > 4 || element_size == 0) return false;
+
+      // the range [offset, offset + size) of a view, null if it doesn't fit
+      const auto view_data = [&](int32_t view_index, size_t offset, size_t size) {
+        const std::byte* data = nullptr;
+        if (view_index < 0 || size_t(view_index) >= file.bufferViews.size()) return data;
+
+        const tinygltf::BufferView& view = file.bufferViews[view_index];
+        if (view.buffer < 0 || size_t(view.buffer) >= file.buffers.size()) return data;
+
+        const auto& buffer = file.buffers[view.buffer].data;
+        if (offset > view.byteLength || size > view.byteLength - offset ||
+            view.byteOffset + view.byteLength > buffer.size())
+          return data;
+
+        return reinterpret_cast<const std::byte*>(buffer.data() + view.byteOffset + offset);
+      };
+
+      // without a view every element starts out zero
+      if (accessor.bufferView >= 0) {
+        const int32_t stride = accessor.ByteStride(file.bufferViews[accessor.bufferView]);
+        if (stride <= 0) return false;
+        source.stride = static_cast<size_t>(stride);
+
+        const size_t size = source.count ? (source.count - 1) * source.stride + element_size : 0;
+        source.data = view_data(accessor.bufferView, accessor.byteOffset, size);
+        if (!source.data) return false;
+      }
+
+      if (accessor.sparse.isSparse) {
+        const auto& sparse = accessor.sparse;
+        source.sparse_count = static_cast<size_t>(sparse.count);
+        source.sparse_index_type = static_cast<ComponentType>(sparse.indices.componentType);
+
+        const size_t index_size = component_size(source.sparse_index_type);
+        if (index_size == 0 || source.sparse_index_type == ComponentType::Byte ||
+            source.sparse_index_type == ComponentType::Short)
+          return false;
+
+        source.sparse_indices = view_data(
+            sparse.indices.bufferView,
+            static_cast<size_t>(sparse.indices.byteOffset),
+            source.sparse_count * index_size);
+        source.sparse_values = view_data(
+            sparse.values.bufferView,
+            static_cast<size_t>(sparse.values.byteOffset),
+            source.sparse_count * element_size);
+        if (!source.sparse_indices || !source.sparse_values) return false;
+      }
+
+      return true;
+    }
+
+    MaterialSource read_material(
+        const tinygltf::Model& file, const tinygltf::Material& mat, const fs::path& gltf_path) {
+      MaterialSource source;
+      auto& material = source.material;
+      material.color_factor.r = mat.pbrMetallicRoughness.baseColorFactor[0];
+      material.color_factor.g = mat.pbrMetallicRoughness.baseColorFactor[1];
+      material.color_factor.b = mat.pbrMetallicRoughness.baseColorFactor[2];
+      material.emissive_factor.r = mat.emissiveFactor[0];
+      material.emissive_factor.g = mat.emissiveFactor[1];
+      material.emissive_factor.b = mat.emissiveFactor[2];
+      material.metallic_factor = mat.pbrMetallicRoughness.metallicFactor;
+      material.roughness_factor = mat.pbrMetallicRoughness.roughnessFactor;
+
+      const auto texture = [&](int index, vk::Format format) {
+        if (index < 0) return TextureSource{};
+
+        const tinygltf::Image& image = file.images[file.textures[index].source];
+        return TextureSource{
+            .path = fs::path(gltf_path).replace_filename(image.uri),
+            .format = format,
+        };
+      };
+
+      // same order as k_material_textures
+      source.textures = {
+          texture(mat.pbrMetallicRoughness.baseColorTexture.index, vk::Format::eR8G8B8A8Srgb),
+          texture(
+              mat.pbrMetallicRoughness.metallicRoughnessTexture.index,
+              vk::Format::eR8G8B8A8Unorm),
+          texture(mat.normalTexture.index, vk::Format::eR8G8B8A8Unorm),
+          texture(mat.emissiveTexture.index, vk::Format::eR8G8B8A8Srgb),
+      };
+
+      return source;
+    }
+
+    // whether the reordering paid off, acmr is what the gpu's vertex work follows
+    void log_optimization(const fs::path& path, const vulkan::MeshOptimizeStats& stats) {
+      GEG_CORE_INFO(
+          "{}: acmr {:.3f} -> {:.3f}, atvr {:.3f} -> {:.3f}",
+          path.filename().string(),
+          stats.before.acmr(),
+          stats.after.acmr(),
+          stats.before.atvr(),
+          stats.after.atvr());
+    }
+
+    bool read_primitive(
+        const tinygltf::Model& file, const tinygltf::Primitive& p, PrimitiveSource& primitive) {
+      auto& verts = primitive.vertices;
+      auto& inds = primitive.indices;
+
+      const auto attribute = [&](const char* name) {
+        const auto it = p.attributes.find(name);
+        return it == p.attributes.end() ? -1 : it->second;
+      };
+
+      AccessorSource position;
+      if (!accessor_source(file, attribute("POSITION"), position) || p.indices < 0)
+        return false;
+
+      std::vector<AccessorTarget> targets = {{
+          .source = position,
+          .offset = offsetof(vulkan::Vertex, position),
+          .components = 3,
+      }};
+
+      // missing attributes stay zero, quantized unit vectors are brought back to unit length
+      const auto add_target = [&](const char* name, size_t offset, uint32_t components, bool unit) {
+        const int32_t index = attribute(name);
+        if (index < 0) return true;
+
+        AccessorSource source;
+        if (!accessor_source(file, index, source) || source.count != position.count ||
+            source.components < components)
+          return false;
+
+        targets.push_back({
+            .source = source,
+            .offset = offset,
+            .components = components,
+            .renormalize = unit && source.type != ComponentType::Float,
+        });
+        return true;
+      };
+
+      if (!add_target("NORMAL", offsetof(vulkan::Vertex, normal), 3, true) ||
+          !add_target("TANGENT", offsetof(vulkan::Vertex, tangent), 3, false) ||
+          !add_target("TEXCOORD_0", offsetof(vulkan::Vertex, tex_coord), 2, false))
+        return false;
+
+      // index buffer views are tightly packed
+      AccessorSource index_source;
+      if (!accessor_source(file, p.indices, index_source) || !index_source.data ||
+          index_source.components != 1 ||
+          index_source.stride != component_size(index_source.type))
+        return false;
+      const auto* data = index_source.data;
+      const size_t count = index_source.count;
+      const std::span<const uint8_t> bytes = {reinterpret_cast<const uint8_t*>(data), count};
+
+      uint32_t max_index = 0;
+      switch (index_source.type) {
+        case ComponentType::UnsignedInt:
+          max_index = vulkan::max_index({vk::IndexType::eUint32, {data, count * 4}});
+          break;
+        case ComponentType::UnsignedShort:
+          max_index = vulkan::max_index({vk::IndexType::eUint16, {data, count * 2}});
+          break;
+        case ComponentType::UnsignedByte:
+          max_index = count ? *std::max_element(bytes.begin(), bytes.end()) : 0;
+          break;
+        default:
+          GEG_CORE_ERROR("unsupported index type {}", static_cast<int32_t>(index_source.type));
+          return false;
+      }
+
+      // an index past the vertices reads out of bounds on the gpu and narrowing it to 16 bit
+      // would wrap it onto another vertex
+      if (count && max_index >= position.count) {
+        GEG_CORE_WARN("index {} past the {} vertices of the primitive", max_index, position.count);
+        return false;
+      }
+
+      verts.resize(position.count);
+      auto* stream = reinterpret_cast<std::byte*>(verts.data());
+      decode_vertex_stream(targets, verts.size(), stream, sizeof(vulkan::Vertex));
+
+      // the buffer is sized once and converted in bulk, 16 bit sources stay 16 bit and 32
+      // bit ones are narrowed when every vertex fits
+      switch (index_source.type) {
+        case ComponentType::UnsignedInt:
+          vulkan::convert_indices(
+              {vk::IndexType::eUint32, {data, count * 4}},
+              vulkan::index_type_for(verts.size()),
+              inds);
+          break;
+        case ComponentType::UnsignedShort:
+          vulkan::convert_indices(
+              {vk::IndexType::eUint16, {data, count * 2}}, vk::IndexType::eUint16, inds);
+          break;
+        default: vulkan::widen_indices(bytes, vk::IndexType::eUint16, inds);
+      }
+
+      return true;
+    }
+  }    // namespace
+
+  bool import_gltf(const fs::path& path, ImportedScene& scene) {
+    tinygltf::Model file;
+    tinygltf::TinyGLTF loader;
+    std::string warn;
+    std::string err;
+
+    const bool res = path.extension() == ".glb" ?
+                         loader.LoadBinaryFromFile(&file, &err, &warn, path.string()) :
+                         loader.LoadASCIIFromFile(&file, &err, &warn, path.string());
+    if (!err.empty()) { GEG_CORE_ERROR("{}", err); }
+    if (!warn.empty()) { GEG_CORE_ERROR("{}", warn); }
+    if (!res) return false;
+
+    for (const auto& buffer : file.buffers)
+      if (!buffer.uri.empty() && !buffer.uri.starts_with("data:"))
+        scene.buffers.push_back(fs::path(path).replace_filename(buffer.uri));
+
+    scene.materials.reserve(file.materials.size());
+    for (const auto& material : file.materials)
+      scene.materials.push_back(read_material(file, material, path));
+
+    const tinygltf::Scene& gltf_scene = file.scenes[std::max(file.defaultScene, 0)];
+    for (const int ni : gltf_scene.nodes) {
+      const tinygltf::Node& node = file.nodes[ni];
+      if (node.mesh < 0) continue;
+
+      components::Transform transform;
+      if (!node.rotation.empty()) {
+        glm::quat rotation(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+        transform.rotation = glm::eulerAngles(rotation);
+      }
+
+      // if(!node.translation.empty())
+      //   transform.translation = glm::vec3(node.translation[0], node.translation[1],
+      //   node.translation[2]);
+
+      const tinygltf::Mesh& mesh = file.meshes[node.mesh];
+      for (uint32_t i = 0; i < mesh.primitives.size(); i++) {
+        GEG_CORE_INFO("Loading mesh {} out of {}", i, mesh.primitives.size());
+        const auto& p = mesh.primitives[i];
+
+        PrimitiveSource primitive{
+            .name = node.name,
+            .transform = transform,
+            .material = p.material,
+        };
+        if (!read_primitive(file, p, primitive)) {
+          GEG_CORE_WARN("skipped primitive {} of {} in {}", i, node.name, path.string());
+          continue;
+        }
+
+        // the pipelines only draw triangle lists
+        if (p.mode == TINYGLTF_MODE_TRIANGLES || p.mode == -1)
+          scene.optimization += vulkan::optimize_mesh(primitive.vertices, primitive.indices);
+
+        scene.primitives.push_back(std::move(primitive));
+      }
+    }
+
+    log_optimization(path, scene.optimization);
+
+    return true;
+  }
+
+  bool import_mesh(
+      const fs::path& path, std::vector<vulkan::Vertex>& vertices, vulkan::Indices& indices) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(
+        path.string(),
+        0 /*aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs*/);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode ||
+        !scene->mNumMeshes) {
+      GEG_CORE_ERROR("Error loading model {}: {}", path.string(), importer.GetErrorString());
+      return false;
+    }
+
+    const aiMesh* mesh = scene->mMeshes[0];
+
+    vertices.clear();
+    vertices.reserve(mesh->mNumVertices);
+    for (uint32_t i = 0; i != mesh->mNumVertices; i++) {
+      const auto v = mesh->mVertices[i];
+      const auto n = mesh->mNormals ? mesh->mNormals[i] : aiVector3D{0, 0, 0};
+      const auto tan = mesh->mTangents ? mesh->mTangents[i] : aiVector3D{0, 0, 0};
+      const auto t = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i] : aiVector3D{0, 0, 0};
+
+      vertices.push_back(vulkan::Vertex{
+          .position = {v.x, v.y, v.z},
+          .normal = {n.x, n.y, n.z},
+          .tangent = {tan.x, tan.y, tan.z},
+          .tex_coord = {t.x, t.y},
+      });
+    }
+
+    size_t indices_count = 0;
+    for (uint32_t i = 0; i < mesh->mNumFaces; i++)
+      indices_count += mesh->mFaces[i].mNumIndices;
+
+    // assimp keeps an array per face, they are gathered straight into the final width
+    const auto gather = [&]<typename T>(std::span<T> out) {
+      size_t n = 0;
+      for (uint32_t i = 0; i < mesh->mNumFaces; i++) {
+        const aiFace& face = mesh->mFaces[i];
+        for (uint32_t j = 0; j < face.mNumIndices; j++)
+          out[n++] = static_cast<T>(face.mIndices[j]);
+      }
+    };
+
+    indices.type = vulkan::index_type_for(vertices.size());
+    indices.data.resize(indices_count * vulkan::index_size(indices.type));
+    if (indices.type == vk::IndexType::eUint16)
+      gather(indices.as<uint16_t>());
+    else
+      gather(indices.as<uint32_t>());
+
+    // without aiProcess_Triangulate faces can have any number of corners
+    if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+      log_optimization(path, vulkan::optimize_mesh(vertices, indices));
+
+    return true;
+  }
+}    // namespace geg
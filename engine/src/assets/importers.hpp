@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "pch.hpp"
+#include "assets/asset-manager.hpp"
+#include "assets/meshes/indices.hpp"
+#include "assets/meshes/mesh-optimizer.hpp"
+#include "ecs/components.hpp"
+
+namespace geg {
+  // source files decoded on the cpu, shared by AssetManager::load_scene and the cooker
+
+  // a texture a material references, loaded by whoever imports the material
+  struct TextureSource {
+    fs::path path;
+    vk::Format format = vk::Format::eUndefined;
+
+    explicit operator bool() const { return !path.empty(); }
+  };
+
+  // the factors with empty texture handles, the textures are in k_material_textures order
+  struct MaterialSource {
+    Material material;
+    std::array<TextureSource, 4> textures;
+  };
+
+  // the handle each entry of MaterialSource::textures ends up in
+  inline constexpr std::array<TextureId Material::*, 4> k_material_textures = {
+      &Material::albedo,
+      &Material::metallic_roughness,
+      &Material::normal_map,
+      &Material::emissive_map,
+  };
+
+  struct PrimitiveSource {
+    std::string name;
+    components::Transform transform;
+    // into ImportedScene::materials, -1 for none
+    int32_t material = -1;
+    std::vector<vulkan::Vertex> vertices;
+    // 16 bit when the mesh allows it
+    vulkan::Indices indices;
+  };
+
+  struct ImportedScene {
+    std::vector<MaterialSource> materials;
+    // one per gltf primitive, the node's name and transform are repeated
+    std::vector<PrimitiveSource> primitives;
+    // external buffers the file references, the images are in the materials
+    std::vector<fs::path> buffers;
+    // vertex cache figures of all the primitives before and after reordering
+    vulkan::MeshOptimizeStats optimization;
+  };
+
+  // .gltf and .glb
+  bool import_gltf(const fs::path& path, ImportedScene& scene);
+
+  // both importers weld, reorder and renumber the triangle lists they read
+  // (vulkan::optimize_mesh)
+
+  // the first mesh of any file assimp reads
+  bool import_mesh(
+      const fs::path& path, std::vector<vulkan::Vertex>& vertices, vulkan::Indices& indices);
+}    // namespace geg
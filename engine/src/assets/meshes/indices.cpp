@@ -0,0 +1,157 @@
+#include "indices.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define GEG_INDICES_SSE2
+#elif defined(__ARM_NEON)
+  #include <arm_neon.h>
+  #define GEG_INDICES_NEON
+#endif
+
+namespace geg::vulkan {
+  namespace {
+    // the sources come straight from files and may not be aligned, the outputs are
+    // freshly allocated vectors
+
+    void widen_8_to_16(const uint8_t* src, size_t count, uint16_t* dst) {
+      size_t i = 0;
+#if defined(GEG_INDICES_SSE2)
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 16 <= count; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+      }
+#elif defined(GEG_INDICES_NEON)
+      for (; i + 16 <= count; i += 16) {
+        const uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(dst + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i + 8, vmovl_u8(vget_high_u8(v)));
+      }
+#endif
+      for (; i < count; i++)
+        dst[i] = src[i];
+    }
+
+    void widen_8_to_32(const uint8_t* src, size_t count, uint32_t* dst) {
+      size_t i = 0;
+#if defined(GEG_INDICES_SSE2)
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 16 <= count; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(v, zero);
+        const __m128i hi = _mm_unpackhi_epi8(v, zero);
+        auto* out = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+      }
+#elif defined(GEG_INDICES_NEON)
+      for (; i + 16 <= count; i += 16) {
+        const uint8x16_t v = vld1q_u8(src + i);
+        const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+        vst1q_u32(dst + i, vmovl_u16(vget_low_u16(lo)));
+        vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(lo)));
+        vst1q_u32(dst + i + 8, vmovl_u16(vget_low_u16(hi)));
+        vst1q_u32(dst + i + 12, vmovl_u16(vget_high_u16(hi)));
+      }
+#endif
+      for (; i < count; i++)
+        dst[i] = src[i];
+    }
+
+    void widen_16_to_32(const std::byte* src, size_t count, uint32_t* dst) {
+      size_t i = 0;
+#if defined(GEG_INDICES_SSE2)
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 8 <= count; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+      }
+#elif defined(GEG_INDICES_NEON)
+      for (; i + 8 <= count; i += 8) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(src + i * 2);
+        const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(bytes));
+        vst1q_u32(dst + i, vmovl_u16(vget_low_u16(v)));
+        vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(v)));
+      }
+#endif
+      for (; i < count; i++) {
+        uint16_t index;
+        std::memcpy(&index, src + i * 2, 2);
+        dst[i] = index;
+      }
+    }
+
+    void narrow_32_to_16(const std::byte* src, size_t count, uint16_t* dst) {
+      size_t i = 0;
+#if defined(GEG_INDICES_SSE2)
+      for (; i + 8 <= count; i += 8) {
+        const auto* in = reinterpret_cast<const __m128i*>(src + i * 4);
+        // sse2 only packs with signed saturation, sign extending the low halves first
+        // makes the pack keep them as they are
+        const __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(in), 16), 16);
+        const __m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(in + 1), 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+      }
+#elif defined(GEG_INDICES_NEON)
+      for (; i + 8 <= count; i += 8) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(src + i * 4);
+        const uint32x4_t a = vreinterpretq_u32_u8(vld1q_u8(bytes));
+        const uint32x4_t b = vreinterpretq_u32_u8(vld1q_u8(bytes + 16));
+        vst1q_u16(dst + i, vcombine_u16(vmovn_u32(a), vmovn_u32(b)));
+      }
+#endif
+      for (; i < count; i++) {
+        uint32_t index;
+        std::memcpy(&index, src + i * 4, 4);
+        dst[i] = static_cast<uint16_t>(index);
+      }
+    }
+
+    template<typename T>
+    uint32_t max_of(const std::byte* src, size_t count) {
+      T max = 0;
+      for (size_t i = 0; i < count; i++) {
+        T index;
+        std::memcpy(&index, src + i * sizeof(T), sizeof(T));
+        max = index > max ? index : max;
+      }
+      return max;
+    }
+  }    // namespace
+
+  uint32_t max_index(IndexView indices) {
+    const size_t count = indices.count();
+    if (indices.type == vk::IndexType::eUint16)
+      return max_of<uint16_t>(indices.data.data(), count);
+    return max_of<uint32_t>(indices.data.data(), count);
+  }
+
+  void convert_indices(IndexView source, vk::IndexType type, Indices& indices) {
+    const size_t count = source.count();
+    indices.type = type;
+    indices.data.resize(count * index_size(type));
+
+    if (source.type == type) {
+      if (count) std::memcpy(indices.data.data(), source.data.data(), indices.data.size());
+    } else if (type == vk::IndexType::eUint32) {
+      widen_16_to_32(source.data.data(), count, indices.as<uint32_t>().data());
+    } else {
+      narrow_32_to_16(source.data.data(), count, indices.as<uint16_t>().data());
+    }
+  }
+
+  void widen_indices(std::span<const uint8_t> source, vk::IndexType type, Indices& indices) {
+    indices.type = type;
+    indices.data.resize(source.size() * index_size(type));
+
+    if (type == vk::IndexType::eUint16)
+      widen_8_to_16(source.data(), source.size(), indices.as<uint16_t>().data());
+    else
+      widen_8_to_32(source.data(), source.size(), indices.as<uint32_t>().data());
+  }
+}    // namespace geg::vulkan
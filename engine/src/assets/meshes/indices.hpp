@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "vulkan/geg-vulkan.hpp"
+
+namespace geg::vulkan {
+  // bytes of one index
+  inline uint32_t index_size(vk::IndexType type) {
+    return type == vk::IndexType::eUint16 ? 2 : 4;
+  }
+
+  // 16 bit indices reach every vertex of a mesh with fewer than 65536 vertices
+  inline vk::IndexType index_type_for(size_t vertices_count) {
+    return vertices_count < 65536 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+  }
+
+  // a mesh's indices in either width, the data doesn't have to be aligned
+  struct IndexView {
+    vk::IndexType type = vk::IndexType::eUint32;
+    std::span<const std::byte> data;
+
+    IndexView() = default;
+    IndexView(vk::IndexType type, std::span<const std::byte> data): type(type), data(data) {}
+    IndexView(std::span<const uint32_t> indices):
+        type(vk::IndexType::eUint32),
+        data(std::as_bytes(indices)) {}
+    IndexView(std::span<const uint16_t> indices):
+        type(vk::IndexType::eUint16),
+        data(std::as_bytes(indices)) {}
+
+    uint32_t count() const { return static_cast<uint32_t>(data.size() / index_size(type)); }
+    bool empty() const { return data.empty(); }
+
+    // for the occasional lookup, whole buffers go through convert_indices
+    uint32_t operator[](size_t i) const {
+      if (type == vk::IndexType::eUint32) {
+        uint32_t index;
+        std::memcpy(&index, data.data() + i * 4, 4);
+        return index;
+      }
+
+      uint16_t index;
+      std::memcpy(&index, data.data() + i * 2, 2);
+      return index;
+    }
+  };
+
+  // owns the indices, what the importers produce
+  struct Indices {
+    vk::IndexType type = vk::IndexType::eUint32;
+    std::vector<std::byte> data;
+
+    uint32_t count() const { return static_cast<uint32_t>(data.size() / index_size(type)); }
+    bool empty() const { return data.empty(); }
+
+    operator IndexView() const { return {type, data}; }
+
+    // T must match the type
+    template<typename T>
+    std::span<T> as() {
+      return {reinterpret_cast<T*>(data.data()), data.size() / sizeof(T)};
+    }
+    template<typename T>
+    std::span<const T> as() const {
+      return {reinterpret_cast<const T*>(data.data()), data.size() / sizeof(T)};
+    }
+  };
+
+  // sse2/neon kernels over a buffer sized once, narrowing keeps the low 16 bits so the
+  // indices have to fit
+  void convert_indices(IndexView source, vk::IndexType type, Indices& indices);
+  // zero when there are none, the importers check it against the vertices before converting
+  uint32_t max_index(IndexView indices);
+  // glTF's unsigned byte indices, there are no 8 bit index buffers on the gpu side
+  void widen_indices(std::span<const uint8_t> source, vk::IndexType type, Indices& indices);
+}    // namespace geg::vulkan
@@ -0,0 +1,341 @@
+#include "mesh-optimizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "utils/hash.hpp"
+
+namespace geg::vulkan {
+  namespace {
+    constexpr uint32_t k_no_vertex = ~0u;
+
+    // a fifo of timestamps, a vertex is cached while fewer than size vertices went in after it
+    struct CacheSim {
+      std::vector<uint32_t> timestamps;
+      uint32_t size;
+      uint32_t time;
+
+      CacheSim(size_t vertices_count, uint32_t size):
+          timestamps(vertices_count, 0),
+          size(size),
+          time(size + 1) {}
+
+      bool cached(uint32_t v) const { return time - timestamps[v] <= size; }
+
+      // true on a miss
+      bool touch(uint32_t v) {
+        if (cached(v)) return false;
+        timestamps[v] = time++;
+        return true;
+      }
+
+      uint32_t touch_triangle(const uint32_t* t) {
+        return uint32_t(touch(t[0])) + uint32_t(touch(t[1])) + uint32_t(touch(t[2]));
+      }
+
+      void flush() { time += size + 1; }
+    };
+  }    // namespace
+
+  VertexCacheStats analyze_vertex_cache(
+      IndexView indices, size_t vertices_count, uint32_t cache_size) {
+    VertexCacheStats stats{
+        .triangles = indices.count() / 3,
+        .vertices = static_cast<uint32_t>(vertices_count),
+    };
+
+    Indices wide;
+    convert_indices(indices, vk::IndexType::eUint32, wide);
+
+    CacheSim cache(vertices_count, cache_size);
+    for (const uint32_t v : wide.as<uint32_t>())
+      if (v < vertices_count && cache.touch(v)) stats.transformed++;
+
+    return stats;
+  }
+
+  size_t weld_vertices(std::vector<Vertex>& vertices, std::span<uint32_t> indices) {
+    // open addressing over the compacted vertices, at most half full, the hash is kept next
+    // to the index so probing rarely has to touch another vertex
+    struct Slot {
+      uint32_t vertex = k_no_vertex;
+      uint32_t hash = 0;
+    };
+    size_t capacity = 16;
+    while (capacity < vertices.size() * 2)
+      capacity *= 2;
+    std::vector<Slot> table(capacity);
+    std::vector<uint32_t> remap(vertices.size());
+
+    uint32_t unique = 0;
+    for (size_t v = 0; v < vertices.size(); v++) {
+      const uint64_t hash = hash_bytes(&vertices[v], sizeof(Vertex));
+      const auto tag = static_cast<uint32_t>(hash >> 32);
+      size_t slot = hash & (capacity - 1);
+      while (true) {
+        const Slot entry = table[slot];
+        if (entry.vertex == k_no_vertex) {
+          table[slot] = {unique, tag};
+          vertices[unique] = vertices[v];
+          remap[v] = unique++;
+          break;
+        }
+        if (entry.hash == tag &&
+            std::memcmp(&vertices[entry.vertex], &vertices[v], sizeof(Vertex)) == 0) {
+          remap[v] = entry.vertex;
+          break;
+        }
+        slot = (slot + 1) & (capacity - 1);
+      }
+    }
+    vertices.resize(unique);
+
+    // triangles whose corners were welded together cover no pixels
+    size_t count = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const uint32_t a = remap[indices[i]];
+      const uint32_t b = remap[indices[i + 1]];
+      const uint32_t c = remap[indices[i + 2]];
+      if (a == b || b == c || a == c) continue;
+
+      indices[count++] = a;
+      indices[count++] = b;
+      indices[count++] = c;
+    }
+
+    return count;
+  }
+
+  void optimize_vertex_cache(
+      std::span<uint32_t> indices,
+      size_t vertices_count,
+      std::vector<uint32_t>* clusters,
+      uint32_t cache_size) {
+    if (clusters) clusters->clear();
+    const size_t triangles = indices.size() / 3;
+    if (!triangles) return;
+
+    // the triangles around every vertex
+    std::vector<uint32_t> offsets(vertices_count + 1, 0);
+    for (const uint32_t v : indices)
+      offsets[v + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(triangles * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangles * 3; i++)
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    // triangles left to emit around every vertex
+    std::vector<uint32_t> live(vertices_count);
+    for (size_t v = 0; v < vertices_count; v++)
+      live[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<uint8_t> emitted(triangles, 0);
+    std::vector<uint32_t> dead_end;
+    dead_end.reserve(triangles * 3);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result(triangles * 3);
+    size_t written = 0;
+
+    CacheSim cache(vertices_count, cache_size);
+    uint32_t cursor = 0;
+
+    // the most recent vertices first, they may still be cached, then the input order
+    const auto skip_dead_end = [&]() {
+      while (!dead_end.empty()) {
+        const uint32_t v = dead_end.back();
+        dead_end.pop_back();
+        if (live[v]) return v;
+      }
+      for (; cursor < vertices_count; cursor++)
+        if (live[cursor]) return cursor;
+      return k_no_vertex;
+    };
+
+    uint32_t fanning = skip_dead_end();
+    if (clusters) clusters->push_back(0);
+    while (fanning != k_no_vertex) {
+      candidates.clear();
+      for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+        const uint32_t t = adjacency[a];
+        if (emitted[t]) continue;
+        emitted[t] = 1;
+
+        for (uint32_t k = 0; k < 3; k++) {
+          const uint32_t v = indices[t * 3 + k];
+          result[written++] = v;
+          dead_end.push_back(v);
+          candidates.push_back(v);
+          live[v]--;
+          cache.touch(v);
+        }
+      }
+
+      // the oldest candidate that stays cached while its own triangles are emitted, the
+      // others would be evicted halfway through their fan
+      uint32_t next = k_no_vertex;
+      int64_t best = -1;
+      for (const uint32_t v : candidates) {
+        if (!live[v]) continue;
+
+        const uint32_t age = cache.time - cache.timestamps[v];
+        const int64_t priority = age + 2 * live[v] <= cache_size ? age : 0;
+        if (priority > best) {
+          best = priority;
+          next = v;
+        }
+      }
+
+      if (next == k_no_vertex) {
+        next = skip_dead_end();
+        if (clusters && next != k_no_vertex)
+          clusters->push_back(static_cast<uint32_t>(written / 3));
+      }
+      fanning = next;
+    }
+
+    GEG_CORE_ASSERT(written == triangles * 3, "tipsify missed triangles");
+    std::copy(result.begin(), result.end(), indices.begin());
+  }
+
+  void optimize_overdraw(
+      std::span<uint32_t> indices,
+      std::span<const Vertex> vertices,
+      std::span<const uint32_t> clusters,
+      float threshold,
+      uint32_t cache_size) {
+    const auto triangles = static_cast<uint32_t>(indices.size() / 3);
+    if (clusters.empty() || !triangles) return;
+
+    // smaller clusters sort better, a cluster is split where the run so far is already as
+    // cache friendly as the whole cluster give or take the threshold
+    std::vector<uint32_t> soft;
+    CacheSim cache(vertices.size(), cache_size);
+    for (size_t c = 0; c < clusters.size(); c++) {
+      const uint32_t start = clusters[c];
+      const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangles;
+      if (start >= end) continue;
+
+      cache.flush();
+      uint32_t cluster_misses = 0;
+      for (uint32_t t = start; t < end; t++)
+        cluster_misses += cache.touch_triangle(&indices[t * 3]);
+      const float limit = threshold * float(cluster_misses) / float(end - start);
+
+      cache.flush();
+      soft.push_back(start);
+      uint32_t misses = 0;
+      uint32_t run = 0;
+      for (uint32_t t = start; t < end; t++) {
+        misses += cache.touch_triangle(&indices[t * 3]);
+        run++;
+        if (t + 1 < end && float(misses) <= limit * float(run)) {
+          soft.push_back(t + 1);
+          cache.flush();
+          misses = 0;
+          run = 0;
+        }
+      }
+    }
+
+    // area weighted centroid and normal of every cluster and of the whole mesh
+    std::vector<glm::vec3> centroids(soft.size(), glm::vec3(0));
+    std::vector<glm::vec3> normals(soft.size(), glm::vec3(0));
+    glm::vec3 center(0);
+    float total_area = 0;
+    for (size_t c = 0; c < soft.size(); c++) {
+      const uint32_t end = c + 1 < soft.size() ? soft[c + 1] : triangles;
+      float area = 0;
+      for (uint32_t t = soft[c]; t < end; t++) {
+        const glm::vec3 a = vertices[indices[t * 3]].position;
+        const glm::vec3 b = vertices[indices[t * 3 + 1]].position;
+        const glm::vec3 p = vertices[indices[t * 3 + 2]].position;
+        const glm::vec3 n = glm::cross(b - a, p - a);
+        const float w = glm::length(n);
+
+        centroids[c] += (a + b + p) * (w / 3.0f);
+        normals[c] += n;
+        area += w;
+      }
+
+      center += centroids[c];
+      total_area += area;
+      if (area > 0) centroids[c] /= area;
+    }
+    if (total_area > 0) center /= total_area;
+
+    std::vector<float> keys(soft.size());
+    for (size_t c = 0; c < soft.size(); c++) {
+      const float length = glm::length(normals[c]);
+      keys[c] = length > 0 ? glm::dot(centroids[c] - center, normals[c] / length) : 0.0f;
+    }
+
+    std::vector<uint32_t> order(soft.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return keys[a] > keys[b];
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const uint32_t c : order) {
+      const uint32_t end = c + 1 < soft.size() ? soft[c + 1] : triangles;
+      result.insert(result.end(), &indices[soft[c] * 3], &indices[0] + end * 3);
+    }
+    std::copy(result.begin(), result.end(), indices.begin());
+  }
+
+  size_t optimize_vertex_fetch(std::vector<Vertex>& vertices, std::span<uint32_t> indices) {
+    std::vector<uint32_t> remap(vertices.size(), k_no_vertex);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (uint32_t& v : indices) {
+      if (remap[v] == k_no_vertex) {
+        remap[v] = static_cast<uint32_t>(ordered.size());
+        ordered.push_back(vertices[v]);
+      }
+      v = remap[v];
+    }
+
+    vertices = std::move(ordered);
+    return vertices.size();
+  }
+
+  MeshOptimizeStats optimize_mesh(std::vector<Vertex>& vertices, Indices& indices) {
+    MeshOptimizeStats stats;
+    stats.before = analyze_vertex_cache(indices, vertices.size());
+    stats.after = stats.before;
+    if (indices.count() % 3) {
+      GEG_CORE_WARN("{} indices aren't a triangle list, left as is", indices.count());
+      return stats;
+    }
+
+    Indices wide;
+    convert_indices(indices, vk::IndexType::eUint32, wide);
+    auto list = wide.as<uint32_t>();
+
+    // the steps index their tables with the vertices
+    const auto out_of_range = std::find_if(list.begin(), list.end(), [&](uint32_t v) {
+      return v >= vertices.size();
+    });
+    if (out_of_range != list.end()) {
+      GEG_CORE_WARN("index {} is past the {} vertices, left as is", *out_of_range, vertices.size());
+      return stats;
+    }
+
+    list = list.first(weld_vertices(vertices, list));
+
+    std::vector<uint32_t> clusters;
+    optimize_vertex_cache(list, vertices.size(), &clusters);
+    optimize_overdraw(list, vertices, clusters);
+    optimize_vertex_fetch(vertices, list);
+
+    const IndexView optimized = std::span<const uint32_t>(list);
+    convert_indices(optimized, index_type_for(vertices.size()), indices);
+    stats.after = analyze_vertex_cache(indices, vertices.size());
+    return stats;
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "assets/meshes/indices.hpp"
+#include "assets/meshes/vertex-format.hpp"
+
+namespace geg::vulkan {
+  // import time reordering of triangle lists so the gpu transforms fewer vertices, draws
+  // fewer hidden pixels and fetches vertices in order
+
+  // the fifo the reordering targets and the statistics simulate, close enough to how the
+  // post transform caches of the last decade behave
+  inline constexpr uint32_t k_vertex_cache_size = 16;
+
+  struct VertexCacheStats {
+    uint32_t triangles = 0;
+    uint32_t vertices = 0;
+    // vertices that missed the cache and went through the vertex shader
+    uint32_t transformed = 0;
+
+    // average cache miss ratio, transformed vertices per triangle, 3 is no reuse at all and
+    // a regular grid gets close to 0.5
+    float acmr() const { return triangles ? float(transformed) / float(triangles) : 0.0f; }
+    // average transform to vertex ratio, 1 is every vertex transformed once
+    float atvr() const { return vertices ? float(transformed) / float(vertices) : 0.0f; }
+
+    // sums the counts so a scene can report one ratio for all its meshes
+    VertexCacheStats& operator+=(const VertexCacheStats& other) {
+      triangles += other.triangles;
+      vertices += other.vertices;
+      transformed += other.transformed;
+      return *this;
+    }
+  };
+
+  struct MeshOptimizeStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+
+    MeshOptimizeStats& operator+=(const MeshOptimizeStats& other) {
+      before += other.before;
+      after += other.after;
+      return *this;
+    }
+  };
+
+  // vertices_count is what atvr divides by
+  VertexCacheStats analyze_vertex_cache(
+      IndexView indices, size_t vertices_count, uint32_t cache_size = k_vertex_cache_size);
+
+  // the steps optimize_mesh runs, usable on their own on 32 bit triangle lists
+
+  // merges bitwise identical vertices and drops the triangles that collapse, returns the
+  // new index count, the indices are rewritten in place
+  size_t weld_vertices(std::vector<Vertex>& vertices, std::span<uint32_t> indices);
+  // tipsify (Sander et al. 2007), linear in the triangles, clusters gets the first triangle
+  // of every run that starts with a cold cache when it isn't null
+  void optimize_vertex_cache(
+      std::span<uint32_t> indices,
+      size_t vertices_count,
+      std::vector<uint32_t>* clusters = nullptr,
+      uint32_t cache_size = k_vertex_cache_size);
+  // splits the clusters further while their acmr stays within threshold of the whole
+  // cluster's then draws the ones facing away from the center first, outer surfaces
+  // tend to hide the inner ones
+  void optimize_overdraw(
+      std::span<uint32_t> indices,
+      std::span<const Vertex> vertices,
+      std::span<const uint32_t> clusters,
+      float threshold = 1.05f,
+      uint32_t cache_size = k_vertex_cache_size);
+  // renumbers the vertices in the order the indices first reach them and drops the unused
+  // ones, returns the vertex count
+  size_t optimize_vertex_fetch(std::vector<Vertex>& vertices, std::span<uint32_t> indices);
+
+  // all of the above on a triangle list, the indices come back in the narrowest type the
+  // welded vertex count allows
+  MeshOptimizeStats optimize_mesh(std::vector<Vertex>& vertices, Indices& indices);
+}    // namespace geg::vulkan
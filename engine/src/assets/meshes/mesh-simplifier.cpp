@@ -0,0 +1,327 @@
+#include "mesh-simplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "assets/meshes/mesh-optimizer.hpp"
+
+namespace geg::vulkan {
+  namespace {
+    // sum of w * (dot(n, p) + d)^2 over the planes of the triangles around a vertex, the
+    // area weights keep big triangles from being folded by collapses on small ones
+    struct Quadric {
+      float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+      float b0 = 0, b1 = 0, b2 = 0;
+      float c = 0;
+      float weight = 0;
+
+      static Quadric plane(const glm::vec3& n, float d, float w) {
+        return {
+            .a00 = w * n.x * n.x,
+            .a11 = w * n.y * n.y,
+            .a22 = w * n.z * n.z,
+            .a01 = w * n.x * n.y,
+            .a02 = w * n.x * n.z,
+            .a12 = w * n.y * n.z,
+            .b0 = w * n.x * d,
+            .b1 = w * n.y * d,
+            .b2 = w * n.z * d,
+            .c = w * d * d,
+            .weight = w,
+        };
+      }
+
+      Quadric& operator+=(const Quadric& q) {
+        a00 += q.a00, a11 += q.a11, a22 += q.a22;
+        a01 += q.a01, a02 += q.a02, a12 += q.a12;
+        b0 += q.b0, b1 += q.b1, b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+        return *this;
+      }
+
+      // the weighted mean of the squared distances to the planes
+      float error(const glm::vec3& p) const {
+        const float rx = a00 * p.x + a01 * p.y + a02 * p.z;
+        const float ry = a01 * p.x + a11 * p.y + a12 * p.z;
+        const float rz = a02 * p.x + a12 * p.y + a22 * p.z;
+        const float r = rx * p.x + ry * p.y + rz * p.z + 2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return weight > 0 ? std::abs(r) / weight : 0.0f;
+      }
+    };
+
+    Quadric operator+(Quadric a, const Quadric& b) { return a += b; }
+
+    // the triangles around every vertex
+    struct Adjacency {
+      std::vector<uint32_t> offsets;
+      std::vector<uint32_t> triangles;
+
+      void build(std::span<const uint32_t> indices, size_t vertices_count) {
+        offsets.assign(vertices_count + 1, 0);
+        for (const uint32_t v : indices)
+          offsets[v + 1]++;
+        for (size_t v = 0; v < vertices_count; v++)
+          offsets[v + 1] += offsets[v];
+
+        triangles.resize(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+          triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+
+      std::span<const uint32_t> around(uint32_t v) const {
+        return std::span(triangles).subspan(offsets[v], offsets[v + 1] - offsets[v]);
+      }
+    };
+
+    struct Collapse {
+      uint32_t from;
+      uint32_t to;
+      float cost;
+    };
+
+    // a vertex is locked when one of its edges has no twin going the other way, that is the
+    // mesh's borders and the seams where welding had to keep vertices apart
+    std::vector<uint8_t> find_locked(std::span<const uint32_t> indices, size_t vertices_count) {
+      Adjacency adjacency;
+      adjacency.build(indices, vertices_count);
+
+      std::vector<uint8_t> locked(vertices_count, 0);
+      const auto has_edge = [&](uint32_t a, uint32_t b) {
+        for (const uint32_t t : adjacency.around(a)) {
+          const uint32_t* tri = &indices[t * 3];
+          for (uint32_t e = 0; e < 3; e++)
+            if (tri[e] == a && tri[(e + 1) % 3] == b) return true;
+        }
+        return false;
+      };
+
+      for (size_t i = 0; i < indices.size(); i += 3) {
+        for (uint32_t e = 0; e < 3; e++) {
+          const uint32_t a = indices[i + e];
+          const uint32_t b = indices[i + (e + 1) % 3];
+          if (has_edge(b, a)) continue;
+          locked[a] = 1;
+          locked[b] = 1;
+        }
+      }
+
+      return locked;
+    }
+  }    // namespace
+
+  std::vector<uint32_t> simplify(
+      std::span<const Vertex> vertices,
+      std::span<const uint32_t> indices,
+      size_t target_index_count,
+      float target_error,
+      float* result_error) {
+    std::vector<uint32_t> result(indices.begin(), indices.end());
+    if (result_error) *result_error = 0;
+    if (vertices.empty() || result.size() <= target_index_count) return result;
+
+    // the errors are computed in the unit cube around the mesh, floats lose too much on
+    // squared distances of big coordinates
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : vertices) {
+      min = glm::min(min, vertex.position);
+      max = glm::max(max, vertex.position);
+    }
+    const glm::vec3 extents = max - min;
+    const float scale = std::max(extents.x, std::max(extents.y, extents.z));
+    if (scale <= 0) return result;
+
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++)
+      positions[v] = (vertices[v].position - min) / scale;
+
+    std::vector<Quadric> quadrics(vertices.size());
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+      const glm::vec3& a = positions[result[i]];
+      const glm::vec3& b = positions[result[i + 1]];
+      const glm::vec3& c = positions[result[i + 2]];
+      const glm::vec3 cross = glm::cross(b - a, c - a);
+      const float area = glm::length(cross);
+      if (area <= 0) continue;
+
+      const glm::vec3 n = cross / area;
+      const auto q = Quadric::plane(n, -glm::dot(n, a), area);
+      for (uint32_t k = 0; k < 3; k++)
+        quadrics[result[i + k]] += q;
+    }
+
+    const auto locked = find_locked(result, vertices.size());
+    const float max_cost = target_error / scale * (target_error / scale);
+    float worst_cost = 0;
+
+    Adjacency adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<uint8_t> touched(vertices.size());
+    std::vector<uint32_t> ring_from;
+    std::vector<uint32_t> ring_to;
+
+    // the vertices sharing a triangle with v
+    const auto ring = [&](uint32_t v, std::vector<uint32_t>& out) {
+      out.clear();
+      for (const uint32_t t : adjacency.around(v))
+        for (uint32_t k = 0; k < 3; k++)
+          if (result[t * 3 + k] != v) out.push_back(result[t * 3 + k]);
+      std::sort(out.begin(), out.end());
+      out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+
+    // moving from onto to mustn't turn any of the remaining triangles around, neither from
+    // how it was nor, since the turns add up over the passes, from the vertex normals
+    const auto flips = [&](uint32_t from, uint32_t to) {
+      for (const uint32_t t : adjacency.around(from)) {
+        const uint32_t* tri = &result[t * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+        std::array<glm::vec3, 3> p = {positions[tri[0]], positions[tri[1]], positions[tri[2]]};
+        glm::vec3 normals(0);
+        const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        for (uint32_t k = 0; k < 3; k++) {
+          const uint32_t v = tri[k] == from ? to : tri[k];
+          p[k] = positions[v];
+          normals += vertices[v].normal;
+        }
+        const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+        if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after) ||
+            glm::dot(normals, after) <= 0)
+          return true;
+      }
+      return false;
+    };
+
+    // every pass collapses the cheapest edges whose neighbourhoods don't overlap, so the
+    // adjacency stays valid for the whole pass, then the triangles are renumbered
+    while (result.size() > target_index_count) {
+      adjacency.build(result, vertices.size());
+
+      collapses.clear();
+      for (size_t i = 0; i < result.size(); i += 3) {
+        for (uint32_t e = 0; e < 3; e++) {
+          const uint32_t a = result[i + e];
+          const uint32_t b = result[i + (e + 1) % 3];
+          // the twin edge of the neighbouring triangle has them the other way round
+          if (a > b || (locked[a] && locked[b])) continue;
+
+          const auto q = quadrics[a] + quadrics[b];
+          const float to_b = locked[a] ? std::numeric_limits<float>::max() : q.error(positions[b]);
+          const float to_a = locked[b] ? std::numeric_limits<float>::max() : q.error(positions[a]);
+          if (to_b <= to_a)
+            collapses.push_back({a, b, to_b});
+          else
+            collapses.push_back({b, a, to_a});
+        }
+      }
+      std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+        return a.cost < b.cost;
+      });
+
+      for (uint32_t v = 0; v < remap.size(); v++)
+        remap[v] = v;
+      std::fill(touched.begin(), touched.end(), 0);
+
+      const size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+      size_t removed = 0;
+      size_t collapsed = 0;
+      for (const auto& collapse : collapses) {
+        if (collapse.cost > max_cost || removed >= triangles_to_remove) break;
+        const uint32_t from = collapse.from;
+        const uint32_t to = collapse.to;
+        if (touched[from] || touched[to]) continue;
+
+        // more than two shared neighbours and the collapse pinches the surface
+        ring(from, ring_from);
+        ring(to, ring_to);
+        size_t shared = 0;
+        for (const uint32_t v : ring_from)
+          shared += std::binary_search(ring_to.begin(), ring_to.end(), v) ? 1 : 0;
+        if (shared > 2 || flips(from, to)) continue;
+
+        remap[from] = to;
+        quadrics[to] += quadrics[from];
+        touched[to] = 1;
+        for (const uint32_t t : adjacency.around(from)) {
+          const uint32_t* tri = &result[t * 3];
+          for (uint32_t k = 0; k < 3; k++)
+            touched[tri[k]] = 1;
+          if (tri[0] == to || tri[1] == to || tri[2] == to) removed++;
+        }
+
+        worst_cost = std::max(worst_cost, collapse.cost);
+        collapsed++;
+      }
+
+      if (collapsed == 0) break;
+
+      size_t kept = 0;
+      for (size_t i = 0; i < result.size(); i += 3) {
+        const uint32_t a = remap[result[i]];
+        const uint32_t b = remap[result[i + 1]];
+        const uint32_t c = remap[result[i + 2]];
+        if (a == b || b == c || a == c) continue;
+
+        result[kept++] = a;
+        result[kept++] = b;
+        result[kept++] = c;
+      }
+      result.resize(kept);
+    }
+
+    if (result_error) *result_error = std::sqrt(worst_cost) * scale;
+    return result;
+  }
+
+  std::vector<MeshLod> build_lods(
+      std::span<const Vertex> vertices, IndexView lod0, Indices& indices) {
+    Indices wide;
+    convert_indices(lod0, vk::IndexType::eUint32, wide);
+    const auto full = wide.as<uint32_t>();
+
+    std::vector<MeshLod> lods = {{.first_index = 0, .index_count = lod0.count(), .error = 0}};
+    std::vector<uint32_t> chain(full.begin(), full.end());
+    std::vector<uint32_t> previous(full.begin(), full.end());
+
+    // each level is simplified from the one before, the errors add up to a bound of the
+    // distance to the full mesh
+    float error = 0;
+    while (lods.size() < k_max_lods && previous.size() / 6 >= k_lod_min_triangles) {
+      const size_t target = previous.size() / 6 * 3;
+      float lod_error = 0;
+      auto lod = simplify(
+          vertices, previous, target, std::numeric_limits<float>::max(), &lod_error);
+
+      // the locked borders and seams are most of what is left
+      if (lod.empty() || lod.size() * 10 > previous.size() * 8) break;
+
+      optimize_vertex_cache(lod, vertices.size());
+      error += lod_error;
+      lods.push_back({
+          .first_index = static_cast<uint32_t>(chain.size()),
+          .index_count = static_cast<uint32_t>(lod.size()),
+          .error = error,
+      });
+      chain.insert(chain.end(), lod.begin(), lod.end());
+      previous = std::move(lod);
+    }
+
+    convert_indices(std::span<const uint32_t>(chain), lod0.type, indices);
+    return lods;
+  }
+
+  bool lods_fit(std::span<const MeshLod> lods, uint32_t indices_count) {
+    if (lods.empty() || lods.size() > k_max_lods) return false;
+
+    return std::all_of(lods.begin(), lods.end(), [&](const MeshLod& lod) {
+      return lod.index_count % 3 == 0 && lod.first_index <= indices_count &&
+             lod.index_count <= indices_count - lod.first_index;
+    });
+  }
+}    // namespace geg::vulkan
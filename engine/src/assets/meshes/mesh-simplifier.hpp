@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "assets/meshes/indices.hpp"
+#include "assets/meshes/vertex-format.hpp"
+
+namespace geg::vulkan {
+  // coarser versions of a mesh, drawn in its place once they are small enough on screen that
+  // the difference doesn't show (vulkan/lod-selector.hpp)
+
+  // the full mesh and up to four simplified ones
+  inline constexpr uint32_t k_max_lods = 5;
+  // meshes that get under this many triangles aren't simplified further
+  inline constexpr uint32_t k_lod_min_triangles = 128;
+
+  // the lods share the mesh's vertices and follow each other in its index range
+  struct MeshLod {
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    // how far the lod's surface can be from the full mesh, in mesh units
+    float error = 0;
+    uint32_t padding = 0;
+  };
+  static_assert(sizeof(MeshLod) == 16, "lods are stored as they are in the asset files");
+
+  // edge collapses ordered by quadric error (Garland and Heckbert 1997), a vertex is moved onto
+  // one of its neighbours so the result indexes the same vertices, vertices on open edges
+  // (borders and the seams between attributes) never move
+  // stops at target_index_count or before the first collapse costing more than target_error
+  // (mesh units), result_error gets the largest error it went up to
+  std::vector<uint32_t> simplify(
+      std::span<const Vertex> vertices,
+      std::span<const uint32_t> indices,
+      size_t target_index_count,
+      float target_error,
+      float* result_error = nullptr);
+
+  // lod 0 is the mesh as it is, every next one has about half the triangles of the one before
+  // and is ordered for the vertex cache, the chain ends early once a level doesn't pay off
+  // indices gets all the lods one after the other in lod0's index type
+  std::vector<MeshLod> build_lods(
+      std::span<const Vertex> vertices, IndexView lod0, Indices& indices);
+
+  // what the asset readers check lods from a file with, between one and k_max_lods whole
+  // triangle ranges inside the indices
+  bool lods_fit(std::span<const MeshLod> lods, uint32_t indices_count);
+}    // namespace geg::vulkan
@@ -1,70 +1,139 @@
 #include "meshes.hpp"
 
-#include "assimp/postprocess.h"
-#include "assimp/Importer.hpp"
+#include <limits>
+
+#include "assets/importers.hpp"
 #include "vk_mem_alloc.h"
 
 namespace geg::vulkan {
   Mesh::Mesh(
       const std::shared_ptr<Device>& device,
-      const std::vector<Vertex>& vertices,
-      const std::vector<uint32_t>& indices):
+      std::span<const Vertex> vertices,
+      IndexView indices,
+      VertexFormat format,
+      std::span<const MeshLod> lods):
       m_device(device) {
-    upload_to_gpu(vertices, indices);
+    m_contents.format = format;
+    build_contents(vertices, indices, lods);
+    upload_to_gpu();
+  }
+
+  Mesh::Mesh(const std::shared_ptr<Device>& device, Contents contents):
+      m_device(device),
+      m_contents(std::move(contents)) {
+    upload_to_gpu();
   }
 
-  Mesh::Mesh(const fs::path& path, const std::shared_ptr<Device>& device): m_device(device) {
+  Mesh::Mesh(const fs::path& path, const std::shared_ptr<Device>& device, VertexFormat format):
+      m_device(device) {
     m_path = path;
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(
-        path.string(),
-        0 /*aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs*/);
+    m_contents.format = format;
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-      GEG_CORE_ASSERT(false, " Error loadin model : ", importer.GetErrorString());
-    }
+    std::vector<Vertex> vertices;
+    Indices indices;
+    const bool res = import_mesh(path, vertices, indices);
+    GEG_CORE_ASSERT(res, "Error loading model: {}", path.string());
 
-    aiMesh* mesh = scene->mMeshes[0];
+    build_contents(vertices, indices, {});
+    upload_to_gpu();
+  }
 
-    std::vector<Vertex> vertices;
-    for (uint32_t i = 0; i != mesh->mNumVertices; i++) {
-      const auto v = mesh->mVertices[i];
-      const auto n = mesh->mNormals[i];
-      const auto tan = mesh->mTangents[i];
-      const auto t = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i] : aiVector3D{0, 0, 0};
-
-      vertices.push_back(Vertex{
-          .position = {v.x, v.y, v.z},
-          .normal = {n.x, n.y, n.z},
-          .tangent = {tan.x, tan.y, tan.z},
-          .tex_coord = {t.x, t.y},
-      });
+  void Mesh::build_contents(
+      std::span<const Vertex> vertices, IndexView indices, std::span<const MeshLod> lods) {
+    auto& c = m_contents;
+
+    // the vertex range starts with the header that tells the shaders how to read it
+    VertexStreamHeader header;
+    std::vector<PackedVertex> packed;
+    auto vertex_data = std::as_bytes(vertices);
+    if (c.format == VertexFormat::Quantized) {
+      header = quantize_vertices(vertices, packed);
+      vertex_data = std::as_bytes(std::span(packed));
     }
 
-    std::vector<uint32_t> indices;
-    for (uint32_t i = 0; i < mesh->mNumFaces; i++) {
-      aiFace face = mesh->mFaces[i];
-      for (uint32_t j = 0; j < face.mNumIndices; j++)
-        indices.push_back(face.mIndices[j]);
+    // callers that only have 32 bit indices still get 16 bit ones on the gpu
+    Indices narrowed;
+    if (indices.type == vk::IndexType::eUint32 &&
+        index_type_for(vertices.size()) == vk::IndexType::eUint16) {
+      convert_indices(indices, vk::IndexType::eUint16, narrowed);
+      indices = narrowed;
+    }
+    c.index_type = indices.type;
+    header.index_size = index_size(c.index_type);
+
+    // meshes that come from the cooker or were evicted already have them
+    Indices chain;
+    std::vector<MeshLod> built;
+    if (lods.empty()) {
+      built = build_lods(vertices, indices, chain);
+      indices = chain;
+      lods = built;
+    }
+    c.lods.assign(lods.begin(), lods.end());
+    GEG_CORE_ASSERT(
+        c.lods.back().first_index + c.lods.back().index_count <= indices.count(),
+        "mesh lods outside of its indices");
+    const IndexView lod0(
+        indices.type, indices.data.first(c.lods[0].index_count * index_size(indices.type)));
+
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : vertices) {
+      min = glm::min(min, vertex.position);
+      max = glm::max(max, vertex.position);
     }
+    c.center = vertices.empty() ? glm::vec3(0) : (min + max) * 0.5f;
+    float radius_sq = 0;
+    for (const auto& vertex : vertices) {
+      const glm::vec3 d = vertex.position - c.center;
+      radius_sq = std::max(radius_sq, glm::dot(d, d));
+    }
+    c.radius = std::sqrt(radius_sq);
+
+    c.vertex_size = sizeof(header) + vertex_data.size();
+    // the index range is bound as the index buffer of indexed draws, so the post transform
+    // cache sees the reuse the importers ordered the triangles for, the vertex range is
+    // still pulled by gl_VertexIndex
+    const vk::DeviceSize index_range = indices.data.size();
+    const vk::DeviceSize alignment = m_device->min_storage_buffer_alignment;
+    const auto align = [&](vk::DeviceSize offset) {
+      return (offset + alignment - 1) / alignment * alignment;
+    };
 
-    upload_to_gpu(vertices, indices);
+    // the culling pass reads them, they follow the indices
+    const auto meshlets = build_meshlets(vertices, lod0);
+    const vk::DeviceSize meshlet_range = meshlets.size() * sizeof(Meshlet);
+
+    c.vertices_count = static_cast<uint32_t>(vertices.size());
+    c.indices_count = lod0.count();
+    c.meshlets_count = static_cast<uint32_t>(meshlets.size());
+    c.index_offset = align(c.vertex_size);
+    c.meshlet_offset = align(c.index_offset + index_range);
+
+    c.data.resize(c.meshlet_offset + meshlet_range);
+    memcpy(c.data.data(), &header, sizeof(header));
+    memcpy(c.data.data() + sizeof(header), vertex_data.data(), vertex_data.size());
+    memcpy(c.data.data() + c.index_offset, indices.data.data(), indices.data.size());
+    if (!meshlets.empty())
+      memcpy(c.data.data() + c.meshlet_offset, meshlets.data(), meshlet_range);
   }
 
-  void Mesh::upload_to_gpu(
-      const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
-    const vk::DeviceSize vertex_size = sizeof(Vertex) * vertices.size();
-    const vk::DeviceSize index_size = sizeof(indices[1]) * indices.size();
-
+  void Mesh::upload_to_gpu() {
+    const auto& c = m_contents;
+    center = c.center;
+    radius = c.radius;
     vertex_offset = 0;
-    index_offset = vertex_size;
-    size = vertex_size + index_size;
+    index_offset = c.index_offset;
+    meshlet_offset = c.meshlet_offset;
+    size = c.data.size();
 
     {
       // final buffer
       auto buffer_info = static_cast<VkBufferCreateInfo>(vk::BufferCreateInfo{
           .size = size,
-          .usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+          .usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc |
+                   vk::BufferUsageFlagBits::eStorageBuffer |
+                   vk::BufferUsageFlagBits::eIndexBuffer,
           .sharingMode = vk::SharingMode::eExclusive,
       });
 
@@ -97,10 +166,9 @@ namespace geg::vulkan {
 
     void* mapping_addr = nullptr;
     vmaMapMemory(m_device->allocator, staging_alloc, &mapping_addr);
-    void* indecies_mapping_addr = static_cast<uint8_t*>(mapping_addr) + index_offset;
+    auto* staging = static_cast<uint8_t*>(mapping_addr);
 
-    memcpy(mapping_addr, vertices.data(), vertex_size);
-    memcpy(indecies_mapping_addr, indices.data(), index_size);
+    memcpy(staging, c.data.data(), c.data.size());
     vmaUnmapMemory(m_device->allocator, staging_alloc);
 
     m_device->single_time_command(
@@ -110,14 +178,8 @@ namespace geg::vulkan {
 
     vk::DescriptorBufferInfo vertx_desc_buff{
         .buffer = buffer,
-        .offset = vertex_offset,    // 0
-        .range = vertex_size,    // sizeof(Vertex) * vertices.size() 1152
-    };
-
-    vk::DescriptorBufferInfo index_desc_buff{
-        .buffer = buffer,
-        .offset = index_offset,    // 1152
-        .range = size - index_offset,    // sizeof(indices[1]) * indices.size() 144
+        .offset = vertex_offset,
+        .range = c.vertex_size,
     };
 
     auto [descriptor, layout] = m_device->build_descriptor()
@@ -125,21 +187,65 @@ namespace geg::vulkan {
                                         0,
                                         &vertx_desc_buff,
                                         vk::DescriptorType::eStorageBuffer,
-                                        vk::ShaderStageFlagBits::eVertex)
-                                    .bind_buffer(
-                                        1,
-                                        &index_desc_buff,
-                                        vk::DescriptorType::eStorageBuffer,
-                                        vk::ShaderStageFlagBits::eVertex)
+                                        vk::ShaderStageFlagBits::eAllGraphics)
                                     .build()
                                     .value();
 
     descriptor_set = descriptor;
     descriptor_set_layout = layout;
+
+    if (c.meshlets_count == 0) return;
+
+    vk::DescriptorBufferInfo meshlet_desc_buff{
+        .buffer = buffer,
+        .offset = meshlet_offset,
+        .range = c.meshlets_count * sizeof(Meshlet),
+    };
+
+    meshlet_descriptor_set = m_device->build_descriptor()
+                                 .bind_buffer(
+                                     0,
+                                     &meshlet_desc_buff,
+                                     vk::DescriptorType::eStorageBuffer,
+                                     vk::ShaderStageFlagBits::eCompute)
+                                 .build()
+                                 .value()
+                                 .first;
+  }
+
+  std::vector<uint8_t> Mesh::download(bool with_lods) const {
+    const auto& c = m_contents;
+    const size_t vertices_size = c.vertices_count * sizeof(Vertex);
+    const auto& last = c.lods.back();
+    const uint32_t indices_count =
+        with_lods ? last.first_index + last.index_count : c.indices_count;
+    std::vector<uint8_t> data(vertices_size + indices_count * index_size(c.index_type));
+
+    VertexStreamHeader header;
+    memcpy(&header, c.data.data(), sizeof(header));
+    if (header.format == VertexFormat::Quantized) {
+      const auto* packed = c.data.data() + sizeof(header);
+      for (uint32_t i = 0; i < c.vertices_count; i++) {
+        PackedVertex vertex;
+        memcpy(&vertex, packed + i * sizeof(PackedVertex), sizeof(vertex));
+        const auto full = dequantize_vertex(vertex, header);
+        memcpy(data.data() + i * sizeof(Vertex), &full, sizeof(full));
+      }
+    } else {
+      memcpy(data.data(), c.data.data() + sizeof(header), vertices_size);
+    }
+    memcpy(
+        data.data() + vertices_size,
+        c.data.data() + c.index_offset,
+        data.size() - vertices_size);
+
+    return data;
   }
 
   Mesh::~Mesh() {
-    vmaDestroyBuffer(m_device->allocator, buffer, m_alloc);
     GEG_CORE_WARN("Destroying mesh");
+    m_device->free_descriptor_set(descriptor_set);
+    m_device->free_descriptor_set(meshlet_descriptor_set);
+    m_device->destroy_buffer(buffer, m_alloc);
   }
 }    // namespace geg::vulkan
@@ -1,48 +1,106 @@
 #pragma once
 
+#include <span>
+
 #include "glm/glm.hpp"
+#include "utils/hash.hpp"
 #include "vulkan/geg-vulkan.hpp"
 #include "vk_mem_alloc.h"
 #include "vulkan/device.hpp"
 #include "utils/filesystem.hpp"
 #include "assimp/scene.h"
+#include "assets/meshes/indices.hpp"
+#include "assets/meshes/meshlets.hpp"
+#include "assets/meshes/mesh-simplifier.hpp"
+#include "assets/meshes/vertex-format.hpp"
 
 namespace geg::vulkan {
 
-  struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec3 tangent;
-    glm::vec2 tex_coord;
-    glm::vec2 padding = {0, 0};
-  };
-
   class Mesh {
   public:
-    Mesh(const fs::path& path, const std::shared_ptr<Device>& device);
+    // the buffer as it was uploaded and what it takes to upload it again, kept in system
+    // memory so an evicted mesh comes back and downloads without reading the gpu or building
+    // anything again
+    struct Contents {
+      std::vector<uint8_t> data;
+      // the range bound as the vertices, the stream header included
+      vk::DeviceSize vertex_size = 0;
+      vk::DeviceSize index_offset = 0;
+      vk::DeviceSize meshlet_offset = 0;
+      uint32_t vertices_count = 0;
+      uint32_t indices_count = 0;
+      uint32_t meshlets_count = 0;
+      std::vector<MeshLod> lods;
+      vk::IndexType index_type = vk::IndexType::eUint32;
+      VertexFormat format = VertexFormat::Full;
+      glm::vec3 center{0};
+      float radius = 0;
+    };
+
     Mesh(
+        const fs::path& path,
         const std::shared_ptr<Device>& device,
-        const std::vector<Vertex>& vertices,
-        const std::vector<uint32_t>& indices);
+        VertexFormat format = VertexFormat::Full);
+    // indices holds every lod when lods isn't empty, the lods are built otherwise
+    Mesh(
+        const std::shared_ptr<Device>& device,
+        std::span<const Vertex> vertices,
+        IndexView indices,
+        VertexFormat format = VertexFormat::Full,
+        std::span<const MeshLod> lods = {});
+    // what an evicted mesh gave up with take_contents
+    Mesh(const std::shared_ptr<Device>& device, Contents contents);
     ~Mesh();
 
     vk::DeviceSize size;
     vk::DeviceSize vertex_offset;
     vk::DeviceSize index_offset;
+    vk::DeviceSize meshlet_offset;
+
+    // bounding sphere in mesh space
+    glm::vec3 center{0};
+    float radius = 0;
 
     vk::DescriptorSet descriptor_set;
     vk::DescriptorSetLayout descriptor_set_layout;
+    // the meshlets for the culling pass, null for meshes without any
+    vk::DescriptorSet meshlet_descriptor_set;
 
     vk::Buffer buffer;
     fs::path path() const { return m_path; };
     std::string name() const { return m_path.filename().string(); }
-    uint32_t indices_count() const { return (size - index_offset) / sizeof(uint32_t); };
+    // of the full mesh, lod 0
+    uint32_t indices_count() const { return m_contents.indices_count; };
+    uint32_t vertices_count() const { return m_contents.vertices_count; };
+    // of lod 0, the coarser lods are drawn without culling
+    uint32_t meshlets_count() const { return m_contents.meshlets_count; }
+    // lod 0 first, offsets are in indices from index_offset
+    std::span<const MeshLod> lods() const { return m_contents.lods; }
+    VertexFormat vertex_format() const { return m_contents.format; }
+    // 16 bit below 65536 vertices whatever the indices were given as
+    vk::IndexType index_type() const { return m_contents.index_type; }
+
+    // full vertices whatever the format on the gpu then the indices in index_type(), lod 0's
+    // or with_lods every lod's, from the system memory copy
+    std::vector<uint8_t> download(bool with_lods = false) const;
+    // the mesh can only be destroyed after
+    Contents take_contents() { return std::move(m_contents); }
+
+    // stable across runs, used as the content id of meshes that don't come from a file
+    static uint64_t content_hash(
+        std::span<const std::byte> vertices, std::span<const std::byte> indices) {
+      return hash_bytes(
+          indices.data(), indices.size(), hash_bytes(vertices.data(), vertices.size()));
+    }
 
   private:
     std::shared_ptr<Device> m_device;
     VmaAllocation m_alloc;
     fs::path m_path;
+    Contents m_contents;
 
-    void upload_to_gpu(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+    void build_contents(
+        std::span<const Vertex> vertices, IndexView indices, std::span<const MeshLod> lods);
+    void upload_to_gpu();
   };
 }    // namespace geg::vulkan
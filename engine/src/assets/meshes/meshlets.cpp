@@ -0,0 +1,108 @@
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace geg::vulkan {
+  namespace {
+    // the bounds of the triangles in [first_index, first_index + index_count)
+    void compute_bounds(
+        Meshlet& meshlet, std::span<const Vertex> vertices, std::span<const uint32_t> indices) {
+      glm::vec3 min(std::numeric_limits<float>::max());
+      glm::vec3 max(std::numeric_limits<float>::lowest());
+      glm::vec3 normal_sum(0);
+
+      const auto triangle = indices.subspan(meshlet.first_index, meshlet.index_count);
+      for (size_t i = 0; i < triangle.size(); i += 3) {
+        const glm::vec3 a = vertices[triangle[i]].position;
+        const glm::vec3 b = vertices[triangle[i + 1]].position;
+        const glm::vec3 c = vertices[triangle[i + 2]].position;
+        min = glm::min(min, glm::min(a, glm::min(b, c)));
+        max = glm::max(max, glm::max(a, glm::max(b, c)));
+
+        const glm::vec3 n = glm::cross(b - a, c - a);
+        const float length = glm::length(n);
+        if (length > 0) normal_sum += n / length;
+      }
+
+      meshlet.center = (min + max) * 0.5f;
+      float radius_sq = 0;
+      for (const uint32_t v : triangle) {
+        const glm::vec3 d = vertices[v].position - meshlet.center;
+        radius_sq = std::max(radius_sq, glm::dot(d, d));
+      }
+      meshlet.radius = std::sqrt(radius_sq);
+
+      meshlet.cone_axis = glm::vec3(0, 0, 1);
+      meshlet.cone_cutoff = 1;
+      const float sum_length = glm::length(normal_sum);
+      if (sum_length <= 0) return;
+
+      // the widest angle between a triangle and the axis, clusters spread close to a
+      // hemisphere can be seen from anywhere
+      const glm::vec3 axis = normal_sum / sum_length;
+      float min_dot = 1;
+      for (size_t i = 0; i < triangle.size(); i += 3) {
+        const glm::vec3 a = vertices[triangle[i]].position;
+        const glm::vec3 b = vertices[triangle[i + 1]].position;
+        const glm::vec3 c = vertices[triangle[i + 2]].position;
+        const glm::vec3 n = glm::cross(b - a, c - a);
+        const float length = glm::length(n);
+        if (length > 0) min_dot = std::min(min_dot, glm::dot(n / length, axis));
+      }
+
+      meshlet.cone_axis = axis;
+      if (min_dot > 0.1f) meshlet.cone_cutoff = std::sqrt(1 - min_dot * min_dot);
+    }
+  }    // namespace
+
+  std::vector<Meshlet> build_meshlets(std::span<const Vertex> vertices, IndexView indices) {
+    Indices wide;
+    convert_indices(indices, vk::IndexType::eUint32, wide);
+    const auto list = wide.as<uint32_t>();
+
+    // the bounds read the vertices, a mesh with stray indices is drawn without meshlets
+    std::vector<Meshlet> meshlets;
+    const auto out_of_range = [&](uint32_t v) { return v >= vertices.size(); };
+    if (std::any_of(list.begin(), list.end(), out_of_range)) return meshlets;
+
+    // the meshlet each vertex was last counted in, plus one
+    std::vector<uint32_t> seen(vertices.size(), 0);
+    uint32_t vertex_count = 0;
+
+    const auto begin = [&](uint32_t first_index) {
+      meshlets.push_back({.first_index = first_index, .index_count = 0});
+      vertex_count = 0;
+    };
+
+    for (uint32_t i = 0; i + 2 < list.size(); i += 3) {
+      if (meshlets.empty()) begin(i);
+
+      // the corners the current meshlet doesn't have yet
+      const uint32_t a = list[i];
+      const uint32_t b = list[i + 1];
+      const uint32_t c = list[i + 2];
+      const auto id = static_cast<uint32_t>(meshlets.size());
+      const uint32_t added = uint32_t(seen[a] != id) + uint32_t(seen[b] != id && b != a) +
+                             uint32_t(seen[c] != id && c != a && c != b);
+
+      if (vertex_count + added > k_meshlet_max_vertices ||
+          meshlets.back().index_count == k_meshlet_max_triangles * 3)
+        begin(i);
+
+      const auto current = static_cast<uint32_t>(meshlets.size());
+      for (const uint32_t v : {a, b, c}) {
+        if (seen[v] == current) continue;
+        seen[v] = current;
+        vertex_count++;
+      }
+      meshlets.back().index_count += 3;
+    }
+
+    for (auto& meshlet : meshlets)
+      compute_bounds(meshlet, vertices, list);
+
+    return meshlets;
+  }
+}    // namespace geg::vulkan
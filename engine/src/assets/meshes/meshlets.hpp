@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "assets/meshes/indices.hpp"
+#include "assets/meshes/vertex-format.hpp"
+
+namespace geg::vulkan {
+  // small clusters of a mesh's triangles, culled one by one on the gpu (cluster-cull.glsl)
+  inline constexpr uint32_t k_meshlet_max_vertices = 64;
+  inline constexpr uint32_t k_meshlet_max_triangles = 124;
+
+  // matches the Meshlet struct in the culling shader
+  struct Meshlet {
+    // bounding sphere in mesh space
+    glm::vec3 center;
+    float radius;
+    // average normal, the cluster faces away from a viewer past the cone and can be
+    // skipped, a cutoff of 1 never culls
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+    // without mesh shaders a meshlet is drawn as a range of the mesh's index buffer
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t padding[2] = {0, 0};
+  };
+  static_assert(sizeof(Meshlet) == 48, "the culling shader reads 48 byte meshlets");
+
+  // the triangles are taken in the order they come in, so the cache and overdraw ordering
+  // done at import carries over and every meshlet stays a contiguous index range
+  std::vector<Meshlet> build_meshlets(std::span<const Vertex> vertices, IndexView indices);
+}    // namespace geg::vulkan
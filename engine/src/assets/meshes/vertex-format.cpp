@@ -0,0 +1,84 @@
+#include "vertex-format.hpp"
+
+#include "glm/packing.hpp"
+
+namespace geg::vulkan {
+  namespace {
+    glm::vec2 sign_not_zero(glm::vec2 v) {
+      return {v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f};
+    }
+
+    uint16_t quantize_unorm16(float value, float offset, float scale) {
+      // a flat axis keeps every vertex at the offset
+      if (scale <= 0.0f) return 0;
+      const float unorm = glm::clamp((value - offset) / scale, 0.0f, 1.0f);
+      return static_cast<uint16_t>(unorm * 65535.0f + 0.5f);
+    }
+  }    // namespace
+
+  glm::vec2 octahedral_encode(glm::vec3 n) {
+    const float sum = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+    // importers leave the tangent zero when there are no uvs
+    if (sum == 0.0f) return {0.0f, 0.0f};
+
+    n /= sum;
+    const glm::vec2 p(n.x, n.y);
+    if (n.z >= 0.0f) return p;
+
+    return (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign_not_zero(p);
+  }
+
+  // same as oct_decode in the shaders
+  glm::vec3 octahedral_decode(glm::vec2 e) {
+    glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+    const float t = glm::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    return glm::normalize(n);
+  }
+
+  VertexStreamHeader quantize_vertices(
+      std::span<const Vertex> vertices, std::vector<PackedVertex>& packed) {
+    glm::vec3 min(0.0f);
+    glm::vec3 max(0.0f);
+    if (!vertices.empty()) min = max = vertices[0].position;
+    for (const auto& vertex : vertices) {
+      min = glm::min(min, vertex.position);
+      max = glm::max(max, vertex.position);
+    }
+
+    const VertexStreamHeader header = {
+        .position_offset = min,
+        .format = VertexFormat::Quantized,
+        .position_scale = max - min,
+    };
+
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+      const auto& vertex = vertices[i];
+      auto& out = packed[i];
+      for (int32_t axis = 0; axis < 3; axis++)
+        out.position[axis] = quantize_unorm16(
+            vertex.position[axis], header.position_offset[axis], header.position_scale[axis]);
+
+      out.normal = glm::packSnorm2x16(octahedral_encode(vertex.normal));
+      out.tangent = glm::packSnorm2x16(octahedral_encode(vertex.tangent));
+      out.tex_coord = glm::packHalf2x16(vertex.tex_coord);
+    }
+
+    return header;
+  }
+
+  Vertex dequantize_vertex(const PackedVertex& vertex, const VertexStreamHeader& header) {
+    const glm::vec3 unorm =
+        glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) / 65535.0f;
+
+    return {
+        .position = header.position_offset + unorm * header.position_scale,
+        .normal = octahedral_decode(glm::unpackSnorm2x16(vertex.normal)),
+        .tangent = octahedral_decode(glm::unpackSnorm2x16(vertex.tangent)),
+        .tex_coord = glm::unpackHalf2x16(vertex.tex_coord),
+    };
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace geg::vulkan {
+  // what the importers produce and what cooked files and scene files store
+  struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 tangent;
+    glm::vec2 tex_coord;
+    glm::vec2 padding = {0, 0};
+  };
+
+  // how a mesh keeps its vertices on the gpu, the shaders read both
+  enum class VertexFormat : uint32_t {
+    // Vertex as is, 52 bytes
+    Full = 0,
+    // PackedVertex, 20 bytes
+    Quantized = 1,
+  };
+
+  // position in unorm16 against the mesh bounds, normal and tangent octahedral encoded in
+  // snorm16x2, uv in half floats
+  struct PackedVertex {
+    uint16_t position[3];
+    uint16_t padding = 0;
+    uint32_t normal;
+    uint32_t tangent;
+    uint32_t tex_coord;
+  };
+  static_assert(sizeof(PackedVertex) == 20, "the shaders read packed vertices as 5 words");
+
+  // at the start of a mesh's vertex range, matches the Vertices block in the shaders
+  struct VertexStreamHeader {
+    glm::vec3 position_offset{0};
+    VertexFormat format = VertexFormat::Full;
+    glm::vec3 position_scale{1};
+    // bytes of one index in the index range, 2 or 4, the draws bind the range as an index
+    // buffer so the shaders don't read it
+    uint32_t index_size = 4;
+  };
+  static_assert(sizeof(VertexStreamHeader) == 32);
+
+  // the header's offset and scale are the bounds of the positions
+  VertexStreamHeader quantize_vertices(
+      std::span<const Vertex> vertices, std::vector<PackedVertex>& packed);
+  Vertex dequantize_vertex(const PackedVertex& vertex, const VertexStreamHeader& header);
+
+  // unit vector to the [-1, 1] square and back
+  glm::vec2 octahedral_encode(glm::vec3 n);
+  glm::vec3 octahedral_decode(glm::vec2 e);
+}    // namespace geg::vulkan
@@ -0,0 +1,179 @@
+#include "residency-manager.hpp"
+
+#include <algorithm>
+
+#include "assets/asset-manager.hpp"
+#include "imgui.h"
+#include "vk_mem_alloc.h"
+
+namespace geg {
+  namespace {
+    // the mip chain adds a third of the base level
+    size_t texture_bytes(const vulkan::Texture& texture) {
+      return texture.size() + (texture.mipmap_levels > 1 ? texture.size() / 3 : 0);
+    }
+  }    // namespace
+
+  void ResidencyManager::begin_frame(uint64_t frame) {
+    m_frame = frame;
+
+    auto& assets = AssetManager::get();
+    const auto allocator = assets.m_device->allocator;
+
+    const VkPhysicalDeviceMemoryProperties* memory_props = nullptr;
+    vmaGetMemoryProperties(allocator, &memory_props);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    // integrated gpus only have device local heaps, that's fine, it's the memory that runs out
+    size_t usage = 0;
+    size_t available = 0;
+    for (uint32_t i = 0; i < memory_props->memoryHeapCount; i++) {
+      if (!(memory_props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) continue;
+      usage += budgets[i].usage;
+      available += budgets[i].budget;
+    }
+
+    // what was evicted in the last frames is still allocated until the device retires it
+    usage -= std::min(usage, assets.m_device->pending_deletion_bytes());
+
+    const auto settings = this->settings();
+    const size_t budget = settings.budget ?
+                              settings.budget :
+                              static_cast<size_t>(available * settings.budget_fraction);
+    size_t evicted_bytes = 0;
+    if (usage > budget) evicted_bytes = evict(usage - budget, settings.min_idle_frames);
+
+    size_t resident = 0;
+    uint32_t evicted = 0;
+    for (const auto* entries : {&m_meshs, &m_textures}) {
+      for (const auto& e : *entries) {
+        if (e.evicted)
+          evicted++;
+        else
+          resident += e.bytes;
+      }
+    }
+
+    std::lock_guard lock(m_mutex);
+    m_stats.budget = budget;
+    m_stats.usage = usage - std::min(usage, evicted_bytes);
+    m_stats.resident_bytes = resident;
+    m_stats.evicted = evicted;
+  }
+
+  size_t ResidencyManager::evict(size_t bytes, uint64_t idle_frames) {
+    struct Candidate {
+      uint64_t last_used;
+      uint32_t index;
+      bool texture;
+    };
+
+    std::vector<Candidate> candidates;
+    const auto gather = [&](const std::vector<Entry>& entries, bool texture) {
+      for (uint32_t i = 0; i < entries.size(); i++) {
+        const auto& e = entries[i];
+        if (e.evicted || !e.bytes || e.last_used + idle_frames > m_frame) continue;
+        candidates.push_back({e.last_used, i, texture});
+      }
+    };
+    gather(m_meshs, false);
+    gather(m_textures, true);
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+      return a.last_used < b.last_used;
+    });
+
+    auto& assets = AssetManager::get();
+    size_t freed = 0;
+    uint32_t evictions = 0;
+    for (const auto& candidate : candidates) {
+      if (freed >= bytes) break;
+
+      auto& e = candidate.texture ? m_textures[candidate.index] : m_meshs[candidate.index];
+      const bool evicted =
+          candidate.texture ?
+              assets.evict_texture({.index = candidate.index, .generation = e.generation}) :
+              assets.evict_mesh({.index = candidate.index, .generation = e.generation});
+      if (!evicted) continue;
+
+      e.evicted = true;
+      freed += e.bytes;
+      evictions++;
+    }
+
+    if (evictions)
+      GEG_CORE_INFO(
+          "residency: evicted {} assets, {:.2f} MiB", evictions, freed / (1024.0 * 1024.0));
+
+    std::lock_guard lock(m_mutex);
+    m_stats.evictions += evictions;
+
+    return freed;
+  }
+
+  const vulkan::Mesh* ResidencyManager::use(MeshId id) {
+    auto& assets = AssetManager::get();
+    if (!assets.m_meshs.contains(id)) return nullptr;
+
+    auto& e = entry(m_meshs, id);
+    e.last_used = m_frame;
+    if (e.evicted && assets.restore_mesh(id)) {
+      e.evicted = false;
+      std::lock_guard lock(m_mutex);
+      m_stats.reloads++;
+    }
+
+    const auto* mesh = assets.m_meshs.get(id);
+    if (mesh) e.bytes = mesh->size;
+
+    return mesh;
+  }
+
+  vulkan::Texture* ResidencyManager::use(TextureId id) {
+    auto& assets = AssetManager::get();
+    if (!assets.m_textures.contains(id)) return nullptr;
+
+    auto& e = entry(m_textures, id);
+    e.last_used = m_frame;
+    if (e.evicted && assets.restore_texture(id)) {
+      e.evicted = false;
+      std::lock_guard lock(m_mutex);
+      m_stats.reloads++;
+    }
+
+    auto* texture = assets.m_textures.get(id);
+    if (texture) e.bytes = texture_bytes(*texture);
+
+    return texture;
+  }
+
+  void ResidencyManager::clear() {
+    m_meshs.clear();
+    m_textures.clear();
+    m_frame = 0;
+
+    std::lock_guard lock(m_mutex);
+    m_stats = {};
+  }
+
+  void ResidencyManager::draw_debug_ui() {
+    if (!ImGui::CollapsingHeader("Residency: ")) return;
+
+    std::lock_guard lock(m_mutex);
+    constexpr double mib = 1024.0 * 1024.0;
+    ImGui::Text(
+        "device memory: %.2f / %.2f MiB", m_stats.usage / mib, m_stats.budget / mib);
+    ImGui::Text("resident assets: %.2f MiB", m_stats.resident_bytes / mib);
+    ImGui::Text("evicted assets: %u", m_stats.evicted);
+    ImGui::Text("evictions: %u, reloads: %u", m_stats.evictions, m_stats.reloads);
+
+    // MiB in the ui, 0 keeps the fraction of the driver's budget
+    int budget_mib = static_cast<int>(m_settings.budget / (1024 * 1024));
+    if (ImGui::DragInt("Budget (MiB, 0 = auto)", &budget_mib, 16.f, 0, 1 << 20))
+      m_settings.budget = static_cast<size_t>(budget_mib) * 1024 * 1024;
+    ImGui::SliderFloat("Budget fraction", &m_settings.budget_fraction, 0.1f, 1.0f);
+    int idle_frames = static_cast<int>(m_settings.min_idle_frames);
+    if (ImGui::DragInt("Min idle frames", &idle_frames, 1.f, 1, 1000))
+      m_settings.min_idle_frames = static_cast<uint32_t>(idle_frames);
+  }
+}    // namespace geg
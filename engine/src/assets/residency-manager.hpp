@@ -0,0 +1,98 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "pch.hpp"
+#include "assets/asset-handles.hpp"
+
+namespace geg {
+  struct ResidencySettings {
+    // bytes of device local memory the engine may use, 0 takes budget_fraction of what the
+    // driver reports as available
+    size_t budget = 0;
+    float budget_fraction = 0.8f;
+    // assets used within this many frames are never evicted, keeps a working set that is
+    // slightly over budget from being evicted and reloaded every frame
+    uint32_t min_idle_frames = 4;
+  };
+
+  // keeps the meshes and textures under a device memory budget, the least recently drawn
+  // ones are evicted and reloaded the next time a pass uses them
+  // meshes come back from the copy they keep in system memory, textures are decoded again
+  // from their file so textures without a source are never evicted
+  // everything but the settings, stats and debug ui is render thread only
+  class ResidencyManager {
+  public:
+    struct Stats {
+      // what the assets may use this frame
+      size_t budget = 0;
+      // device local memory in use as vma reports it, render targets included and queued
+      // deletions excluded
+      size_t usage = 0;
+      size_t resident_bytes = 0;
+      uint32_t evicted = 0;
+      // since init
+      uint32_t evictions = 0;
+      uint32_t reloads = 0;
+    };
+
+    ResidencyManager() = default;
+    ResidencyManager(const ResidencyManager&) = delete;
+    ResidencyManager& operator=(const ResidencyManager&) = delete;
+
+    // evicts idle assets until the usage fits, the device destroys them once the frames
+    // in flight are done with them
+    void begin_frame(uint64_t frame);
+
+    // marks the asset as used by the current frame and reloads it if it was evicted,
+    // null for unknown handles and assets that are still queued
+    const vulkan::Mesh* use(MeshId id);
+    vulkan::Texture* use(TextureId id);
+
+    void set_settings(const ResidencySettings& settings) {
+      std::lock_guard lock(m_mutex);
+      m_settings = settings;
+    }
+    ResidencySettings settings() const {
+      std::lock_guard lock(m_mutex);
+      return m_settings;
+    }
+    Stats stats() const {
+      std::lock_guard lock(m_mutex);
+      return m_stats;
+    }
+
+    void draw_debug_ui();
+    void clear();
+
+  private:
+    struct Entry {
+      uint32_t generation = 0;
+      uint64_t last_used = 0;
+      size_t bytes = 0;
+      bool evicted = false;
+    };
+
+    // a reused slot starts over, the old asset's history means nothing
+    template<typename T>
+    static Entry& entry(std::vector<Entry>& entries, AssetHandle<T> id) {
+      if (entries.size() <= id.index) entries.resize(id.index + 1);
+      auto& e = entries[id.index];
+      if (e.generation != id.generation) e = {.generation = id.generation};
+
+      return e;
+    }
+
+    // least recently used first, returns the bytes freed
+    size_t evict(size_t bytes, uint64_t idle_frames);
+
+    std::vector<Entry> m_meshs;
+    std::vector<Entry> m_textures;
+    uint64_t m_frame = 0;
+
+    mutable std::mutex m_mutex;
+    ResidencySettings m_settings;
+    Stats m_stats;
+  };
+}    // namespace geg
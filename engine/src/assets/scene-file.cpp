@@ -0,0 +1,618 @@
+#include "scene-file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "assets/asset-manager.hpp"
+#include "ecs/components.hpp"
+#include "utils/hash.hpp"
+#include "utils/mapped-file.hpp"
+
+namespace geg {
+  namespace {
+    namespace cmps = components;
+
+    constexpr char k_magic[4] = {'G', 'E', 'G', 'S'};
+    constexpr uint32_t k_version = 6;
+    // every array starts 16 bytes aligned so the mmapped data can be used in place
+    constexpr size_t k_alignment = 16;
+
+    // stable on disk, the registry's type ids can change between builds
+    enum class PoolId : uint32_t {
+      Name,
+      Transform,
+      Mesh,
+      Material,
+      Light,
+      EnvMap,
+      SkyLight,
+      HlodRange,
+      Static,
+    };
+
+    // all the offsets are from the start of the file, the file is little endian
+    struct FileHeader {
+      char magic[4];
+      uint32_t version;
+      uint32_t entities_count;
+      uint32_t meshes_count;
+      uint32_t textures_count;
+      uint32_t materials_count;
+      uint32_t pools_count;
+      uint32_t padding = 0;
+      uint64_t meshes_offset;
+      uint64_t textures_offset;
+      uint64_t materials_offset;
+      uint64_t pools_offset;
+    };
+
+    struct MeshRecord {
+      uint64_t content_id;
+      uint64_t vertices_offset;
+      // every lod, indices_count covers them all
+      uint64_t indices_offset;
+      uint64_t lods_offset;
+      uint32_t vertices_count;
+      uint32_t indices_count;
+      // 2 or 4
+      uint32_t index_size;
+      // zero when the lods are built on load
+      uint32_t lods_count;
+    };
+
+    struct TextureRecord {
+      uint64_t content_id;
+      uint64_t path_offset;
+      uint32_t path_size;
+      uint32_t mip_maps;
+      int32_t format;
+      uint32_t padding = 0;
+    };
+
+    struct PoolRecord {
+      PoolId id;
+      // size of one element, a mismatch means the component changed since the file was written
+      uint32_t stride;
+      uint32_t count;
+      uint32_t padding = 0;
+      // local entity indices, then the components in the same order
+      uint64_t entities_offset;
+      uint64_t data_offset;
+    };
+
+    struct StringRecord {
+      uint64_t offset;
+      uint32_t size;
+      uint32_t padding = 0;
+    };
+
+    // the textures are indices into the file's texture table, -1 for none
+    struct MaterialRecord {
+      int32_t albedo;
+      int32_t metallic_roughness;
+      int32_t normal_map;
+      int32_t emissive_map;
+
+      glm::vec3 color_factor;
+      glm::vec3 emissive_factor;
+      float metallic_factor;
+      float roughness_factor;
+      float AO;
+    };
+
+    // the meshes come from their system memory copy
+    class LoadedAssets final: public SceneFileAssets {
+    public:
+      SceneFileMesh mesh(MeshId id) override {
+        auto& asset_manager = AssetManager::get();
+        const auto& mesh = asset_manager.get_mesh(id);
+        return {
+            .data = mesh.download(true),
+            .vertices_size = mesh.vertices_count() * sizeof(vulkan::Vertex),
+            .index_type = mesh.index_type(),
+            .content_id = asset_manager.mesh_content_id(id),
+            .lods = {mesh.lods().begin(), mesh.lods().end()},
+        };
+      }
+
+      AssetManager::TextureInfo texture(TextureId id) override {
+        return AssetManager::get().get_texture_source(id);
+      }
+
+      Material material(MaterialId id) override { return AssetManager::get().get_material(id); }
+    };
+
+    class Writer {
+    public:
+      Writer(Scene& scene, SceneFileAssets& assets): m_reg(scene.get_reg()), m_assets(assets) {
+        m_bytes.resize(sizeof(FileHeader));
+      }
+
+      bool write(const fs::path& path) {
+        m_reg.each([this](entt::entity e) { m_entities[e] = m_entities_count++; });
+
+        write_pool<cmps::Name>(PoolId::Name, [this](const cmps::Name& name) {
+          return StringRecord{
+              .offset = append(std::span(name.name.data(), name.name.size())),
+              .size = static_cast<uint32_t>(name.name.size()),
+          };
+        });
+        write_pool<cmps::Transform>(PoolId::Transform, [](const auto& c) { return c; });
+        write_pool<cmps::Mesh>(
+            PoolId::Mesh, [this](const cmps::Mesh& mesh) { return remap_mesh(mesh.id); });
+        write_pool<cmps::Material>(PoolId::Material, [this](const cmps::Material& material) {
+          return remap_material(material.id);
+        });
+        write_pool<cmps::Light>(PoolId::Light, [](const auto& c) { return c; });
+        write_pool<cmps::EnvMap>(
+            PoolId::EnvMap, [this](const cmps::EnvMap& env) { return remap_texture(env.env_map); });
+        write_pool<cmps::SkyLight>(PoolId::SkyLight, [](const auto& c) { return c; });
+        write_pool<cmps::HlodRange>(PoolId::HlodRange, [](const auto& c) { return c; });
+        write_tag<cmps::Static>(PoolId::Static);
+
+        const FileHeader header{
+            .magic = {k_magic[0], k_magic[1], k_magic[2], k_magic[3]},
+            .version = k_version,
+            .entities_count = m_entities_count,
+            .meshes_count = static_cast<uint32_t>(m_meshes.size()),
+            .textures_count = static_cast<uint32_t>(m_textures.size()),
+            .materials_count = static_cast<uint32_t>(m_materials.size()),
+            .pools_count = static_cast<uint32_t>(m_pools.size()),
+            .meshes_offset = append(std::span(m_meshes)),
+            .textures_offset = append(std::span(m_textures)),
+            .materials_offset = append(std::span(m_materials)),
+            .pools_offset = append(std::span(m_pools)),
+        };
+        std::memcpy(m_bytes.data(), &header, sizeof(header));
+
+        fs::create_directories(fs::absolute(path).parent_path());
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+          GEG_CORE_ERROR("can't open {} for writing", path.string());
+          return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(m_bytes.data()), m_bytes.size());
+        GEG_CORE_INFO(
+            "saved scene {}: {} entities, {} meshes, {} textures, {} materials, {} bytes",
+            path.string(),
+            m_entities_count,
+            m_meshes.size(),
+            m_textures.size(),
+            m_materials.size(),
+            m_bytes.size());
+
+        return file.good();
+      }
+
+    private:
+      template<typename T>
+      uint64_t append(std::span<T> data) {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        const auto offset = (m_bytes.size() + k_alignment - 1) & ~(k_alignment - 1);
+        m_bytes.resize(offset + data.size_bytes());
+        if (!data.empty()) std::memcpy(m_bytes.data() + offset, data.data(), data.size_bytes());
+
+        return offset;
+      }
+
+      template<typename T, typename Fn>
+      void write_pool(PoolId id, Fn&& convert) {
+        using Stored = std::invoke_result_t<Fn, const T&>;
+
+        const auto view = m_reg.view<T>();
+        if (view.empty()) return;
+
+        std::vector<uint32_t> entities;
+        std::vector<Stored> data;
+        entities.reserve(view.size());
+        data.reserve(view.size());
+        for (const auto e : view) {
+          entities.push_back(m_entities[e]);
+          data.push_back(convert(view.template get<T>(e)));
+        }
+
+        m_pools.push_back({
+            .id = id,
+            .stride = sizeof(Stored),
+            .count = static_cast<uint32_t>(data.size()),
+            .entities_offset = append(std::span(entities)),
+            .data_offset = append(std::span(data)),
+        });
+      }
+
+      // tags have no data, only the entities
+      template<typename T>
+      void write_tag(PoolId id) {
+        const auto view = m_reg.view<T>();
+        if (view.empty()) return;
+
+        std::vector<uint32_t> entities;
+        entities.reserve(view.size());
+        for (const auto e : view)
+          entities.push_back(m_entities[e]);
+
+        m_pools.push_back({
+            .id = id,
+            .stride = 0,
+            .count = static_cast<uint32_t>(entities.size()),
+            .entities_offset = append(std::span(entities)),
+            .data_offset = 0,
+        });
+      }
+
+      int32_t remap_mesh(MeshId id) {
+        if (!id) return -1;
+        if (const auto it = m_mesh_indices.find(id); it != m_mesh_indices.end())
+          return it->second;
+
+        const auto mesh = m_assets.mesh(id);
+        const auto bytes = std::as_bytes(std::span(mesh.data));
+        const auto vertices = bytes.first(mesh.vertices_size);
+        const auto indices = bytes.subspan(mesh.vertices_size);
+        const auto index_size = vulkan::index_size(mesh.index_type);
+
+        auto content_id = mesh.content_id;
+        if (!content_id) content_id = vulkan::Mesh::content_hash(vertices, indices);
+
+        m_meshes.push_back({
+            .content_id = content_id,
+            .vertices_offset = append(vertices),
+            .indices_offset = append(indices),
+            .lods_offset = append(std::span(mesh.lods)),
+            .vertices_count = static_cast<uint32_t>(vertices.size() / sizeof(vulkan::Vertex)),
+            .indices_count = static_cast<uint32_t>(indices.size() / index_size),
+            .index_size = index_size,
+            .lods_count = static_cast<uint32_t>(mesh.lods.size()),
+        });
+
+        return m_mesh_indices[id] = static_cast<int32_t>(m_meshes.size() - 1);
+      }
+
+      int32_t remap_texture(TextureId id) {
+        if (!id) return -1;
+        if (const auto it = m_texture_indices.find(id); it != m_texture_indices.end())
+          return it->second;
+
+        const auto source = m_assets.texture(id);
+        if (source.path.empty()) {
+          GEG_CORE_WARN("texture {} wasn't loaded from a file, not saved", id.index);
+          return m_texture_indices[id] = -1;
+        }
+
+        const auto path = source.path.string();
+        const auto format = static_cast<int32_t>(source.format);
+        // the hash of the file when it could be read, the path otherwise
+        m_textures.push_back({
+            .content_id = source.content_id ?
+                              source.content_id :
+                              hash_string(
+                                  path, hash_bytes(&source.mip_maps, sizeof(uint32_t), format)),
+            .path_offset = append(std::span(path.data(), path.size())),
+            .path_size = static_cast<uint32_t>(path.size()),
+            .mip_maps = source.mip_maps,
+            .format = format,
+        });
+
+        return m_texture_indices[id] = static_cast<int32_t>(m_textures.size() - 1);
+      }
+
+      int32_t remap_material(MaterialId id) {
+        if (!id) return -1;
+        if (const auto it = m_material_indices.find(id); it != m_material_indices.end())
+          return it->second;
+
+        const auto material = m_assets.material(id);
+        m_materials.push_back({
+            .albedo = remap_texture(material.albedo),
+            .metallic_roughness = remap_texture(material.metallic_roughness),
+            .normal_map = remap_texture(material.normal_map),
+            .emissive_map = remap_texture(material.emissive_map),
+            .color_factor = material.color_factor,
+            .emissive_factor = material.emissive_factor,
+            .metallic_factor = material.metallic_factor,
+            .roughness_factor = material.roughness_factor,
+            .AO = material.AO,
+        });
+
+        return m_material_indices[id] = static_cast<int32_t>(m_materials.size() - 1);
+      }
+
+      entt::registry& m_reg;
+      SceneFileAssets& m_assets;
+      std::vector<uint8_t> m_bytes;
+
+      std::unordered_map<entt::entity, uint32_t> m_entities;
+      uint32_t m_entities_count = 0;
+      std::unordered_map<MeshId, int32_t> m_mesh_indices;
+      std::unordered_map<TextureId, int32_t> m_texture_indices;
+      std::unordered_map<MaterialId, int32_t> m_material_indices;
+
+      std::vector<MeshRecord> m_meshes;
+      std::vector<TextureRecord> m_textures;
+      std::vector<MaterialRecord> m_materials;
+      std::vector<PoolRecord> m_pools;
+    };
+
+    class Reader {
+    public:
+      Reader(Scene* scene, const MappedFile& file): m_reg(scene->get_reg()), m_file(file) {}
+
+      bool read() {
+        FileHeader header;
+        if (m_file.size() < sizeof(header)) return fail("truncated header");
+        std::memcpy(&header, m_file.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, k_magic, sizeof(k_magic)) != 0)
+          return fail("not a scene file");
+        if (header.version != k_version)
+          return fail("unsupported version");
+
+        const auto* meshes = array<MeshRecord>(header.meshes_offset, header.meshes_count);
+        const auto* textures =
+            array<TextureRecord>(header.textures_offset, header.textures_count);
+        const auto* materials =
+            array<MaterialRecord>(header.materials_offset, header.materials_count);
+        const auto* pools = array<PoolRecord>(header.pools_offset, header.pools_count);
+        if (!meshes || !textures || !materials || !pools) return fail("corrupted tables");
+
+        // everything is checked before anything is loaded or created, a bad file leaves the
+        // scene and the asset manager as they were
+        for (uint32_t i = 0; i < header.meshes_count; i++)
+          if (!check_mesh(meshes[i])) return fail("corrupted mesh");
+        for (uint32_t i = 0; i < header.textures_count; i++)
+          if (!array<char>(textures[i].path_offset, textures[i].path_size))
+            return fail("corrupted texture path");
+        for (uint32_t i = 0; i < header.pools_count; i++)
+          if (!check_pool(pools[i], header.entities_count))
+            return fail("corrupted component pool");
+
+        auto& asset_manager = AssetManager::get();
+
+        // the vertices are uploaded straight from the mapping
+        m_meshes.resize(header.meshes_count);
+        for (uint32_t i = 0; i < header.meshes_count; i++) {
+          const auto& record = meshes[i];
+          const auto* vertices =
+              array<vulkan::Vertex>(record.vertices_offset, record.vertices_count);
+          const auto indices_size = uint64_t(record.indices_count) * record.index_size;
+          const auto* indices = array<std::byte>(record.indices_offset, indices_size);
+          const auto* lods = array<vulkan::MeshLod>(record.lods_offset, record.lods_count);
+
+          const auto index_type =
+              record.index_size == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+          m_meshes[i] = asset_manager.load_mesh(
+              std::span(vertices, record.vertices_count),
+              {index_type, {indices, indices_size}},
+              record.content_id,
+              std::span(lods, record.lods_count));
+        }
+
+        m_textures.resize(header.textures_count);
+        for (uint32_t i = 0; i < header.textures_count; i++) {
+          const auto& record = textures[i];
+          m_textures[i] = asset_manager.enqueue_texture(
+              std::string(array<char>(record.path_offset, record.path_size), record.path_size),
+              static_cast<vk::Format>(record.format),
+              record.mip_maps);
+        }
+        asset_manager.load_textures();
+        asset_manager.log_dedup_stats();
+
+        // identical materials collapse into the ones already loaded
+        m_materials.resize(header.materials_count);
+        for (uint32_t i = 0; i < header.materials_count; i++) {
+          const auto& record = materials[i];
+          m_materials[i] = asset_manager.add_material({
+              .albedo = texture_id(record.albedo),
+              .metallic_roughness = texture_id(record.metallic_roughness),
+              .normal_map = texture_id(record.normal_map),
+              .emissive_map = texture_id(record.emissive_map),
+              .color_factor = record.color_factor,
+              .emissive_factor = record.emissive_factor,
+              .metallic_factor = record.metallic_factor,
+              .roughness_factor = record.roughness_factor,
+              .AO = record.AO,
+          });
+        }
+
+        m_entities.resize(header.entities_count);
+        m_reg.create(m_entities.begin(), m_entities.end());
+
+        for (uint32_t i = 0; i < header.pools_count; i++) {
+          bool res = false;
+          switch (pools[i].id) {
+            case PoolId::Name:
+              res = read_pool<cmps::Name, StringRecord>(pools[i], [this](const StringRecord& s) {
+                const auto* str = array<char>(s.offset, s.size);
+                return str ? cmps::Name(std::string(str, s.size)) : cmps::Name();
+              });
+              break;
+            case PoolId::Transform: res = read_pool<cmps::Transform>(pools[i]); break;
+            case PoolId::Mesh:
+              res = read_pool<cmps::Mesh, int32_t>(
+                  pools[i], [this](int32_t mesh) { return cmps::Mesh(mesh_id(mesh)); });
+              break;
+            case PoolId::Material:
+              res = read_pool<cmps::Material, int32_t>(pools[i], [this](int32_t material) {
+                return cmps::Material(material_id(material));
+              });
+              break;
+            case PoolId::Light: res = read_pool<cmps::Light>(pools[i]); break;
+            case PoolId::EnvMap:
+              res = read_pool<cmps::EnvMap, int32_t>(pools[i], [this](int32_t texture) {
+                return cmps::EnvMap{.env_map = texture_id(texture)};
+              });
+              break;
+            case PoolId::SkyLight: res = read_pool<cmps::SkyLight>(pools[i]); break;
+            case PoolId::HlodRange: res = read_pool<cmps::HlodRange>(pools[i]); break;
+            case PoolId::Static: res = read_tag<cmps::Static>(pools[i]); break;
+            default:
+              GEG_CORE_WARN("unknown pool {} in scene file, skipped", uint32_t(pools[i].id));
+              res = true;
+          }
+
+          if (!res) return fail("corrupted component pool");
+        }
+
+        return true;
+      }
+
+    private:
+      bool fail(const char* reason) {
+        GEG_CORE_ERROR("can't load scene file: {}", reason);
+        return false;
+      }
+
+      // null when the range doesn't fit in the file
+      template<typename T>
+      const T* array(uint64_t offset, uint64_t count) const {
+        if (offset % alignof(T) != 0) return nullptr;
+        if (offset > m_file.size() || count > (m_file.size() - offset) / sizeof(T))
+          return nullptr;
+
+        return reinterpret_cast<const T*>(m_file.data() + offset);
+      }
+
+      MeshId mesh_id(int32_t index) const {
+        return index < 0 || uint32_t(index) >= m_meshes.size() ? MeshId{} : m_meshes[index];
+      }
+
+      TextureId texture_id(int32_t index) const {
+        return index < 0 || uint32_t(index) >= m_textures.size() ? TextureId{} : m_textures[index];
+      }
+
+      MaterialId material_id(int32_t index) const {
+        return index < 0 || uint32_t(index) >= m_materials.size() ? MaterialId{} :
+                                                                    m_materials[index];
+      }
+
+      bool check_mesh(const MeshRecord& record) const {
+        if (record.index_size != 2 && record.index_size != 4) return false;
+
+        const auto indices_size = uint64_t(record.indices_count) * record.index_size;
+        const auto* lods = array<vulkan::MeshLod>(record.lods_offset, record.lods_count);
+        if (!array<vulkan::Vertex>(record.vertices_offset, record.vertices_count) ||
+            !array<std::byte>(record.indices_offset, indices_size) || !lods)
+          return false;
+
+        const std::span lods_span(lods, record.lods_count);
+        return lods_span.empty() || vulkan::lods_fit(lods_span, record.indices_count);
+      }
+
+      // the stride and every range of the pool, unknown pools are skipped when reading
+      bool check_pool(const PoolRecord& pool, uint32_t entities_count) const {
+        switch (pool.id) {
+          case PoolId::Name: return check_pool_as<StringRecord>(pool, entities_count);
+          case PoolId::Transform: return check_pool_as<cmps::Transform>(pool, entities_count);
+          case PoolId::Mesh:
+          case PoolId::Material:
+          case PoolId::EnvMap: return check_pool_as<int32_t>(pool, entities_count);
+          case PoolId::Light: return check_pool_as<cmps::Light>(pool, entities_count);
+          case PoolId::SkyLight: return check_pool_as<cmps::SkyLight>(pool, entities_count);
+          case PoolId::HlodRange: return check_pool_as<cmps::HlodRange>(pool, entities_count);
+          case PoolId::Static: return pool.stride == 0 && check_entities(pool, entities_count);
+          default: return true;
+        }
+      }
+
+      template<typename Stored>
+      bool check_pool_as(const PoolRecord& pool, uint32_t entities_count) const {
+        if (pool.stride != sizeof(Stored)) return false;
+
+        return array<Stored>(pool.data_offset, pool.count) && check_entities(pool, entities_count);
+      }
+
+      bool check_entities(const PoolRecord& pool, uint32_t entities_count) const {
+        const auto* indices = array<uint32_t>(pool.entities_offset, pool.count);
+        if (!indices) return false;
+        for (uint32_t i = 0; i < pool.count; i++)
+          if (indices[i] >= entities_count) return false;
+
+        return true;
+      }
+
+      bool pool_entities(const PoolRecord& pool, std::vector<entt::entity>& entities) {
+        const auto* indices = array<uint32_t>(pool.entities_offset, pool.count);
+        if (!indices) return false;
+
+        entities.resize(pool.count);
+        for (uint32_t i = 0; i < pool.count; i++) {
+          if (indices[i] >= m_entities.size()) return false;
+          entities[i] = m_entities[indices[i]];
+        }
+
+        return true;
+      }
+
+      // plain components are inserted straight from the mapping
+      template<typename T>
+      bool read_pool(const PoolRecord& pool) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (pool.stride != sizeof(T)) return false;
+
+        const auto* data = array<T>(pool.data_offset, pool.count);
+        std::vector<entt::entity> entities;
+        if (!data || !pool_entities(pool, entities)) return false;
+
+        m_reg.insert<T>(entities.begin(), entities.end(), data);
+        return true;
+      }
+
+      template<typename T>
+      bool read_tag(const PoolRecord& pool) {
+        std::vector<entt::entity> entities;
+        if (pool.stride != 0 || !pool_entities(pool, entities)) return false;
+
+        m_reg.insert<T>(entities.begin(), entities.end());
+        return true;
+      }
+
+      template<typename T, typename Stored, typename Fn>
+      bool read_pool(const PoolRecord& pool, Fn&& convert) {
+        if (pool.stride != sizeof(Stored)) return false;
+
+        const auto* data = array<Stored>(pool.data_offset, pool.count);
+        std::vector<entt::entity> entities;
+        if (!data || !pool_entities(pool, entities)) return false;
+
+        std::vector<T> components;
+        components.reserve(pool.count);
+        for (uint32_t i = 0; i < pool.count; i++)
+          components.push_back(convert(data[i]));
+
+        m_reg.insert<T>(entities.begin(), entities.end(), components.begin());
+        return true;
+      }
+
+      entt::registry& m_reg;
+      const MappedFile& m_file;
+
+      std::vector<entt::entity> m_entities;
+      std::vector<MeshId> m_meshes;
+      std::vector<TextureId> m_textures;
+      std::vector<MaterialId> m_materials;
+    };
+  }    // namespace
+
+  bool save_scene_file(Scene& scene, const fs::path& path) {
+    LoadedAssets assets;
+    return Writer(scene, assets).write(path);
+  }
+
+  bool save_scene_file(Scene& scene, const fs::path& path, SceneFileAssets& assets) {
+    return Writer(scene, assets).write(path);
+  }
+
+  bool load_scene_file(Scene* scene, const fs::path& path) {
+    MappedFile file(path);
+    if (!file.is_open()) {
+      GEG_CORE_ERROR("can't open scene file {}", path.string());
+      return false;
+    }
+
+    return Reader(scene, file).read();
+  }
+}    // namespace geg
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "pch.hpp"
+#include "assets/asset-manager.hpp"
+#include "ecs/scene.hpp"
+
+namespace geg {
+  struct SceneFileMesh {
+    // vertices then every lod's indices
+    std::vector<uint8_t> data;
+    size_t vertices_size = 0;
+    vk::IndexType index_type = vk::IndexType::eUint32;
+    // zero to hash the data
+    uint64_t content_id = 0;
+    // empty when the indices are only the full mesh, the lods are built when it's loaded
+    std::vector<vulkan::MeshLod> lods;
+  };
+
+  // where save_scene_file gets what the components reference, by default the asset
+  // manager, the cooker writes scenes without a device and provides its own
+  class SceneFileAssets {
+  public:
+    virtual ~SceneFileAssets() = default;
+
+    virtual SceneFileMesh mesh(MeshId id) = 0;
+    // an empty path leaves the texture out of the file
+    virtual AssetManager::TextureInfo texture(TextureId id) = 0;
+    virtual Material material(MaterialId id) = 0;
+  };
+
+  // binary snapshot of a scene, every component pool is one contiguous array and assets
+  // are referenced by content id so a file written by one run loads in any other
+  // mesh data is stored inline, textures by their source path
+  // like AssetManager::load_scene both must be called before App::run, they use the
+  // device queue and the asset lists the render thread reads
+
+  // downloads the meshes back from the gpu, entities keep their relative order
+  bool save_scene_file(Scene& scene, const fs::path& path);
+  bool save_scene_file(Scene& scene, const fs::path& path, SceneFileAssets& assets);
+  // mmaps the file and bulk creates the entities, meshes that are already loaded
+  // (same content id) are reused, entities tagged Static are kept as they are until
+  // bake_static_batches
+  bool load_scene_file(Scene* scene, const fs::path& path);
+}    // namespace geg
@@ -0,0 +1,221 @@
+#include "static-batching.hpp"
+
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include "assets/asset-manager.hpp"
+#include "assets/meshes/mesh-optimizer.hpp"
+#include "assets/meshes/mesh-simplifier.hpp"
+#include "ecs/components.hpp"
+#include "ecs/entity.hpp"
+
+namespace geg {
+  namespace {
+    namespace cmps = components;
+
+    // full vertices and 32 bit indices, what the merging and the simplifier work on
+    struct Geometry {
+      std::vector<vulkan::Vertex> vertices;
+      std::vector<uint32_t> indices;
+    };
+
+    struct Batch {
+      MaterialId material;
+      Geometry geometry;
+    };
+
+    // cell then material index, ordered so the bake comes out the same every run
+    using CellKey = std::tuple<int32_t, int32_t, int32_t, uint32_t>;
+    using Level = std::map<CellKey, Batch>;
+
+    glm::ivec3 cell_of(const CellKey& key) {
+      return {std::get<0>(key), std::get<1>(key), std::get<2>(key)};
+    }
+
+    CellKey key_of(glm::ivec3 cell, MaterialId material) {
+      return {cell.x, cell.y, cell.z, material.index};
+    }
+
+    glm::vec3 safe_normalize(const glm::vec3& v) {
+      const float length = glm::length(v);
+      return length > 0 ? v / length : v;
+    }
+
+    Geometry download(MeshId id) {
+      const auto& mesh = AssetManager::get().get_mesh(id);
+      const auto data = mesh.download();
+      const size_t vertices_size = mesh.vertices_count() * sizeof(vulkan::Vertex);
+
+      Geometry geometry;
+      geometry.vertices.resize(mesh.vertices_count());
+      std::memcpy(geometry.vertices.data(), data.data(), vertices_size);
+
+      vulkan::Indices indices;
+      vulkan::convert_indices(
+          {mesh.index_type(), std::as_bytes(std::span(data)).subspan(vertices_size)},
+          vk::IndexType::eUint32,
+          indices);
+      const auto source = indices.as<const uint32_t>();
+      geometry.indices.assign(source.begin(), source.end());
+
+      return geometry;
+    }
+
+    void append(
+        Geometry& to,
+        const Geometry& from,
+        const glm::mat4& model = glm::mat4(1),
+        const glm::mat3& normal = glm::mat3(1)) {
+      const auto base = static_cast<uint32_t>(to.vertices.size());
+      const glm::mat3 basis(model);
+      for (const auto& vertex : from.vertices)
+        to.vertices.push_back({
+            .position = model * glm::vec4(vertex.position, 1.0f),
+            .normal = safe_normalize(normal * vertex.normal),
+            .tangent = safe_normalize(basis * vertex.tangent),
+            .tex_coord = vertex.tex_coord,
+        });
+
+      // a mirroring transform turns the triangles inside out
+      const bool flip = glm::determinant(basis) < 0;
+      for (size_t i = 0; i + 2 < from.indices.size(); i += 3) {
+        to.indices.push_back(base + from.indices[i]);
+        to.indices.push_back(base + from.indices[i + (flip ? 2 : 1)]);
+        to.indices.push_back(base + from.indices[i + (flip ? 1 : 2)]);
+      }
+    }
+
+    MeshId upload(const Geometry& geometry) {
+      auto vertices = geometry.vertices;
+      vulkan::Indices indices;
+      indices.data.resize(geometry.indices.size() * sizeof(uint32_t));
+      std::memcpy(indices.data.data(), geometry.indices.data(), indices.data.size());
+      vulkan::optimize_mesh(vertices, indices);
+
+      return AssetManager::get().load_mesh(vertices, indices);
+    }
+  }    // namespace
+
+  StaticBatchStats bake_static_batches(Scene& scene, const StaticBatchSettings& settings) {
+    GEG_CORE_ASSERT(settings.cell_size > 0, "static batch cells need a size");
+    GEG_CORE_ASSERT(
+        settings.switch_distance >= 1.0f, "cells closer than that overlap their parent's range");
+
+    auto& asset_manager = AssetManager::get();
+    StaticBatchStats stats;
+
+    // one download per mesh however many entities use it
+    struct Source {
+      MeshId id;
+      Geometry geometry;
+      // merged entities that used it
+      uint32_t references = 0;
+    };
+    std::unordered_map<uint32_t, Source> sources;
+    std::vector<entt::entity> merged;
+    std::vector<Level> levels(settings.proxy_levels + 1);
+
+    scene.each<cmps::Static, cmps::Transform, cmps::Mesh, cmps::Material>(
+        [&](entt::entity entity,
+            const cmps::Transform& transform,
+            const cmps::Mesh& mesh,
+            const cmps::Material& material) {
+          if (!mesh || !material) return;
+
+          auto [source, inserted] = sources.try_emplace(mesh.id.index);
+          if (inserted) source->second = {.id = mesh.id, .geometry = download(mesh.id)};
+          source->second.references++;
+
+          // by the center of the bounds so an entity lands in exactly one cell
+          const auto model = transform.model_matrix();
+          const glm::vec3 center =
+              model * glm::vec4(asset_manager.get_mesh(mesh.id).center, 1.0f);
+          const glm::ivec3 cell = glm::floor(center / settings.cell_size);
+
+          auto& batch = levels[0][key_of(cell, material.id)];
+          batch.material = material.id;
+          append(batch.geometry, source->second.geometry, model, transform.normal_matrix());
+
+          merged.push_back(entity);
+        });
+    if (merged.empty()) return stats;
+
+    scene.get_reg().destroy(merged.begin(), merged.end());
+    stats.entities = static_cast<uint32_t>(merged.size());
+
+    // load_scene takes a reference per entity, the ones of the merged entities are dropped
+    // and a mesh no other entity draws goes with them
+    scene.each<cmps::Mesh>([&](entt::entity, const cmps::Mesh& mesh) {
+      if (mesh) sources.erase(mesh.id.index);
+    });
+    for (const auto& [index, source] : sources)
+      for (uint32_t i = 0; i < source.references; i++)
+        asset_manager.unload_mesh(source.id);
+    sources.clear();
+
+    // every proxy merges its children, welded so the simplifier can collapse across the
+    // entities that touch, then drops about three quarters of the triangles since it's
+    // drawn from twice as far
+    for (size_t level = 1; level < levels.size(); level++) {
+      const float error = settings.proxy_error * settings.cell_size * float(1u << level);
+
+      for (const auto& [key, child] : levels[level - 1]) {
+        auto& batch = levels[level][key_of(cell_of(key) >> 1, child.material)];
+        batch.material = child.material;
+        append(batch.geometry, child.geometry);
+      }
+
+      for (auto& [key, batch] : levels[level]) {
+        auto& geometry = batch.geometry;
+        geometry.indices.resize(vulkan::weld_vertices(geometry.vertices, geometry.indices));
+        geometry.indices = vulkan::simplify(
+            geometry.vertices, geometry.indices, geometry.indices.size() / 12 * 3, error);
+        geometry.vertices.resize(
+            vulkan::optimize_vertex_fetch(geometry.vertices, geometry.indices));
+      }
+    }
+
+    // a level is drawn from its own switch distance to its parent's, both measured from the
+    // center of the cell at that level
+    const auto cell_size = [&](size_t level) { return settings.cell_size * float(1u << level); };
+    const auto cell_center = [&](glm::ivec3 cell, size_t level) {
+      return (glm::vec3(cell) + 0.5f) * cell_size(level);
+    };
+
+    for (size_t level = 0; level < levels.size(); level++) {
+      for (const auto& [key, batch] : levels[level]) {
+        if (batch.geometry.indices.empty()) continue;
+
+        const auto cell = cell_of(key);
+        cmps::HlodRange range;
+        if (level > 0) {
+          range.near_center = cell_center(cell, level);
+          range.near = settings.switch_distance * cell_size(level);
+        }
+        if (level + 1 < levels.size()) {
+          range.far_center = cell_center(cell >> 1, level + 1);
+          range.far = settings.switch_distance * cell_size(level + 1);
+        }
+
+        auto entity = scene.create_entity(
+            fmt::format(
+                "{} {} {} {}", level ? "hlod proxy" : "static batch", cell.x, cell.y, cell.z));
+        entity.add_component<cmps::Mesh>(upload(batch.geometry));
+        entity.add_component<cmps::Material>(batch.material);
+        entity.add_component<cmps::HlodRange>(range);
+
+        (level ? stats.proxies : stats.batches)++;
+      }
+    }
+
+    GEG_CORE_INFO(
+        "baked {} static entities into {} batches and {} proxies",
+        stats.entities,
+        stats.batches,
+        stats.proxies);
+
+    return stats;
+  }
+}    // namespace geg
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pch.hpp"
+#include "ecs/scene.hpp"
+
+namespace geg {
+  struct StaticBatchSettings {
+    // edge of the leaf cells, a batch is culled and gets its lod picked as a whole so it
+    // shouldn't be much bigger than what a view sees of it
+    float cell_size = 16.0f;
+    // levels of proxies above the leaf cells, each one merges 2x2x2 cells of the one below
+    uint32_t proxy_levels = 2;
+    // a cell is swapped for its parent's proxy this many of the parent's cell sizes away from
+    // the parent's center, at least 1 so a cell and its parent are never drawn together
+    float switch_distance = 4.0f;
+    // how far a proxy's surface may move from the geometry it replaces, in its cell size
+    float proxy_error = 0.01f;
+  };
+
+  struct StaticBatchStats {
+    // entities merged away
+    uint32_t entities = 0;
+    uint32_t batches = 0;
+    uint32_t proxies = 0;
+  };
+
+  // hierarchical lods for immovable geometry (HLOD), entities tagged Static that share a
+  // material are merged into one mesh per grid cell with their transforms applied, then
+  // every level of proxies merges and simplifies the cells of the one below, HlodRange
+  // makes the snapshot draw the batches up close and the proxies further away
+  // the merged entities are deleted with their references to the meshes, a mesh that other
+  // entities still draw stays loaded
+  // like AssetManager::load_scene it must be called before App::run, the meshes are
+  // downloaded from the gpu
+  StaticBatchStats bake_static_batches(Scene& scene, const StaticBatchSettings& settings = {});
+}    // namespace geg
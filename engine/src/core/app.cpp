@@ -5,6 +5,7 @@
 #include "events/base-event.hpp"
 #include "events/events.hpp"
 #include "core/time.hpp"
+#include "core/job-system.hpp"
 #include "core/input.hpp"
 #include "imgui.h"
 
@@ -14,19 +15,24 @@ namespace geg {
     init();
   }
 
-  App::App(const AppInfo &info) {
+  App::App(const AppInfo &info): m_info(info) {
     m_window = std::make_shared<Window>(info, GEG_BIND_CB(event_handler));
     init();
   }
 
   App::~App() {
+    m_render_thread.reset();
     m_graphics_context->wait_until_free();
     AssetManager::get().deinit();
+    // may still wait on jobs
+    m_graphics_context.reset();
+    JobSystem::get().deinit();
     GEG_CORE_WARN("destroying app");
   }
 
   void App::init() {
     GEG_CORE_INFO("init app");
+    JobSystem::init();
     m_graphics_context = std::make_unique<VulkanContext>(m_window);
     AssetManager::init(m_graphics_context->get_rendering_device());
     m_camera_controller =
@@ -113,7 +119,9 @@ namespace geg {
   }
 
   void App::run() {
+    // everything is loaded up front, the render thread reads the assets without locking
     AssetManager::get().load_all();
+    m_render_thread = std::make_unique<RenderThread>(m_graphics_context.get());
 
     while (is_running) {
       Timer::update();
@@ -138,13 +146,54 @@ namespace geg {
       m_camera_controller.draw_debug_ui();
 
       m_window->poll_events();
-      if (!paused) {
-        m_camera_controller.update(Timer::delta(), {mouse_x, mouse_y}, is_pressed);
+      JobSystem::get().pump_main();
+      if (paused) continue;
+
+      m_camera_controller.update(Timer::delta(), {mouse_x, mouse_y}, is_pressed);
+      update_layers(Timer::delta());
+
+      // only blocks while the render thread is more than a frame behind
+      auto &frame = m_render_thread->begin_frame();
+      frame.frame = Timer::frame_count();
+      frame.camera.capture(m_camera_controller);
+      // layers and overlays end up in one scene, drawn with one submission
+      frame.scene.clear();
+      uint32_t layer_index = 0;
+      for (auto layer : m_layers)
+        frame.scene.append(layer->scene, layer_index++, frame.camera);
+      frame.scene.capture_assets();
+      m_graphics_context->capture(frame);
+      m_render_thread->submit();
+    }
+
+    m_render_thread.reset();
+  }
+
+  void App::update_layers(float dt) {
+    if (m_info.fixed_timestep <= 0.0f) {
+      for (auto layer : m_layers) {
+        layer->update(dt, &m_camera_controller);
+        layer->scene.run_systems(dt);
+      }
+    } else {
+      const double step = m_info.fixed_timestep;
+      m_accumulator += dt;
+
+      uint32_t steps = 0;
+      while (m_accumulator >= step && steps < m_info.max_fixed_steps) {
         for (auto layer : m_layers) {
-          layer->update(Timer::delta(), &m_camera_controller);
-          m_graphics_context->render(Camera{m_camera_controller}, &layer->scene);
+          layer->update(m_info.fixed_timestep, &m_camera_controller);
+          layer->scene.run_systems(m_info.fixed_timestep);
         }
+        m_accumulator -= step;
+        steps++;
       }
+
+      if (m_accumulator >= step) m_accumulator = 0;
     }
+
+    // the ui is drawn once per frame no matter how many steps ran
+    for (auto layer : m_layers)
+      layer->ui(dt);
   }
 }    // namespace geg
@@ -10,6 +10,7 @@
 #include "vulkan/graphics-context.hpp"
 #include "renderer/camera.hpp"
 #include "renderer/fps-camera.hpp"
+#include "renderer/render-thread.hpp"
 #include "logger.hpp"
 
 namespace geg {
@@ -18,6 +19,11 @@ namespace geg {
     uint32_t width = 1280;
     uint32_t height = 720;
     bool start_maximized = true;
+
+    // seconds per layer update, 0 updates once per frame with the frame delta
+    float fixed_timestep = 0.0f;
+    // caps the catch up after a stall, the remaining time is dropped
+    uint32_t max_fixed_steps = 8;
   };
 
   class App {
@@ -44,7 +50,7 @@ namespace geg {
     }
 
     void attach_layer(Layer *layer) { m_layers.pushLayer(layer); };
-    void attach_overlay(Layer *layer) { m_layers.popOverlay(layer); };
+    void attach_overlay(Layer *layer) { m_layers.pushOverlay(layer); };
     void detach(Layer *layer) {
       layer->on_detach();
       m_layers.popLayer(layer);
@@ -55,6 +61,7 @@ namespace geg {
 
   private:
     void init();
+    void update_layers(float dt);
     bool close(const WindowCloseEvent &e);
     bool pause(const KeyPressedEvent &e) {
       if (e.key_code() == input::KEY_C) paused = !paused;
@@ -66,9 +73,14 @@ namespace geg {
     bool paused = false;
     bool is_running = true;
 
+    AppInfo m_info;
+    double m_accumulator = 0;
+
     LayerStack m_layers;
     std::shared_ptr<Window> m_window;
     std::unique_ptr<VulkanContext> m_graphics_context;
+    // only alive inside run()
+    std::unique_ptr<RenderThread> m_render_thread;
 
     // to be refactored
     CameraPositioner_FirstPerson m_camera_controller;
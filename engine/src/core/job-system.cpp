@@ -0,0 +1,243 @@
+#include "job-system.hpp"
+
+#include <algorithm>
+
+#include "core/asserts.hpp"
+#include "core/logger.hpp"
+
+namespace geg {
+  namespace {
+    // index of the worker's own queue, non worker threads use the shared queue
+    thread_local int32_t t_worker_index = -1;
+  }    // namespace
+
+  JobSystem JobSystem::m_instance;
+
+  void JobCounter::decrement() {
+    m_busy++;
+    std::vector<std::pair<Job, JobCounter*>> continuations;
+    {
+      std::lock_guard lock(m_mutex);
+      if (m_value.fetch_sub(1) == 1) continuations.swap(m_continuations);
+    }
+    m_busy--;
+
+    // the counter can be destroyed by a waiter from here on
+    for (auto& [job, counter] : continuations) {
+      // already accounted for in run_after
+      JobSystem::get().push({std::move(job), counter});
+    }
+  }
+
+  void JobSystem::init(uint32_t num_of_workers) {
+    auto& self = m_instance;
+    GEG_CORE_ASSERT(!self.m_inited, "Trying to init job system more than once!");
+    self.m_inited = true;
+    self.m_main_thread = std::this_thread::get_id();
+    self.m_stopping = false;
+
+    if (num_of_workers == 0)
+      num_of_workers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    for (uint32_t i = 0; i <= num_of_workers; i++)
+      self.m_queues.push_back(std::make_unique<Queue>());
+
+    for (uint32_t i = 0; i < num_of_workers; i++)
+      self.m_workers.emplace_back([i] { m_instance.worker_loop(i); });
+
+    GEG_CORE_INFO("job system started with {} workers", num_of_workers);
+  }
+
+  void JobSystem::deinit() {
+    if (!m_inited) return;
+
+    {
+      std::lock_guard lock(m_sleep_mutex);
+      m_stopping = true;
+    }
+    m_sleep_cv.notify_all();
+
+    for (auto& worker : m_workers)
+      worker.join();
+
+    m_workers.clear();
+    m_queues.clear();
+    m_inited = false;
+  }
+
+  void JobSystem::run(Job job, JobCounter* counter) {
+    if (counter) counter->increment();
+    push({std::move(job), counter});
+  }
+
+  void JobSystem::run_background(Job job, JobCounter* counter) {
+    GEG_CORE_ASSERT(m_inited, "job system used before init");
+    if (counter) counter->increment();
+
+    {
+      std::lock_guard lock(m_background_queue.mutex);
+      m_background_queue.tasks.push_back({std::move(job), counter});
+    }
+
+    {
+      std::lock_guard lock(m_sleep_mutex);
+      m_queued.fetch_add(1);
+    }
+    m_sleep_cv.notify_one();
+  }
+
+  void JobSystem::run_after(JobCounter& dependency, Job job, JobCounter* counter) {
+    if (counter) counter->increment();
+
+    {
+      std::lock_guard lock(dependency.m_mutex);
+      if (dependency.m_value.load() != 0) {
+        dependency.m_continuations.emplace_back(std::move(job), counter);
+        return;
+      }
+    }
+
+    push({std::move(job), counter});
+  }
+
+  void JobSystem::parallel_for(
+      uint32_t count,
+      uint32_t min_batch,
+      const std::function<void(uint32_t begin, uint32_t end)>& fn) {
+    if (count == 0) return;
+
+    min_batch = std::max(min_batch, 1u);
+    const uint32_t max_batches = workers_count() + 1;
+    const uint32_t num_of_batches =
+        std::clamp((count + min_batch - 1) / min_batch, 1u, max_batches);
+    const uint32_t batch_size = (count + num_of_batches - 1) / num_of_batches;
+
+    JobCounter counter;
+    for (uint32_t batch = 1; batch < num_of_batches; batch++) {
+      const uint32_t begin = std::min(batch * batch_size, count);
+      const uint32_t end = std::min(begin + batch_size, count);
+      run([&fn, begin, end] { fn(begin, end); }, &counter);
+    }
+
+    fn(0, std::min(batch_size, count));
+    wait(counter);
+  }
+
+  void JobSystem::wait(JobCounter& counter) {
+    while (!counter.done()) {
+      if (is_main_thread()) pump_main();
+      if (!run_one()) std::this_thread::yield();
+    }
+  }
+
+  void JobSystem::run_on_main(Job job, JobCounter* counter) {
+    if (counter) counter->increment();
+
+    std::lock_guard lock(m_main_queue.mutex);
+    m_main_queue.tasks.push_back({std::move(job), counter});
+  }
+
+  void JobSystem::pump_main() {
+    GEG_CORE_ASSERT(is_main_thread(), "main thread jobs pumped from another thread");
+
+    std::deque<Task> tasks;
+    {
+      std::lock_guard lock(m_main_queue.mutex);
+      tasks.swap(m_main_queue.tasks);
+    }
+
+    for (auto& task : tasks)
+      execute(task);
+  }
+
+  void JobSystem::worker_loop(uint32_t index) {
+    t_worker_index = static_cast<int32_t>(index);
+
+    while (true) {
+      if (run_one() || run_background_one()) continue;
+
+      std::unique_lock lock(m_sleep_mutex);
+      m_sleep_cv.wait(lock, [this] { return m_stopping || m_queued.load() > 0; });
+      // drain everything before stopping so no counter is left hanging
+      if (m_stopping && m_queued.load() == 0) return;
+    }
+  }
+
+  void JobSystem::push(Task task) {
+    GEG_CORE_ASSERT(m_inited, "job system used before init");
+
+    const auto queue_index =
+        t_worker_index >= 0 ? static_cast<uint32_t>(t_worker_index) : workers_count();
+    auto& queue = *m_queues[queue_index];
+    {
+      std::lock_guard lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+
+    {
+      // taking the lock so a worker can't miss the wake up between its check and its wait
+      std::lock_guard lock(m_sleep_mutex);
+      m_queued.fetch_add(1);
+    }
+    m_sleep_cv.notify_one();
+  }
+
+  bool JobSystem::try_pop(uint32_t queue_index, Task& task) {
+    auto& queue = *m_queues[queue_index];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+
+    // newest first for the owner, it's the one most likely still in cache
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+  }
+
+  bool JobSystem::try_steal(uint32_t thief_index, Task& task) {
+    const auto queues_count = static_cast<uint32_t>(m_queues.size());
+    for (uint32_t offset = 1; offset <= queues_count; offset++) {
+      auto& queue = *m_queues[(thief_index + offset) % queues_count];
+      std::lock_guard lock(queue.mutex);
+      if (queue.tasks.empty()) continue;
+
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    }
+
+    return false;
+  }
+
+  bool JobSystem::run_one() {
+    const auto own_index =
+        t_worker_index >= 0 ? static_cast<uint32_t>(t_worker_index) : workers_count();
+
+    Task task;
+    if (!try_pop(own_index, task) && !try_steal(own_index, task)) return false;
+
+    m_queued.fetch_sub(1);
+    execute(task);
+    return true;
+  }
+
+  bool JobSystem::run_background_one() {
+    Task task;
+    {
+      std::lock_guard lock(m_background_queue.mutex);
+      if (m_background_queue.tasks.empty()) return false;
+
+      // oldest first, they are requested in the order they are needed
+      task = std::move(m_background_queue.tasks.front());
+      m_background_queue.tasks.pop_front();
+    }
+
+    m_queued.fetch_sub(1);
+    execute(task);
+    return true;
+  }
+
+  void JobSystem::execute(Task& task) {
+    task.job();
+    if (task.counter) task.counter->decrement();
+  }
+}    // namespace geg
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace geg {
+  using Job = std::function<void()>;
+
+  // tracks a group of jobs, other jobs can be chained to run once it reaches zero
+  class JobCounter {
+  public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    // also waits for the last decrement to let go of the counter so it can be destroyed
+    bool done() const { return m_value.load() == 0 && m_busy.load() == 0; }
+    uint32_t value() const { return m_value.load(); }
+
+  private:
+    void increment() { m_value.fetch_add(1, std::memory_order_relaxed); }
+    void decrement();
+
+    std::atomic<uint32_t> m_value = 0;
+    std::atomic<uint32_t> m_busy = 0;
+    std::mutex m_mutex;
+    std::vector<std::pair<Job, JobCounter*>> m_continuations;
+
+    friend class JobSystem;
+  };
+
+  // one deque per worker, owners push and pop at the back and idle workers steal
+  // from the front of the others, threads that aren't workers (main, render) push into a
+  // shared queue that everyone steals from
+  // waiting on a counter runs other jobs instead of blocking so jobs can wait on jobs
+  class JobSystem {
+  public:
+    JobSystem(JobSystem&) = delete;
+
+    // 0 workers means one less than the number of hardware threads
+    static void init(uint32_t num_of_workers = 0);
+    static JobSystem& get() { return m_instance; };
+    void deinit();
+
+    void run(Job job, JobCounter* counter = nullptr);
+    // long jobs that nobody waits on inline (pipeline compiles ...), only idle workers take
+    // them and wait never runs them so they can't land on the main or render thread
+    void run_background(Job job, JobCounter* counter = nullptr);
+    // runs once every job tracked by dependency finished
+    void run_after(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+    // splits [0, count) into batches of at least min_batch and blocks until all of them ran,
+    // the calling thread takes part in the work
+    void parallel_for(
+        uint32_t count,
+        uint32_t min_batch,
+        const std::function<void(uint32_t begin, uint32_t end)>& fn);
+    void wait(JobCounter& counter);
+
+    // jobs that have to run on the main thread (window, imgui ...)
+    void run_on_main(Job job, JobCounter* counter = nullptr);
+    // runs the queued main thread jobs, called once a frame by the app
+    void pump_main();
+
+    uint32_t workers_count() const { return static_cast<uint32_t>(m_workers.size()); }
+    bool is_main_thread() const { return std::this_thread::get_id() == m_main_thread; }
+
+  private:
+    JobSystem() = default;
+
+    struct Task {
+      Job job;
+      JobCounter* counter = nullptr;
+    };
+
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    void worker_loop(uint32_t index);
+    void push(Task task);
+    bool try_pop(uint32_t queue_index, Task& task);
+    bool try_steal(uint32_t thief_index, Task& task);
+    bool run_one();
+    bool run_background_one();
+    static void execute(Task& task);
+
+    static JobSystem m_instance;
+    friend class JobCounter;
+
+    bool m_inited = false;
+    std::thread::id m_main_thread;
+    std::vector<std::thread> m_workers;
+    // one per worker plus the shared one at the end
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    Queue m_main_queue;
+    Queue m_background_queue;
+
+    std::atomic<uint32_t> m_queued = 0;
+    std::atomic<bool> m_stopping = false;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_sleep_cv;
+  };
+}    // namespace geg
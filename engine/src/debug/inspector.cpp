@@ -156,7 +156,9 @@ namespace geg {
         if (ImGui::BeginPopup("New Component")) {
           if (ImGui::MenuItem("Light")) selected_entity.add_component<cmps::Light>();
           if (ImGui::MenuItem("Mesh")) selected_entity.add_component<cmps::Mesh>();
-          if (ImGui::MenuItem("Pbr")) selected_entity.add_component<cmps::PBR>();
+          if (ImGui::MenuItem("Material"))
+            selected_entity.add_component<cmps::Material>(
+                AssetManager::get().create_material({}));
           ImGui::EndPopup();
         }
       }
@@ -188,21 +190,26 @@ namespace geg {
       if (entity.has_component<cmps::Mesh>()) {
         const MeshId mesh_id = entity.get_component<cmps::Mesh>().id;
         const std::string mesh_name =
-            fmt::format("{} - id({})", asset_manager.get_mesh_name(mesh_id), mesh_id);
+            fmt::format("{} - id({})", asset_manager.get_mesh_name(mesh_id), mesh_id.index);
         ui::draw_text("Mesh", mesh_name.c_str(), {0.2f, 0.7f, 0.2f, 1.0f});
         ImGui::Separator();
       }
 
-      if (entity.has_component<cmps::PBR>()) {
-        auto& pbr = entity.get_component<cmps::PBR>();
-        const std::string albedo_name =
-            fmt::format("{} - id({})", asset_manager.get_texture_name(pbr.albedo), pbr.albedo);
-        const std::string metallic_roughness_name =
-            fmt::format("{} - id({})", asset_manager.get_texture_name(pbr.metallic_roughness), pbr.metallic_roughness);
-        const std::string normal_name = fmt::format(
-            "{} - id({})", asset_manager.get_texture_name(pbr.normal_map), pbr.normal_map);
-        const std::string emission_name = fmt::format(
-            "{} - id({})", asset_manager.get_texture_name(pbr.emissive_map), pbr.emissive_map);
+      if (entity.has_component<cmps::Material>() && entity.get_component<cmps::Material>()) {
+        auto& material_id = entity.get_component<cmps::Material>().id;
+        // edits show up on every entity using the handle, a material shared by other loads
+        // is copied on the first edit
+        auto pbr = asset_manager.get_material(material_id);
+        const auto texture_label = [&](TextureId id) {
+          return fmt::format("{} - id({})", asset_manager.get_texture_name(id), id.index);
+        };
+
+        const std::string material_name = fmt::format("id({})", material_id.index);
+        ui::draw_text("Material", material_name.c_str(), {0.2f, 0.7f, 0.2f, 1.0f});
+        const std::string albedo_name = texture_label(pbr.albedo);
+        const std::string metallic_roughness_name = texture_label(pbr.metallic_roughness);
+        const std::string normal_name = texture_label(pbr.normal_map);
+        const std::string emission_name = texture_label(pbr.emissive_map);
 
 
         ui::draw_text("Albedo", albedo_name.c_str(), {0.2f, 0.7f, 0.2f, 1.0f});
@@ -216,6 +223,8 @@ namespace geg {
         ui::draw_smth("Roughness Factor", [&pbr] { ImGui::SliderFloat("##rf", &pbr.roughness_factor, 0.0f, 1.0f); });
         ui::draw_smth("Metallic Factor", [&pbr] { ImGui::SliderFloat("##mf", &pbr.metallic_factor, 0.0f, 1.0f); });
         ui::draw_smth("Fresnel Reflect", [&pbr] { ImGui::SliderFloat("##AO", &pbr.AO, 0.0f, 1.0f); });
+        if (pbr != asset_manager.get_material(material_id))
+          material_id = asset_manager.update_material(material_id, pbr);
         ImGui::Separator();
       }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <limits>
+
 #include "assets/asset-manager.hpp"
 #include "glm/fwd.hpp"
 #include "pch.hpp"
@@ -48,25 +50,39 @@ namespace geg::components {
     Mesh() = default;
     Mesh(MeshId id): id(id) {}
 
-    operator bool() const { return id > -1; }
+    operator bool() const { return bool(id); }
 
-    MeshId id = -1;
+    MeshId id;
   };
 
-  struct PBR {
-    PBR() = default;
+  // the textures and factors live in the asset manager, shared between entities
+  struct Material {
+    Material() = default;
+    Material(MaterialId id): id(id) {}
 
-    TextureId albedo = -1;
-    TextureId metallic_roughness = -1;
-    TextureId normal_map = -1;
-    TextureId emissive_map = -1;
+    operator bool() const { return bool(id); }
 
-    glm::vec3 color_factor{1};
-    glm::vec3 emissive_factor{0};
-    float metallic_factor = 0;
-    float roughness_factor = 0;
+    MaterialId id;
+  };
 
-    float AO = 0.0f;
+  // geometry that never moves once loaded, bake_static_batches merges it, saved with scene
+  // files so cooked scenes can be baked after they're loaded
+  struct Static {};
+
+  // drawn only while the camera is at least near from near_center and closer than far to
+  // far_center, the ranges of one hierarchy level end where the next one's start so exactly
+  // one level is drawn (assets/static-batching.hpp)
+  struct HlodRange {
+    glm::vec3 near_center{0};
+    float near = 0;
+    glm::vec3 far_center{0};
+    float far = std::numeric_limits<float>::infinity();
+
+    bool contains(const glm::vec3& position) const {
+      const glm::vec3 to_near = position - near_center;
+      const glm::vec3 to_far = position - far_center;
+      return glm::dot(to_near, to_near) >= near * near && glm::dot(to_far, to_far) < far * far;
+    }
   };
 
   struct Light {
@@ -74,11 +90,9 @@ namespace geg::components {
     glm::vec4 light_color{1.0f};
   };
 
+  // the prefiltered maps are produced and owned by the renderer
   struct EnvMap {
-    TextureId env_map = -1;
-    TextureId env_map_diffuse = -1;
-    TextureId env_map_specular = -1;
-    TextureId brdf_integration = -1;
+    TextureId env_map;
   };
 
   struct SkyLight {
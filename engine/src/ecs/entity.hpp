@@ -45,4 +45,12 @@ namespace geg {
 
     friend class Scene;
   };
+
+  template<typename Fn>
+  void Scene::for_each(Fn&& fn) {
+    registry.each([this, &fn](entt::entity e) {
+      Entity entity(this, e);
+      fn(entity);
+    });
+  }
 }    // namespace geg
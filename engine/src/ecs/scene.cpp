@@ -12,13 +12,6 @@ namespace geg {
     return entity;
   }
 
-  void Scene::for_each(std::function<void(Entity&)> cb) {
-    registry.each([this, cb](entt::entity e) {
-      Entity entity(this, e);
-      cb(entity);
-    });
-  };
-
   Entity Scene::create_entity() {
     Entity entity(this);
     entity.add_component<components::Name>("untitled :(");
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "entt/entt.hpp"
+#include "core/job-system.hpp"
+#include "ecs/system-scheduler.hpp"
 
 namespace geg {
   class Entity;
@@ -16,9 +18,65 @@ namespace geg {
 
     entt::registry& get_reg() { return registry; }
 
-    void for_each(std::function<void(Entity&)> cb);
+    // R and W are Reads<...> and Writes<...>, see SystemScheduler
+    template<typename R = Reads<>, typename W = Writes<>>
+    void add_system(const std::string& name, SystemScheduler::SystemFn fn) {
+      m_systems.add<R, W>(name, std::move(fn));
+    }
+    void add_exclusive_system(const std::string& name, SystemScheduler::SystemFn fn) {
+      m_systems.add_exclusive(name, std::move(fn));
+    }
+    void remove_system(const std::string& name) { m_systems.remove(name); }
+    // called by the app after the layer's update, once per (fixed) step
+    void run_systems(float dt) { m_systems.run(*this, dt); }
+    const SystemScheduler& systems() const { return m_systems; }
+
+    // every entity, wrapped for the editor, systems should use each/par_each instead
+    template<typename Fn>
+    void for_each(Fn&& fn);
+
+    // only walks the pools of the requested components
+    template<typename... Components>
+    auto view() {
+      return registry.view<Components...>();
+    }
+
+    // fn(entt::entity, Components&...), inlined, no allocations
+    template<typename... Components, typename Fn>
+    void each(Fn&& fn) {
+      registry.view<Components...>().each(std::forward<Fn>(fn));
+    }
+
+    // same as each but chunked over the workers, blocks until every entity was visited
+    // the chunks come from the first component's pool so put the rarest one first
+    // fn runs concurrently on different entities and must not add or remove components
+    template<typename... Components, typename Fn>
+    void par_each(Fn&& fn, uint32_t min_batch = 256);
 
   private:
     entt::registry registry;
+    SystemScheduler m_systems;
   };
+
+  template<typename... Components, typename Fn>
+  void Scene::par_each(Fn&& fn, uint32_t min_batch) {
+    static_assert(sizeof...(Components) > 0, "par_each needs at least one component");
+    using Leading = std::tuple_element_t<0, std::tuple<Components...>>;
+
+    // the pools are created here on the calling thread, the workers only read them
+    const auto view = registry.view<Components...>();
+    const auto leading = registry.view<Leading>();
+    const auto* entities = leading.data();
+    const auto count = static_cast<uint32_t>(leading.size());
+
+    JobSystem::get().parallel_for(count, min_batch, [&](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; i++) {
+        const auto entity = entities[i];
+        if constexpr (sizeof...(Components) > 1)
+          if (!view.contains(entity)) continue;
+
+        fn(entity, view.template get<Components>(entity)...);
+      }
+    });
+  }
 }    // namespace geg
@@ -0,0 +1,86 @@
+#include "system-scheduler.hpp"
+
+#include <algorithm>
+
+#include "core/job-system.hpp"
+#include "ecs/scene.hpp"
+
+namespace geg {
+  namespace {
+    bool intersects(const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b) {
+      for (const auto id : a)
+        if (std::find(b.begin(), b.end(), id) != b.end()) return true;
+
+      return false;
+    }
+  }    // namespace
+
+  void SystemScheduler::remove(const std::string& name) {
+    std::erase_if(m_systems, [&](const System& system) { return system.name == name; });
+    m_dirty = true;
+  }
+
+  bool SystemScheduler::conflicts(const System& a, const System& b) {
+    if (a.exclusive || b.exclusive) return true;
+
+    return intersects(a.writes, b.reads) || intersects(a.writes, b.writes) ||
+           intersects(b.writes, a.reads);
+  }
+
+  void SystemScheduler::build() {
+    for (auto& system : m_systems) {
+      system.dependents.clear();
+      system.dependencies = 0;
+    }
+
+    // every conflicting pair is ordered by registration, the edges that are implied by
+    // others are kept, they only cost a decrement
+    for (uint32_t i = 0; i < m_systems.size(); i++) {
+      for (uint32_t j = i + 1; j < m_systems.size(); j++) {
+        if (!conflicts(m_systems[i], m_systems[j])) continue;
+
+        m_systems[i].dependents.push_back(j);
+        m_systems[j].dependencies++;
+      }
+    }
+
+    m_roots_count = static_cast<uint32_t>(std::count_if(
+        m_systems.begin(), m_systems.end(), [](const System& s) { return s.dependencies == 0; }));
+    m_dirty = false;
+  }
+
+  void SystemScheduler::run(Scene& scene, float dt) {
+    if (m_systems.empty()) return;
+    if (m_dirty) build();
+
+    auto& reg = scene.get_reg();
+    for (const auto& system : m_systems)
+      for (const auto assure : system.assure)
+        assure(reg);
+
+    std::vector<std::atomic<uint32_t>> pending(m_systems.size());
+    for (uint32_t i = 0; i < m_systems.size(); i++)
+      pending[i].store(m_systems[i].dependencies, std::memory_order_relaxed);
+
+    auto& jobs = JobSystem::get();
+    JobCounter done;
+
+    // a system queues its dependents once it is the last one they waited on, they are
+    // queued before its own job retires so the counter can't hit zero early
+    std::function<void(uint32_t)> launch = [&](uint32_t index) {
+      jobs.run(
+          [&, index] {
+            m_systems[index].fn(scene, dt);
+            for (const auto dependent : m_systems[index].dependents)
+              if (pending[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                launch(dependent);
+          },
+          &done);
+    };
+
+    for (uint32_t i = 0; i < m_systems.size(); i++)
+      if (m_systems[i].dependencies == 0) launch(i);
+
+    jobs.wait(done);
+  }
+}    // namespace geg
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "pch.hpp"
+#include "entt/entt.hpp"
+
+namespace geg {
+  class Scene;
+
+  // component access lists for Scene::add_system
+  template<typename... Components>
+  struct Reads {};
+  template<typename... Components>
+  struct Writes {};
+
+  // systems run in registration order unless they touch disjoint components, those run
+  // concurrently on the job system
+  // two systems conflict when one writes a component the other reads or writes, the later
+  // registered one then waits for the earlier one
+  class SystemScheduler {
+  public:
+    using SystemFn = std::function<void(Scene& scene, float dt)>;
+
+    SystemScheduler() = default;
+    SystemScheduler(const SystemScheduler&) = delete;
+    SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+    template<typename R = Reads<>, typename W = Writes<>>
+    void add(const std::string& name, SystemFn fn) {
+      System system{.name = name, .fn = std::move(fn)};
+      declare(system, R{}, W{});
+      m_systems.push_back(std::move(system));
+      m_dirty = true;
+    }
+
+    // for systems that create or destroy entities or components, runs alone
+    void add_exclusive(const std::string& name, SystemFn fn) {
+      m_systems.push_back({.name = name, .fn = std::move(fn), .exclusive = true});
+      m_dirty = true;
+    }
+
+    void remove(const std::string& name);
+
+    // blocks until every system ran
+    void run(Scene& scene, float dt);
+
+    size_t systems_count() const { return m_systems.size(); }
+    // systems that run before any other, the width of the first wave
+    uint32_t roots_count() const { return m_roots_count; }
+
+  private:
+    struct System {
+      std::string name;
+      SystemFn fn;
+      bool exclusive = false;
+      std::vector<entt::id_type> reads;
+      std::vector<entt::id_type> writes;
+      // creates the pools before the systems run so views never create them concurrently
+      std::vector<void (*)(entt::registry&)> assure;
+
+      // filled by build()
+      std::vector<uint32_t> dependents;
+      uint32_t dependencies = 0;
+    };
+
+    template<typename... R, typename... W>
+    static void declare(System& system, Reads<R...>, Writes<W...>) {
+      (system.reads.push_back(entt::type_hash<R>::value()), ...);
+      (system.writes.push_back(entt::type_hash<W>::value()), ...);
+      (system.assure.push_back([](entt::registry& reg) { reg.storage<R>(); }), ...);
+      (system.assure.push_back([](entt::registry& reg) { reg.storage<W>(); }), ...);
+    }
+
+    static bool conflicts(const System& a, const System& b);
+    void build();
+
+    std::vector<System> m_systems;
+    bool m_dirty = false;
+    uint32_t m_roots_count = 0;
+  };
+}    // namespace geg
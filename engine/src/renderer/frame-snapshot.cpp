@@ -0,0 +1,94 @@
+#include "frame-snapshot.hpp"
+
+#include <atomic>
+
+#include "imgui.h"
+
+namespace geg {
+  void SceneSnapshot::clear() {
+    meshes.clear();
+    lights.clear();
+    materials.clear();
+    sky_light.reset();
+    env_map.reset();
+  }
+
+  void SceneSnapshot::append(Scene& scene, uint32_t layer, const CameraSnapshot& camera) {
+    namespace cmps = components;
+
+    // the matrices are the expensive part so the copy is spread over the workers, the
+    // draws land in whatever order the chunks finish, both passes read the same order
+    const auto first = meshes.size();
+    meshes.resize(first + scene.view<cmps::Material>().size());
+    std::atomic<size_t> cursor = first;
+    // the pool is created here, the workers only look entities up in it
+    const auto hlods = scene.view<cmps::HlodRange>();
+    scene.par_each<cmps::Material, cmps::Transform, cmps::Mesh>(
+        [&](entt::entity obj,
+            const cmps::Material& material,
+            const cmps::Transform& transform,
+            const cmps::Mesh& mesh) {
+          if (!mesh || !material) {
+            GEG_CORE_WARN("no mesh or material data in some mesh");
+            return;
+          }
+          if (hlods.contains(obj) && !hlods.get<cmps::HlodRange>(obj).contains(camera.position))
+            return;
+
+          meshes[cursor++] = {
+              .model = transform.model_matrix(),
+              .normal = transform.normal_matrix(),
+              .mesh = mesh.id,
+              .material = material.id,
+              .object = (uint64_t(layer) << 32) | static_cast<uint32_t>(obj),
+          };
+        },
+        64);
+    meshes.resize(cursor);
+
+    scene.each<cmps::Light, cmps::Transform>(
+        [&](entt::entity, const cmps::Light& light, const cmps::Transform& transform) {
+          lights.push_back({
+              .position = transform.translation,
+              .color = light.light_color,
+          });
+        });
+
+    const auto sky_lights = scene.view<cmps::SkyLight>();
+    if (!sky_light && !sky_lights.empty())
+      sky_light = sky_lights.get<cmps::SkyLight>(sky_lights.front());
+
+    const auto env_maps = scene.view<cmps::EnvMap>();
+    if (!env_map && !env_maps.empty()) env_map = env_maps.get<cmps::EnvMap>(env_maps.front());
+  }
+
+  void SceneSnapshot::capture_assets() {
+    AssetManager::get().copy_materials(materials);
+  }
+
+  UiSnapshot::UiSnapshot(): m_draw_data(std::make_unique<ImDrawData>()) {}
+
+  UiSnapshot::~UiSnapshot() {
+    clear();
+  }
+
+  void UiSnapshot::capture(const ImDrawData* draw_data) {
+    clear();
+    if (!draw_data || !draw_data->Valid) return;
+
+    // copies the header and the list pointers, the lists are swapped for clones below
+    *m_draw_data = *draw_data;
+    for (auto& list : m_draw_data->CmdLists)
+      list = list->CloneOutput();
+  }
+
+  void UiSnapshot::clear() {
+    for (auto* list : m_draw_data->CmdLists)
+      IM_DELETE(list);
+    m_draw_data->Clear();
+  }
+
+  ImDrawData* UiSnapshot::draw_data() const {
+    return m_draw_data->Valid ? m_draw_data.get() : nullptr;
+  }
+}    // namespace geg
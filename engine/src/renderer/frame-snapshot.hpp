@@ -0,0 +1,91 @@
+#pragma once
+
+#include "pch.hpp"
+#include "glm/glm.hpp"
+#include "ecs/components.hpp"
+#include "ecs/scene.hpp"
+#include "renderer/camera.hpp"
+#include "vulkan/geg-vulkan.hpp"
+
+struct ImDrawData;
+
+namespace geg {
+  // everything the renderer reads from the simulation, copied out once per frame
+  // so the render thread never touches the registry or the camera controller
+  struct CameraSnapshot {
+    glm::mat4 view{1};
+    glm::vec3 position{0};
+
+    void capture(const CameraPositionerInterface& camera) {
+      view = camera.view_matrix();
+      position = camera.position();
+    }
+  };
+
+  struct SceneSnapshot {
+    struct MeshDraw {
+      glm::mat4 model{1};
+      glm::mat4 normal{1};
+      MeshId mesh;
+      MaterialId material;
+      // identifies the entity across frames, the layer index is in the high bits since
+      // entity ids are only unique within one scene
+      uint64_t object = 0;
+    };
+
+    struct PointLight {
+      glm::vec3 position{0};
+      glm::vec4 color{1};
+    };
+
+    std::vector<MeshDraw> meshes;
+    std::vector<PointLight> lights;
+    // the asset manager's table, indexed by MeshDraw::material's index
+    std::vector<Material> materials;
+    std::optional<components::SkyLight> sky_light;
+    std::optional<components::EnvMap> env_map;
+
+    // the vectors keep their capacity so a reused snapshot doesn't allocate
+    void clear();
+    // appends the scene of one layer, the first sky light and env map found are kept
+    // entities whose HlodRange doesn't contain the camera are left out
+    void append(Scene& scene, uint32_t layer, const CameraSnapshot& camera);
+    // copies the shared asset tables, once per frame after the layers
+    void capture_assets();
+  };
+
+  // a deep copy of the imgui draw lists, the context itself stays on the main thread
+  class UiSnapshot {
+  public:
+    UiSnapshot();
+    ~UiSnapshot();
+    UiSnapshot(const UiSnapshot&) = delete;
+    UiSnapshot& operator=(const UiSnapshot&) = delete;
+
+    // to be called right after ImGui::Render()
+    void capture(const ImDrawData* draw_data);
+    void clear();
+    ImDrawData* draw_data() const;
+
+  private:
+    std::unique_ptr<ImDrawData> m_draw_data;
+  };
+
+  struct RenderSettings {
+    bool imgui_renderer = true;
+    bool mesh_renderer = true;
+    vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+    float fov = 45.0f;
+  };
+
+  struct FrameSnapshot {
+    uint64_t frame = 0;
+    // window size at capture time, zero while minimized
+    vk::Extent2D extent;
+    RenderSettings settings;
+    CameraSnapshot camera;
+    // every layer and overlay merged, drawn with a single submission
+    SceneSnapshot scene;
+    UiSnapshot ui;
+  };
+}    // namespace geg
@@ -0,0 +1,75 @@
+#include "render-thread.hpp"
+
+#include <algorithm>
+
+#include "vulkan/graphics-context.hpp"
+
+namespace geg {
+  RenderThread::RenderThread(VulkanContext* context): m_context(context) {
+    GEG_CORE_ASSERT(m_context, "render thread without a context");
+    m_thread = std::thread([this] { loop(); });
+    GEG_CORE_INFO("render thread started");
+  }
+
+  RenderThread::~RenderThread() {
+    {
+      std::lock_guard lock(m_mutex);
+      m_running = false;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    GEG_CORE_WARN("render thread stopped");
+  }
+
+  FrameSnapshot& RenderThread::begin_frame() {
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [&] { return m_states[m_write_slot] == SlotState::Free; });
+
+    return m_snapshots[m_write_slot];
+  }
+
+  void RenderThread::submit() {
+    {
+      std::lock_guard lock(m_mutex);
+      GEG_CORE_ASSERT(
+          m_states[m_write_slot] == SlotState::Free, "submitting a snapshot that is in use");
+      m_states[m_write_slot] = SlotState::Ready;
+      m_write_slot = (m_write_slot + 1) % m_snapshots.size();
+    }
+    m_cv.notify_all();
+  }
+
+  void RenderThread::wait_idle() {
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [&] {
+      return std::all_of(m_states.begin(), m_states.end(), [](SlotState state) {
+        return state == SlotState::Free;
+      });
+    });
+  }
+
+  void RenderThread::loop() {
+    // with two slots at most one is ready at a time and it is always the older one
+    uint32_t read_slot = 0;
+
+    while (true) {
+      {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [&] { return !m_running || m_states[read_slot] == SlotState::Ready; });
+        // whatever is still queued is dropped on shutdown
+        if (!m_running) return;
+        m_states[read_slot] = SlotState::Rendering;
+      }
+
+      m_context->render(m_snapshots[read_slot]);
+      m_frames_rendered++;
+
+      {
+        std::lock_guard lock(m_mutex);
+        m_states[read_slot] = SlotState::Free;
+      }
+      m_cv.notify_all();
+      read_slot = (read_slot + 1) % m_snapshots.size();
+    }
+  }
+}    // namespace geg
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "pch.hpp"
+#include "renderer/frame-snapshot.hpp"
+
+namespace geg {
+  class VulkanContext;
+
+  // renders frame n while the main thread simulates frame n + 1, the two only meet
+  // on the snapshot hand off
+  class RenderThread {
+  public:
+    explicit RenderThread(VulkanContext* context);
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // main thread, blocks until the render thread is done with the slot
+    FrameSnapshot& begin_frame();
+    // main thread, hands the snapshot from begin_frame over to the render thread
+    void submit();
+    // blocks until every submitted snapshot is rendered
+    void wait_idle();
+
+    uint64_t frames_rendered() const { return m_frames_rendered; }
+
+  private:
+    void loop();
+
+    enum class SlotState {
+      Free,
+      Ready,
+      Rendering,
+    };
+
+    VulkanContext* m_context;
+
+    std::array<FrameSnapshot, 2> m_snapshots;
+    std::array<SlotState, 2> m_states{SlotState::Free, SlotState::Free};
+    uint32_t m_write_slot = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_running = true;
+    std::atomic<uint64_t> m_frames_rendered = 0;
+
+    std::thread m_thread;
+  };
+}    // namespace geg
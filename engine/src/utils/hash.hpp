@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace geg {
+  inline void hash_combine(size_t& seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2);
+  }
+
+  // MurmurHash64A, stable across runs and platforms so it can be written to disk
+  // (content ids of assets), not meant to be cryptographic
+  inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0) {
+    constexpr uint64_t m = 0xc6a4a7935bd1e995ull;
+    constexpr int r = 47;
+
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t h = seed ^ (size * m);
+
+    const size_t blocks = size / 8;
+    for (size_t i = 0; i < blocks; i++) {
+      uint64_t k;
+      std::memcpy(&k, bytes + i * 8, 8);
+
+      k *= m;
+      k ^= k >> r;
+      k *= m;
+
+      h ^= k;
+      h *= m;
+    }
+
+    const uint8_t* tail = bytes + blocks * 8;
+    switch (size & 7) {
+      case 7: h ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+      case 6: h ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+      case 5: h ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+      case 4: h ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+      case 3: h ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+      case 2: h ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+      case 1:
+        h ^= uint64_t(tail[0]);
+        h *= m;
+    };
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+  }
+
+  inline uint64_t hash_string(std::string_view str, uint64_t seed = 0) {
+    return hash_bytes(str.data(), str.size(), seed);
+  }
+}    // namespace geg
@@ -0,0 +1,63 @@
+#include "mapped-file.hpp"
+
+#include <fstream>
+#include "pch.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define GEG_HAS_MMAP 1
+#endif
+
+namespace geg {
+  bool MappedFile::open(const fs::path& path) {
+    close();
+
+#ifdef GEG_HAS_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    m_data = static_cast<const uint8_t*>(mapping);
+    m_size = static_cast<size_t>(info.st_size);
+#else
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (!file.is_open()) return false;
+
+    m_fallback.resize(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(m_fallback.data()), m_fallback.size());
+    if (m_fallback.empty()) return false;
+
+    m_data = m_fallback.data();
+    m_size = m_fallback.size();
+#endif
+
+    return true;
+  }
+
+  void MappedFile::close() {
+    if (!m_data) return;
+
+#ifdef GEG_HAS_MMAP
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+#else
+    m_fallback.clear();
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+  }
+}    // namespace geg
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "utils/filesystem.hpp"
+
+namespace geg {
+  // read only view of a whole file, mmapped where the platform allows it
+  class MappedFile {
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const fs::path& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const fs::path& path);
+    void close();
+
+    bool is_open() const { return m_data != nullptr; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    std::span<const uint8_t> bytes() const { return {m_data, m_size}; }
+
+  private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    // only used where mmap isn't available
+    std::vector<uint8_t> m_fallback;
+  };
+}    // namespace geg
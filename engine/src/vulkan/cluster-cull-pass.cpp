@@ -0,0 +1,454 @@
+#include "cluster-cull-pass.hpp"
+
+#include <bit>
+
+#include "assets/asset-manager.hpp"
+#include "imgui.h"
+#include "vk_mem_alloc.h"
+
+namespace geg::vulkan {
+  namespace {
+    constexpr uint32_t k_cull_group_size = 64;
+    constexpr uint32_t k_pyramid_group_size = 8;
+
+    constexpr uint32_t k_cull_frustum = 1;
+    constexpr uint32_t k_cull_backface = 2;
+    constexpr uint32_t k_cull_occlusion = 4;
+
+    // orders the compute work recorded so far before dst_stages
+    void compute_barrier(
+        const vk::CommandBuffer& cmd,
+        vk::AccessFlags2 src_access,
+        vk::PipelineStageFlags2 dst_stages,
+        vk::AccessFlags2 dst_access) {
+      const vk::MemoryBarrier2 barrier{
+          .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+          .srcAccessMask = src_access,
+          .dstStageMask = dst_stages,
+          .dstAccessMask = dst_access,
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+          .memoryBarrierCount = 1,
+          .pMemoryBarriers = &barrier,
+      });
+    }
+  }    // namespace
+
+  ClusterCullPass::ClusterCullPass(const std::shared_ptr<Device>& device, uint32_t frames_count):
+      m_device(device), m_frames_count(frames_count) {
+    init_pipelines();
+
+    const vk::SamplerCreateInfo sampler_info{
+        .magFilter = vk::Filter::eNearest,
+        .minFilter = vk::Filter::eNearest,
+        .mipmapMode = vk::SamplerMipmapMode::eNearest,
+        .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = false,
+        .maxAnisotropy = 0,
+        .compareEnable = false,
+        .compareOp = vk::CompareOp::eAlways,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+        .borderColor = vk::BorderColor::eFloatOpaqueWhite,
+        .unnormalizedCoordinates = false,
+    };
+    m_sampler = m_device->vkdevice.createSampler(sampler_info);
+
+    // a placeholder so the culling set is complete before the first depth comes in
+    create_pyramid({1, 1});
+    reserve_commands(k_cull_group_size);
+  }
+
+  ClusterCullPass::~ClusterCullPass() {
+    m_device->vkdevice.destroyPipeline(m_cull_pipeline);
+    m_device->vkdevice.destroyPipeline(m_pyramid_pipeline);
+    destroy_pyramid();
+    m_device->destroy_sampler(m_sampler);
+    m_device->free_descriptor_set(m_cull_set);
+    m_device->destroy_buffer(m_commands, m_commands_alloc);
+  }
+
+  void ClusterCullPass::render_debug_gui() {
+    {
+      std::lock_guard lock(m_settings_mutex);
+      ImGui::Checkbox("cluster culling", &m_settings.enabled);
+      ImGui::Checkbox("frustum", &m_settings.frustum);
+      ImGui::Checkbox("backface cones", &m_settings.backface);
+      ImGui::Checkbox("occlusion", &m_settings.occlusion);
+    }
+    if (!m_device->multi_draw_indirect) ImGui::Text("multi draw indirect isn't supported");
+    ImGui::Text("meshlets tested: %u", m_meshlets_count.load());
+    ImGui::Text("meshes drawn whole: %u", m_whole_meshes_count.load());
+  }
+
+  void ClusterCullPass::fill_commands(
+      const vk::CommandBuffer& cmd,
+      uint32_t frame,
+      const CameraSnapshot& camera,
+      const SceneSnapshot& scene,
+      const LodSelector& lods) {
+    const glm::mat4 proj_view = projection * camera.view;
+    m_frame_proj_view = proj_view;
+    m_ranges.assign(scene.meshes.size(), {});
+
+    Settings settings;
+    {
+      std::lock_guard lock(m_settings_mutex);
+      settings = m_settings;
+    }
+
+    // every mesh is drawn whole
+    if (!settings.enabled || !m_device->multi_draw_indirect) {
+      m_meshlets_count = 0;
+      m_whole_meshes_count = static_cast<uint32_t>(scene.meshes.size());
+      return;
+    }
+
+    auto& residency = AssetManager::get().residency();
+
+    m_jobs.clear();
+    uint32_t commands_count = 0;
+    for (size_t i = 0; i < scene.meshes.size(); i++) {
+      const auto& mesh = scene.meshes[i];
+      const auto* mesh_data = residency.use(mesh.mesh);
+      if (!mesh_data || mesh_data->meshlets_count() == 0 || lods.lod(i) != 0) continue;
+
+      m_jobs.push_back({
+          .push =
+              {
+                  .model = mesh.model,
+                  .first_command = commands_count,
+                  .meshlets_count = mesh_data->meshlets_count(),
+              },
+          .meshlets = mesh_data->meshlet_descriptor_set,
+      });
+      m_ranges[i] = {
+          .offset = commands_count * sizeof(vk::DrawIndexedIndirectCommand),
+          .count = mesh_data->meshlets_count(),
+      };
+      commands_count += mesh_data->meshlets_count();
+    }
+
+    m_meshlets_count = commands_count;
+    m_whole_meshes_count = static_cast<uint32_t>(scene.meshes.size() - m_jobs.size());
+    if (m_jobs.empty()) return;
+
+    reserve_commands(commands_count);
+
+    // gribb and hartmann, the rows of the matrix give the planes in world space
+    const glm::mat4 rows = glm::transpose(proj_view);
+    const std::array<glm::vec4, 6> planes = {
+        rows[3] + rows[0],
+        rows[3] - rows[0],
+        rows[3] + rows[1],
+        rows[3] - rows[1],
+        // glm's projection puts the near plane at -1
+        rows[3] + rows[2],
+        rows[3] - rows[2],
+    };
+    for (size_t i = 0; i < planes.size(); i++)
+      cull_data.planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+
+    cull_data.proj_view = proj_view;
+    cull_data.camera_position = camera.position;
+    cull_data.flags = 0;
+    if (settings.frustum) cull_data.flags |= k_cull_frustum;
+    if (settings.backface) cull_data.flags |= k_cull_backface;
+    if (settings.occlusion && m_pyramid_valid) cull_data.flags |= k_cull_occlusion;
+    cull_data.pyramid_size = {m_pyramid.extent.width, m_pyramid.extent.height};
+    cull_data.pyramid_levels = static_cast<float>(m_pyramid.levels);
+    m_cull_ubo.write_at_frame(&cull_data, sizeof(cull_data), frame);
+
+    // the draws of the previous frame are done reading the commands
+    const vk::MemoryBarrier2 before{
+        .srcStageMask = vk::PipelineStageFlagBits2::eDrawIndirect,
+        .srcAccessMask = vk::AccessFlagBits2::eIndirectCommandRead,
+        .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+        .dstAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &before,
+    });
+
+    const auto layout = m_cull_shader.pipeline_layout();
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_cull_pipeline);
+    cmd.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute,
+        layout,
+        0,
+        {m_cull_set},
+        {m_cull_ubo.frame_offset(frame)});
+
+    for (const auto& job : m_jobs) {
+      cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 1, {job.meshlets}, {});
+      cmd.pushConstants(
+          layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(job.push), &job.push);
+      cmd.dispatch((job.push.meshlets_count + k_cull_group_size - 1) / k_cull_group_size, 1, 1);
+    }
+
+    compute_barrier(
+        cmd,
+        vk::AccessFlagBits2::eShaderStorageWrite,
+        vk::PipelineStageFlagBits2::eDrawIndirect,
+        vk::AccessFlagBits2::eIndirectCommandRead);
+  }
+
+  void ClusterCullPass::build_depth_pyramid(const vk::CommandBuffer& cmd, const Image& depth) {
+    {
+      std::lock_guard lock(m_settings_mutex);
+      if (!m_settings.enabled || !m_settings.occlusion || !m_device->multi_draw_indirect) {
+        m_pyramid_valid = false;
+        return;
+      }
+    }
+
+    const vk::Extent2D extent = {
+        std::bit_floor(std::max(depth.extent.width, 1u)),
+        std::bit_floor(std::max(depth.extent.height, 1u)),
+    };
+    if (extent != m_pyramid.extent) {
+      destroy_pyramid();
+      create_pyramid(extent);
+      m_pyramid_valid = false;
+    }
+
+    // the depth is a transient of the render graph and changes with the window
+    if (depth.view != m_pyramid.depth_view) {
+      m_device->free_descriptor_set(m_pyramid.sets[0]);
+
+      vk::DescriptorImageInfo src_info{
+          .sampler = m_sampler,
+          .imageView = depth.view,
+          .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+      };
+      vk::DescriptorImageInfo dst_info{
+          .imageView = m_pyramid.level_views[0],
+          .imageLayout = vk::ImageLayout::eGeneral,
+      };
+      const auto stages = m_pyramid_shader.stage_flags;
+      m_pyramid.sets[0] =
+          m_device->build_descriptor()
+              .bind_image(0, &src_info, vk::DescriptorType::eCombinedImageSampler, stages)
+              .bind_image(1, &dst_info, vk::DescriptorType::eStorageImage, stages)
+              .build()
+              .value()
+              .first;
+      m_pyramid.depth_view = depth.view;
+    }
+
+    // the culling of this frame is done with the old pyramid
+    compute_barrier(
+        cmd,
+        vk::AccessFlagBits2::eShaderSampledRead,
+        vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eShaderStorageWrite);
+
+    const auto layout = m_pyramid_shader.pipeline_layout();
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pyramid_pipeline);
+
+    glm::uvec2 src_size = {depth.extent.width, depth.extent.height};
+    for (uint32_t level = 0; level < m_pyramid.levels; level++) {
+      const glm::uvec2 dst_size = {
+          std::max(extent.width >> level, 1u),
+          std::max(extent.height >> level, 1u),
+      };
+      const std::array<glm::uvec2, 2> push = {src_size, dst_size};
+
+      cmd.bindDescriptorSets(
+          vk::PipelineBindPoint::eCompute, layout, 0, {m_pyramid.sets[level]}, {});
+      cmd.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(push), &push);
+      cmd.dispatch(
+          (dst_size.x + k_pyramid_group_size - 1) / k_pyramid_group_size,
+          (dst_size.y + k_pyramid_group_size - 1) / k_pyramid_group_size,
+          1);
+
+      // the next level reads this one, the culling of the next frame all of them
+      compute_barrier(
+          cmd,
+          vk::AccessFlagBits2::eShaderStorageWrite,
+          vk::PipelineStageFlagBits2::eComputeShader,
+          vk::AccessFlagBits2::eShaderSampledRead);
+      src_size = dst_size;
+    }
+
+    m_pyramid_valid = true;
+    cull_data.pyramid_proj_view = m_frame_proj_view;
+  }
+
+  void ClusterCullPass::init_pipelines() {
+    m_cull_pipeline = m_device->vkdevice
+                          .createComputePipeline(
+                              VK_NULL_HANDLE,
+                              {
+                                  .stage = m_cull_shader.compute_stage_info,
+                                  .layout = m_cull_shader.pipeline_layout(),
+                              })
+                          .value;
+
+    m_pyramid_pipeline = m_device->vkdevice
+                             .createComputePipeline(
+                                 VK_NULL_HANDLE,
+                                 {
+                                     .stage = m_pyramid_shader.compute_stage_info,
+                                     .layout = m_pyramid_shader.pipeline_layout(),
+                                 })
+                             .value;
+  }
+
+  void ClusterCullPass::reserve_commands(uint32_t count) {
+    if (count <= m_commands_capacity) return;
+
+    uint32_t capacity = std::max(m_commands_capacity, k_cull_group_size);
+    while (capacity < count)
+      capacity *= 2;
+
+    m_device->destroy_buffer(m_commands, m_commands_alloc);
+
+    const auto buffer_info = static_cast<VkBufferCreateInfo>(vk::BufferCreateInfo{
+        .size = capacity * sizeof(vk::DrawIndexedIndirectCommand),
+        .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+        .sharingMode = vk::SharingMode::eExclusive,
+    });
+    const VmaAllocationCreateInfo alloc_info = {.usage = VMA_MEMORY_USAGE_GPU_ONLY};
+
+    VkBuffer vk_buff;
+    vmaCreateBuffer(
+        m_device->allocator, &buffer_info, &alloc_info, &vk_buff, &m_commands_alloc, nullptr);
+    m_commands = vk_buff;
+    m_commands_capacity = capacity;
+
+    build_cull_set();
+  }
+
+  void ClusterCullPass::create_pyramid(vk::Extent2D extent) {
+    m_pyramid.extent = extent;
+    m_pyramid.levels = std::bit_width(std::max(extent.width, extent.height));
+
+    const auto image_info = static_cast<VkImageCreateInfo>(vk::ImageCreateInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = vk::Format::eR32Sfloat,
+        .extent = {.width = extent.width, .height = extent.height, .depth = 1},
+        .mipLevels = m_pyramid.levels,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    });
+    const VmaAllocationCreateInfo alloc_info = {.usage = VMA_MEMORY_USAGE_GPU_ONLY};
+
+    VkImage vk_img;
+    vmaCreateImage(
+        m_device->allocator, &image_info, &alloc_info, &vk_img, &m_pyramid.alloc, nullptr);
+    m_pyramid.image = vk_img;
+
+    const auto view_of = [&](uint32_t base_level, uint32_t levels) {
+      return m_device->vkdevice.createImageView({
+          .image = m_pyramid.image,
+          .viewType = vk::ImageViewType::e2D,
+          .format = vk::Format::eR32Sfloat,
+          .subresourceRange{
+              .aspectMask = vk::ImageAspectFlagBits::eColor,
+              .baseMipLevel = base_level,
+              .levelCount = levels,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+      });
+    };
+    m_pyramid.view = view_of(0, m_pyramid.levels);
+    for (uint32_t i = 0; i < m_pyramid.levels; i++)
+      m_pyramid.level_views.push_back(view_of(i, 1));
+
+    // the first level's set is built once the depth is known
+    m_pyramid.sets.resize(m_pyramid.levels);
+    m_pyramid.depth_view = nullptr;
+    const auto stages = m_pyramid_shader.stage_flags;
+    for (uint32_t i = 1; i < m_pyramid.levels; i++) {
+      vk::DescriptorImageInfo src_info{
+          .sampler = m_sampler,
+          .imageView = m_pyramid.level_views[i - 1],
+          .imageLayout = vk::ImageLayout::eGeneral,
+      };
+      vk::DescriptorImageInfo dst_info{
+          .imageView = m_pyramid.level_views[i],
+          .imageLayout = vk::ImageLayout::eGeneral,
+      };
+      m_pyramid.sets[i] =
+          m_device->build_descriptor()
+              .bind_image(0, &src_info, vk::DescriptorType::eCombinedImageSampler, stages)
+              .bind_image(1, &dst_info, vk::DescriptorType::eStorageImage, stages)
+              .build()
+              .value()
+              .first;
+    }
+
+    m_device->single_time_command([&](vk::CommandBuffer cmd) {
+      const vk::ImageMemoryBarrier2 barrier{
+          .srcStageMask = vk::PipelineStageFlagBits2::eNone,
+          .srcAccessMask = vk::AccessFlagBits2::eNone,
+          .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+          .dstAccessMask =
+              vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eShaderStorageWrite,
+          .oldLayout = vk::ImageLayout::eUndefined,
+          .newLayout = vk::ImageLayout::eGeneral,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = m_pyramid.image,
+          .subresourceRange{
+              .aspectMask = vk::ImageAspectFlagBits::eColor,
+              .baseMipLevel = 0,
+              .levelCount = m_pyramid.levels,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+          .imageMemoryBarrierCount = 1,
+          .pImageMemoryBarriers = &barrier,
+      });
+    });
+
+    // the culling set points at the old pyramid
+    if (m_commands) build_cull_set();
+  }
+
+  void ClusterCullPass::build_cull_set() {
+    m_device->free_descriptor_set(m_cull_set);
+    auto ubo_info = m_cull_ubo.descriptor_info();
+    vk::DescriptorBufferInfo commands_info{
+        .buffer = m_commands,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    vk::DescriptorImageInfo pyramid_info{
+        .sampler = m_sampler,
+        .imageView = m_pyramid.view,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+    const auto stages = m_cull_shader.stage_flags;
+    constexpr auto sampler = vk::DescriptorType::eCombinedImageSampler;
+    m_cull_set = m_device->build_descriptor()
+                     .bind_buffer(0, &ubo_info, vk::DescriptorType::eUniformBufferDynamic, stages)
+                     .bind_buffer(1, &commands_info, vk::DescriptorType::eStorageBuffer, stages)
+                     .bind_image(2, &pyramid_info, sampler, stages)
+                     .build()
+                     .value()
+                     .first;
+  }
+
+  void ClusterCullPass::destroy_pyramid() {
+    for (const auto set : m_pyramid.sets)
+      m_device->free_descriptor_set(set);
+    for (const auto view : m_pyramid.level_views)
+      m_device->destroy_image_view(view);
+    m_device->destroy_image_view(m_pyramid.view);
+    m_device->destroy_image(m_pyramid.image, m_pyramid.alloc);
+    m_pyramid = {};
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "pch.hpp"
+#include "vulkan/device.hpp"
+#include "vulkan/lod-selector.hpp"
+#include "renderer/frame-snapshot.hpp"
+#include "vulkan/shader.hpp"
+#include "vulkan/uniform-buffer.hpp"
+
+namespace geg::vulkan {
+  // tests every meshlet of the scene's meshes against the frustum, its normal cone and the
+  // depth pyramid of the last frame in a compute pass, it writes one indexed indirect command
+  // per meshlet and the depth and pbr passes draw each mesh with one indirect draw, culled
+  // meshlets get no instances
+  // works without mesh shaders since meshlets are ranges of the meshes' index buffers
+  class ClusterCullPass {
+  public:
+    // frames_count is how many frames can be in flight, the swapchain's image count
+    ClusterCullPass(const std::shared_ptr<Device>& device, uint32_t frames_count);
+    ~ClusterCullPass();
+
+    // where a mesh's commands are in commands(), a count of 0 means the mesh is drawn whole
+    // (it has no meshlets, draws a coarser lod, wasn't resident yet when the culling ran or
+    // culling is off)
+    struct DrawRange {
+      vk::DeviceSize offset = 0;
+      uint32_t count = 0;
+    };
+
+    // before the passes that draw the meshes, only meshes drawn at lod 0 are culled
+    // frame picks the uniform buffer slot, the frames before it may still be reading theirs
+    void fill_commands(
+        const vk::CommandBuffer& cmd,
+        uint32_t frame,
+        const CameraSnapshot& camera,
+        const SceneSnapshot& scene,
+        const LodSelector& lods);
+    // after the depth is laid down, the next frame's occlusion tests read the result
+    void build_depth_pyramid(const vk::CommandBuffer& cmd, const Image& depth);
+
+    // indexed like SceneSnapshot::meshes
+    DrawRange range(size_t mesh) const {
+      return mesh < m_ranges.size() ? m_ranges[mesh] : DrawRange{};
+    }
+    vk::Buffer commands() const { return m_commands; }
+
+    void render_debug_gui();
+
+    glm::mat4 projection = glm::mat4(1);
+
+  private:
+    std::shared_ptr<Device> m_device;
+    uint32_t m_frames_count;
+
+    Shader m_cull_shader{m_device, "assets/shaders/cluster-cull.glsl", "cluster cull", true};
+    Shader m_pyramid_shader{m_device, "assets/shaders/depth-pyramid.glsl", "depth pyramid", true};
+    vk::Pipeline m_cull_pipeline;
+    vk::Pipeline m_pyramid_pipeline;
+
+    // matches CullData in cluster-cull.glsl
+    struct {
+      glm::mat4 proj_view;
+      glm::mat4 pyramid_proj_view;
+      glm::vec4 planes[6];
+      glm::vec3 camera_position;
+      uint32_t flags = 0;
+      glm::vec2 pyramid_size;
+      float pyramid_levels = 1;
+      float _padding;
+    } cull_data{};
+    UniformBuffer m_cull_ubo{m_device, sizeof(cull_data), m_frames_count};
+
+    struct Dispatch {
+      glm::mat4 model;
+      uint32_t first_command = 0;
+      uint32_t meshlets_count = 0;
+    };
+    struct CullJob {
+      Dispatch push;
+      vk::DescriptorSet meshlets;
+    };
+    std::vector<CullJob> m_jobs;
+    std::vector<DrawRange> m_ranges;
+
+    // grows, the old buffer is dropped once the frames using it are done
+    vk::Buffer m_commands;
+    VmaAllocation m_commands_alloc = nullptr;
+    uint32_t m_commands_capacity = 0;
+
+    // set 0 of the culling, rebuilt with the commands buffer or the pyramid
+    vk::DescriptorSet m_cull_set;
+
+    // r32 float, a power of two no bigger than the depth, every level keeps the farthest
+    // depth of the texels it covers, always in the general layout
+    struct DepthPyramid {
+      vk::Image image;
+      VmaAllocation alloc = nullptr;
+      vk::ImageView view;
+      vk::Extent2D extent;
+      uint32_t levels = 0;
+      std::vector<vk::ImageView> level_views;
+      // one per level, the first reads the depth
+      std::vector<vk::DescriptorSet> sets;
+      vk::ImageView depth_view;
+    } m_pyramid;
+    vk::Sampler m_sampler;
+    // false until a pyramid was built, and after the depth it came from stopped matching
+    bool m_pyramid_valid = false;
+    glm::mat4 m_frame_proj_view{1};
+
+    struct Settings {
+      bool enabled = true;
+      bool frustum = true;
+      bool backface = true;
+      bool occlusion = true;
+    } m_settings;
+    std::mutex m_settings_mutex;
+    std::atomic<uint32_t> m_meshlets_count = 0;
+    std::atomic<uint32_t> m_whole_meshes_count = 0;
+
+    void init_pipelines();
+    void reserve_commands(uint32_t count);
+    void build_cull_set();
+    void create_pyramid(vk::Extent2D extent);
+    void destroy_pyramid();
+  };
+}    // namespace geg::vulkan
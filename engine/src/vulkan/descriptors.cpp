@@ -28,6 +28,7 @@ namespace geg::vulkan {
       }
 
       auto new_pool = m_device->vkdevice.createDescriptorPool({
+          .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
           .maxSets = count,
           .poolSizeCount = static_cast<uint32_t>(sizes.size()),
           .pPoolSizes = sizes.data(),
@@ -47,46 +48,59 @@ namespace geg::vulkan {
   std::optional<vk::DescriptorSet> DescriptorAllocator::allocate(vk::DescriptorSetLayout layout) {
     if (!m_current_pool.has_value()) { m_current_pool = get_free_pool(); }
 
+    const auto allocate_from_current = [&] {
+      const auto set = m_device->vkdevice
+                           .allocateDescriptorSets({
+                               .descriptorPool = m_current_pool.value(),
+                               .descriptorSetCount = 1,
+                               .pSetLayouts = &layout,
+                           })
+                           .front();
+      m_set_pools[set] = m_current_pool.value();
+      m_pool_sets[m_current_pool.value()]++;
+
+      return set;
+    };
+
     try {
-      return m_device->vkdevice
-          .allocateDescriptorSets({
-              .descriptorPool = m_current_pool.value(),
-              .descriptorSetCount = 1,
-              .pSetLayouts = &layout,
-          })
-          .front();
+      return allocate_from_current();
     } catch (vk::FragmentedPoolError) {
       m_current_pool = get_free_pool();
-      return m_device->vkdevice
-          .allocateDescriptorSets({
-              .descriptorPool = m_current_pool.value(),
-              .descriptorSetCount = 1,
-              .pSetLayouts = &layout,
-
-          })
-          .front();
+      return allocate_from_current();
     } catch (vk::OutOfPoolMemoryError) {
       m_current_pool = get_free_pool();
-      return m_device->vkdevice
-          .allocateDescriptorSets({
-              .descriptorPool = m_current_pool.value(),
-              .descriptorSetCount = 1,
-              .pSetLayouts = &layout,
-
-          })
-          .front();
+      return allocate_from_current();
     } catch (...) {
       GEG_CORE_ERROR("Unknown error in DescriptorAllocator::allocate");
       return {};
     }
   }
 
+  void DescriptorAllocator::free(vk::DescriptorSet set) {
+    const auto it = m_set_pools.find(set);
+    if (it == m_set_pools.end()) return;
+
+    const vk::DescriptorPool pool = it->second;
+    m_device->vkdevice.freeDescriptorSets(pool, set);
+    m_set_pools.erase(it);
+
+    // the current pool keeps serving allocations, the others only come back when empty
+    if (--m_pool_sets[pool] > 0 || pool == m_current_pool) return;
+
+    m_pool_sets.erase(pool);
+    m_device->vkdevice.resetDescriptorPool(pool);
+    std::erase(m_used_pools, static_cast<VkDescriptorPool>(pool));
+    m_free_pools.push_back(pool);
+  }
+
   void DescriptorAllocator::reset_pools() {
     for (auto &pool : m_used_pools) {
       m_device->vkdevice.resetDescriptorPool(pool);
       m_free_pools.push_back(pool);
     }
     m_used_pools.clear();
+    m_set_pools.clear();
+    m_pool_sets.clear();
     m_current_pool = {};
   }
 
@@ -303,6 +317,19 @@ namespace geg::vulkan {
     return *this;
   }
 
+  DescriptorBuilder &DescriptorBuilder::bind_layout(
+      uint32_t binding, uint32_t count, vk::DescriptorType type, vk::ShaderStageFlags stage_flags) {
+    vk::DescriptorSetLayoutBinding new_binding{};
+    new_binding.descriptorCount = count;
+    new_binding.descriptorType = type;
+    new_binding.stageFlags = stage_flags;
+    new_binding.binding = binding;
+
+    bindings.push_back(new_binding);
+
+    return *this;
+  }
+
   std::optional<std::pair<vk::DescriptorSet, vk::DescriptorSetLayout>> DescriptorBuilder::build() {
     // build layout first
     vk::DescriptorSetLayoutCreateInfo layoutInfo{};
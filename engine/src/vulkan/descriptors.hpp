@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "pch.hpp"
 #include "geg-vulkan.hpp"
 
@@ -12,6 +14,9 @@ namespace geg::vulkan {
 
     void reset_pools();
     std::optional<vk::DescriptorSet> allocate(vk::DescriptorSetLayout layout);
+    // back to its pool, a pool without sets left is reset and reused
+    // goes through Device::free_descriptor_set while the gpu may still use the set
+    void free(vk::DescriptorSet set);
 
   private:
     Device* m_device;
@@ -34,6 +39,9 @@ namespace geg::vulkan {
 
     std::vector<VkDescriptorPool> m_used_pools;
     std::vector<VkDescriptorPool> m_free_pools;
+    // where every live set came from and how many each pool has
+    std::unordered_map<VkDescriptorSet, VkDescriptorPool> m_set_pools;
+    std::unordered_map<VkDescriptorPool, uint32_t> m_pool_sets;
 
     vk::DescriptorPool get_free_pool();
 
@@ -102,6 +110,10 @@ namespace geg::vulkan {
         vk::DescriptorType type,
         vk::ShaderStageFlags stageFlags);
 
+    // any descriptor type, used when the bindings come from shader reflection
+    DescriptorBuilder& bind_layout(
+        uint32_t binding, uint32_t count, vk::DescriptorType type, vk::ShaderStageFlags stageFlags);
+
     std::optional<std::pair<vk::DescriptorSet, vk::DescriptorSetLayout>> build();
     std::optional<vk::DescriptorSetLayout> build_layout();
 
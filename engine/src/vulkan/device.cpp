@@ -230,6 +230,8 @@ namespace geg::vulkan {
     for (auto &prop : properties) {
       if (std::strcmp(prop.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
         dynamic_rendering = true;
+      if (std::strcmp(prop.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+        memory_budget = true;
     }
     GEG_CORE_ASSERT(dynamic_rendering, "dynamic rendering extension required");
 
@@ -239,12 +241,34 @@ namespace geg::vulkan {
         .runtimeDescriptorArray = VK_TRUE,
     };
 
-    vk::PhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features = {
+    // the render graph uses sync2 barriers and depth only layouts on depth/stencil formats
+    vk::PhysicalDeviceSeparateDepthStencilLayoutsFeatures separate_depth_stencil_features = {
         .pNext = &device_indexing_features,
+        .separateDepthStencilLayouts = VK_TRUE,
+    };
+
+    vk::PhysicalDeviceSynchronization2Features synchronization2_features = {
+        .pNext = &separate_depth_stencil_features,
+        .synchronization2 = VK_TRUE,
+    };
+
+    vk::PhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features = {
+        .pNext = &synchronization2_features,
         .dynamicRendering = VK_TRUE,
     };
 
+    texture_compression_bc = physical_device.getFeatures().textureCompressionBC;
+    if (!texture_compression_bc)
+      GEG_CORE_WARN("bc texture compression not supported, cooked textures won't load");
+    multi_draw_indirect = physical_device.getFeatures().multiDrawIndirect;
+    if (!multi_draw_indirect)
+      GEG_CORE_WARN("multi draw indirect not supported, meshes are drawn without cluster culling");
+    min_storage_buffer_alignment =
+        physical_device.getProperties().limits.minStorageBufferOffsetAlignment;
+
     const vk::PhysicalDeviceFeatures device_features = {
+        .multiDrawIndirect = multi_draw_indirect,
+        .textureCompressionBC = texture_compression_bc,
         .shaderSampledImageArrayDynamicIndexing = VK_TRUE,
     };
 
@@ -253,12 +277,18 @@ namespace geg::vulkan {
         .features = device_features,
     };
 
-    std::array<const char *, 1> device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char *> device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    // without it vma estimates the budget from the heap sizes and its own allocations
+    if (memory_budget)
+      device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    else
+      GEG_CORE_WARN("VK_EXT_memory_budget not supported, the memory budget is an estimate");
+
     vkdevice = physical_device.createDevice({
         .pNext = &device_features2,
         .queueCreateInfoCount = 1,
         .pQueueCreateInfos = &device_queue_create_info,
-        .enabledExtensionCount = static_cast<uint32_t>(1),
+        .enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
         .ppEnabledExtensionNames = device_extensions.data(),
     });
 
@@ -272,6 +302,7 @@ namespace geg::vulkan {
     });
 
     VmaAllocatorCreateInfo allocator_info{
+        .flags = memory_budget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u,
         .physicalDevice = physical_device,
         .device = vkdevice,
         .instance = instance,
@@ -281,10 +312,14 @@ namespace geg::vulkan {
 
     m_descriptor_allocator = std::make_unique<DescriptorAllocator>(this);
     m_descriptor_layout_cache = std::make_unique<DescriptorLayoutCache>(this);
+    m_pipeline_cache = std::make_unique<PipelineCache>(this);
   };
 
   Device::~Device() {
     GEG_CORE_WARN("destroying vulkan device");
+    vkdevice.waitIdle();
+    flush_deletions();
+    m_pipeline_cache.reset();
     m_descriptor_layout_cache.reset();
     m_descriptor_allocator.reset();
     vmaDestroyAllocator(allocator);
@@ -295,6 +330,70 @@ namespace geg::vulkan {
     instance.destroy();
   }
 
+  void Device::defer(std::function<void()> destroy, VmaAllocation alloc) {
+    size_t bytes = 0;
+    if (alloc) {
+      VmaAllocationInfo info;
+      vmaGetAllocationInfo(allocator, alloc, &info);
+      bytes = info.size;
+      m_pending_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    std::lock_guard lock(m_deletion_mutex);
+    m_deletions.push_back({m_frame.load(std::memory_order_acquire), std::move(destroy), bytes});
+  }
+
+  void Device::destroy_buffer(vk::Buffer buffer, VmaAllocation alloc) {
+    if (!buffer) return;
+    defer([this, buffer, alloc] { vmaDestroyBuffer(allocator, buffer, alloc); }, alloc);
+  }
+
+  void Device::destroy_image(vk::Image image, VmaAllocation alloc) {
+    if (!image) return;
+    defer([this, image, alloc] { vmaDestroyImage(allocator, image, alloc); }, alloc);
+  }
+
+  void Device::destroy_image_view(vk::ImageView view) {
+    if (!view) return;
+    defer([this, view] { vkdevice.destroy(view); });
+  }
+
+  void Device::destroy_sampler(vk::Sampler sampler) {
+    if (!sampler) return;
+    defer([this, sampler] { vkdevice.destroy(sampler); });
+  }
+
+  void Device::destroy_pipeline(vk::Pipeline pipeline) {
+    if (!pipeline) return;
+    defer([this, pipeline] { vkdevice.destroy(pipeline); });
+  }
+
+  void Device::free_descriptor_set(vk::DescriptorSet set) {
+    if (!set) return;
+    defer([this, set] { m_descriptor_allocator->free(set); });
+  }
+
+  void Device::retire_frames(uint64_t frame) {
+    std::vector<Deletion> retired;
+    {
+      std::lock_guard lock(m_deletion_mutex);
+      while (!m_deletions.empty() && m_deletions.front().frame <= frame) {
+        retired.push_back(std::move(m_deletions.front()));
+        m_deletions.pop_front();
+      }
+    }
+
+    // outside the lock so other threads can keep queueing
+    for (auto &deletion : retired) {
+      deletion.destroy();
+      m_pending_bytes.fetch_sub(deletion.bytes, std::memory_order_relaxed);
+    }
+  }
+
+  void Device::flush_deletions() {
+    retire_frames(UINT64_MAX);
+  }
+
   void Device::single_time_command(const std::function<void(vk::CommandBuffer)> &lambda) {
     auto command_buffer = vkdevice
                               .allocateCommandBuffers({
@@ -372,6 +471,30 @@ namespace geg::vulkan {
       const void *data,
       vk::DeviceSize size,
       uint32_t mip_levels) {
+    const vk::BufferImageCopy region{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource{
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageExtent = extent,
+    };
+
+    upload_levels_to_image(image, layout_after, format, {&region, 1}, data, size, mip_levels);
+  }
+
+  void Device::upload_levels_to_image(
+      vk::Image image,
+      vk::ImageLayout layout_after,
+      vk::Format format,
+      std::span<const vk::BufferImageCopy> regions,
+      const void *data,
+      vk::DeviceSize size,
+      uint32_t mip_levels) {
     auto buffer_info = static_cast<VkBufferCreateInfo>(vk::BufferCreateInfo{
         .size = size,
         .usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
@@ -398,10 +521,15 @@ namespace geg::vulkan {
     memcpy(mapping_addr, data, size);
     vmaUnmapMemory(allocator, staging_allocation);
 
-    single_time_command([&](auto cmd) {
+    single_time_command([&](vk::CommandBuffer cmd) {
       transition_image_layout(
           image, format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, cmd, mip_levels);
-      copy_buffer_to_image(staging_buffer, image, extent, cmd);
+      cmd.copyBufferToImage(
+          staging_buffer,
+          image,
+          vk::ImageLayout::eTransferDstOptimal,
+          static_cast<uint32_t>(regions.size()),
+          regions.data());
       transition_image_layout(
           image, format, vk::ImageLayout::eTransferDstOptimal, layout_after, cmd, mip_levels);
     });
@@ -1,8 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+
 #include "geg-vulkan.hpp"
 #include "core/window.hpp"
 #include "vulkan/descriptors.hpp"
+#include "vulkan/pipeline-cache.hpp"
 #include "vk_mem_alloc.h"
 
 namespace geg::vulkan {
@@ -24,6 +31,14 @@ namespace geg::vulkan {
     vk::Queue graphics_queue;
     vk::CommandPool command_pool;
     VmaAllocator allocator;
+    // VK_EXT_memory_budget is enabled, vmaGetHeapBudgets reports what the driver sees
+    bool memory_budget = false;
+    // bc1-7 can be sampled, cooked textures are bc compressed
+    bool texture_compression_bc = false;
+    // an indirect draw can take many commands, the cluster culling pass needs it
+    bool multi_draw_indirect = false;
+    // offsets of storage buffer ranges in a descriptor have to be a multiple of this
+    vk::DeviceSize min_storage_buffer_alignment = 1;
     std::shared_ptr<Window> window;
 
     // helpers
@@ -49,16 +64,62 @@ namespace geg::vulkan {
         const void *data,
         vk::DeviceSize size,
         uint32_t mip_levels = 1);
+    // one staging buffer for several levels, regions[i] says where level i is in data
+    // all the image's mip_levels are transitioned, the ones without a region are left undefined
+    void upload_levels_to_image(
+        vk::Image image,
+        vk::ImageLayout layout_after,
+        vk::Format format,
+        std::span<const vk::BufferImageCopy> regions,
+        const void *data,
+        vk::DeviceSize size,
+        uint32_t mip_levels);
     DescriptorBuilder build_descriptor() {
       return DescriptorBuilder::begin(
           m_descriptor_layout_cache.get(), m_descriptor_allocator.get());
     };
+    PipelineCache& pipeline_cache() { return *m_pipeline_cache; }
+
+    // deferred destruction, an object handed over is destroyed once the frames that were
+    // recorded before it finished on the gpu, callable from any thread
+    void destroy_buffer(vk::Buffer buffer, VmaAllocation alloc);
+    void destroy_image(vk::Image image, VmaAllocation alloc);
+    void destroy_image_view(vk::ImageView view);
+    void destroy_sampler(vk::Sampler sampler);
+    void destroy_pipeline(vk::Pipeline pipeline);
+    void free_descriptor_set(vk::DescriptorSet set);
+
+    // frames are numbered from 1, the render thread begins one before recording it
+    uint64_t begin_frame() { return m_frame.fetch_add(1, std::memory_order_acq_rel) + 1; }
+    // the fence of `frame` was waited on, it and every frame before it are done
+    void retire_frames(uint64_t frame);
+    // destroys everything that is queued, the device must be idle
+    void flush_deletions();
+    // memory of the queued buffers and images, still counted by vma until they retire
+    size_t pending_deletion_bytes() const {
+      return m_pending_bytes.load(std::memory_order_relaxed);
+    }
 
   private:
+    struct Deletion {
+      // the last frame that may reference the object
+      uint64_t frame;
+      std::function<void()> destroy;
+      size_t bytes = 0;
+    };
+    void defer(std::function<void()> destroy, VmaAllocation alloc = nullptr);
+
+    std::atomic<uint64_t> m_frame = 0;
+    std::atomic<size_t> m_pending_bytes = 0;
+    // ordered by frame, they are queued with the frame that was current at the time
+    std::mutex m_deletion_mutex;
+    std::deque<Deletion> m_deletions;
+
     bool m_debug_messenger_created = false;
     vk::DebugUtilsMessengerEXT m_debug_messenger;
 
     std::unique_ptr<DescriptorAllocator> m_descriptor_allocator;
     std::unique_ptr<DescriptorLayoutCache> m_descriptor_layout_cache;
+    std::unique_ptr<PipelineCache> m_pipeline_cache;
   };
 }    // namespace geg::vulkan
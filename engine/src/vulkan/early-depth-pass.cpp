@@ -1,26 +1,26 @@
 #include "early-depth-pass.hpp"
-#include "ecs/components.hpp"
+#include "assets/asset-manager.hpp"
 
 namespace geg::vulkan {
   DepthPass::DepthPass(const std::shared_ptr<Device>& device): m_device(device) {
     init_pipeline();
   }
 
-  DepthPass::~DepthPass() {
-    m_device->vkdevice.destroyPipelineLayout(m_pipeline_layout);
-    m_device->vkdevice.destroyPipeline(m_pipeline);
-  }
+  DepthPass::~DepthPass() = default;
 
   void DepthPass::fill_commands(
-      const vk::CommandBuffer& cmd, const Camera& camera, Scene* scene, const Image& depth_target) {
-    namespace cmps = components;
-    GEG_CORE_ASSERT(scene, "rendering empty scene");
-
+      const vk::CommandBuffer& cmd,
+      ParallelRecorder& recorder,
+      const CameraSnapshot& camera,
+      const SceneSnapshot& scene,
+      const LodSelector& lods,
+      const ClusterCullPass& clusters,
+      const Image& depth_target) {
     vk::RenderingAttachmentInfoKHR depth_attachment_info{};
     depth_attachment_info.imageView = depth_target.view;
     depth_attachment_info.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
-    depth_attachment_info.loadOp = vk::AttachmentLoadOp::eClear;
-    depth_attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
+    depth_attachment_info.loadOp = depth_target.load_op;
+    depth_attachment_info.storeOp = depth_target.store_op;
     depth_attachment_info.clearValue = vk::ClearValue{
         .depthStencil = {
             .depth = 1.0f,
@@ -34,196 +34,119 @@ namespace geg::vulkan {
     rendering_info.colorAttachmentCount = 0;
     rendering_info.layerCount = 1;
 
-    cmd.beginRendering(rendering_info);
-    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
-
-    cmd.setViewport(
-        0,
-        vk::Viewport{
-            .x = 0,
-            .y = 0,
-            .width = static_cast<float>(depth_target.extent.width),
-            .height = static_cast<float>(depth_target.extent.height),
-            .minDepth = 0,
-            .maxDepth = 1,
-        });
-
-    cmd.setScissor(
-        0,
-        vk::Rect2D{
-            .offset = {},
-            .extent = depth_target.extent,
-        });
+    // still compiling, only clear the depth
+    const auto pipeline = m_device->pipeline_cache().get(m_pipeline_state);
+    if (!pipeline) {
+      cmd.beginRendering(rendering_info);
+      cmd.endRendering();
+      return;
+    }
 
-    global_data.proj_view = projection * camera.view_matrix();
+    global_data.proj_view = projection * camera.view;
     m_global_ubo.write_at_frame(&global_data, sizeof(global_data), 0);
 
-    cmd.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        m_pipeline_layout,
-        0,
-        {m_global_ubo.descriptor_set},
-        {m_global_ubo.frame_offset(0)});
-
-    const auto objects = scene->get_reg().group<cmps::PBR>(entt::get<cmps::Transform, cmps::Mesh>);
-
-    auto& asset_manager = AssetManager::get();
-    std::array<glm::mat4, 2> push_data;
-
-    for (auto obj : objects) {
-      const auto& transform = objects.get<cmps::Transform>(obj);
-      const auto& mesh = objects.get<cmps::Mesh>(obj);
-
-      if (!mesh) continue;
-
-      push_data[0] = transform.model_matrix();
-      push_data[1] = transform.normal_matrix();
-
-      cmd.pushConstants(
-          m_pipeline_layout,
-          vk::ShaderStageFlagBits::eAllGraphics,
-          0,
-          sizeof(push_data),
-          &push_data);
-
-      auto& mesh_descriptor = asset_manager.get_mesh(mesh.id).descriptor_set;
-
-      cmd.bindDescriptorSets(
-          vk::PipelineBindPoint::eGraphics,
-          m_pipeline_layout,
-          1,
-          {
-              mesh_descriptor,
-          },
-          {});
-
-      uint32_t indcies_count = asset_manager.get_mesh(mesh.id).indices_count();
-      cmd.draw(indcies_count, 1, 0, 0);
+    auto& residency = AssetManager::get().residency();
+
+    m_draws.clear();
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+      const auto& mesh = scene.meshes[m];
+      // null while the mesh is still queued
+      const auto* mesh_data = residency.use(mesh.mesh);
+      if (!mesh_data || lods.impostor(m)) continue;
+      const auto& lod = mesh_data->lods()[lods.lod(m)];
+
+      m_draws.push_back({
+          .push = {mesh.model, mesh.normal},
+          .geometry = mesh_data->descriptor_set,
+          .index_buffer = mesh_data->buffer,
+          .index_offset = mesh_data->index_offset,
+          .index_type = mesh_data->index_type(),
+          .first_index = lod.first_index,
+          .indices_count = lod.index_count,
+          .commands = clusters.commands(),
+          .commands_offset = clusters.range(m).offset,
+          .commands_count = clusters.range(m).count,
+      });
     }
 
-    cmd.endRendering();
-  }
-
-  void DepthPass::init_pipeline() {
-    auto vert_shader_stage = m_shader.vert_stage_info;
-
-    auto vertex_input_info = vk::PipelineVertexInputStateCreateInfo{};
-
-    auto input_assembly = vk::PipelineInputAssemblyStateCreateInfo{
-        .topology = vk::PrimitiveTopology::eTriangleList,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-
-    vk::PipelineViewportStateCreateInfo viewport_state{
-        .viewportCount = 1,
-        .scissorCount = 1,
-    };
-
-    std::array<vk::DynamicState, 2> dynamic_states = {
-        vk::DynamicState::eViewport,
-        vk::DynamicState::eScissor,
-    };
-
-    vk::PipelineDynamicStateCreateInfo dynamic_state{
-        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
-        .pDynamicStates = dynamic_states.data(),
-    };
-
-    auto rasterizer = vk::PipelineRasterizationStateCreateInfo{
-        .depthClampEnable = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode = vk::PolygonMode::eFill,
-        .cullMode = vk::CullModeFlagBits::eNone,
-        .frontFace = vk::FrontFace::eClockwise,
-        .depthBiasEnable = VK_FALSE,
-        .lineWidth = 1.0f,
-    };
-
-    auto multisampling = vk::PipelineMultisampleStateCreateInfo{
+    const vk::CommandBufferInheritanceRenderingInfo inheritance_info{
+        .depthAttachmentFormat = m_pipeline_state.depth_format,
         .rasterizationSamples = vk::SampleCountFlagBits::e1,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 1.0f,
-    };
-
-    auto depth_stencil = vk::PipelineDepthStencilStateCreateInfo{
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = vk::CompareOp::eLess,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable = VK_FALSE,
-    };
-
-    auto color_blend_attachment = vk::PipelineColorBlendAttachmentState{
-        .blendEnable = VK_FALSE,
-        .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-                          vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
-    };
-
-    auto color_blending = vk::PipelineColorBlendStateCreateInfo{
-        .logicOpEnable = VK_FALSE,
-        .attachmentCount = 1,
-        .pAttachments = &color_blend_attachment,
-    };
-
-    vk::PushConstantRange push_range{
-        .stageFlags = vk::ShaderStageFlagBits::eAllGraphics,
-        .offset = 0,
-        .size = 128,
-    };
-
-    // @TODO: automate this
-    auto gubo_layout = m_global_ubo.descriptor_set_layout;
-    auto geometry_layout =
-        m_device->build_descriptor()
-            .bind_buffer_layout(
-                0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex)
-            .bind_buffer_layout(
-                1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex)
-            .build_layout()
-            .value();
-
-    const std::array<vk::DescriptorSetLayout, 2> layouts = {
-        gubo_layout,
-        geometry_layout,
-    };
-
-    m_pipeline_layout = m_device->vkdevice.createPipelineLayout(vk::PipelineLayoutCreateInfo{
-        .setLayoutCount = layouts.size(),
-        .pSetLayouts = layouts.data(),
-        .pushConstantRangeCount = 1,
-        .pPushConstantRanges = &push_range,
-    });
-
-    // dynamic rendering
-    vk::PipelineRenderingCreateInfoKHR rendering_info{
-        .colorAttachmentCount = 0,
-        .pColorAttachmentFormats = nullptr,
-        .depthAttachmentFormat = vk::Format::eD32SfloatS8Uint,
     };
 
-    auto result = m_device->vkdevice.createGraphicsPipeline(
-        {},
-        {
-            .pNext = &rendering_info,
-            .stageCount = 1,
-            .pStages = &vert_shader_stage,
-            .pVertexInputState = &vertex_input_info,
-            .pInputAssemblyState = &input_assembly,
-            .pViewportState = &viewport_state,
-            .pRasterizationState = &rasterizer,
-            .pMultisampleState = &multisampling,
-            .pDepthStencilState = &depth_stencil,
-            .pColorBlendState = &color_blending,
-            .pDynamicState = &dynamic_state,
-            .layout = m_pipeline_layout,
-            .renderPass = nullptr,
-            .subpass = 0,
-            .basePipelineHandle = vk::Pipeline{},
-            .basePipelineIndex = -1,
+    const auto secondaries = recorder.record(
+        inheritance_info,
+        static_cast<uint32_t>(m_draws.size()),
+        [&](vk::CommandBuffer scmd, uint32_t begin, uint32_t end) {
+          scmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+          scmd.setViewport(
+              0,
+              vk::Viewport{
+                  .x = 0,
+                  .y = 0,
+                  .width = static_cast<float>(depth_target.extent.width),
+                  .height = static_cast<float>(depth_target.extent.height),
+                  .minDepth = 0,
+                  .maxDepth = 1,
+              });
+          scmd.setScissor(
+              0,
+              vk::Rect2D{
+                  .offset = {},
+                  .extent = depth_target.extent,
+              });
+
+          scmd.bindDescriptorSets(
+              vk::PipelineBindPoint::eGraphics,
+              m_pipeline_layout,
+              PER_FRAME_SET,
+              {m_global_ubo.descriptor_set},
+              {m_global_ubo.frame_offset(0)});
+
+          for (uint32_t d = begin; d < end; d++) {
+            const auto& draw = m_draws[d];
+
+            scmd.pushConstants(
+                m_pipeline_layout, m_shader.stage_flags, 0, sizeof(draw.push), &draw.push);
+            scmd.bindDescriptorSets(
+                vk::PipelineBindPoint::eGraphics,
+                m_pipeline_layout,
+                PER_DRAW_SET,
+                {draw.geometry},
+                {});
+            scmd.bindIndexBuffer(draw.index_buffer, draw.index_offset, draw.index_type);
+            if (draw.commands_count) {
+              scmd.drawIndexedIndirect(
+                  draw.commands,
+                  draw.commands_offset,
+                  draw.commands_count,
+                  sizeof(vk::DrawIndexedIndirectCommand));
+            } else {
+              scmd.drawIndexed(draw.indices_count, 1, draw.first_index, 0, 0);
+            }
+          }
         });
 
-    GEG_CORE_ASSERT(result.result == vk::Result::eSuccess, "Failed to create graphics pipeline!");
+    rendering_info.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+    cmd.beginRendering(rendering_info);
+    cmd.executeCommands(secondaries);
+    cmd.endRendering();
+  }
 
-    m_pipeline = result.value;
+  void DepthPass::init_pipeline() {
+    // set 1 (per material) is unused here and gets an empty layout
+    m_pipeline_layout = m_shader.pipeline_layout();
+
+    m_pipeline_state = {
+        .vert_module = m_shader.vert_module,
+        .layout = m_pipeline_layout,
+        .cull_mode = vk::CullModeFlagBits::eNone,
+        .front_face = vk::FrontFace::eClockwise,
+        .depth_test = true,
+        .depth_write = true,
+        .depth_compare_op = vk::CompareOp::eLess,
+        .depth_format = vk::Format::eD32SfloatS8Uint,
+    };
+    m_device->pipeline_cache().request(m_pipeline_state);
   }
 }    // namespace geg::vulkan
@@ -2,10 +2,11 @@
 #include "pch.hpp"
 
 #include "vulkan/device.hpp"
-#include "ecs/scene.hpp"
-#include "renderer/camera.hpp"
+#include "renderer/frame-snapshot.hpp"
 #include "vulkan/shader.hpp"
 #include "vulkan/uniform-buffer.hpp"
+#include "vulkan/parallel-recorder.hpp"
+#include "vulkan/cluster-cull-pass.hpp"
 
 namespace geg::vulkan {
   class DepthPass {
@@ -15,8 +16,11 @@ namespace geg::vulkan {
 
     void fill_commands(
         const vk::CommandBuffer& cmd,
-        const Camera& camera,
-        Scene* scene,
+        ParallelRecorder& recorder,
+        const CameraSnapshot& camera,
+        const SceneSnapshot& scene,
+        const LodSelector& lods,
+        const ClusterCullPass& clusters,
         const Image& depth_target);
 
     glm::mat4 projection = glm::mat4(1);
@@ -24,7 +28,7 @@ namespace geg::vulkan {
   private:
     std::shared_ptr<Device> m_device;
     vk::PipelineLayout m_pipeline_layout;
-    vk::Pipeline m_pipeline;
+    GraphicsPipelineState m_pipeline_state;
 
     Shader m_shader{m_device, "assets/shaders/early-depth.glsl", "early depth"};
 
@@ -33,6 +37,23 @@ namespace geg::vulkan {
     } global_data{};
     UniformBuffer m_global_ubo{m_device, sizeof(global_data), 1};
 
+    struct DrawItem {
+      std::array<glm::mat4, 2> push;
+      vk::DescriptorSet geometry;
+      // the mesh's buffer, its index range starts at index_offset, the selected lod's
+      // triangles at first_index
+      vk::Buffer index_buffer;
+      vk::DeviceSize index_offset = 0;
+      vk::IndexType index_type = vk::IndexType::eUint32;
+      uint32_t first_index = 0;
+      uint32_t indices_count = 0;
+      // the meshlets' commands of the culling pass, drawn whole when there are none
+      vk::Buffer commands;
+      vk::DeviceSize commands_offset = 0;
+      uint32_t commands_count = 0;
+    };
+    std::vector<DrawItem> m_draws;
+
     void init_pipeline();
   };
 }    // namespace geg::vulkan
@@ -1,7 +1,6 @@
 #include "env-map-preprocessing-pass.hpp"
 #include "assets/asset-manager.hpp"
 #include "imgui.h"
-#include "ecs/components.hpp"
 
 namespace geg::vulkan {
   EnvMapPreprocessPass::EnvMapPreprocessPass(const std::shared_ptr<Device>& device):
@@ -16,101 +15,87 @@ namespace geg::vulkan {
   };
 
   void EnvMapPreprocessPass::render_debug_gui() {
+    std::lock_guard lock(m_settings_mutex);
     ImGui::DragFloat("number of samples", &m_settings.number_of_samples, 100.0f, 128, 4098);
     ImGui::DragFloat("mip level", &m_settings.mip_level, 1.0f, 0, 6);
-    ImGui::InputFloat("Diffuse map width", &m_settings.width);
-    ImGui::InputFloat("Diffuse map height", &m_settings.height);
     if (ImGui::Button("recalc importance sampling")) { m_calculated = false; };
     ImGui::Checkbox("recalc importance sampling anyway", &m_calc_anyway);
   }
 
-  void EnvMapPreprocessPass::fill_commands(const vk::CommandBuffer& cmd, Scene* scene) {
-    if (!m_calc_anyway) {
-      if (m_calculated) return;
-      m_calculated = true;
+  void EnvMapPreprocessPass::fill_commands(
+      const vk::CommandBuffer& cmd, const components::EnvMap& env_map) {
+    Settings settings;
+    {
+      std::lock_guard lock(m_settings_mutex);
+      if (!m_calc_anyway) {
+        if (m_calculated) return;
+        m_calculated = true;
+      }
+      settings = m_settings;
     }
 
-    namespace cmps = components;
-    auto env_maps = scene->get_reg().group<cmps::EnvMap>();
-    GEG_CORE_ASSERT(!env_maps.empty(), "u need to use env map");
-    cmps::EnvMap& env_map_cmp = env_maps.get<cmps::EnvMap>(env_maps[0]);
-
-    auto& asset_manager = AssetManager::get();
-    auto env_map_tex = asset_manager.get_texture(env_map_cmp.env_map).descriptor_set;
+    GEG_CORE_ASSERT(env_map.env_map, "u need to use env map");
+    const auto* env_map_texture = AssetManager::get().residency().use(env_map.env_map);
+    GEG_CORE_ASSERT(env_map_texture, "env map texture isn't loaded");
+    auto env_map_tex = env_map_texture->descriptor_set;
 
     GEG_CORE_INFO("prefiltering diffuse map");
-    Texture* env_map_diffuse = &asset_manager.get_texture(env_map_cmp.env_map_diffuse);
-    if (env_map_cmp.env_map_diffuse < 0) {
-      env_map_diffuse = new Texture(
-          m_device, m_settings.width, m_settings.height, vk::Format::eR32G32B32A32Sfloat);
-      env_map_cmp.env_map_diffuse = asset_manager.add_texture(env_map_diffuse);
-    }
-
-    env_map_diffuse->transition_layout(vk::ImageLayout::eGeneral);
+    m_diffuse_map.transition_layout(vk::ImageLayout::eGeneral);
+    settings.width = 512;
+    settings.height = 288;
     cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_diffuse_pipeline);
     cmd.pushConstants(
-        m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(m_settings), &m_settings);
+        m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(settings), &settings);
     cmd.bindDescriptorSets(
         vk::PipelineBindPoint::eCompute,
         m_pipeline_layout,
         0,
         {
             env_map_tex,
-            env_map_diffuse->write_descriptor_set,
+            m_diffuse_map.write_descriptor_set,
         },
         nullptr);
-    cmd.dispatch(m_settings.width / 32, m_settings.height / 18, 1);
+    cmd.dispatch(512 / 32, 288 / 18, 1);
 
     GEG_CORE_INFO("prefiltering specular map");
-    Texture* env_map_specular = &asset_manager.get_texture(env_map_cmp.env_map_specular);
-    if (env_map_cmp.env_map_specular < 0) {
-      env_map_specular = new Texture(m_device, 1280, 720, vk::Format::eR32G32B32A32Sfloat, 6);
-      env_map_cmp.env_map_specular = asset_manager.add_texture(env_map_specular);
-    }
-
-    env_map_specular->transition_layout(vk::ImageLayout::eGeneral);
-    m_settings.width = 1280;
-    m_settings.height = 720;
+    m_specular_map.transition_layout(vk::ImageLayout::eGeneral);
+    settings.width = 1280;
+    settings.height = 720;
     cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_specular_pipeline);
     cmd.pushConstants(
-        m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(m_settings), &m_settings);
+        m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(settings), &settings);
     cmd.bindDescriptorSets(
         vk::PipelineBindPoint::eCompute,
         m_pipeline_layout,
         0,
         {
             env_map_tex,
-            env_map_specular->write_descriptor_set,
+            m_specular_map.write_descriptor_set,
         },
         nullptr);
     cmd.dispatch(1280 / 32, 720 / 18, 1);
 
     GEG_CORE_INFO("integrating brdf");
-    Texture* brdf_integration_map = &asset_manager.get_texture(env_map_cmp.brdf_integration);
-    if (env_map_cmp.brdf_integration < 0) {
-      brdf_integration_map = new Texture(m_device, 512, 512, vk::Format::eR32G32B32A32Sfloat);
-      env_map_cmp.brdf_integration = asset_manager.add_texture(brdf_integration_map);
-    }
-    brdf_integration_map->transition_layout(vk::ImageLayout::eGeneral);
-    m_settings.width = 512;
-    m_settings.height = 512;
+    m_brdf_map.transition_layout(vk::ImageLayout::eGeneral);
+    settings.width = 512;
+    settings.height = 512;
     cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_brdf_pipeline);
     cmd.pushConstants(
-        m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(m_settings), &m_settings);
+        m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(settings), &settings);
     cmd.bindDescriptorSets(
         vk::PipelineBindPoint::eCompute,
         m_pipeline_layout,
         0,
         {
             env_map_tex,
-            brdf_integration_map->write_descriptor_set,
+            m_brdf_map.write_descriptor_set,
         },
         nullptr);
     cmd.dispatch(512 / 32, 512 / 32, 1);
 
-     env_map_diffuse->transition_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
-    // env_map_specular->transition_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
-    brdf_integration_map->transition_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    m_diffuse_map.transition_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    // m_specular_map.transition_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    m_brdf_map.transition_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
   };
 
   void EnvMapPreprocessPass::init_pipeline() {
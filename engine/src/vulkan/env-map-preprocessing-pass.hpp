@@ -1,8 +1,10 @@
 #pragma once
 
+#include <mutex>
+
 #include "device.hpp"
 #include "shader.hpp"
-#include "ecs/scene.hpp"
+#include "ecs/components.hpp"
 #include "texture.hpp"
 
 namespace geg::vulkan {
@@ -13,9 +15,15 @@ namespace geg::vulkan {
     EnvMapPreprocessPass(const std::shared_ptr<Device>& device);
     ~EnvMapPreprocessPass();
 
-    void fill_commands(const vk::CommandBuffer& cmd, Scene* scene);
+    void fill_commands(const vk::CommandBuffer& cmd, const components::EnvMap& env_map);
+    // main thread, guarded against the render thread reading the settings
     void render_debug_gui();
 
+    // the prefiltered maps are owned by the pass so the render thread never writes the scene
+    const Texture& diffuse_map() const { return m_diffuse_map; }
+    const Texture& specular_map() const { return m_specular_map; }
+    const Texture& brdf_map() const { return m_brdf_map; }
+
   private:
     Shader m_diffuse_shader{m_device, "assets/shaders/prefilter-diffuse.glsl", "prefilter-diffuse", true};
     Shader m_specular_shader{m_device, "assets/shaders/prefilter-specular.glsl", "prefilter-specular", true};
@@ -24,12 +32,17 @@ namespace geg::vulkan {
     bool m_calculated = false;
     bool m_calc_anyway = false;
 
-    struct {
+    struct Settings {
       float number_of_samples = 4098;
       float mip_level = 0;
-      float width = 512;
-      float height = 288;
+      float width = 0;
+      float height = 0;
     } m_settings;
+    std::mutex m_settings_mutex;
+
+    Texture m_diffuse_map{m_device, 512, 288, vk::Format::eR32G32B32A32Sfloat};
+    Texture m_specular_map{m_device, 1280, 720, vk::Format::eR32G32B32A32Sfloat, 6};
+    Texture m_brdf_map{m_device, 512, 512, vk::Format::eR32G32B32A32Sfloat};
 
     vk::Pipeline m_diffuse_pipeline;
     vk::Pipeline m_specular_pipeline;
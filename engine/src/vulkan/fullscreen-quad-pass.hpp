@@ -2,9 +2,8 @@
 
 #include "device.hpp"
 #include "shader.hpp"
-#include "renderer/camera.hpp"
+#include "renderer/frame-snapshot.hpp"
 #include "texture.hpp"
-#include "ecs/scene.hpp"
 
 namespace geg::vulkan {
 
@@ -15,8 +14,9 @@ namespace geg::vulkan {
 
     void fill_commands(
         const vk::CommandBuffer& cmd,
-        const Camera& camera,
-        Scene* scene,
+        const CameraSnapshot& camera,
+        const SceneSnapshot& scene,
+        const Texture& diffuse_map,
         const Image& input,
         const Image& target);
 
@@ -30,7 +30,7 @@ namespace geg::vulkan {
       glm::mat4 inv_proj;
     } m_push_data;
     const std::shared_ptr<Device> m_device;
-    vk::Pipeline m_pipeline;
+    GraphicsPipelineState m_pipeline_state;
     vk::Sampler m_sampler;
     vk::PipelineLayout m_pipeline_layout;
     Shader m_shader{m_device, "assets/shaders/fullscreen-quad.glsl", "fullscreen-quad"};
@@ -8,5 +8,9 @@ namespace geg::vulkan {
     vk::Image image;
     vk::ImageView view;
     vk::Extent2D extent;
+
+    // set by the render graph for the pass using the image as an attachment
+    vk::AttachmentLoadOp load_op = vk::AttachmentLoadOp::eLoad;
+    vk::AttachmentStoreOp store_op = vk::AttachmentStoreOp::eStore;
   };
 }    // namespace geg::vulkan
@@ -1,4 +1,5 @@
 #include "graphics-context.hpp"
+#include "assets/asset-manager.hpp"
 #include "core/time.hpp"
 
 #include "ProfilerTask.h"
@@ -21,13 +22,13 @@ namespace geg {
         .width = m_window->dimensions().first,
         .height = m_window->dimensions().second,
     };
-
-    create_depth_resources();
+    m_window_extent = m_current_dimensions;
 
     m_present_semaphore = m_device->vkdevice.createSemaphore(vk::SemaphoreCreateInfo{});
     m_render_semaphore = m_device->vkdevice.createSemaphore(vk::SemaphoreCreateInfo{});
     const auto images_count = m_swapchain->image_count();
     m_swapchain_image_fences.resize(images_count);
+    m_image_frames.resize(images_count, 0);
 
     // create fences
     for (auto& fence : m_swapchain_image_fences) {
@@ -52,18 +53,25 @@ namespace geg {
       q = m_device->vkdevice.createQueryPool(info);
     }
 
+    m_recorder = std::make_unique<vulkan::ParallelRecorder>(m_device, images_count);
+    m_render_graph = std::make_unique<vulkan::RenderGraph>(m_device);
+
     m_env_map_pass = std::make_unique<vulkan::EnvMapPreprocessPass>(m_device);
+    m_lod_selector = std::make_unique<vulkan::LodSelector>();
+    m_cluster_cull_pass = std::make_unique<vulkan::ClusterCullPass>(m_device, images_count);
     m_early_depth_pass = std::make_unique<vulkan::DepthPass>(m_device);
     m_mesh_renderer = std::make_unique<vulkan::MeshRenderer>(m_device, m_swapchain->format());
+    m_impostor_pass =
+        std::make_unique<vulkan::ImpostorPass>(m_device, m_swapchain->format(), images_count);
     m_quad_pass = std::make_unique<vulkan::QuadPass>(m_device, m_swapchain->format());
     m_imgui_renderer = std::make_unique<vulkan::ImguiRenderer>(
         m_device, m_swapchain->format(), m_swapchain->image_count());
   }
 
   VulkanContext::~VulkanContext() {
+    // the passes own the shader modules in flight compilations are using
+    m_device->pipeline_cache().wait_idle();
     m_device->vkdevice.waitIdle();
-    vmaDestroyImage(m_device->allocator, m_depth_image.first, m_depth_image.second);
-    m_device->vkdevice.destroyImageView(m_depth_image_view);
     m_device->vkdevice.destroySemaphore(m_render_semaphore);
     m_device->vkdevice.destroySemaphore(m_present_semaphore);
     for (const auto& fence : m_swapchain_image_fences)
@@ -73,62 +81,38 @@ namespace geg {
       m_device->vkdevice.destroyQueryPool(q);
   }
 
-  void VulkanContext::create_depth_resources() {
-    if (m_depth_image.first || m_depth_image.second) {
-      vmaDestroyImage(m_device->allocator, m_depth_image.first, m_depth_image.second);
-      m_device->vkdevice.destroyImageView(m_depth_image_view);
-    }
-
-    const auto image_info = static_cast<VkImageCreateInfo>(vk::ImageCreateInfo{
-        .imageType = vk::ImageType::e2D,
-        .format = depth_format,
-        .extent = vk::Extent3D{m_swapchain->extent().width, m_swapchain->extent().height, 1},
-        .mipLevels = 1,
-        .arrayLayers = 1,
-        .samples = vk::SampleCountFlagBits::e1,
-        .tiling = vk::ImageTiling::eOptimal,
-        .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
-        .sharingMode = vk::SharingMode::eExclusive,
-        .initialLayout = vk::ImageLayout::eUndefined,
-    });
-
-    constexpr auto alloc_info = VmaAllocationCreateInfo{
-        .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
-        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
-    };
+  void VulkanContext::capture(FrameSnapshot& frame) {
+    draw_debug_ui();
 
-    VkImage img;
-    VmaAllocation alloc;
-    vmaCreateImage(m_device->allocator, &image_info, &alloc_info, &img, &alloc, nullptr);
-    m_depth_image = {img, alloc};
-
-    m_depth_image_view = m_device->vkdevice.createImageView({
-        .image = m_depth_image.first,
-        .viewType = vk::ImageViewType::e2D,
-        .format = depth_format,
-        .subresourceRange =
-            {
-                .aspectMask = vk::ImageAspectFlagBits::eDepth,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
-    });
+    frame.extent = m_window_extent;
+    frame.settings = m_settings;
+    m_imgui_renderer->end_frame(frame.ui, m_window_extent);
   }
 
-  void VulkanContext::render(const Camera& camera, Scene* scene) {
-    if (m_current_dimensions.width == 0 || m_current_dimensions.height == 0) return;
+  void VulkanContext::render(const FrameSnapshot& frame) {
+    if (frame.extent.width == 0 || frame.extent.height == 0) return;
 
-    draw_debug_ui();
+    if (frame.extent != m_current_dimensions) {
+      m_current_dimensions = frame.extent;
+      should_resize_swapchain = true;
+    }
 
-    if (m_swapchain->present_mode() != m_debug_ui_settings.present_mode)
+    if (m_swapchain->present_mode() != frame.settings.present_mode)
       should_resize_swapchain = true;
 
+    // nothing to draw before a layer with an env map is attached
+    const auto& scene = frame.scene;
+    if (!scene.env_map) {
+      GEG_CORE_ASSERT(scene.meshes.empty(), "u need to use env map");
+      return;
+    }
+
+    const auto& settings = frame.settings;
+    const auto& camera = frame.camera;
+
     if (should_resize_swapchain) {
       m_device->vkdevice.waitIdle();
-      m_swapchain->recreate(m_debug_ui_settings.present_mode);
-      create_depth_resources();
+      m_swapchain->recreate(m_current_dimensions, settings.present_mode);
       should_resize_swapchain = false;
     }
 
@@ -148,8 +132,16 @@ namespace geg {
     GEG_CORE_ASSERT(res == vk::Result::eSuccess, "Fence timeout")
     m_device->vkdevice.resetFences(m_swapchain_image_fences[m_current_image_index]);
 
+    // every frame up to the last one that used this image is done, what was destroyed
+    // while they were in flight can go now
+    m_device->retire_frames(m_image_frames[m_current_image_index]);
+    m_image_frames[m_current_image_index] = m_device->begin_frame();
+
+    // the passes below reload whatever gets evicted here if they need it
+    AssetManager::get().residency().begin_frame(frame.frame);
+
     auto proj = glm::perspective(
-        glm::radians(m_debug_ui_settings.fov),
+        glm::radians(settings.fov),
         (float)m_current_dimensions.width / (float)m_current_dimensions.height,
         0.1f,
         100.f);
@@ -157,57 +149,106 @@ namespace geg {
 
     m_mesh_renderer->projection = proj;
     m_early_depth_pass->projection = proj;
+    m_lod_selector->projection = proj;
+    m_impostor_pass->projection = proj;
+    m_cluster_cull_pass->projection = proj;
     m_quad_pass->projection = proj;
 
+    // the image fence was waited on so its secondary buffers can be reused
+    m_recorder->begin_frame(m_current_image_index);
+
     auto cmd = m_command_buffers[m_current_image_index];
     cmd.begin(vk::CommandBufferBeginInfo{});
 
     cmd.resetQueryPool(m_querey_pools[m_current_image_index], 0, 6);
-    m_env_map_pass->fill_commands(cmd, scene);
-
-    vulkan::Image color_target = m_swapchain->images()[m_current_image_index];
-    vulkan::Image depth_target =
-        vulkan::Image{.view = m_depth_image_view, .extent = m_current_dimensions};
-
-    m_device->transition_image_layout(
-        color_target.image,
+    m_env_map_pass->fill_commands(cmd, *scene.env_map);
+    // both passes drawing the meshes read the lods and the indirect commands
+    m_lod_selector->select(camera, scene, m_swapchain->extent());
+    m_impostor_pass->select(
+        cmd, m_current_image_index, camera, scene, m_swapchain->extent(), *m_lod_selector);
+    m_cluster_cull_pass->fill_commands(
+        cmd, m_current_image_index, camera, scene, *m_lod_selector);
+
+    const auto query_pool = m_querey_pools[m_current_image_index];
+    auto& graph = *m_render_graph;
+    graph.reset();
+
+    const auto color = graph.import_image(
+        "swapchain",
+        m_swapchain->images()[m_current_image_index],
         m_swapchain->format(),
         vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eColorAttachmentOptimal,
-        cmd);
-
-    m_quad_pass->fill_commands(cmd, camera, scene, {}, color_target);
-
-    if (m_debug_ui_settings.mesh_renderer) {
-      cmd.writeTimestamp(
-          vk::PipelineStageFlagBits::eTopOfPipe, m_querey_pools[m_current_image_index], 0);
-      m_early_depth_pass->fill_commands(cmd, camera, scene, depth_target);
-      cmd.writeTimestamp(
-          vk::PipelineStageFlagBits::eTopOfPipe, m_querey_pools[m_current_image_index], 1);
-
-      cmd.writeTimestamp(
-          vk::PipelineStageFlagBits::eTopOfPipe, m_querey_pools[m_current_image_index], 2);
-      m_mesh_renderer->fill_commands(cmd, camera, scene, color_target, depth_target);
-      cmd.writeTimestamp(
-          vk::PipelineStageFlagBits::eBottomOfPipe, m_querey_pools[m_current_image_index], 3);
+        vk::ImageLayout::ePresentSrcKHR);
+    const auto depth = graph.create_image(
+        "depth", {.format = depth_format, .extent = m_swapchain->extent()});
+
+    graph.add_pass("skybox", [&, color](vk::CommandBuffer cmd) {
+      m_quad_pass->fill_commands(
+          cmd, camera, scene, m_env_map_pass->diffuse_map(), {}, graph.image(color));
+    }).color_attachment(color, true);
+
+    // culled by the graph when nothing reads the depth
+    graph.add_pass("early depth", [&, depth](vk::CommandBuffer cmd) {
+      cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, query_pool, 0);
+      m_early_depth_pass->fill_commands(
+          cmd,
+          *m_recorder,
+          camera,
+          scene,
+          *m_lod_selector,
+          *m_cluster_cull_pass,
+          graph.image(depth));
+      cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, query_pool, 1);
+    }).depth_attachment(depth, true);
+
+    if (settings.mesh_renderer) {
+      graph.add_pass("pbr", [&, color, depth](vk::CommandBuffer cmd) {
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, query_pool, 2);
+        m_mesh_renderer->fill_commands(
+            cmd,
+            *m_recorder,
+            camera,
+            scene,
+            *m_lod_selector,
+            *m_cluster_cull_pass,
+            *m_env_map_pass,
+            graph.image(color),
+            graph.image(depth));
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool, 3);
+      })
+          .color_attachment(color)
+          .depth_read(depth);
+
+      graph.add_pass("impostors", [&, color, depth](vk::CommandBuffer cmd) {
+        m_impostor_pass->fill_commands(
+            cmd,
+            m_current_image_index,
+            camera,
+            *m_env_map_pass,
+            graph.image(color),
+            graph.image(depth));
+      })
+          .color_attachment(color)
+          .depth_attachment(depth);
+
+      // the occlusion tests of the next frame read it
+      graph.add_pass("depth pyramid", [&, depth](vk::CommandBuffer cmd) {
+        m_cluster_cull_pass->build_depth_pyramid(cmd, graph.image(depth));
+      })
+          .sampled(depth)
+          .side_effects();
     }
 
-    if (m_debug_ui_settings.imgui_renderer) {
-      cmd.writeTimestamp(
-          vk::PipelineStageFlagBits::eTopOfPipe, m_querey_pools[m_current_image_index], 4);
-
-      m_imgui_renderer->fill_commands(cmd, scene, color_target);
-
-      cmd.writeTimestamp(
-          vk::PipelineStageFlagBits::eBottomOfPipe, m_querey_pools[m_current_image_index], 5);
+    if (settings.imgui_renderer) {
+      graph.add_pass("imgui", [&, color](vk::CommandBuffer cmd) {
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, query_pool, 4);
+        m_imgui_renderer->fill_commands(cmd, frame.ui, graph.image(color));
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool, 5);
+      }).color_attachment(color);
     }
 
-    m_device->transition_image_layout(
-        color_target.image,
-        m_swapchain->format(),
-        vk::ImageLayout::eColorAttachmentOptimal,
-        vk::ImageLayout::ePresentSrcKHR,
-        cmd);
+    graph.compile();
+    graph.execute(cmd);
 
     cmd.end();
 
@@ -246,15 +287,39 @@ namespace geg {
     double timestamp_p = m_device->physical_device.getProperties().limits.timestampPeriod;
     double depth_start = double(timestamp_p * timestamps[0]) / 1000000;
     double depth_end = double(timestamp_p * timestamps[2]) / 1000000;
-    double depth_pass_delta = (depth_end - depth_start) / 1000;
 
     double mesh_start = double(timestamp_p * timestamps[4]) / 1000000;
     double mesh_end = double(timestamp_p * timestamps[6]) / 1000000;
-    double mesh_pass_delta = (mesh_end - mesh_start) / 1000;
 
     double imgui_start = double(timestamp_p * timestamps[8]) / 1000000;
     double imgui_end = double(timestamp_p * timestamps[10]) / 1000000;
-    double imgui_pass_delta = (imgui_end - imgui_start) / 1000;
+
+    {
+      std::lock_guard lock(m_frame_stats_mutex);
+      m_frame_stats.depth_pass = (depth_end - depth_start) / 1000;
+      m_frame_stats.mesh_pass = (mesh_end - mesh_start) / 1000;
+      m_frame_stats.imgui_pass = (imgui_end - imgui_start) / 1000;
+      m_frame_stats.image_index = m_current_image_index;
+    }
+
+    if (present_res == vk::Result::eSuboptimalKHR)
+      should_resize_swapchain = true;
+    else if (present_res != vk::Result::eSuccess)
+      GEG_CORE_ASSERT(false, "unkonwn error when presenting image");
+  }
+
+  void VulkanContext::draw_debug_ui() {
+    uint32_t image_index = 0;
+    double depth_pass_delta = 0;
+    double mesh_pass_delta = 0;
+    double imgui_pass_delta = 0;
+    {
+      std::lock_guard lock(m_frame_stats_mutex);
+      image_index = m_frame_stats.image_index;
+      depth_pass_delta = m_frame_stats.depth_pass;
+      mesh_pass_delta = m_frame_stats.mesh_pass;
+      imgui_pass_delta = m_frame_stats.imgui_pass;
+    }
 
     double time_before = 0;
 
@@ -300,63 +365,67 @@ namespace geg {
     m_profiler_graph.maxFrameTime = 1 / 1000.f;
     ImGui::End();
 
-    if (present_res == vk::Result::eSuboptimalKHR)
-      should_resize_swapchain = true;
-    else if (present_res != vk::Result::eSuccess)
-      GEG_CORE_ASSERT(false, "unkonwn error when presenting image");
-  }
-
-  void VulkanContext::draw_debug_ui() {
     ImGui::Begin("Vulkan Context");
 
     if (ImGui::CollapsingHeader("Info: "), ImGuiTreeNodeFlags_DefaultOpen) {
       auto props = m_device->physical_device.getProperties();
       ImGui::Text("Device name: %s", props.deviceName.data());
       ImGui::Text("Device type: %s", vk::to_string(props.deviceType).data());
+      ImGui::Text("Current dimensions: %d, %d", m_window_extent.width, m_window_extent.height);
+      ImGui::Text("Current image index: %d", image_index);
       ImGui::Text(
-          "Current dimensions: %d, %d", m_current_dimensions.width, m_current_dimensions.height);
-      ImGui::Text("Current image index: %d", m_current_image_index);
+          "Pipelines: %d (%d compiling)",
+          m_device->pipeline_cache().pipelines_count(),
+          m_device->pipeline_cache().pending_count());
     }
 
     ImGui::Spacing();
     if (ImGui::CollapsingHeader("settings: ", ImGuiTreeNodeFlags_DefaultOpen)) {
-      ImGui::DragFloat("Fov", &m_debug_ui_settings.fov, 0.1f, 0.1f, 180.f);
-      if (ImGui::BeginCombo("Present Mode: ", m_debug_ui_settings.present_mode_name.c_str())) {
+      ImGui::DragFloat("Fov", &m_settings.fov, 0.1f, 0.1f, 180.f);
+      if (ImGui::BeginCombo("Present Mode: ", m_present_mode_name.c_str())) {
         if (ImGui::Selectable("Fifo - Vsync")) {
-          m_debug_ui_settings.present_mode = vk::PresentModeKHR::eFifo;
-          m_debug_ui_settings.present_mode_name = "Fifo - Vsync";
+          m_settings.present_mode = vk::PresentModeKHR::eFifo;
+          m_present_mode_name = "Fifo - Vsync";
         }
-        if (m_debug_ui_settings.present_mode == vk::PresentModeKHR::eFifo)
+        if (m_settings.present_mode == vk::PresentModeKHR::eFifo)
           ImGui::SetItemDefaultFocus();
 
         if (ImGui::Selectable("Immediate")) {
-          m_debug_ui_settings.present_mode = vk::PresentModeKHR::eImmediate;
-          m_debug_ui_settings.present_mode_name = "Immediate";
+          m_settings.present_mode = vk::PresentModeKHR::eImmediate;
+          m_present_mode_name = "Immediate";
         }
-        if (m_debug_ui_settings.present_mode == vk::PresentModeKHR::eImmediate)
+        if (m_settings.present_mode == vk::PresentModeKHR::eImmediate)
           ImGui::SetItemDefaultFocus();
 
         if (ImGui::Selectable("Mailbox")) {
-          m_debug_ui_settings.present_mode = vk::PresentModeKHR::eMailbox;
-          m_debug_ui_settings.present_mode_name = "Mailbox";
+          m_settings.present_mode = vk::PresentModeKHR::eMailbox;
+          m_present_mode_name = "Mailbox";
         }
-        if (m_debug_ui_settings.present_mode == vk::PresentModeKHR::eMailbox)
+        if (m_settings.present_mode == vk::PresentModeKHR::eMailbox)
           ImGui::SetItemDefaultFocus();
 
         if (ImGui::Selectable("Fifo Relaxed")) {
-          m_debug_ui_settings.present_mode = vk::PresentModeKHR::eFifoRelaxed;
-          m_debug_ui_settings.present_mode_name = "Fifo Relaxed";
+          m_settings.present_mode = vk::PresentModeKHR::eFifoRelaxed;
+          m_present_mode_name = "Fifo Relaxed";
         }
-        if (m_debug_ui_settings.present_mode == vk::PresentModeKHR::eFifoRelaxed)
+        if (m_settings.present_mode == vk::PresentModeKHR::eFifoRelaxed)
           ImGui::SetItemDefaultFocus();
 
         ImGui::EndCombo();
       }
-      ImGui::Checkbox("Render ImGui", &m_debug_ui_settings.imgui_renderer);
-      ImGui::Checkbox("Render Geometry", &m_debug_ui_settings.mesh_renderer);
+      ImGui::Checkbox("Render ImGui", &m_settings.imgui_renderer);
+      ImGui::Checkbox("Render Geometry", &m_settings.mesh_renderer);
       ImGui::Separator();
       m_env_map_pass->render_debug_gui();
+      ImGui::Separator();
+      m_cluster_cull_pass->render_debug_gui();
+      ImGui::Separator();
+      m_lod_selector->render_debug_gui();
+      ImGui::Separator();
+      m_impostor_pass->render_debug_gui();
     }
+    m_render_graph->draw_debug_ui();
+    AssetManager::get().residency().draw_debug_ui();
     ImGui::End();
   }
 }    // namespace geg
@@ -1,19 +1,25 @@
 #pragma once
 
+#include <mutex>
+
 #include "assets/asset-manager.hpp"
 #include "imgui-renderer.hpp"
 #include "core/window.hpp"
 #include "events/events.hpp"
 #include "core/input.hpp"
-#include "renderer/camera.hpp"
+#include "renderer/frame-snapshot.hpp"
 
+#include "vulkan/cluster-cull-pass.hpp"
+#include "vulkan/lod-selector.hpp"
+#include "vulkan/impostor-pass.hpp"
 #include "vulkan/device.hpp"
 #include "vulkan/early-depth-pass.hpp"
 #include "vulkan/env-map-preprocessing-pass.hpp"
 #include "vulkan/fullscreen-quad-pass.hpp"
+#include "vulkan/parallel-recorder.hpp"
+#include "vulkan/render-graph.hpp"
 #include "vulkan/swapchain.hpp"
 #include "mesh-renderer.hpp"
-#include "ecs/scene.hpp"
 
 // legit profiler
 #include "ImGuiProfilerRenderer.h"
@@ -25,10 +31,15 @@ namespace geg {
     VulkanContext(std::shared_ptr<Window> window);
     ~VulkanContext();
 
-    void render(const Camera& camera, Scene* scene);
+    // main thread, draws the renderer ui and closes the imgui frame into the snapshot,
+    // call it after everything else that draws ui
+    void capture(FrameSnapshot& frame);
+    // render thread, reads nothing but the snapshot and the loaded assets
+    void render(const FrameSnapshot& frame);
+
+    // the render thread picks the new size up from the next snapshot
     bool resize(const WindowResizeEvent& new_dim) {
-      m_current_dimensions = vk::Extent2D{.width = new_dim.width(), .height = new_dim.height()};
-      should_resize_swapchain = true;
+      m_window_extent = vk::Extent2D{.width = new_dim.width(), .height = new_dim.height()};
 
       return false;
     };
@@ -36,7 +47,7 @@ namespace geg {
     bool toggle_ui(const KeyPressedEvent& event) {
       // ` key
       if (event.key_code() == input::KEY_GRAVE_ACCENT) {
-        m_debug_ui_settings.imgui_renderer = !m_debug_ui_settings.imgui_renderer;
+        m_settings.imgui_renderer = !m_settings.imgui_renderer;
       }
 
       return false;
@@ -49,16 +60,21 @@ namespace geg {
     void wait_until_free() { m_device->vkdevice.waitIdle(); };
 
   private:
-    void create_depth_resources();
     void draw_debug_ui();
 
+    // main thread state, handed to the render thread through the snapshots
+    RenderSettings m_settings = {};
+    std::string m_present_mode_name = "Fifo - VSync";
+    vk::Extent2D m_window_extent;
+
+    // written by the render thread after every frame, read by the debug ui
     struct {
-      bool imgui_renderer = true;
-      bool mesh_renderer = true;
-      vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
-      std::string present_mode_name = "Fifo - VSync";
-      float fov = 45.0f;
-    } m_debug_ui_settings = {};
+      double depth_pass = 0;
+      double mesh_pass = 0;
+      double imgui_pass = 0;
+      uint32_t image_index = 0;
+    } m_frame_stats;
+    std::mutex m_frame_stats_mutex;
 
     std::shared_ptr<Window> m_window;
 
@@ -67,18 +83,22 @@ namespace geg {
     vk::Extent2D m_current_dimensions;
     uint32_t m_current_image_index = 0;
 
-    std::pair<vk::Image, VmaAllocation> m_depth_image = {nullptr, nullptr};
-    vk::ImageView m_depth_image_view;
-
+    std::unique_ptr<vulkan::ParallelRecorder> m_recorder;
+    std::unique_ptr<vulkan::RenderGraph> m_render_graph;
+    std::unique_ptr<vulkan::LodSelector> m_lod_selector;
+    std::unique_ptr<vulkan::ClusterCullPass> m_cluster_cull_pass;
     std::unique_ptr<vulkan::DepthPass> m_early_depth_pass;
     std::unique_ptr<vulkan::EnvMapPreprocessPass> m_env_map_pass;
     std::unique_ptr<vulkan::MeshRenderer> m_mesh_renderer;
+    std::unique_ptr<vulkan::ImpostorPass> m_impostor_pass;
     std::unique_ptr<vulkan::ImguiRenderer> m_imgui_renderer;
     std::unique_ptr<vulkan::QuadPass> m_quad_pass;
 
     vk::Semaphore m_present_semaphore;
     vk::Semaphore m_render_semaphore;
     std::vector<vk::Fence> m_swapchain_image_fences;
+    // the device frame last submitted with each image, retired once its fence is waited on
+    std::vector<uint64_t> m_image_frames;
     std::vector<vk::CommandBuffer> m_command_buffers;
     std::vector<vk::QueryPool> m_querey_pools;
     ImGuiUtils::ProfilerGraph m_profiler_graph{500};
@@ -87,4 +107,3 @@ namespace geg {
 
   }; // namespace geg
 }
-        
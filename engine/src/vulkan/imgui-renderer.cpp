@@ -58,23 +58,25 @@ namespace geg::vulkan {
     GEG_CORE_WARN("Imgui renderer destroyed");
   }
 
-  void ImguiRenderer::fill_commands(
-      const vk::CommandBuffer& cmd, Scene* scene, const Image& target) {
+  void ImguiRenderer::end_frame(UiSnapshot& ui, vk::Extent2D extent) {
     ImGuiIO& io = ImGui::GetIO();
-    io.DisplaySize =
-        ImVec2(static_cast<float>(target.extent.width), static_cast<float>(target.extent.height));
+    io.DisplaySize = ImVec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
 
+    // platform windows would be rendered and submitted from here, off the render thread,
+    // so multi viewports have to stay disabled
     ImGui::Render();
-    if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
-      ImGui::UpdatePlatformWindows();
-      ImGui::RenderPlatformWindowsDefault();
-    }
+    ui.capture(ImGui::GetDrawData());
+
+    ImGui::NewFrame();
+  }
 
+  void ImguiRenderer::fill_commands(
+      const vk::CommandBuffer& cmd, const UiSnapshot& ui, const Image& target) {
     vk::RenderingAttachmentInfoKHR attachment_info{};
     attachment_info.imageView = target.view;
     attachment_info.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
-    attachment_info.loadOp = vk::AttachmentLoadOp::eLoad;
-    attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
+    attachment_info.loadOp = target.load_op;
+    attachment_info.storeOp = target.store_op;
 
     vk::RenderingInfoKHR rendering_info{};
     rendering_info.renderArea.extent = target.extent;
@@ -83,10 +85,8 @@ namespace geg::vulkan {
     rendering_info.layerCount = 1;
 
     cmd.beginRendering(rendering_info);
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+    if (auto* draw_data = ui.draw_data()) ImGui_ImplVulkan_RenderDrawData(draw_data, cmd);
     cmd.endRendering();
-
-    ImGui::NewFrame();
   }
 
   void ImguiRenderer::create_descriptor_pool() {
@@ -2,8 +2,7 @@
 
 #include "device.hpp"
 #include "swapchain.hpp"
-#include "renderer/camera.hpp"
-#include "ecs/scene.hpp"
+#include "renderer/frame-snapshot.hpp"
 
 namespace geg::vulkan {
   class ImguiRenderer {
@@ -11,7 +10,10 @@ namespace geg::vulkan {
     ImguiRenderer(const std::shared_ptr<Device>& device, vk::Format img_format, uint32_t img_count);
     ~ImguiRenderer();
 
-    void fill_commands(const vk::CommandBuffer& cmd, Scene* scene, const Image& target);
+    // main thread, closes the imgui frame, copies it out and starts the next one
+    void end_frame(UiSnapshot& ui, vk::Extent2D extent);
+    // render thread, only reads the copied draw lists
+    void fill_commands(const vk::CommandBuffer& cmd, const UiSnapshot& ui, const Image& target);
 
   private:
     void create_descriptor_pool();
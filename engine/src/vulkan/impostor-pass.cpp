@@ -0,0 +1,576 @@
+#include "impostor-pass.hpp"
+
+#include <algorithm>
+
+#include "imgui.h"
+
+namespace geg::vulkan {
+  namespace {
+    constexpr uint32_t k_atlas_size = k_impostor_frames * k_impostor_frame_size;
+    // albedo, normal and depth, the outputs of impostor-bake.glsl
+    constexpr std::array<vk::Format, 3> k_atlas_formats = {
+        vk::Format::eR8G8B8A8Unorm,
+        vk::Format::eR8G8B8A8Unorm,
+        vk::Format::eR16Sfloat,
+    };
+    constexpr vk::Format k_bake_depth_format = vk::Format::eD32Sfloat;
+
+    // same as impostor.glsl
+    glm::vec3 hemi_oct_decode(glm::vec2 e) {
+      glm::vec3 d((e.x + e.y) * 0.5f, 0.0f, (e.x - e.y) * 0.5f);
+      d.y = 1.0f - std::abs(d.x) - std::abs(d.z);
+      return glm::normalize(d);
+    }
+
+    vk::ImageAspectFlags aspect_of(vk::Format format) {
+      return format == k_bake_depth_format ? vk::ImageAspectFlagBits::eDepth :
+                                             vk::ImageAspectFlagBits::eColor;
+    }
+
+    void image_barrier(
+        const vk::CommandBuffer& cmd,
+        vk::Image image,
+        vk::ImageAspectFlags aspect,
+        vk::ImageLayout old_layout,
+        vk::ImageLayout new_layout,
+        vk::PipelineStageFlags2 src_stages,
+        vk::AccessFlags2 src_access,
+        vk::PipelineStageFlags2 dst_stages,
+        vk::AccessFlags2 dst_access) {
+      const vk::ImageMemoryBarrier2 barrier{
+          .srcStageMask = src_stages,
+          .srcAccessMask = src_access,
+          .dstStageMask = dst_stages,
+          .dstAccessMask = dst_access,
+          .oldLayout = old_layout,
+          .newLayout = new_layout,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = image,
+          .subresourceRange{
+              .aspectMask = aspect,
+              .baseMipLevel = 0,
+              .levelCount = 1,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+          .imageMemoryBarrierCount = 1,
+          .pImageMemoryBarriers = &barrier,
+      });
+    }
+  }    // namespace
+
+  ImpostorPass::ImpostorPass(
+      const std::shared_ptr<Device>& device, vk::Format img_format, uint32_t frames_count):
+      m_device(device), m_frames_count(frames_count) {
+    init_pipelines(img_format);
+
+    const vk::SamplerCreateInfo sampler_info{
+        .magFilter = vk::Filter::eLinear,
+        .minFilter = vk::Filter::eLinear,
+        .mipmapMode = vk::SamplerMipmapMode::eNearest,
+        .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = false,
+        .maxAnisotropy = 0,
+        .compareEnable = false,
+        .compareOp = vk::CompareOp::eAlways,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = vk::BorderColor::eFloatTransparentBlack,
+        .unnormalizedCoordinates = false,
+    };
+    m_sampler = m_device->vkdevice.createSampler(sampler_info);
+
+    m_bake_depth = create_target(
+        k_bake_depth_format, vk::ImageUsageFlagBits::eDepthStencilAttachment);
+  }
+
+  ImpostorPass::~ImpostorPass() {
+    for (auto& [key, impostor] : m_impostors)
+      destroy_impostor(impostor);
+    destroy_target(m_bake_depth);
+    m_device->free_descriptor_set(m_frame_set);
+    m_device->destroy_sampler(m_sampler);
+  }
+
+  void ImpostorPass::render_debug_gui() {
+    {
+      std::lock_guard lock(m_settings_mutex);
+      ImGui::Checkbox("impostors", &m_settings.enabled);
+      ImGui::DragFloat("impostor below (pixels)", &m_settings.max_pixels, 0.5f, 1.0f, 256.0f);
+    }
+    ImGui::Text("impostors baked: %u / %u", m_baked_count.load(), k_max_impostors);
+    ImGui::Text("meshes drawn as impostors: %u", m_drawn_count.load());
+  }
+
+  void ImpostorPass::select(
+      const vk::CommandBuffer& cmd,
+      uint32_t frame,
+      const CameraSnapshot& camera,
+      const SceneSnapshot& scene,
+      vk::Extent2D extent,
+      LodSelector& lods) {
+    Settings settings;
+    {
+      std::lock_guard lock(m_settings_mutex);
+      settings = m_settings;
+    }
+
+    m_draws.clear();
+    // the meshes are drawn as usual until the impostors' pipeline is compiled
+    if (!settings.enabled || !m_device->pipeline_cache().get(m_pipeline_state)) {
+      m_drawn_count = 0;
+      return;
+    }
+
+    // same as LodSelector
+    const float pixels_per_unit = std::abs(projection[1][1]) * float(extent.height) * 0.5f;
+    constexpr float k_min_distance = 0.1f;
+
+    m_frame_index++;
+    auto& asset_manager = AssetManager::get();
+    for (auto it = m_impostors.begin(); it != m_impostors.end();) {
+      if (asset_manager.has_mesh(it->second.mesh) &&
+          asset_manager.has_material(it->second.material)) {
+        ++it;
+        continue;
+      }
+
+      destroy_impostor(it->second);
+      it = m_impostors.erase(it);
+    }
+
+    auto& residency = asset_manager.residency();
+    bool baked = false;
+    for (size_t i = 0; i < scene.meshes.size(); i++) {
+      const auto& mesh = scene.meshes[i];
+      const auto* mesh_data = residency.use(mesh.mesh);
+      if (!mesh_data || mesh_data->radius <= 0) continue;
+
+      const glm::mat3 basis(mesh.model);
+      const float scale = std::max(
+          glm::length(basis[0]), std::max(glm::length(basis[1]), glm::length(basis[2])));
+      const glm::vec3 center = mesh.model * glm::vec4(mesh_data->center, 1.0f);
+      const float distance = std::max(glm::length(center - camera.position), k_min_distance);
+      // the sphere's diameter
+      const float pixels = 2.0f * mesh_data->radius * scale * pixels_per_unit / distance;
+      if (pixels >= settings.max_pixels) continue;
+
+      const auto& material = scene.materials[mesh.material.index];
+      const auto material_hash = material.content_hash();
+      const auto key = std::pair(mesh.mesh.key(), mesh.material.key());
+      auto it = m_impostors.find(key);
+      // the material was edited since, the atlas is baked again
+      if (it != m_impostors.end() && it->second.material_hash != material_hash) {
+        destroy_impostor(it->second);
+        m_impostors.erase(it);
+        it = m_impostors.end();
+      }
+
+      if (it == m_impostors.end()) {
+        if (baked) continue;
+
+        // full, the atlas drawn longest ago goes once the bake worked, the ones drawn last
+        // frame are likely drawn again so they're kept
+        auto evicted = m_impostors.end();
+        if (m_impostors.size() >= k_max_impostors) {
+          evicted = std::min_element(
+              m_impostors.begin(), m_impostors.end(), [](const auto& a, const auto& b) {
+                return a.second.last_used < b.second.last_used;
+              });
+          if (evicted->second.last_used + 1 >= m_frame_index) continue;
+        }
+
+        Impostor impostor{
+            .mesh = mesh.mesh,
+            .material = mesh.material,
+            .material_hash = material_hash,
+        };
+        if (!bake(cmd, frame, *mesh_data, material, impostor)) continue;
+        if (evicted != m_impostors.end()) {
+          destroy_impostor(evicted->second);
+          m_impostors.erase(evicted);
+        }
+        it = m_impostors.emplace(key, impostor).first;
+        baked = true;
+      }
+
+      it->second.last_used = m_frame_index;
+
+      lods.use_impostor(i);
+      m_draws.push_back({
+          .push =
+              {
+                  .model = mesh.model,
+                  .center_radius = glm::vec4(mesh_data->center, mesh_data->radius),
+              },
+          .atlas = it->second.set,
+      });
+    }
+
+    // entities sharing a mesh and material bind their atlas once
+    std::stable_sort(m_draws.begin(), m_draws.end(), [](const DrawItem& a, const DrawItem& b) {
+      return VkDescriptorSet(a.atlas) < VkDescriptorSet(b.atlas);
+    });
+
+    m_drawn_count = static_cast<uint32_t>(m_draws.size());
+    m_baked_count = static_cast<uint32_t>(m_impostors.size());
+  }
+
+  void ImpostorPass::fill_commands(
+      const vk::CommandBuffer& cmd,
+      uint32_t frame,
+      const CameraSnapshot& camera,
+      const EnvMapPreprocessPass& env_maps,
+      const Image& color_target,
+      const Image& depth_target) {
+    const vk::RenderingAttachmentInfoKHR color_attachment{
+        .imageView = color_target.view,
+        .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+        .loadOp = color_target.load_op,
+        .storeOp = color_target.store_op,
+    };
+    const vk::RenderingAttachmentInfoKHR depth_attachment{
+        .imageView = depth_target.view,
+        .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+        .loadOp = depth_target.load_op,
+        .storeOp = depth_target.store_op,
+        .clearValue = vk::ClearValue{.depthStencil = {.depth = 1.0f, .stencil = 0}},
+    };
+    const vk::RenderingInfoKHR rendering_info{
+        .renderArea = {.extent = color_target.extent},
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment,
+        .pDepthAttachment = &depth_attachment,
+    };
+
+    // nothing to draw or still compiling, the attachments are left as they are
+    const auto pipeline = m_device->pipeline_cache().get(m_pipeline_state);
+    if (!pipeline || m_draws.empty()) {
+      cmd.beginRendering(rendering_info);
+      cmd.endRendering();
+      return;
+    }
+
+    global_data.proj_view = projection * camera.view;
+    global_data.cam_pos = glm::vec4(camera.position, 1.0f);
+    m_global_ubo.write_at_frame(&global_data, sizeof(global_data), frame);
+
+    const auto env_info = env_maps.diffuse_map().descriptor_info();
+    if (!m_frame_set || env_info != m_frame_set_image) {
+      m_device->free_descriptor_set(m_frame_set);
+      auto ubo_info = m_global_ubo.descriptor_info();
+      auto image_info = env_info;
+      const auto stages = m_shader.stage_flags;
+      m_frame_set =
+          m_device->build_descriptor()
+              .bind_buffer(0, &ubo_info, vk::DescriptorType::eUniformBufferDynamic, stages)
+              .bind_image(1, &image_info, vk::DescriptorType::eCombinedImageSampler, stages)
+              .build()
+              .value()
+              .first;
+      m_frame_set_image = env_info;
+    }
+
+    const auto layout = m_pipeline_state.layout;
+    cmd.beginRendering(rendering_info);
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    cmd.setViewport(
+        0,
+        vk::Viewport{
+            .x = 0,
+            .y = 0,
+            .width = static_cast<float>(color_target.extent.width),
+            .height = static_cast<float>(color_target.extent.height),
+            .minDepth = 0,
+            .maxDepth = 1,
+        });
+    cmd.setScissor(0, vk::Rect2D{.offset = {}, .extent = color_target.extent});
+    cmd.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics,
+        layout,
+        0,
+        {m_frame_set},
+        {m_global_ubo.frame_offset(frame)});
+
+    vk::DescriptorSet bound_atlas;
+    for (const auto& draw : m_draws) {
+      if (draw.atlas != bound_atlas) {
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, {draw.atlas}, {});
+        bound_atlas = draw.atlas;
+      }
+      cmd.pushConstants(layout, m_shader.stage_flags, 0, sizeof(draw.push), &draw.push);
+      cmd.draw(4, 1, 0, 0);
+    }
+    cmd.endRendering();
+  }
+
+  bool ImpostorPass::bake(
+      const vk::CommandBuffer& cmd,
+      uint32_t frame,
+      const Mesh& mesh,
+      const Material& material,
+      Impostor& impostor) {
+    const auto pipeline = m_device->pipeline_cache().get(m_bake_state);
+    if (!pipeline) return false;
+
+    // a texture baked while still queued would stay missing from the atlas
+    auto& residency = AssetManager::get().residency();
+    std::array<vk::DescriptorImageInfo, 4> images;
+    const std::array<TextureId, 4> textures = {
+        material.albedo,
+        material.metallic_roughness,
+        material.normal_map,
+        material.emissive_map,
+    };
+    for (size_t i = 0; i < textures.size(); i++) {
+      if (!textures[i]) {
+        images[i] = m_dummy_tex.descriptor_info();
+        continue;
+      }
+      const auto* texture = residency.use(textures[i]);
+      if (!texture) return false;
+      images[i] = texture->descriptor_info();
+    }
+
+    material_data.color_factor = glm::vec4(material.color_factor, 1.0f);
+    material_data.emissive_factor = glm::vec4(material.emissive_factor, 1.0f);
+    material_data.metallic_factor = material.metallic_factor;
+    material_data.roughness_factor = material.roughness_factor;
+    material_data.ao = material.AO;
+    m_material_ubo.write_at_frame(&material_data, sizeof(material_data), frame);
+
+    auto ubo_info = m_material_ubo.descriptor_info();
+    const auto stages = m_bake_shader.stage_flags;
+    constexpr auto sampler = vk::DescriptorType::eCombinedImageSampler;
+    const auto material_set =
+        m_device->build_descriptor()
+            .bind_buffer(0, &ubo_info, vk::DescriptorType::eUniformBufferDynamic, stages)
+            .bind_image(1, &images[0], sampler, stages)
+            .bind_image(2, &images[1], sampler, stages)
+            .bind_image(3, &images[2], sampler, stages)
+            .bind_image(4, &images[3], sampler, stages)
+            .build()
+            .value()
+            .first;
+
+    const auto usage =
+        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
+    for (size_t i = 0; i < impostor.atlas.size(); i++) {
+      impostor.atlas[i] = create_target(k_atlas_formats[i], usage);
+      image_barrier(
+          cmd,
+          impostor.atlas[i].image,
+          vk::ImageAspectFlagBits::eColor,
+          vk::ImageLayout::eUndefined,
+          vk::ImageLayout::eColorAttachmentOptimal,
+          vk::PipelineStageFlagBits2::eNone,
+          vk::AccessFlagBits2::eNone,
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+          vk::AccessFlagBits2::eColorAttachmentWrite);
+    }
+    // the last bake may still be testing against it
+    image_barrier(
+        cmd,
+        m_bake_depth.image,
+        vk::ImageAspectFlagBits::eDepth,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eDepthAttachmentOptimal,
+        vk::PipelineStageFlagBits2::eLateFragmentTests,
+        vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+        vk::PipelineStageFlagBits2::eEarlyFragmentTests,
+        vk::AccessFlagBits2::eDepthStencilAttachmentWrite);
+
+    std::array<vk::RenderingAttachmentInfoKHR, 3> color_attachments;
+    for (size_t i = 0; i < color_attachments.size(); i++)
+      color_attachments[i] = {
+          .imageView = impostor.atlas[i].view,
+          .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+          .loadOp = vk::AttachmentLoadOp::eClear,
+          .storeOp = vk::AttachmentStoreOp::eStore,
+          // an albedo alpha of 0 is no coverage
+          .clearValue = vk::ClearValue{},
+      };
+    const vk::RenderingAttachmentInfoKHR depth_attachment{
+        .imageView = m_bake_depth.view,
+        .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+        .loadOp = vk::AttachmentLoadOp::eClear,
+        .storeOp = vk::AttachmentStoreOp::eDontCare,
+        .clearValue = vk::ClearValue{.depthStencil = {.depth = 1.0f, .stencil = 0}},
+    };
+    cmd.beginRendering(vk::RenderingInfoKHR{
+        .renderArea = {.extent = {k_atlas_size, k_atlas_size}},
+        .layerCount = 1,
+        .colorAttachmentCount = static_cast<uint32_t>(color_attachments.size()),
+        .pColorAttachments = color_attachments.data(),
+        .pDepthAttachment = &depth_attachment,
+    });
+
+    const auto layout = m_bake_state.layout;
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    // set 0 is empty, the material and the geometry use pbr.glsl's numbers
+    cmd.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics,
+        layout,
+        1,
+        {material_set, mesh.descriptor_set},
+        {m_material_ubo.frame_offset(frame)});
+    cmd.bindIndexBuffer(mesh.buffer, mesh.index_offset, mesh.index_type());
+
+    // one orthographic view of the bounding sphere per frame, from the direction at the
+    // frame's center, the basis is rebuilt the same way by impostor.glsl
+    const auto& lod0 = mesh.lods()[0];
+    for (uint32_t y = 0; y < k_impostor_frames; y++) {
+      for (uint32_t x = 0; x < k_impostor_frames; x++) {
+        const glm::vec2 e = (glm::vec2(x, y) + 0.5f) / float(k_impostor_frames) * 2.0f - 1.0f;
+        const glm::vec3 forward = hemi_oct_decode(e);
+        const glm::vec3 right = glm::normalize(glm::cross(glm::vec3(0, 1, 0), forward));
+        const glm::vec3 up = glm::cross(forward, right);
+        const std::array<glm::vec4, 4> push = {
+            glm::vec4(mesh.center, mesh.radius),
+            glm::vec4(right, 0.0f),
+            glm::vec4(up, 0.0f),
+            glm::vec4(forward, 0.0f),
+        };
+
+        cmd.setViewport(
+            0,
+            vk::Viewport{
+                .x = float(x * k_impostor_frame_size),
+                .y = float(y * k_impostor_frame_size),
+                .width = float(k_impostor_frame_size),
+                .height = float(k_impostor_frame_size),
+                .minDepth = 0,
+                .maxDepth = 1,
+            });
+        cmd.setScissor(
+            0,
+            vk::Rect2D{
+                .offset = {int32_t(x * k_impostor_frame_size), int32_t(y * k_impostor_frame_size)},
+                .extent = {k_impostor_frame_size, k_impostor_frame_size},
+            });
+        cmd.pushConstants(layout, stages, 0, sizeof(push), push.data());
+        cmd.drawIndexed(lod0.index_count, 1, lod0.first_index, 0, 0);
+      }
+    }
+    cmd.endRendering();
+
+    // the frame that baked it samples it right away
+    for (const auto& target : impostor.atlas)
+      image_barrier(
+          cmd,
+          target.image,
+          vk::ImageAspectFlagBits::eColor,
+          vk::ImageLayout::eColorAttachmentOptimal,
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+          vk::AccessFlagBits2::eColorAttachmentWrite,
+          vk::PipelineStageFlagBits2::eFragmentShader,
+          vk::AccessFlagBits2::eShaderSampledRead);
+    // only the recorded commands use it
+    m_device->free_descriptor_set(material_set);
+
+    std::array<vk::DescriptorImageInfo, 3> atlas_infos;
+    for (size_t i = 0; i < atlas_infos.size(); i++)
+      atlas_infos[i] = {
+          .sampler = m_sampler,
+          .imageView = impostor.atlas[i].view,
+          .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+      };
+    const auto draw_stages = m_shader.stage_flags;
+    impostor.set = m_device->build_descriptor()
+                       .bind_image(0, &atlas_infos[0], sampler, draw_stages)
+                       .bind_image(1, &atlas_infos[1], sampler, draw_stages)
+                       .bind_image(2, &atlas_infos[2], sampler, draw_stages)
+                       .build()
+                       .value()
+                       .first;
+
+    return true;
+  }
+
+  void ImpostorPass::init_pipelines(vk::Format img_format) {
+    m_bake_state = {
+        .vert_module = m_bake_shader.vert_module,
+        .frag_module = m_bake_shader.frag_module,
+        .layout = m_bake_shader.pipeline_layout(),
+        .cull_mode = vk::CullModeFlagBits::eBack,
+        .front_face = vk::FrontFace::eCounterClockwise,
+        .depth_test = true,
+        .depth_write = true,
+        .depth_compare_op = vk::CompareOp::eLess,
+        .color_formats = std::vector(k_atlas_formats.begin(), k_atlas_formats.end()),
+        .depth_format = k_bake_depth_format,
+    };
+    m_device->pipeline_cache().request(m_bake_state);
+
+    // the depth is the main pass', pbr only reads it
+    m_pipeline_state = {
+        .vert_module = m_shader.vert_module,
+        .frag_module = m_shader.frag_module,
+        .layout = m_shader.pipeline_layout(),
+        .topology = vk::PrimitiveTopology::eTriangleStrip,
+        .cull_mode = vk::CullModeFlagBits::eNone,
+        .depth_test = true,
+        .depth_write = true,
+        .depth_compare_op = vk::CompareOp::eLess,
+        .color_formats = {img_format},
+        .depth_format = vk::Format::eD32SfloatS8Uint,
+    };
+    m_device->pipeline_cache().request(m_pipeline_state);
+  }
+
+  // frames in flight may still sample it, the device destroys it once they are done
+  void ImpostorPass::destroy_impostor(Impostor& impostor) {
+    m_device->free_descriptor_set(impostor.set);
+    for (auto& target : impostor.atlas)
+      destroy_target(target);
+  }
+
+  ImpostorPass::Target ImpostorPass::create_target(vk::Format format, vk::ImageUsageFlags usage) {
+    const auto image_info = static_cast<VkImageCreateInfo>(vk::ImageCreateInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = format,
+        .extent = {.width = k_atlas_size, .height = k_atlas_size, .depth = 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = usage,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    });
+    const VmaAllocationCreateInfo alloc_info = {.usage = VMA_MEMORY_USAGE_GPU_ONLY};
+
+    Target target;
+    VkImage vk_img;
+    vmaCreateImage(m_device->allocator, &image_info, &alloc_info, &vk_img, &target.alloc, nullptr);
+    target.image = vk_img;
+    target.view = m_device->vkdevice.createImageView({
+        .image = target.image,
+        .viewType = vk::ImageViewType::e2D,
+        .format = format,
+        .subresourceRange{
+            .aspectMask = aspect_of(format),
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    });
+
+    return target;
+  }
+
+  void ImpostorPass::destroy_target(Target& target) {
+    m_device->destroy_image_view(target.view);
+    m_device->destroy_image(target.image, target.alloc);
+    target = {};
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "pch.hpp"
+#include "assets/asset-manager.hpp"
+#include "renderer/frame-snapshot.hpp"
+#include "vulkan/device.hpp"
+#include "vulkan/env-map-preprocessing-pass.hpp"
+#include "vulkan/lod-selector.hpp"
+#include "vulkan/shader.hpp"
+#include "vulkan/texture.hpp"
+#include "vulkan/uniform-buffer.hpp"
+#include "vk_mem_alloc.h"
+
+namespace geg::vulkan {
+  // frames per side of an atlas, FRAMES in impostor.glsl
+  inline constexpr uint32_t k_impostor_frames = 8;
+  // pixels per side of one frame, about the size the impostors are drawn at
+  inline constexpr uint32_t k_impostor_frame_size = 32;
+  // every atlas takes 10 bytes per texel, past that the one drawn longest ago makes room
+  inline constexpr uint32_t k_max_impostors = 128;
+
+  // meshes covering only a few pixels are drawn as one quad instead, the quad samples an
+  // atlas the mesh was rendered into from a hemisphere of directions (hemi-octahedral
+  // mapping) with albedo, mesh space normals and depth so it's lit and depth tested about
+  // like the mesh would be
+  // an atlas is baked per mesh and material the first frame it's needed, once the material's
+  // textures are resident and at most one per frame, the mesh is drawn as usual until then
+  class ImpostorPass {
+  public:
+    // frames_count is how many frames can be in flight, the swapchain's image count
+    ImpostorPass(
+        const std::shared_ptr<Device>& device, vk::Format img_format, uint32_t frames_count);
+    ~ImpostorPass();
+
+    // after LodSelector::select and before the passes that draw the meshes, marks the
+    // meshes it draws in lods so the other passes skip them, bakes outside of any rendering
+    // frame picks the uniform buffer slots, the frames before it may still be reading theirs
+    void select(
+        const vk::CommandBuffer& cmd,
+        uint32_t frame,
+        const CameraSnapshot& camera,
+        const SceneSnapshot& scene,
+        vk::Extent2D extent,
+        LodSelector& lods);
+
+    // after the pbr pass, writes the depth of the surfaces the atlases saw
+    void fill_commands(
+        const vk::CommandBuffer& cmd,
+        uint32_t frame,
+        const CameraSnapshot& camera,
+        const EnvMapPreprocessPass& env_maps,
+        const Image& color_target,
+        const Image& depth_target);
+
+    // main thread, guarded against the render thread reading the settings
+    void render_debug_gui();
+
+    glm::mat4 projection = glm::mat4(1);
+
+  private:
+    std::shared_ptr<Device> m_device;
+    uint32_t m_frames_count;
+
+    Shader m_bake_shader{m_device, "assets/shaders/impostor-bake.glsl", "impostor bake"};
+    Shader m_shader{m_device, "assets/shaders/impostor.glsl", "impostor"};
+    GraphicsPipelineState m_bake_state;
+    GraphicsPipelineState m_pipeline_state;
+
+    struct Target {
+      vk::Image image;
+      VmaAllocation alloc = nullptr;
+      vk::ImageView view;
+    };
+
+    // albedo, normal and depth, in the shader read only layout once baked
+    struct Impostor {
+      std::array<Target, 3> atlas;
+      vk::DescriptorSet set;
+      // dropped once either is unloaded
+      MeshId mesh;
+      MaterialId material;
+      // the material it was baked with, update_material edits materials under the same handle
+      uint64_t material_hash = 0;
+      // m_frame_index of the last select that drew it
+      uint64_t last_used = 0;
+    };
+    // keyed by the mesh's then the material's handle
+    std::map<std::pair<uint64_t, uint64_t>, Impostor> m_impostors;
+    uint64_t m_frame_index = 0;
+    // the depth test of the bakes, shared by all of them
+    Target m_bake_depth;
+    vk::Sampler m_sampler;
+
+    // matches MaterialUbo in pbr.glsl, one slot per frame is enough with one bake per frame
+    struct {
+      glm::vec4 color_factor;
+      glm::vec4 emissive_factor;
+      float metallic_factor = 0.0f;
+      float roughness_factor = 0.0f;
+      float ao = 1.0f;
+      float _padding;
+    } material_data{};
+    UniformBuffer m_material_ubo{m_device, sizeof(material_data), m_frames_count};
+    Texture m_dummy_tex{m_device, glm::vec<4, uint8_t>{255}};
+
+    // matches GlobalUbo in impostor.glsl
+    struct {
+      glm::mat4 proj_view;
+      glm::vec4 cam_pos;
+    } global_data{};
+    UniformBuffer m_global_ubo{m_device, sizeof(global_data), m_frames_count};
+
+    // set 0, rebuilt only when the diffuse env map changes
+    vk::DescriptorSet m_frame_set;
+    vk::DescriptorImageInfo m_frame_set_image{};
+
+    struct PushData {
+      glm::mat4 model;
+      glm::vec4 center_radius;
+    };
+    struct DrawItem {
+      PushData push;
+      vk::DescriptorSet atlas;
+    };
+    std::vector<DrawItem> m_draws;
+
+    struct Settings {
+      bool enabled = true;
+      // meshes whose bounding sphere is less tall than that on screen
+      float max_pixels = 32.0f;
+    } m_settings;
+    std::mutex m_settings_mutex;
+    std::atomic<uint32_t> m_drawn_count = 0;
+    std::atomic<uint32_t> m_baked_count = 0;
+
+    void init_pipelines(vk::Format img_format);
+    // false when the pipeline is still compiling or a texture isn't resident yet
+    bool bake(
+        const vk::CommandBuffer& cmd,
+        uint32_t frame,
+        const Mesh& mesh,
+        const Material& material,
+        Impostor& impostor);
+    void destroy_impostor(Impostor& impostor);
+    Target create_target(vk::Format format, vk::ImageUsageFlags usage);
+    void destroy_target(Target& target);
+  };
+}    // namespace geg::vulkan
@@ -0,0 +1,68 @@
+#include "lod-selector.hpp"
+
+#include "assets/asset-manager.hpp"
+#include "imgui.h"
+
+namespace geg::vulkan {
+  void LodSelector::render_debug_gui() {
+    {
+      std::lock_guard lock(m_settings_mutex);
+      ImGui::Checkbox("lod selection", &m_settings.enabled);
+      ImGui::DragFloat("max lod error (pixels)", &m_settings.max_pixel_error, 0.05f, 0.1f, 16.0f);
+      ImGui::SliderInt(
+          "forced lod", &m_settings.forced_lod, -1, static_cast<int>(k_max_lods) - 1);
+    }
+    for (uint32_t i = 0; i < k_max_lods; i++)
+      ImGui::Text("lod %u: %u meshes", i, m_lod_counts[i].load());
+  }
+
+  void LodSelector::select(
+      const CameraSnapshot& camera, const SceneSnapshot& scene, vk::Extent2D extent) {
+    Settings settings;
+    {
+      std::lock_guard lock(m_settings_mutex);
+      settings = m_settings;
+    }
+
+    // an error of one mesh unit at one unit away covers this many pixels, the projection's
+    // y scale is 1 / tan(fov / 2)
+    const float pixels_per_unit = std::abs(projection[1][1]) * float(extent.height) * 0.5f;
+    // the near plane of the projection, nothing gets closer than that
+    constexpr float k_min_distance = 0.1f;
+
+    auto& residency = AssetManager::get().residency();
+    std::array<uint32_t, k_max_lods> counts{};
+
+    m_lods.assign(scene.meshes.size(), 0);
+    for (size_t i = 0; i < scene.meshes.size(); i++) {
+      const auto& mesh = scene.meshes[i];
+      const auto* mesh_data = residency.use(mesh.mesh);
+      if (!mesh_data) continue;
+
+      const auto lods = mesh_data->lods();
+      const auto coarsest = static_cast<uint32_t>(lods.size() - 1);
+      uint32_t lod = 0;
+      if (settings.forced_lod >= 0) {
+        lod = std::min(static_cast<uint32_t>(settings.forced_lod), coarsest);
+      } else if (settings.enabled && coarsest > 0) {
+        // the errors are in mesh units, the largest axis scale bounds how much they grow
+        const glm::mat3 basis(mesh.model);
+        const float scale = std::max(
+            glm::length(basis[0]), std::max(glm::length(basis[1]), glm::length(basis[2])));
+        const glm::vec3 center = mesh.model * glm::vec4(mesh_data->center, 1.0f);
+        const float distance = std::max(
+            glm::length(center - camera.position) - mesh_data->radius * scale, k_min_distance);
+        const float max_error = settings.max_pixel_error * distance / pixels_per_unit;
+
+        while (lod < coarsest && lods[lod + 1].error * scale <= max_error)
+          lod++;
+      }
+
+      m_lods[i] = lod;
+      counts[lod]++;
+    }
+
+    for (uint32_t i = 0; i < k_max_lods; i++)
+      m_lod_counts[i] = counts[i];
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#include "pch.hpp"
+#include "assets/meshes/mesh-simplifier.hpp"
+#include "renderer/frame-snapshot.hpp"
+
+namespace geg::vulkan {
+  // picks every mesh's coarsest lod whose error stays under a few pixels on screen, once per
+  // frame so the depth and pbr passes draw the same triangles, pbr tests depth with equal
+  class LodSelector {
+  public:
+    // before the passes that draw the meshes
+    void select(const CameraSnapshot& camera, const SceneSnapshot& scene, vk::Extent2D extent);
+
+    // what lod() returns for meshes drawn by the ImpostorPass, the other passes skip them
+    static constexpr uint32_t k_impostor = ~0u;
+
+    // indexed like SceneSnapshot::meshes
+    uint32_t lod(size_t mesh) const { return mesh < m_lods.size() ? m_lods[mesh] : 0; }
+    bool impostor(size_t mesh) const { return lod(mesh) == k_impostor; }
+    // after select, for the ImpostorPass
+    void use_impostor(size_t mesh) { m_lods[mesh] = k_impostor; }
+
+    // main thread, guarded against the render thread reading the settings
+    void render_debug_gui();
+
+    glm::mat4 projection = glm::mat4(1);
+
+  private:
+    std::vector<uint32_t> m_lods;
+
+    struct Settings {
+      bool enabled = true;
+      float max_pixel_error = 1.0f;
+      // -1 selects by error, otherwise every mesh draws this lod or its coarsest
+      int32_t forced_lod = -1;
+    } m_settings;
+    std::mutex m_settings_mutex;
+    std::array<std::atomic<uint32_t>, k_max_lods> m_lod_counts{};
+  };
+}    // namespace geg::vulkan
@@ -1,10 +1,11 @@
 #include "mesh-renderer.hpp"
 
+#include <algorithm>
+
 #include "assets/asset-manager.hpp"
 #include "glm/fwd.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "imgui.h"
-#include "ecs/components.hpp"
 #include "vulkan/uniform-buffer.hpp"
 
 namespace geg::vulkan {
@@ -15,32 +16,33 @@ namespace geg::vulkan {
   }
 
   MeshRenderer::~MeshRenderer() {
-    m_device->vkdevice.destroyPipeline(m_pipeline);
-    m_device->vkdevice.destroyPipelineLayout(m_pipeline_layout);
+    for (auto& material : m_material_cache) delete material.ubo;
   }
 
   void MeshRenderer::fill_commands(
       const vk::CommandBuffer& cmd,
-      const Camera& camera,
-      Scene* scene,
+      ParallelRecorder& recorder,
+      const CameraSnapshot& camera,
+      const SceneSnapshot& scene,
+      const LodSelector& lods,
+      const ClusterCullPass& clusters,
+      const EnvMapPreprocessPass& env_maps,
       const Image& color_target,
       const Image& depth_target) {
-    namespace cmps = components;
-    if (!scene) return;
-    auto& asset_manager = AssetManager::get();
+    auto& residency = AssetManager::get().residency();
 
     vk::RenderingAttachmentInfoKHR color_attachment_info{};
     color_attachment_info.imageView = color_target.view;
     color_attachment_info.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
-    color_attachment_info.loadOp = vk::AttachmentLoadOp::eLoad;
-    color_attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
+    color_attachment_info.loadOp = color_target.load_op;
+    color_attachment_info.storeOp = color_target.store_op;
     color_attachment_info.clearValue = vk::ClearValue{};
 
     vk::RenderingAttachmentInfoKHR depth_attachment_info{};
     depth_attachment_info.imageView = depth_target.view;
     depth_attachment_info.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
-    depth_attachment_info.loadOp = vk::AttachmentLoadOp::eLoad;
-    depth_attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
+    depth_attachment_info.loadOp = depth_target.load_op;
+    depth_attachment_info.storeOp = depth_target.store_op;
     depth_attachment_info.clearValue = vk::ClearValue{};
 
     vk::RenderingInfoKHR rendering_info{};
@@ -50,287 +52,254 @@ namespace geg::vulkan {
     rendering_info.colorAttachmentCount = 1;
     rendering_info.layerCount = 1;
 
-    cmd.beginRendering(rendering_info);
-    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
-
-    cmd.setViewport(
-        0,
-        vk::Viewport{
-            .x = 0,
-            .y = 0,
-            .width = static_cast<float>(color_target.extent.width),
-            .height = static_cast<float>(color_target.extent.height),
-            .minDepth = 0,
-            .maxDepth = 1,
-        });
-
-    cmd.setScissor(
-        0,
-        vk::Rect2D{
-            .offset = {},
-            .extent = color_target.extent,
-        });
+    // still compiling, the attachments are left as they are
+    const auto pipeline = m_device->pipeline_cache().get(m_pipeline_state);
+    if (!pipeline) {
+      cmd.beginRendering(rendering_info);
+      cmd.endRendering();
+      return;
+    }
 
     global_data.proj = projection;
-    global_data.view = camera.view_matrix();
-    global_data.proj_view = projection * camera.view_matrix();
-    global_data.cam_pos = camera.position();
-    const auto& light_view = scene->get_reg().view<cmps::Light, cmps::Transform>();
+    global_data.view = camera.view;
+    global_data.proj_view = projection * camera.view;
+    global_data.cam_pos = camera.position;
     uint32_t i = 0;
-    for (auto& light : light_view) {
-      auto& light_color = light_view.get<cmps::Light>(light).light_color;
-      auto& pos = light_view.get<cmps::Transform>(light).translation;
-
+    for (const auto& light : scene.lights) {
+      // every layer adds its lights, the rest past the ubo's capacity are dropped
+      if (i == std::size(global_data.lights)) break;
       global_data.lights[i] = {
-          .pos = {pos, 1.0f},
-          .color = light_color,
+          .pos = {light.position, 1.0f},
+          .color = light.color,
       };
 
       i++;
     }
     global_data.lights_count = i;
-    auto sky_lights = scene->get_reg().group<cmps::SkyLight>();
-    if (!sky_lights.empty()) {
-      global_data.skylight_dir = {sky_lights.get<cmps::SkyLight>(sky_lights[0]).direction, 1.0f};
-      global_data.skylight_color = sky_lights.get<cmps::SkyLight>(sky_lights[0]).color;
+    if (scene.sky_light) {
+      global_data.skylight_dir = {scene.sky_light->direction, 1.0f};
+      global_data.skylight_color = scene.sky_light->color;
     }
 
     // update the ubos
     m_global_ubo.write_at_frame(&global_data, sizeof(global_data), 0);
 
-    cmd.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        m_pipeline_layout,
-        0,
-        {m_global_ubo.descriptor_set},
-        {m_global_ubo.frame_offset(0)});
-
-    auto env_maps = scene->get_reg().group<cmps::EnvMap>();
-    GEG_CORE_ASSERT(!env_maps.empty(), "u need to use env map");
-    cmps::EnvMap& env_map_cmp = env_maps.get<cmps::EnvMap>(env_maps[0]);
-
-    const auto objects = scene->get_reg().group<cmps::PBR>(entt::get<cmps::Transform, cmps::Mesh>);
-    for (auto obj : objects) {
-      const auto& pbr_data = objects.get<cmps::PBR>(obj);
-      const auto& transform = objects.get<cmps::Transform>(obj);
-      const auto& mesh = objects.get<cmps::Mesh>(obj);
-      const auto obj_id = static_cast<uint32_t>(obj);
-
-      if (!mesh) {
-        GEG_CORE_WARN("no mesh data in some mesh");
-        continue;
-      }
-
-      push_data.model = transform.model_matrix();
-      push_data.norm = transform.normal_matrix();
-
-      cmd.pushConstants(
-          m_pipeline_layout,
-          vk::ShaderStageFlagBits::eAllGraphics,
-          0,
-          sizeof(push_data),
-          &push_data);
-
-      objec_data.color_factor = glm::vec4(pbr_data.color_factor, 1.0f);
-      objec_data.emissive_factor = glm::vec4(pbr_data.emissive_factor, 1.0f);
-      objec_data.metallic_factor = pbr_data.metallic_factor;
-      objec_data.roughness_factor = pbr_data.roughness_factor;
-      objec_data.ao = pbr_data.AO;
-
-      if (m_objectubo_cache.find(obj_id) == m_objectubo_cache.end()) {
-        m_objectubo_cache[obj_id] = new UniformBuffer(m_device, sizeof(objec_data), 1);
-      }
-      m_objectubo_cache[obj_id]->write_at_frame(&objec_data, sizeof(objec_data), 0);
-
-      auto& mesh_descriptor = asset_manager.get_mesh(mesh.id).descriptor_set;
-      auto& albedo_descriptor = (pbr_data.albedo >= 0) ?
-                                    asset_manager.get_texture(pbr_data.albedo).descriptor_set :
-                                    dummy_tex.descriptor_set;
-
-      auto& metallic_roughness_descriptor =
-          (pbr_data.metallic_roughness >= 0) ?
-              asset_manager.get_texture(pbr_data.metallic_roughness).descriptor_set :
-              dummy_tex.descriptor_set;
-
-      auto& normal_descriptor = (pbr_data.normal_map >= 0) ?
-                                    asset_manager.get_texture(pbr_data.normal_map).descriptor_set :
-                                    dummy_tex.descriptor_set;
-
-      auto& emissive_descriptor =
-          (pbr_data.emissive_map >= 0) ?
-              asset_manager.get_texture(pbr_data.emissive_map).descriptor_set :
-              dummy_tex.descriptor_set;
-
-      auto env_diffuse_descriptor = asset_manager.get_texture(env_map_cmp.env_map_diffuse).descriptor_set;
-      auto env_specular_descriptor = asset_manager.get_texture(env_map_cmp.env_map_specular).descriptor_set;
-      auto env_brdflut_descriptor = asset_manager.get_texture(env_map_cmp.brdf_integration).descriptor_set;
-
-      cmd.bindDescriptorSets(
-          vk::PipelineBindPoint::eGraphics,
-          m_pipeline_layout,
-          1,
-          {
-              m_objectubo_cache[obj_id]->descriptor_set,
-              mesh_descriptor,
-              albedo_descriptor,
-              metallic_roughness_descriptor,
-              normal_descriptor,
-              emissive_descriptor,
-              env_diffuse_descriptor,
-              env_specular_descriptor,
-              env_brdflut_descriptor,
-          },
-          {
-              m_objectubo_cache[obj_id]->frame_offset(0),
-          });
-
-      uint32_t indcies_count = asset_manager.get_mesh(mesh.id).indices_count();
-      cmd.draw(indcies_count, 1, 0, 0);
-    }
-
-    cmd.endRendering();
-  }
-
-  void MeshRenderer::init_pipeline(vk::Format img_format) {
-    auto vert_shader_stage = m_shader.vert_stage_info;
-    auto frag_shader_stage = m_shader.frag_stage_info;
-
-    auto vertex_input_info = vk::PipelineVertexInputStateCreateInfo{};
-
-    auto input_assembly = vk::PipelineInputAssemblyStateCreateInfo{
-        .topology = vk::PrimitiveTopology::eTriangleList,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-
-    vk::PipelineViewportStateCreateInfo viewport_state{
-        .viewportCount = 1,
-        .scissorCount = 1,
-    };
-
-    std::array<vk::DynamicState, 2> dynamic_states = {
-        vk::DynamicState::eViewport,
-        vk::DynamicState::eScissor,
-    };
+    const auto global_set = frame_set({
+        env_maps.diffuse_map().descriptor_info(),
+        env_maps.specular_map().descriptor_info(),
+        env_maps.brdf_map().descriptor_info(),
+    });
 
-    vk::PipelineDynamicStateCreateInfo dynamic_state{
-        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
-        .pDynamicStates = dynamic_states.data(),
-    };
+    // everything that touches the asset manager, the descriptor allocator or the ubos
+    // happens here on the calling thread, the workers only record
+    m_draws.clear();
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+      const auto& mesh = scene.meshes[m];
+      const auto* mesh_data = residency.use(mesh.mesh);
+      if (!mesh_data || lods.impostor(m)) continue;
+      const auto& lod = mesh_data->lods()[lods.lod(m)];
+
+      const auto& material = material_set(mesh.material, scene.materials[mesh.material.index]);
+      m_draws.push_back({
+          .push =
+              {
+                  .model = mesh.model,
+                  .norm = mesh.normal,
+              },
+          .material_id = mesh.material,
+          .material = material.set,
+          .material_offset = material.ubo->frame_offset(0),
+          .geometry = mesh_data->descriptor_set,
+          .index_buffer = mesh_data->buffer,
+          .index_offset = mesh_data->index_offset,
+          .index_type = mesh_data->index_type(),
+          .first_index = lod.first_index,
+          .indices_count = lod.index_count,
+          .commands = clusters.commands(),
+          .commands_offset = clusters.range(m).offset,
+          .commands_count = clusters.range(m).count,
+      });
+    }
 
-    auto rasterizer = vk::PipelineRasterizationStateCreateInfo{
-        .depthClampEnable = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode = vk::PolygonMode::eFill,
-        .cullMode = vk::CullModeFlagBits::eBack,
-        .frontFace = vk::FrontFace::eCounterClockwise,
-        .depthBiasEnable = VK_FALSE,
-        .lineWidth = 1.0f,
-    };
+    // entities sharing a material end up next to each other so its set is bound once
+    // per run instead of once per draw
+    std::stable_sort(m_draws.begin(), m_draws.end(), [](const DrawItem& a, const DrawItem& b) {
+      return a.material_id.index < b.material_id.index;
+    });
 
-    auto multisampling = vk::PipelineMultisampleStateCreateInfo{
+    const vk::CommandBufferInheritanceRenderingInfo inheritance_info{
+        .colorAttachmentCount = static_cast<uint32_t>(m_pipeline_state.color_formats.size()),
+        .pColorAttachmentFormats = m_pipeline_state.color_formats.data(),
+        .depthAttachmentFormat = m_pipeline_state.depth_format,
         .rasterizationSamples = vk::SampleCountFlagBits::e1,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 1.0f,
     };
 
-    auto depth_stencil = vk::PipelineDepthStencilStateCreateInfo{
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_FALSE,
-        .depthCompareOp = vk::CompareOp::eEqual,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable = VK_FALSE,
-    };
+    const auto secondaries = recorder.record(
+        inheritance_info,
+        static_cast<uint32_t>(m_draws.size()),
+        [&](vk::CommandBuffer scmd, uint32_t begin, uint32_t end) {
+          // nothing but the rendering state is inherited
+          scmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+          scmd.setViewport(
+              0,
+              vk::Viewport{
+                  .x = 0,
+                  .y = 0,
+                  .width = static_cast<float>(color_target.extent.width),
+                  .height = static_cast<float>(color_target.extent.height),
+                  .minDepth = 0,
+                  .maxDepth = 1,
+              });
+          scmd.setScissor(
+              0,
+              vk::Rect2D{
+                  .offset = {},
+                  .extent = color_target.extent,
+              });
+
+          // per frame set, bound once for the whole chunk
+          scmd.bindDescriptorSets(
+              vk::PipelineBindPoint::eGraphics,
+              m_pipeline_layout,
+              PER_FRAME_SET,
+              {global_set},
+              {m_global_ubo.frame_offset(0)});
+
+          vk::DescriptorSet bound_material;
+          for (uint32_t d = begin; d < end; d++) {
+            const auto& draw = m_draws[d];
+
+            scmd.pushConstants(
+                m_pipeline_layout, m_shader.stage_flags, 0, sizeof(draw.push), &draw.push);
+
+            if (draw.material != bound_material) {
+              scmd.bindDescriptorSets(
+                  vk::PipelineBindPoint::eGraphics,
+                  m_pipeline_layout,
+                  PER_MATERIAL_SET,
+                  {draw.material},
+                  {draw.material_offset});
+              bound_material = draw.material;
+            }
+
+            scmd.bindDescriptorSets(
+                vk::PipelineBindPoint::eGraphics,
+                m_pipeline_layout,
+                PER_DRAW_SET,
+                {draw.geometry},
+                {});
+
+            scmd.bindIndexBuffer(draw.index_buffer, draw.index_offset, draw.index_type);
+            if (draw.commands_count) {
+              scmd.drawIndexedIndirect(
+                  draw.commands,
+                  draw.commands_offset,
+                  draw.commands_count,
+                  sizeof(vk::DrawIndexedIndirectCommand));
+            } else {
+              scmd.drawIndexed(draw.indices_count, 1, draw.first_index, 0, 0);
+            }
+          }
+        });
 
-    auto color_blend_attachment = vk::PipelineColorBlendAttachmentState{
-        .blendEnable = VK_FALSE,
-        .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-                          vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
-    };
+    rendering_info.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+    cmd.beginRendering(rendering_info);
+    cmd.executeCommands(secondaries);
+    cmd.endRendering();
+  }
 
-    auto color_blending = vk::PipelineColorBlendStateCreateInfo{
-        .logicOpEnable = VK_FALSE,
-        .attachmentCount = 1,
-        .pAttachments = &color_blend_attachment,
-    };
+  vk::DescriptorSet MeshRenderer::frame_set(
+      const std::array<vk::DescriptorImageInfo, 3>& images) {
+    if (m_frame_set && images == m_frame_set_images) return m_frame_set;
+
+    auto ubo_info = m_global_ubo.descriptor_info();
+    auto image_infos = images;
+    const auto stages = m_shader.stage_flags;
+    constexpr auto sampler = vk::DescriptorType::eCombinedImageSampler;
+
+    m_frame_set = m_device->build_descriptor()
+                      .bind_buffer(0, &ubo_info, vk::DescriptorType::eUniformBufferDynamic, stages)
+                      .bind_image(1, &image_infos[0], sampler, stages)
+                      .bind_image(2, &image_infos[1], sampler, stages)
+                      .bind_image(3, &image_infos[2], sampler, stages)
+                      .build()
+                      .value()
+                      .first;
+    m_frame_set_images = images;
+
+    return m_frame_set;
+  }
 
-    vk::PushConstantRange push_range{
-        .stageFlags = vk::ShaderStageFlagBits::eAllGraphics,
-        .offset = 0,
-        .size = sizeof(push_data),
-    };
+  MeshRenderer::MaterialSet& MeshRenderer::material_set(
+      MaterialId id, const Material& material) {
+    // a reused slot gets the old set back, it's rebuilt since the material differs
+    if (m_material_cache.size() <= id.index) m_material_cache.resize(id.index + 1);
+    auto& cached = m_material_cache[id.index];
+    if (!cached.ubo) cached.ubo = new UniformBuffer(m_device, sizeof(objec_data), 1);
+
+    if (cached.uploaded != material) {
+      objec_data.color_factor = glm::vec4(material.color_factor, 1.0f);
+      objec_data.emissive_factor = glm::vec4(material.emissive_factor, 1.0f);
+      objec_data.metallic_factor = material.metallic_factor;
+      objec_data.roughness_factor = material.roughness_factor;
+      objec_data.ao = material.AO;
+      cached.ubo->write_at_frame(&objec_data, sizeof(objec_data), 0);
+      cached.uploaded = material;
+    }
 
-    // @TODO: automate this
-    auto gubo_layout = m_global_ubo.descriptor_set_layout;
-    auto oubo_layout = m_global_ubo.descriptor_set_layout;
-    auto geometry_layout =
-        m_device->build_descriptor()
-            .bind_buffer_layout(
-                0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex)
-            .bind_buffer_layout(
-                1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex)
-            .build_layout()
-            .value();
-
-    auto texture_layout =
-        m_device->build_descriptor()
-            .bind_image_layout(
-                0,
-                vk::DescriptorType::eCombinedImageSampler,
-                vk::ShaderStageFlagBits::eAllGraphics | vk::ShaderStageFlagBits::eCompute)
-            .build_layout()
-            .value();
-
-    const std::array<vk::DescriptorSetLayout, 10> layouts = {
-        gubo_layout,
-        oubo_layout,
-        geometry_layout,
-        texture_layout,
-        texture_layout,
-        texture_layout,
-        texture_layout,
-        texture_layout,
-        texture_layout,
-        texture_layout,
+    // looked up every frame, it keeps the textures resident and a texture that was evicted
+    // and reloaded has a new view
+    auto& residency = AssetManager::get().residency();
+    const auto texture_info = [&](TextureId tex_id) {
+      const auto* texture = residency.use(tex_id);
+      return texture ? texture->descriptor_info() : dummy_tex.descriptor_info();
     };
-
-    m_pipeline_layout = m_device->vkdevice.createPipelineLayout(vk::PipelineLayoutCreateInfo{
-        .setLayoutCount = layouts.size(),
-        .pSetLayouts = layouts.data(),
-        .pushConstantRangeCount = 1,
-        .pPushConstantRanges = &push_range,
-    });
-
-    // dynamic rendering
-    vk::PipelineRenderingCreateInfoKHR rendering_info{
-        .colorAttachmentCount = 1,
-        .pColorAttachmentFormats = &img_format,
-        .depthAttachmentFormat = vk::Format::eD32SfloatS8Uint,
+    const std::array<vk::DescriptorImageInfo, 4> images{
+        texture_info(material.albedo),
+        texture_info(material.metallic_roughness),
+        texture_info(material.normal_map),
+        texture_info(material.emissive_map),
     };
+    if (cached.set && images == cached.images) return cached;
+
+    auto ubo_info = cached.ubo->descriptor_info();
+    auto image_infos = images;
+    const auto stages = m_shader.stage_flags;
+    constexpr auto sampler = vk::DescriptorType::eCombinedImageSampler;
+
+    // the old set may still be bound by a frame in flight
+    m_device->free_descriptor_set(cached.set);
+    cached.set = m_device->build_descriptor()
+                     .bind_buffer(0, &ubo_info, vk::DescriptorType::eUniformBufferDynamic, stages)
+                     .bind_image(1, &image_infos[0], sampler, stages)
+                     .bind_image(2, &image_infos[1], sampler, stages)
+                     .bind_image(3, &image_infos[2], sampler, stages)
+                     .bind_image(4, &image_infos[3], sampler, stages)
+                     .build()
+                     .value()
+                     .first;
+    cached.images = images;
+
+    return cached;
+  }
 
-    auto result = m_device->vkdevice.createGraphicsPipeline(
-        VK_NULL_HANDLE,
-        {
-            .pNext = &rendering_info,
-            .stageCount = 2,
-            .pStages = std::array{vert_shader_stage, frag_shader_stage}.data(),
-            .pVertexInputState = &vertex_input_info,
-            .pInputAssemblyState = &input_assembly,
-            .pViewportState = &viewport_state,
-            .pRasterizationState = &rasterizer,
-            .pMultisampleState = &multisampling,
-            .pDepthStencilState = &depth_stencil,
-            .pColorBlendState = &color_blending,
-            .pDynamicState = &dynamic_state,
-            .layout = m_pipeline_layout,
-            .renderPass = nullptr,
-            .subpass = 0,
-            .basePipelineHandle = vk::Pipeline{},
-            .basePipelineIndex = -1,
-        });
-
-    GEG_CORE_ASSERT(result.result == vk::Result::eSuccess, "Failed to create graphics pipeline!");
-
-    m_pipeline = result.value;
+  void MeshRenderer::init_pipeline(vk::Format img_format) {
+    m_pipeline_layout = m_shader.pipeline_layout();
+
+    // depth is already laid down by the early depth pass
+    m_pipeline_state = {
+        .vert_module = m_shader.vert_module,
+        .frag_module = m_shader.frag_module,
+        .layout = m_pipeline_layout,
+        .cull_mode = vk::CullModeFlagBits::eBack,
+        .front_face = vk::FrontFace::eCounterClockwise,
+        .depth_test = true,
+        .depth_write = false,
+        .depth_compare_op = vk::CompareOp::eEqual,
+        .color_formats = {img_format},
+        .depth_format = vk::Format::eD32SfloatS8Uint,
+    };
+    m_device->pipeline_cache().request(m_pipeline_state);
   }
 
 }    // namespace geg::vulkan
@@ -1,14 +1,15 @@
 #pragma once
 
-#include <unordered_map>
 #include "assets/asset-manager.hpp"
-#include "ecs/scene.hpp"
 #include "shader.hpp"
 #include "assets/meshes/meshes.hpp"
 #include "uniform-buffer.hpp"
 #include "glm/gtx/transform.hpp"
 #include "texture.hpp"
-#include "renderer/camera.hpp"
+#include "renderer/frame-snapshot.hpp"
+#include "parallel-recorder.hpp"
+#include "cluster-cull-pass.hpp"
+#include "env-map-preprocessing-pass.hpp"
 
 namespace geg::vulkan {
   class MeshRenderer {
@@ -18,8 +19,12 @@ namespace geg::vulkan {
 
     void fill_commands(
         const vk::CommandBuffer& cmd,
-        const Camera& camera,
-        Scene* scene,
+        ParallelRecorder& recorder,
+        const CameraSnapshot& camera,
+        const SceneSnapshot& scene,
+        const LodSelector& lods,
+        const ClusterCullPass& clusters,
+        const EnvMapPreprocessPass& env_maps,
         const Image& color_target,
         const Image& depth_target);
 
@@ -54,19 +59,54 @@ namespace geg::vulkan {
       float _padding;
     } objec_data{};
 
-    struct {
-      glm::mat4 model =
-          glm::rotate(glm::scale(glm::mat4(1), {0.03, 0.03, 0.03}), 3.140f, {1.0f, 0.0f, 1.0f});
-      glm::mat4 norm =
-          glm::rotate(glm::scale(glm::mat4(1), {33.3, 33.3, 33.3}), 3.140f, {1.0f, 0.0f, 1.0f});
-    } push_data{};
+    struct PushData {
+      glm::mat4 model;
+      glm::mat4 norm;
+    };
+
+    // built on the calling thread, read by the recording threads
+    struct DrawItem {
+      PushData push;
+      MaterialId material_id;
+      vk::DescriptorSet material;
+      uint32_t material_offset = 0;
+      vk::DescriptorSet geometry;
+      // the mesh's buffer, its index range starts at index_offset, the selected lod's
+      // triangles at first_index
+      vk::Buffer index_buffer;
+      vk::DeviceSize index_offset = 0;
+      vk::IndexType index_type = vk::IndexType::eUint32;
+      uint32_t first_index = 0;
+      uint32_t indices_count = 0;
+      // the meshlets' commands of the culling pass, drawn whole when there are none
+      vk::Buffer commands;
+      vk::DeviceSize commands_offset = 0;
+      uint32_t commands_count = 0;
+    };
+    std::vector<DrawItem> m_draws;
 
     UniformBuffer m_global_ubo{m_device, sizeof(global_data), 1};
-    std::unordered_map<uint32_t, UniformBuffer*> m_objectubo_cache;
+
+    // set 0, rebuilt only when the env maps change
+    vk::DescriptorSet m_frame_set;
+    std::array<vk::DescriptorImageInfo, 3> m_frame_set_images{};
+
+    // set 1, one per material slot, indexed by its handle, the set is rebuilt when the
+    // textures change and the ubo rewritten when the constants do
+    struct MaterialSet {
+      UniformBuffer* ubo = nullptr;
+      vk::DescriptorSet set;
+      std::array<vk::DescriptorImageInfo, 4> images{};
+      std::optional<Material> uploaded;
+    };
+    std::vector<MaterialSet> m_material_cache;
+
+    vk::DescriptorSet frame_set(const std::array<vk::DescriptorImageInfo, 3>& images);
+    MaterialSet& material_set(MaterialId id, const Material& material);
 
     Texture dummy_tex{m_device, glm::vec<4, uint8_t>{255}};
 
-    vk::Pipeline m_pipeline;
+    GraphicsPipelineState m_pipeline_state;
     vk::PipelineLayout m_pipeline_layout;
     Shader m_shader{m_device, "assets/shaders/pbr.glsl", "pbr"};
   };
@@ -0,0 +1,93 @@
+#include "parallel-recorder.hpp"
+
+namespace geg::vulkan {
+  ParallelRecorder::ParallelRecorder(std::shared_ptr<Device> device, uint32_t num_of_frames):
+      m_device(std::move(device)) {
+    // one chunk is always recorded on the calling thread
+    m_chunks_per_frame = JobSystem::get().workers_count() + 1;
+
+    m_pools.resize(num_of_frames);
+    for (auto& frame_pools : m_pools) {
+      frame_pools.resize(m_chunks_per_frame);
+      for (auto& chunk_pool : frame_pools) {
+        chunk_pool.pool = m_device->vkdevice.createCommandPool(vk::CommandPoolCreateInfo{
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = m_device->queue_family_index.value(),
+        });
+      }
+    }
+  }
+
+  ParallelRecorder::~ParallelRecorder() {
+    for (auto& frame_pools : m_pools)
+      for (auto& chunk_pool : frame_pools)
+        m_device->vkdevice.destroyCommandPool(chunk_pool.pool);
+  }
+
+  void ParallelRecorder::begin_frame(uint32_t frame_index) {
+    GEG_CORE_ASSERT(frame_index < m_pools.size(), "frame index out of range");
+    m_frame_index = frame_index;
+
+    for (auto& chunk_pool : m_pools[m_frame_index]) {
+      m_device->vkdevice.resetCommandPool(chunk_pool.pool);
+      chunk_pool.used = 0;
+    }
+  }
+
+  std::vector<vk::CommandBuffer> ParallelRecorder::record(
+      const vk::CommandBufferInheritanceRenderingInfo& rendering_info,
+      uint32_t count,
+      const RecordFn& record_fn) {
+    auto& frame_pools = m_pools[m_frame_index];
+
+    const uint32_t wanted_chunks = (count + min_chunk_size - 1) / min_chunk_size;
+    const uint32_t num_of_chunks =
+        std::clamp(wanted_chunks, 1u, static_cast<uint32_t>(m_chunks_per_frame));
+    const uint32_t chunk_size = (count + num_of_chunks - 1) / num_of_chunks;
+
+    // buffers are taken here so workers never touch the pool bookkeeping
+    std::vector<vk::CommandBuffer> buffers(num_of_chunks);
+    for (uint32_t i = 0; i < num_of_chunks; i++)
+      buffers[i] = next_buffer(frame_pools[i]);
+
+    const auto record_chunk = [&](uint32_t chunk) {
+      const vk::CommandBufferInheritanceInfo inheritance_info{.pNext = &rendering_info};
+      auto cmd = buffers[chunk];
+      cmd.begin(vk::CommandBufferBeginInfo{
+          .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                   vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+          .pInheritanceInfo = &inheritance_info,
+      });
+
+      const uint32_t begin = std::min(chunk * chunk_size, count);
+      const uint32_t end = std::min(begin + chunk_size, count);
+      record_fn(cmd, begin, end);
+
+      cmd.end();
+    };
+
+    // chunks own their pools so it doesn't matter which thread ends up running them
+    auto& jobs = JobSystem::get();
+    JobCounter counter;
+    for (uint32_t chunk = 1; chunk < num_of_chunks; chunk++)
+      jobs.run([&record_chunk, chunk] { record_chunk(chunk); }, &counter);
+
+    record_chunk(0);
+    jobs.wait(counter);
+
+    return buffers;
+  }
+
+  vk::CommandBuffer ParallelRecorder::next_buffer(ChunkPool& chunk_pool) {
+    if (chunk_pool.used == chunk_pool.buffers.size()) {
+      auto buffer = m_device->vkdevice.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+          .commandPool = chunk_pool.pool,
+          .level = vk::CommandBufferLevel::eSecondary,
+          .commandBufferCount = 1,
+      });
+      chunk_pool.buffers.push_back(buffer[0]);
+    }
+
+    return chunk_pool.buffers[chunk_pool.used++];
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "pch.hpp"
+#include "geg-vulkan.hpp"
+#include "device.hpp"
+#include "core/job-system.hpp"
+
+namespace geg::vulkan {
+  // records secondary command buffers for a dynamic rendering pass on the job system
+  // every chunk of work gets its own command pool per frame so nothing is shared
+  // between the recording threads
+  class ParallelRecorder {
+  public:
+    using RecordFn = std::function<void(vk::CommandBuffer cmd, uint32_t begin, uint32_t end)>;
+
+    ParallelRecorder(std::shared_ptr<Device> device, uint32_t num_of_frames);
+    ~ParallelRecorder();
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    // resets the pools of this frame, the gpu must be done with it
+    void begin_frame(uint32_t frame_index);
+
+    // splits [0, count) into contiguous chunks and records each into a secondary command
+    // buffer inheriting the given rendering state, returns them in order so they can be
+    // executed inside a pass begun with eContentsSecondaryCommandBuffers
+    std::vector<vk::CommandBuffer> record(
+        const vk::CommandBufferInheritanceRenderingInfo& rendering_info,
+        uint32_t count,
+        const RecordFn& record_fn);
+
+    uint32_t max_chunks() const { return static_cast<uint32_t>(m_chunks_per_frame); }
+
+    // chunks smaller than this aren't worth a thread
+    uint32_t min_chunk_size = 64;
+
+  private:
+    struct ChunkPool {
+      vk::CommandPool pool;
+      std::vector<vk::CommandBuffer> buffers;
+      uint32_t used = 0;
+    };
+
+    vk::CommandBuffer next_buffer(ChunkPool& chunk_pool);
+
+    std::shared_ptr<Device> m_device;
+    size_t m_chunks_per_frame = 0;
+    uint32_t m_frame_index = 0;
+    // [frame][chunk]
+    std::vector<std::vector<ChunkPool>> m_pools;
+  };
+}    // namespace geg::vulkan
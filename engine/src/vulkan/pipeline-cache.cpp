@@ -0,0 +1,306 @@
+#include "pipeline-cache.hpp"
+
+#include <algorithm>
+
+#include "device.hpp"
+#include "utils/hash.hpp"
+
+namespace geg::vulkan {
+  namespace {
+    template<typename T>
+    size_t hash_handle(T handle) {
+      const auto raw = static_cast<typename T::CType>(handle);
+      return std::hash<uint64_t>()(reinterpret_cast<uint64_t>(raw));
+    }
+  }    // namespace
+
+  size_t GraphicsPipelineState::hash() const {
+    size_t result = hash_handle(vert_module);
+    hash_combine(result, hash_handle(frag_module));
+    hash_combine(result, hash_handle(layout));
+
+    // fixed function state packed the same way the descriptor layout cache does it
+    const size_t packed =
+        static_cast<uint32_t>(topology) | static_cast<uint32_t>(polygon_mode) << 4 |
+        static_cast<uint32_t>(cull_mode) << 8 | static_cast<uint32_t>(front_face) << 10 |
+        depth_test << 11 | depth_write << 12 | static_cast<uint32_t>(depth_compare_op) << 13 |
+        blend << 16;
+    hash_combine(result, packed);
+
+    for (const auto format : color_formats)
+      hash_combine(result, static_cast<size_t>(format));
+    hash_combine(result, static_cast<size_t>(depth_format));
+
+    return result;
+  }
+
+  std::size_t PipelineCache::LayoutHash::operator()(const LayoutKey& k) const {
+    size_t result = k.set_layouts.size();
+    for (const auto layout : k.set_layouts)
+      hash_combine(result, hash_handle(layout));
+
+    if (k.push_range.has_value()) {
+      hash_combine(result, static_cast<uint32_t>(k.push_range->stageFlags));
+      hash_combine(result, k.push_range->size);
+    }
+
+    return result;
+  }
+
+  PipelineCache::PipelineCache(Device* device): m_device(device) {
+    m_vk_cache = m_device->vkdevice.createPipelineCache(vk::PipelineCacheCreateInfo{});
+  }
+
+  PipelineCache::~PipelineCache() {
+    wait_idle();
+
+    for (auto& [_, pipeline] : m_pipelines)
+      m_device->vkdevice.destroyPipeline(pipeline.get());
+    for (auto& [_, layout] : m_layouts)
+      m_device->vkdevice.destroyPipelineLayout(layout);
+    for (auto& [_, module] : m_modules)
+      m_device->vkdevice.destroyShaderModule(module.module);
+
+    m_device->vkdevice.destroyPipelineCache(m_vk_cache);
+  }
+
+  void PipelineCache::request(const GraphicsPipelineState& state) {
+    find_or_enqueue(state);
+  }
+
+  vk::Pipeline PipelineCache::get(const GraphicsPipelineState& state) {
+    auto& pipeline = find_or_enqueue(state);
+    if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return {};
+
+    return pipeline.get();
+  }
+
+  vk::Pipeline PipelineCache::get_blocking(const GraphicsPipelineState& state) {
+    std::promise<vk::Pipeline> promise;
+    std::shared_future<vk::Pipeline> pipeline;
+    bool compile_here = false;
+    {
+      std::lock_guard lock(m_mutex);
+      auto it = m_pipelines.find(state);
+      if (it == m_pipelines.end()) {
+        it = m_pipelines.emplace(state, promise.get_future().share()).first;
+        compile_here = true;
+      }
+      pipeline = it->second;
+    }
+
+    // compile outside the lock so other passes can still query the cache
+    if (compile_here) promise.set_value(compile(state));
+    return pipeline.get();
+  }
+
+  vk::ShaderModule PipelineCache::module(std::span<const uint32_t> spirv) {
+    std::lock_guard lock(m_mutex);
+
+    auto& entry = m_modules[hash_bytes(spirv.data(), spirv.size_bytes())];
+    if (!entry.module)
+      entry.module = m_device->vkdevice.createShaderModule({
+          .codeSize = spirv.size_bytes(),
+          .pCode = spirv.data(),
+      });
+    entry.refs++;
+
+    return entry.module;
+  }
+
+  void PipelineCache::release_module(vk::ShaderModule module) {
+    if (!module) return;
+
+    std::vector<std::shared_future<vk::Pipeline>> pipelines;
+    {
+      std::lock_guard lock(m_mutex);
+      const auto it = std::find_if(m_modules.begin(), m_modules.end(), [&](const auto& entry) {
+        return entry.second.module == module;
+      });
+      GEG_CORE_ASSERT(it != m_modules.end(), "shader module isn't from the pipeline cache");
+      if (--it->second.refs > 0) return;
+      m_modules.erase(it);
+
+      std::erase_if(m_pipelines, [&](const auto& entry) {
+        const auto& state = entry.first;
+        if (state.vert_module != module && state.frag_module != module) return false;
+        pipelines.push_back(entry.second);
+        return true;
+      });
+    }
+
+    // a compile still in flight reads the module
+    for (const auto& pipeline : pipelines)
+      m_device->destroy_pipeline(pipeline.get());
+    m_device->vkdevice.destroyShaderModule(module);
+  }
+
+  vk::PipelineLayout PipelineCache::layout(
+      const std::vector<vk::DescriptorSetLayout>& set_layouts,
+      const std::optional<vk::PushConstantRange>& push_range) {
+    std::lock_guard lock(m_mutex);
+
+    LayoutKey key{set_layouts, push_range};
+    auto it = m_layouts.find(key);
+    if (it != m_layouts.end()) return it->second;
+
+    auto layout = m_device->vkdevice.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+        .setLayoutCount = static_cast<uint32_t>(set_layouts.size()),
+        .pSetLayouts = set_layouts.data(),
+        .pushConstantRangeCount = push_range.has_value() ? 1u : 0u,
+        .pPushConstantRanges = push_range.has_value() ? &push_range.value() : nullptr,
+    });
+
+    m_layouts.emplace(std::move(key), layout);
+    return layout;
+  }
+
+  void PipelineCache::wait_idle() {
+    // only the workers run the compiles, waiting just lets them finish
+    JobSystem::get().wait(m_compiling);
+  }
+
+  uint32_t PipelineCache::pipelines_count() {
+    std::lock_guard lock(m_mutex);
+    return static_cast<uint32_t>(m_pipelines.size());
+  }
+
+  uint32_t PipelineCache::pending_count() {
+    std::lock_guard lock(m_mutex);
+    uint32_t pending = 0;
+    for (const auto& [_, pipeline] : m_pipelines)
+      if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready) pending++;
+
+    return pending;
+  }
+
+  std::shared_future<vk::Pipeline>& PipelineCache::find_or_enqueue(
+      const GraphicsPipelineState& state) {
+    std::lock_guard lock(m_mutex);
+
+    auto it = m_pipelines.find(state);
+    if (it != m_pipelines.end()) return it->second;
+
+    auto task = std::make_shared<std::packaged_task<vk::Pipeline()>>(
+        [this, state] { return compile(state); });
+    auto& pipeline = m_pipelines.emplace(state, task->get_future().share()).first->second;
+    // a driver compile takes milliseconds, it must not run inside the render thread's waits
+    JobSystem::get().run_background([task] { (*task)(); }, &m_compiling);
+
+    return pipeline;
+  }
+
+  vk::Pipeline PipelineCache::compile(const GraphicsPipelineState& state) {
+    std::vector<vk::PipelineShaderStageCreateInfo> stages;
+    stages.push_back({
+        .stage = vk::ShaderStageFlagBits::eVertex,
+        .module = state.vert_module,
+        .pName = "main",
+    });
+    if (state.frag_module) {
+      stages.push_back({
+          .stage = vk::ShaderStageFlagBits::eFragment,
+          .module = state.frag_module,
+          .pName = "main",
+      });
+    }
+
+    auto vertex_input_info = vk::PipelineVertexInputStateCreateInfo{};
+
+    auto input_assembly = vk::PipelineInputAssemblyStateCreateInfo{
+        .topology = state.topology,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    vk::PipelineViewportStateCreateInfo viewport_state{
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    std::array<vk::DynamicState, 2> dynamic_states = {
+        vk::DynamicState::eViewport,
+        vk::DynamicState::eScissor,
+    };
+
+    vk::PipelineDynamicStateCreateInfo dynamic_state{
+        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+        .pDynamicStates = dynamic_states.data(),
+    };
+
+    auto rasterizer = vk::PipelineRasterizationStateCreateInfo{
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = state.polygon_mode,
+        .cullMode = state.cull_mode,
+        .frontFace = state.front_face,
+        .depthBiasEnable = VK_FALSE,
+        .lineWidth = 1.0f,
+    };
+
+    auto multisampling = vk::PipelineMultisampleStateCreateInfo{
+        .rasterizationSamples = vk::SampleCountFlagBits::e1,
+        .sampleShadingEnable = VK_FALSE,
+        .minSampleShading = 1.0f,
+    };
+
+    auto depth_stencil = vk::PipelineDepthStencilStateCreateInfo{
+        .depthTestEnable = state.depth_test,
+        .depthWriteEnable = state.depth_write,
+        .depthCompareOp = state.depth_compare_op,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+    };
+
+    std::vector<vk::PipelineColorBlendAttachmentState> color_blend_attachments(
+        state.color_formats.size(),
+        vk::PipelineColorBlendAttachmentState{
+            .blendEnable = state.blend,
+            .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+            .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+            .colorBlendOp = vk::BlendOp::eAdd,
+            .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+            .dstAlphaBlendFactor = vk::BlendFactor::eZero,
+            .alphaBlendOp = vk::BlendOp::eAdd,
+            .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                              vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+        });
+
+    auto color_blending = vk::PipelineColorBlendStateCreateInfo{
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = static_cast<uint32_t>(color_blend_attachments.size()),
+        .pAttachments = color_blend_attachments.data(),
+    };
+
+    // dynamic rendering
+    vk::PipelineRenderingCreateInfoKHR rendering_info{
+        .colorAttachmentCount = static_cast<uint32_t>(state.color_formats.size()),
+        .pColorAttachmentFormats = state.color_formats.data(),
+        .depthAttachmentFormat = state.depth_format,
+    };
+
+    auto result = m_device->vkdevice.createGraphicsPipeline(
+        m_vk_cache,
+        {
+            .pNext = &rendering_info,
+            .stageCount = static_cast<uint32_t>(stages.size()),
+            .pStages = stages.data(),
+            .pVertexInputState = &vertex_input_info,
+            .pInputAssemblyState = &input_assembly,
+            .pViewportState = &viewport_state,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisampling,
+            .pDepthStencilState = &depth_stencil,
+            .pColorBlendState = &color_blending,
+            .pDynamicState = &dynamic_state,
+            .layout = state.layout,
+            .renderPass = nullptr,
+            .subpass = 0,
+            .basePipelineHandle = vk::Pipeline{},
+            .basePipelineIndex = -1,
+        });
+
+    GEG_CORE_ASSERT(result.result == vk::Result::eSuccess, "Failed to create graphics pipeline!");
+
+    return result.value;
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <future>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+#include "pch.hpp"
+#include "geg-vulkan.hpp"
+#include "core/job-system.hpp"
+
+namespace geg::vulkan {
+  class Device;
+
+  // everything that goes into a graphics pipeline, passes describe their pipeline
+  // with this instead of filling the create infos by hand
+  // viewport and scissor are always dynamic
+  // the modules come from PipelineCache::module and the layout from PipelineCache::layout,
+  // both are shared by content so the handles identify the content while they are alive
+  struct GraphicsPipelineState {
+    vk::ShaderModule vert_module;
+    vk::ShaderModule frag_module;    // optional, depth only passes leave it empty
+    vk::PipelineLayout layout;
+
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+    vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+    vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+    vk::FrontFace front_face = vk::FrontFace::eCounterClockwise;
+
+    bool depth_test = false;
+    bool depth_write = false;
+    vk::CompareOp depth_compare_op = vk::CompareOp::eLess;
+    bool blend = false;
+
+    std::vector<vk::Format> color_formats;
+    vk::Format depth_format = vk::Format::eUndefined;
+
+    bool operator==(const GraphicsPipelineState& other) const = default;
+    size_t hash() const;
+  };
+
+  class PipelineCache {
+  public:
+    PipelineCache(Device* device);
+    ~PipelineCache();
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    // starts compiling the pipeline on a worker if it's not already known
+    void request(const GraphicsPipelineState& state);
+    // returns a null handle while the pipeline is still compiling
+    vk::Pipeline get(const GraphicsPipelineState& state);
+    // compiles on the calling thread if needed, for one off passes
+    vk::Pipeline get_blocking(const GraphicsPipelineState& state);
+
+    // one module per SPIR-V content, identical shaders get the same handle and share their
+    // pipelines
+    vk::ShaderModule module(std::span<const uint32_t> spirv);
+    // drops one reference, the last one destroys the module with every pipeline built from
+    // it so the driver can't hand the handle out again while the cache still knows it
+    void release_module(vk::ShaderModule module);
+
+    // layouts are deduplicated too so identical shaders end up with identical states
+    vk::PipelineLayout layout(
+        const std::vector<vk::DescriptorSetLayout>& set_layouts,
+        const std::optional<vk::PushConstantRange>& push_range);
+
+    // waits for all in flight compilations
+    void wait_idle();
+
+    uint32_t pipelines_count();
+    uint32_t pending_count();
+
+  private:
+    struct StateHash {
+      std::size_t operator()(const GraphicsPipelineState& k) const { return k.hash(); }
+    };
+
+    struct LayoutKey {
+      std::vector<vk::DescriptorSetLayout> set_layouts;
+      std::optional<vk::PushConstantRange> push_range;
+
+      bool operator==(const LayoutKey& other) const = default;
+    };
+
+    struct LayoutHash {
+      std::size_t operator()(const LayoutKey& k) const;
+    };
+
+    std::shared_future<vk::Pipeline>& find_or_enqueue(const GraphicsPipelineState& state);
+    vk::Pipeline compile(const GraphicsPipelineState& state);
+
+    Device* m_device;
+    vk::PipelineCache m_vk_cache;
+
+    std::mutex m_mutex;
+    std::unordered_map<GraphicsPipelineState, std::shared_future<vk::Pipeline>, StateHash>
+        m_pipelines;
+    std::unordered_map<LayoutKey, vk::PipelineLayout, LayoutHash> m_layouts;
+    struct Module {
+      vk::ShaderModule module;
+      uint32_t refs = 0;
+    };
+    // keyed by the hash of the SPIR-V
+    std::unordered_map<uint64_t, Module> m_modules;
+    // in flight compilations on the job system
+    JobCounter m_compiling;
+  };
+}    // namespace geg::vulkan
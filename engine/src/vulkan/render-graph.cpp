@@ -0,0 +1,559 @@
+#include "render-graph.hpp"
+
+#include "imgui.h"
+
+namespace geg::vulkan {
+  namespace {
+    struct UsageState {
+      vk::PipelineStageFlags2 stages;
+      vk::AccessFlags2 access;
+      vk::ImageLayout layout;
+      bool write = false;
+    };
+
+    UsageState usage_state(RGUsage usage) {
+      using Stage = vk::PipelineStageFlagBits2;
+      using Access = vk::AccessFlagBits2;
+
+      switch (usage) {
+        case RGUsage::ColorAttachment:
+          return {
+              .stages = Stage::eColorAttachmentOutput,
+              .access = Access::eColorAttachmentRead | Access::eColorAttachmentWrite,
+              .layout = vk::ImageLayout::eColorAttachmentOptimal,
+              .write = true,
+          };
+        case RGUsage::DepthAttachment:
+          return {
+              .stages = Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+              .access = Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite,
+              .layout = vk::ImageLayout::eDepthAttachmentOptimal,
+              .write = true,
+          };
+        case RGUsage::DepthRead:
+          return {
+              .stages = Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+              .access = Access::eDepthStencilAttachmentRead,
+              .layout = vk::ImageLayout::eDepthAttachmentOptimal,
+          };
+        case RGUsage::Sampled:
+          return {
+              .stages = Stage::eFragmentShader | Stage::eComputeShader,
+              .access = Access::eShaderSampledRead,
+              .layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+          };
+      }
+
+      GEG_CORE_ASSERT(false, "unknown render graph usage");
+      return {};
+    }
+
+    bool is_attachment(RGUsage usage) {
+      return usage != RGUsage::Sampled;
+    }
+
+    vk::ImageAspectFlags aspect_of(vk::Format format) {
+      switch (format) {
+        case vk::Format::eD16Unorm:
+        case vk::Format::eD32Sfloat:
+        case vk::Format::eX8D24UnormPack32:
+        case vk::Format::eD16UnormS8Uint:
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint:
+          // separate depth/stencil layouts are enabled, stencil is unused
+          return vk::ImageAspectFlagBits::eDepth;
+        default:
+          return vk::ImageAspectFlagBits::eColor;
+      }
+    }
+  }    // namespace
+
+  // PassBuilder
+
+  RenderGraph::PassBuilder& RenderGraph::PassBuilder::color_attachment(
+      RGHandle handle, bool clear) {
+    return access(handle, RGUsage::ColorAttachment, clear);
+  }
+
+  RenderGraph::PassBuilder& RenderGraph::PassBuilder::depth_attachment(
+      RGHandle handle, bool clear) {
+    return access(handle, RGUsage::DepthAttachment, clear);
+  }
+
+  RenderGraph::PassBuilder& RenderGraph::PassBuilder::depth_read(RGHandle handle) {
+    return access(handle, RGUsage::DepthRead, false);
+  }
+
+  RenderGraph::PassBuilder& RenderGraph::PassBuilder::sampled(RGHandle handle) {
+    return access(handle, RGUsage::Sampled, false);
+  }
+
+  RenderGraph::PassBuilder& RenderGraph::PassBuilder::side_effects() {
+    m_graph->m_passes[m_pass].side_effects = true;
+    return *this;
+  }
+
+  RenderGraph::PassBuilder& RenderGraph::PassBuilder::access(
+      RGHandle handle, RGUsage usage, bool clear) {
+    GEG_CORE_ASSERT(handle < m_graph->m_resources.size(), "invalid render graph handle");
+    m_graph->m_passes[m_pass].accesses.push_back({
+        .handle = handle,
+        .usage = usage,
+        .clear = clear,
+    });
+    return *this;
+  }
+
+  // RenderGraph
+
+  RenderGraph::RenderGraph(std::shared_ptr<Device> device): m_device(std::move(device)) {}
+
+  RenderGraph::~RenderGraph() {
+    free_transients();
+  }
+
+  void RenderGraph::reset() {
+    m_passes.clear();
+    m_resources.clear();
+    m_final_barriers.clear();
+    m_current_pass = UINT32_MAX;
+  }
+
+  RGHandle RenderGraph::import_image(
+      const std::string& name,
+      const Image& image,
+      vk::Format format,
+      vk::ImageLayout initial_layout,
+      vk::ImageLayout final_layout) {
+    m_resources.push_back({
+        .name = name,
+        .format = format,
+        .extent = image.extent,
+        .imported = true,
+        .image = image,
+        .initial_layout = initial_layout,
+        .final_layout = final_layout,
+    });
+
+    return static_cast<RGHandle>(m_resources.size() - 1);
+  }
+
+  RGHandle RenderGraph::create_image(const std::string& name, const RGImageDesc& desc) {
+    m_resources.push_back({
+        .name = name,
+        .format = desc.format,
+        .extent = desc.extent,
+    });
+
+    return static_cast<RGHandle>(m_resources.size() - 1);
+  }
+
+  RenderGraph::PassBuilder RenderGraph::add_pass(const std::string& name, ExecuteFn execute) {
+    m_passes.push_back({
+        .name = name,
+        .execute = std::move(execute),
+    });
+
+    return PassBuilder(this, static_cast<uint32_t>(m_passes.size() - 1));
+  }
+
+  void RenderGraph::compile() {
+    cull_passes();
+    compute_lifetimes();
+    allocate_transients();
+    build_barriers();
+
+    std::lock_guard lock(m_debug_mutex);
+    m_debug_passes.clear();
+    for (const auto& pass : m_passes)
+      m_debug_passes.push_back({pass.name, pass.culled, pass.barriers.size()});
+    m_debug_stats = m_stats;
+  }
+
+  void RenderGraph::execute(vk::CommandBuffer cmd) {
+    for (uint32_t i = 0; i < m_passes.size(); i++) {
+      auto& pass = m_passes[i];
+      if (pass.culled) continue;
+
+      if (!pass.barriers.empty()) {
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(pass.barriers.size()),
+            .pImageMemoryBarriers = pass.barriers.data(),
+        });
+      }
+
+      m_current_pass = i;
+      pass.execute(cmd);
+    }
+    m_current_pass = UINT32_MAX;
+
+    if (!m_final_barriers.empty()) {
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+          .imageMemoryBarrierCount = static_cast<uint32_t>(m_final_barriers.size()),
+          .pImageMemoryBarriers = m_final_barriers.data(),
+      });
+    }
+  }
+
+  Image RenderGraph::image(RGHandle handle) const {
+    GEG_CORE_ASSERT(m_current_pass < m_passes.size(), "render graph image outside of a pass");
+
+    Image image = m_resources[handle].image;
+    for (const auto& access : m_passes[m_current_pass].accesses) {
+      if (access.handle != handle) continue;
+      image.load_op = access.load_op;
+      image.store_op = access.store_op;
+    }
+
+    return image;
+  }
+
+  void RenderGraph::cull_passes() {
+    // walk backwards from the passes that write something visible outside the graph
+    std::vector<bool> needed(m_resources.size(), false);
+    m_stats.culled_passes = 0;
+
+    for (int32_t i = static_cast<int32_t>(m_passes.size()) - 1; i >= 0; i--) {
+      auto& pass = m_passes[i];
+
+      bool keep = pass.side_effects;
+      for (const auto& access : pass.accesses) {
+        const bool write = usage_state(access.usage).write;
+        if (write && (m_resources[access.handle].imported || needed[access.handle])) keep = true;
+      }
+
+      pass.culled = !keep;
+      if (pass.culled) {
+        m_stats.culled_passes++;
+        continue;
+      }
+
+      // a cleared image doesn't depend on earlier writes
+      for (const auto& access : pass.accesses)
+        if (access.clear) needed[access.handle] = false;
+      for (const auto& access : pass.accesses)
+        if (!access.clear) needed[access.handle] = true;
+    }
+  }
+
+  void RenderGraph::compute_lifetimes() {
+    for (uint32_t i = 0; i < m_passes.size(); i++) {
+      if (m_passes[i].culled) continue;
+
+      for (const auto& access : m_passes[i].accesses) {
+        auto& resource = m_resources[access.handle];
+        if (resource.imported) continue;
+
+        resource.first_pass = std::min(resource.first_pass, i);
+        resource.last_pass = std::max(resource.last_pass, i);
+
+        switch (access.usage) {
+          case RGUsage::ColorAttachment:
+            resource.usage |= vk::ImageUsageFlagBits::eColorAttachment;
+            break;
+          case RGUsage::DepthAttachment:
+          case RGUsage::DepthRead:
+            resource.usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+            break;
+          case RGUsage::Sampled:
+            resource.usage |= vk::ImageUsageFlagBits::eSampled;
+            break;
+        }
+      }
+    }
+  }
+
+  void RenderGraph::allocate_transients() {
+    std::vector<RGHandle> transients;
+    for (RGHandle h = 0; h < m_resources.size(); h++)
+      if (!m_resources[h].imported && m_resources[h].first_pass != UINT32_MAX)
+        transients.push_back(h);
+
+    std::sort(transients.begin(), transients.end(), [&](RGHandle a, RGHandle b) {
+      return m_resources[a].first_pass < m_resources[b].first_pass;
+    });
+
+    // greedy interval packing, an image goes into the first block that's free by its first pass
+    std::vector<PhysicalImage> plan;
+    std::vector<uint32_t> block_last_pass;
+    for (const auto h : transients) {
+      auto& resource = m_resources[h];
+
+      uint32_t block = 0;
+      while (block < block_last_pass.size() && block_last_pass[block] >= resource.first_pass)
+        block++;
+      if (block == block_last_pass.size()) block_last_pass.push_back(0);
+      block_last_pass[block] = resource.last_pass;
+
+      resource.physical = static_cast<int32_t>(plan.size());
+      plan.push_back({
+          .desc = {resource.format, resource.extent},
+          .usage = resource.usage,
+          .block = block,
+      });
+    }
+
+    if (plan != m_physical_images) {
+      // only happens on resize or when the frame shape changes
+      m_device->vkdevice.waitIdle();
+      free_transients();
+
+      std::vector<vk::MemoryRequirements> block_reqs(block_last_pass.size());
+      for (auto& req : block_reqs)
+        req.memoryTypeBits = UINT32_MAX;
+
+      m_stats.transient_memory_unaliased = 0;
+      for (auto& physical : plan) {
+        physical.image = m_device->vkdevice.createImage(vk::ImageCreateInfo{
+            .imageType = vk::ImageType::e2D,
+            .format = physical.desc.format,
+            .extent = {physical.desc.extent.width, physical.desc.extent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = physical.usage,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        });
+
+        const auto req = m_device->vkdevice.getImageMemoryRequirements(physical.image);
+        auto& block_req = block_reqs[physical.block];
+        block_req.size = std::max(block_req.size, req.size);
+        block_req.alignment = std::max(block_req.alignment, req.alignment);
+        block_req.memoryTypeBits &= req.memoryTypeBits;
+        GEG_CORE_ASSERT(block_req.memoryTypeBits != 0, "can't alias render graph images");
+
+        m_stats.transient_memory_unaliased += req.size;
+      }
+
+      m_stats.transient_memory = 0;
+      m_blocks.resize(block_reqs.size());
+      for (uint32_t b = 0; b < m_blocks.size(); b++) {
+        const VmaAllocationCreateInfo alloc_info{
+            .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+        };
+
+        const auto req = static_cast<VkMemoryRequirements>(block_reqs[b]);
+        vmaAllocateMemory(m_device->allocator, &req, &alloc_info, &m_blocks[b].alloc, nullptr);
+        m_blocks[b].size = req.size;
+        m_stats.transient_memory += req.size;
+      }
+
+      for (auto& physical : plan) {
+        vmaBindImageMemory2(
+            m_device->allocator, m_blocks[physical.block].alloc, 0, physical.image, nullptr);
+
+        physical.view = m_device->vkdevice.createImageView({
+            .image = physical.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = physical.desc.format,
+            .subresourceRange =
+                {
+                    .aspectMask = aspect_of(physical.desc.format),
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+        });
+      }
+
+      m_physical_images = std::move(plan);
+    }
+
+    for (const auto h : transients) {
+      auto& resource = m_resources[h];
+      const auto& physical = m_physical_images[resource.physical];
+      resource.image = Image{
+          .image = physical.image,
+          .view = physical.view,
+          .extent = physical.desc.extent,
+      };
+    }
+  }
+
+  void RenderGraph::build_barriers() {
+    struct State {
+      vk::PipelineStageFlags2 stages;
+      vk::AccessFlags2 access;
+      vk::ImageLayout layout;
+      bool write = false;
+      bool touched = false;
+      // the content is worth loading
+      bool defined = false;
+    };
+
+    std::vector<State> states(m_resources.size());
+    std::vector<uint32_t> last_use(m_resources.size(), 0);
+    for (RGHandle h = 0; h < m_resources.size(); h++) {
+      const auto& resource = m_resources[h];
+      states[h].layout = resource.imported ? resource.initial_layout : vk::ImageLayout::eUndefined;
+      states[h].defined =
+          resource.imported && resource.initial_layout != vk::ImageLayout::eUndefined;
+    }
+    for (uint32_t i = 0; i < m_passes.size(); i++)
+      if (!m_passes[i].culled)
+        for (const auto& access : m_passes[i].accesses)
+          last_use[access.handle] = i;
+
+    // the last stages that touched each memory block, aliased images have to wait for them,
+    // starting from whatever the last frame left in it
+    std::vector<vk::PipelineStageFlags2> block_stages(m_blocks.size());
+    std::vector<vk::AccessFlags2> block_access(m_blocks.size());
+    for (uint32_t b = 0; b < m_blocks.size(); b++) {
+      block_stages[b] = m_blocks[b].last_stages;
+      block_access[b] = m_blocks[b].last_access;
+    }
+
+    m_stats.barriers = 0;
+    for (uint32_t i = 0; i < m_passes.size(); i++) {
+      auto& pass = m_passes[i];
+      pass.barriers.clear();
+      if (pass.culled) continue;
+
+      for (auto& access : pass.accesses) {
+        auto& resource = m_resources[access.handle];
+        auto& state = states[access.handle];
+        const auto next = usage_state(access.usage);
+
+        if (is_attachment(access.usage)) {
+          if (access.usage == RGUsage::DepthRead) access.load_op = vk::AttachmentLoadOp::eLoad;
+          else if (access.clear) access.load_op = vk::AttachmentLoadOp::eClear;
+          else if (state.defined) access.load_op = vk::AttachmentLoadOp::eLoad;
+          else access.load_op = vk::AttachmentLoadOp::eDontCare;
+
+          access.store_op = (resource.imported || last_use[access.handle] > i) ?
+                                vk::AttachmentStoreOp::eStore :
+                                vk::AttachmentStoreOp::eDontCare;
+        }
+
+        bool needs_barrier = state.layout != next.layout || state.write || next.write;
+        vk::PipelineStageFlags2 src_stages = state.stages;
+        vk::AccessFlags2 src_access = state.access;
+
+        if (!state.touched) {
+          // earlier submissions on the queue are the first scope here, transients wait for
+          // the last use of their memory, in this frame if it's aliased or in the last one
+          // since every frame in flight gets the same images
+          needs_barrier = state.layout != next.layout || !resource.imported;
+          src_stages = next.stages;
+          src_access = {};
+          if (!resource.imported) {
+            const auto block = m_physical_images[resource.physical].block;
+            src_stages |= block_stages[block];
+            src_access = block_access[block];
+          }
+        }
+
+        if (needs_barrier) {
+          pass.barriers.push_back(vk::ImageMemoryBarrier2{
+              .srcStageMask = src_stages,
+              .srcAccessMask = src_access,
+              .dstStageMask = next.stages,
+              .dstAccessMask = next.access,
+              .oldLayout = state.layout,
+              .newLayout = next.layout,
+              .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+              .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+              .image = resource.image.image,
+              .subresourceRange =
+                  {
+                      .aspectMask = aspect_of(resource.format),
+                      .baseMipLevel = 0,
+                      .levelCount = VK_REMAINING_MIP_LEVELS,
+                      .baseArrayLayer = 0,
+                      .layerCount = VK_REMAINING_ARRAY_LAYERS,
+                  },
+          });
+
+          state.stages = next.stages;
+          state.access = next.access;
+        } else {
+          // read after read in the same layout, just widen the scope for the next barrier
+          state.stages |= next.stages;
+          state.access |= next.access;
+        }
+
+        state.layout = next.layout;
+        state.write = next.write;
+        state.touched = true;
+        state.defined = state.defined || next.write;
+
+        if (!resource.imported) {
+          const auto block = m_physical_images[resource.physical].block;
+          block_stages[block] = state.stages;
+          block_access[block] = state.access;
+        }
+      }
+
+      m_stats.barriers += static_cast<uint32_t>(pass.barriers.size());
+    }
+
+    for (uint32_t b = 0; b < m_blocks.size(); b++) {
+      m_blocks[b].last_stages = block_stages[b];
+      m_blocks[b].last_access = block_access[b];
+    }
+
+    m_final_barriers.clear();
+    for (RGHandle h = 0; h < m_resources.size(); h++) {
+      const auto& resource = m_resources[h];
+      const auto& state = states[h];
+      if (!resource.imported || !state.touched) continue;
+      if (resource.final_layout == vk::ImageLayout::eUndefined) continue;
+      if (resource.final_layout == state.layout) continue;
+
+      m_final_barriers.push_back(vk::ImageMemoryBarrier2{
+          .srcStageMask = state.stages,
+          .srcAccessMask = state.access,
+          .dstStageMask = vk::PipelineStageFlagBits2::eNone,
+          .dstAccessMask = vk::AccessFlagBits2::eNone,
+          .oldLayout = state.layout,
+          .newLayout = resource.final_layout,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = resource.image.image,
+          .subresourceRange =
+              {
+                  .aspectMask = aspect_of(resource.format),
+                  .baseMipLevel = 0,
+                  .levelCount = VK_REMAINING_MIP_LEVELS,
+                  .baseArrayLayer = 0,
+                  .layerCount = VK_REMAINING_ARRAY_LAYERS,
+              },
+      });
+    }
+    m_stats.barriers += static_cast<uint32_t>(m_final_barriers.size());
+  }
+
+  void RenderGraph::free_transients() {
+    for (auto& physical : m_physical_images) {
+      m_device->vkdevice.destroyImageView(physical.view);
+      m_device->vkdevice.destroyImage(physical.image);
+    }
+    for (auto& block : m_blocks)
+      vmaFreeMemory(m_device->allocator, block.alloc);
+
+    m_physical_images.clear();
+    m_blocks.clear();
+  }
+
+  void RenderGraph::draw_debug_ui() {
+    if (!ImGui::CollapsingHeader("Render graph: ")) return;
+
+    std::lock_guard lock(m_debug_mutex);
+    for (const auto& pass : m_debug_passes) {
+      ImGui::Text(
+          "%s%s (%zu barriers)",
+          pass.name.c_str(),
+          pass.culled ? " [culled]" : "",
+          pass.barriers);
+    }
+    ImGui::Text("culled passes: %u", m_debug_stats.culled_passes);
+    ImGui::Text("barriers: %u", m_debug_stats.barriers);
+    ImGui::Text(
+        "transient memory: %.2f MiB (%.2f MiB without aliasing)",
+        m_debug_stats.transient_memory / (1024.0 * 1024.0),
+        m_debug_stats.transient_memory_unaliased / (1024.0 * 1024.0));
+  }
+}    // namespace geg::vulkan
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <mutex>
+
+#include "pch.hpp"
+#include "geg-vulkan.hpp"
+#include "device.hpp"
+#include "vk_mem_alloc.h"
+
+namespace geg::vulkan {
+  using RGHandle = uint32_t;
+
+  enum class RGUsage {
+    ColorAttachment,
+    DepthAttachment,
+    // depth test without writes
+    DepthRead,
+    Sampled,
+  };
+
+  struct RGImageDesc {
+    vk::Format format;
+    vk::Extent2D extent;
+  };
+
+  // the frame is declared from scratch every frame, passes only state which images they
+  // touch and how, the graph then:
+  // - culls passes that don't contribute to an imported image
+  // - derives (batched) barriers and layout transitions between passes
+  // - picks attachment load/store ops
+  // - places transient images with non overlapping lifetimes in the same memory
+  class RenderGraph {
+  public:
+    using ExecuteFn = std::function<void(vk::CommandBuffer cmd)>;
+
+    class PassBuilder {
+    public:
+      PassBuilder& color_attachment(RGHandle handle, bool clear = false);
+      PassBuilder& depth_attachment(RGHandle handle, bool clear = false);
+      PassBuilder& depth_read(RGHandle handle);
+      PassBuilder& sampled(RGHandle handle);
+      // never culled
+      PassBuilder& side_effects();
+
+    private:
+      PassBuilder(RenderGraph* graph, uint32_t pass): m_graph(graph), m_pass(pass) {}
+      PassBuilder& access(RGHandle handle, RGUsage usage, bool clear);
+
+      RenderGraph* m_graph;
+      uint32_t m_pass;
+      friend class RenderGraph;
+    };
+
+    RenderGraph(std::shared_ptr<Device> device);
+    ~RenderGraph();
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    void reset();
+
+    // images owned outside the graph, their content is kept unless initial_layout is undefined
+    RGHandle import_image(
+        const std::string& name,
+        const Image& image,
+        vk::Format format,
+        vk::ImageLayout initial_layout,
+        vk::ImageLayout final_layout);
+    // images that only live for the frame, owned and aliased by the graph
+    RGHandle create_image(const std::string& name, const RGImageDesc& desc);
+
+    PassBuilder add_pass(const std::string& name, ExecuteFn execute);
+
+    void compile();
+    void execute(vk::CommandBuffer cmd);
+
+    // only valid inside an execute callback
+    // load and store ops are the ones picked for the running pass
+    Image image(RGHandle handle) const;
+
+    // safe to call from another thread, shows what the last compile produced
+    void draw_debug_ui();
+
+  private:
+    struct Access {
+      RGHandle handle;
+      RGUsage usage;
+      bool clear = false;
+      vk::AttachmentLoadOp load_op = vk::AttachmentLoadOp::eLoad;
+      vk::AttachmentStoreOp store_op = vk::AttachmentStoreOp::eStore;
+    };
+
+    struct Pass {
+      std::string name;
+      ExecuteFn execute;
+      std::vector<Access> accesses;
+      bool side_effects = false;
+      bool culled = false;
+      std::vector<vk::ImageMemoryBarrier2> barriers;
+    };
+
+    struct Resource {
+      std::string name;
+      vk::Format format;
+      vk::Extent2D extent;
+      bool imported = false;
+      Image image;
+      vk::ImageLayout initial_layout = vk::ImageLayout::eUndefined;
+      vk::ImageLayout final_layout = vk::ImageLayout::eUndefined;
+
+      // transient only
+      vk::ImageUsageFlags usage;
+      uint32_t first_pass = UINT32_MAX;
+      uint32_t last_pass = 0;
+      int32_t physical = -1;
+    };
+
+    // memory shared by transients with disjoint lifetimes
+    struct MemoryBlock {
+      VmaAllocation alloc = nullptr;
+      vk::DeviceSize size = 0;
+
+      // the last use of the memory in the last compiled frame, the frames in flight share it
+      // so it's the first scope of the next frame's first barrier
+      vk::PipelineStageFlags2 last_stages;
+      vk::AccessFlags2 last_access;
+    };
+
+    struct PhysicalImage {
+      RGImageDesc desc;
+      vk::ImageUsageFlags usage;
+      uint32_t block = 0;
+      vk::Image image;
+      vk::ImageView view;
+
+      bool operator==(const PhysicalImage& other) const {
+        return desc.format == other.desc.format && desc.extent == other.desc.extent &&
+               usage == other.usage && block == other.block;
+      }
+    };
+
+    void cull_passes();
+    void compute_lifetimes();
+    void allocate_transients();
+    void build_barriers();
+    void free_transients();
+
+    std::shared_ptr<Device> m_device;
+    std::vector<Pass> m_passes;
+    std::vector<Resource> m_resources;
+    std::vector<vk::ImageMemoryBarrier2> m_final_barriers;
+    uint32_t m_current_pass = UINT32_MAX;
+
+    // kept across frames, only rebuilt when the transient layout changes
+    std::vector<PhysicalImage> m_physical_images;
+    std::vector<MemoryBlock> m_blocks;
+
+    struct Stats {
+      uint32_t culled_passes = 0;
+      uint32_t barriers = 0;
+      vk::DeviceSize transient_memory = 0;
+      vk::DeviceSize transient_memory_unaliased = 0;
+    } m_stats;
+
+    // copied out at the end of compile for the debug ui
+    struct DebugPass {
+      std::string name;
+      bool culled = false;
+      size_t barriers = 0;
+    };
+    std::mutex m_debug_mutex;
+    std::vector<DebugPass> m_debug_passes;
+    Stats m_debug_stats;
+  };
+}    // namespace geg::vulkan
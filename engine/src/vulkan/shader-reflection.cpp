@@ -0,0 +1,330 @@
+#include "shader-reflection.hpp"
+
+#include <unordered_map>
+
+namespace geg::vulkan {
+  // the subset of the SPIR-V spec the reflection cares about
+  // https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html
+  namespace spv {
+    constexpr uint32_t MAGIC = 0x07230203;
+    constexpr uint32_t HEADER_SIZE = 5;
+
+    constexpr uint32_t OP_NAME = 5;
+    constexpr uint32_t OP_TYPE_INT = 21;
+    constexpr uint32_t OP_TYPE_FLOAT = 22;
+    constexpr uint32_t OP_TYPE_VECTOR = 23;
+    constexpr uint32_t OP_TYPE_MATRIX = 24;
+    constexpr uint32_t OP_TYPE_IMAGE = 25;
+    constexpr uint32_t OP_TYPE_SAMPLER = 26;
+    constexpr uint32_t OP_TYPE_SAMPLED_IMAGE = 27;
+    constexpr uint32_t OP_TYPE_ARRAY = 28;
+    constexpr uint32_t OP_TYPE_RUNTIME_ARRAY = 29;
+    constexpr uint32_t OP_TYPE_STRUCT = 30;
+    constexpr uint32_t OP_TYPE_POINTER = 32;
+    constexpr uint32_t OP_CONSTANT = 43;
+    constexpr uint32_t OP_VARIABLE = 59;
+    constexpr uint32_t OP_DECORATE = 71;
+    constexpr uint32_t OP_MEMBER_DECORATE = 72;
+
+    constexpr uint32_t DECORATION_BLOCK = 2;
+    constexpr uint32_t DECORATION_BUFFER_BLOCK = 3;
+    constexpr uint32_t DECORATION_ARRAY_STRIDE = 6;
+    constexpr uint32_t DECORATION_MATRIX_STRIDE = 7;
+    constexpr uint32_t DECORATION_BINDING = 33;
+    constexpr uint32_t DECORATION_DESCRIPTOR_SET = 34;
+    constexpr uint32_t DECORATION_OFFSET = 35;
+
+    constexpr uint32_t STORAGE_UNIFORM_CONSTANT = 0;
+    constexpr uint32_t STORAGE_UNIFORM = 2;
+    constexpr uint32_t STORAGE_PUSH_CONSTANT = 9;
+    constexpr uint32_t STORAGE_STORAGE_BUFFER = 12;
+
+    constexpr uint32_t DIM_BUFFER = 5;
+    constexpr uint32_t DIM_SUBPASS_DATA = 6;
+  }    // namespace spv
+
+  namespace {
+    struct Decorations {
+      std::optional<uint32_t> set;
+      std::optional<uint32_t> binding;
+      uint32_t array_stride = 0;
+      bool block = false;
+      bool buffer_block = false;
+    };
+
+    struct MemberDecorations {
+      std::optional<uint32_t> offset;
+      uint32_t matrix_stride = 0;
+    };
+
+    struct Variable {
+      uint32_t type_id;
+      uint32_t id;
+      uint32_t storage_class;
+    };
+
+    class SpirvModule {
+    public:
+      explicit SpirvModule(const std::vector<uint32_t>& spirv) {
+        GEG_CORE_ASSERT(
+            spirv.size() > spv::HEADER_SIZE && spirv[0] == spv::MAGIC, "invalid SPIR-V module");
+
+        size_t i = spv::HEADER_SIZE;
+        while (i < spirv.size()) {
+          const uint32_t word_count = spirv[i] >> 16;
+          const uint32_t opcode = spirv[i] & 0xffff;
+          GEG_CORE_ASSERT(word_count > 0 && i + word_count <= spirv.size(), "truncated SPIR-V");
+
+          const uint32_t* operands = &spirv[i + 1];
+          parse_instruction(opcode, operands, word_count - 1);
+          i += word_count;
+        }
+      }
+
+      std::vector<Variable> variables;
+
+      const std::vector<uint32_t>& type(uint32_t id) const { return m_types.at(id); }
+      uint32_t type_op(uint32_t id) const { return m_type_ops.at(id); }
+      const Decorations& decorations(uint32_t id) const {
+        static const Decorations empty{};
+        const auto it = m_decorations.find(id);
+        return it == m_decorations.end() ? empty : it->second;
+      }
+
+      std::string name(uint32_t id) const {
+        const auto it = m_names.find(id);
+        return it == m_names.end() ? std::string{} : it->second;
+      }
+
+      uint32_t constant(uint32_t id) const {
+        const auto it = m_constants.find(id);
+        GEG_CORE_ASSERT(it != m_constants.end(), "array length isn't a constant");
+        return it->second;
+      }
+
+      // size in bytes of a type as laid out in a block
+      uint32_t type_size(uint32_t id, uint32_t matrix_stride = 0) const {
+        const auto& operands = type(id);
+
+        switch (type_op(id)) {
+          case spv::OP_TYPE_INT:
+          case spv::OP_TYPE_FLOAT: return operands[1] / 8;
+          case spv::OP_TYPE_VECTOR: return operands[2] * type_size(operands[1]);
+          case spv::OP_TYPE_MATRIX: {
+            const uint32_t column_size = matrix_stride ? matrix_stride : type_size(operands[1]);
+            return operands[2] * column_size;
+          }
+          case spv::OP_TYPE_ARRAY: {
+            const uint32_t stride = decorations(id).array_stride;
+            const uint32_t element_size = stride ? stride : type_size(operands[1]);
+            return constant(operands[2]) * element_size;
+          }
+          case spv::OP_TYPE_STRUCT: {
+            uint32_t size = 0;
+            uint32_t running_offset = 0;
+            for (uint32_t m = 1; m < operands.size(); m++) {
+              const auto member = member_decorations(id, m - 1);
+              const uint32_t offset = member.offset.value_or(running_offset);
+              running_offset = offset + type_size(operands[m], member.matrix_stride);
+              size = std::max(size, running_offset);
+            }
+            return size;
+          }
+          default: return 0;
+        }
+      }
+
+    private:
+      std::unordered_map<uint32_t, std::vector<uint32_t>> m_types;
+      std::unordered_map<uint32_t, uint32_t> m_type_ops;
+      std::unordered_map<uint32_t, Decorations> m_decorations;
+      std::unordered_map<uint64_t, MemberDecorations> m_member_decorations;
+      std::unordered_map<uint32_t, uint32_t> m_constants;
+      std::unordered_map<uint32_t, std::string> m_names;
+
+      static uint64_t member_key(uint32_t id, uint32_t member) {
+        return (static_cast<uint64_t>(id) << 32) | member;
+      }
+
+      MemberDecorations member_decorations(uint32_t id, uint32_t member) const {
+        const auto it = m_member_decorations.find(member_key(id, member));
+        return it == m_member_decorations.end() ? MemberDecorations{} : it->second;
+      }
+
+      void parse_instruction(uint32_t opcode, const uint32_t* operands, uint32_t count) {
+        switch (opcode) {
+          case spv::OP_NAME: {
+            const char* str = reinterpret_cast<const char*>(operands + 1);
+            m_names[operands[0]] = std::string(str, strnlen(str, (count - 1) * sizeof(uint32_t)));
+            break;
+          }
+          case spv::OP_DECORATE: {
+            auto& decoration = m_decorations[operands[0]];
+            switch (operands[1]) {
+              case spv::DECORATION_BLOCK: decoration.block = true; break;
+              case spv::DECORATION_BUFFER_BLOCK: decoration.buffer_block = true; break;
+              case spv::DECORATION_ARRAY_STRIDE: decoration.array_stride = operands[2]; break;
+              case spv::DECORATION_BINDING: decoration.binding = operands[2]; break;
+              case spv::DECORATION_DESCRIPTOR_SET: decoration.set = operands[2]; break;
+              default: break;
+            }
+            break;
+          }
+          case spv::OP_MEMBER_DECORATE: {
+            auto& decoration = m_member_decorations[member_key(operands[0], operands[1])];
+            if (operands[2] == spv::DECORATION_OFFSET) decoration.offset = operands[3];
+            if (operands[2] == spv::DECORATION_MATRIX_STRIDE) decoration.matrix_stride = operands[3];
+            break;
+          }
+          case spv::OP_TYPE_INT:
+          case spv::OP_TYPE_FLOAT:
+          case spv::OP_TYPE_VECTOR:
+          case spv::OP_TYPE_MATRIX:
+          case spv::OP_TYPE_IMAGE:
+          case spv::OP_TYPE_SAMPLER:
+          case spv::OP_TYPE_SAMPLED_IMAGE:
+          case spv::OP_TYPE_ARRAY:
+          case spv::OP_TYPE_RUNTIME_ARRAY:
+          case spv::OP_TYPE_STRUCT:
+          case spv::OP_TYPE_POINTER: {
+            m_types[operands[0]] = std::vector<uint32_t>(operands, operands + count);
+            m_type_ops[operands[0]] = opcode;
+            break;
+          }
+          case spv::OP_CONSTANT: {
+            // only the low word matters, array lengths are 32 bit
+            m_constants[operands[1]] = operands[2];
+            break;
+          }
+          case spv::OP_VARIABLE: {
+            variables.push_back({
+                .type_id = operands[0],
+                .id = operands[1],
+                .storage_class = operands[2],
+            });
+            break;
+          }
+          default: break;
+        }
+      }
+    };
+
+    std::optional<vk::DescriptorType> descriptor_type(
+        const SpirvModule& module, uint32_t type_id, uint32_t storage_class) {
+      const auto& operands = module.type(type_id);
+
+      switch (module.type_op(type_id)) {
+        case spv::OP_TYPE_SAMPLED_IMAGE: return vk::DescriptorType::eCombinedImageSampler;
+        case spv::OP_TYPE_SAMPLER: return vk::DescriptorType::eSampler;
+        case spv::OP_TYPE_IMAGE: {
+          // result, sampled type, dim, depth, arrayed, ms, sampled, format
+          const uint32_t dim = operands[2];
+          const uint32_t sampled = operands[6];
+          if (dim == spv::DIM_BUFFER)
+            return sampled == 2 ? vk::DescriptorType::eStorageTexelBuffer :
+                                  vk::DescriptorType::eUniformTexelBuffer;
+          if (dim == spv::DIM_SUBPASS_DATA) return vk::DescriptorType::eInputAttachment;
+          return sampled == 2 ? vk::DescriptorType::eStorageImage :
+                                vk::DescriptorType::eSampledImage;
+        }
+        case spv::OP_TYPE_STRUCT: {
+          if (storage_class == spv::STORAGE_STORAGE_BUFFER) return vk::DescriptorType::eStorageBuffer;
+          if (module.decorations(type_id).buffer_block) return vk::DescriptorType::eStorageBuffer;
+          return vk::DescriptorType::eUniformBufferDynamic;
+        }
+        default: return {};
+      }
+    }
+  }    // namespace
+
+  void ShaderReflection::merge(const ShaderReflection& other) {
+    for (const auto& binding : other.bindings) {
+      const auto found = std::find_if(bindings.begin(), bindings.end(), [&](const auto& b) {
+        return b.set == binding.set && b.binding == binding.binding;
+      });
+
+      if (found == bindings.end()) {
+        bindings.push_back(binding);
+        continue;
+      }
+
+      GEG_CORE_ASSERT(
+          found->type == binding.type && found->count == binding.count,
+          "stages disagree on set {} binding {}",
+          binding.set,
+          binding.binding);
+    }
+
+    std::sort(bindings.begin(), bindings.end(), [](const auto& a, const auto& b) {
+      return a.set == b.set ? a.binding < b.binding : a.set < b.set;
+    });
+
+    push_constant_size = std::max(push_constant_size, other.push_constant_size);
+  }
+
+  uint32_t ShaderReflection::set_count() const {
+    uint32_t count = 0;
+    for (const auto& binding : bindings)
+      count = std::max(count, binding.set + 1);
+
+    return count;
+  }
+
+  ShaderReflection reflect_spirv(const std::vector<uint32_t>& spirv) {
+    const SpirvModule module(spirv);
+    ShaderReflection reflection;
+
+    for (const auto& variable : module.variables) {
+      const bool is_resource = variable.storage_class == spv::STORAGE_UNIFORM_CONSTANT ||
+                               variable.storage_class == spv::STORAGE_UNIFORM ||
+                               variable.storage_class == spv::STORAGE_STORAGE_BUFFER;
+      const bool is_push_constant = variable.storage_class == spv::STORAGE_PUSH_CONSTANT;
+      if (!is_resource && !is_push_constant) continue;
+
+      // variables are always pointers, the pointee is what we care about
+      uint32_t type_id = module.type(variable.type_id)[2];
+
+      if (is_push_constant) {
+        reflection.push_constant_size =
+            std::max(reflection.push_constant_size, module.type_size(type_id));
+        continue;
+      }
+
+      const auto& decorations = module.decorations(variable.id);
+      if (!decorations.set.has_value() || !decorations.binding.has_value()) continue;
+
+      uint32_t count = 1;
+      if (module.type_op(type_id) == spv::OP_TYPE_ARRAY) {
+        count = module.constant(module.type(type_id)[2]);
+        type_id = module.type(type_id)[1];
+      } else if (module.type_op(type_id) == spv::OP_TYPE_RUNTIME_ARRAY) {
+        // unbounded arrays aren't used by the engine yet
+        type_id = module.type(type_id)[1];
+      }
+
+      const auto type = descriptor_type(module, type_id, variable.storage_class);
+      if (!type.has_value()) {
+        GEG_CORE_WARN("skipping unsupported resource {} in SPIR-V", module.name(variable.id));
+        continue;
+      }
+
+      std::string name = module.name(variable.id);
+      if (name.empty()) name = module.name(type_id);
+
+      reflection.bindings.push_back({
+          .set = decorations.set.value(),
+          .binding = decorations.binding.value(),
+          .count = count,
+          .type = type.value(),
+          .name = std::move(name),
+      });
+    }
+
+    std::sort(
+        reflection.bindings.begin(), reflection.bindings.end(), [](const auto& a, const auto& b) {
+          return a.set == b.set ? a.binding < b.binding : a.set < b.set;
+        });
+
+    return reflection;
+  }
+}    // namespace geg::vulkan
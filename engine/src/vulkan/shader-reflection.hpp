@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pch.hpp"
+#include "geg-vulkan.hpp"
+
+namespace geg::vulkan {
+  // descriptor sets are grouped by how often they change so a draw only
+  // rebinds what actually changed, shaders are expected to follow this
+  enum DescriptorFrequency : uint32_t {
+    PER_FRAME_SET = 0,
+    PER_MATERIAL_SET = 1,
+    PER_DRAW_SET = 2,
+  };
+
+  struct ReflectedBinding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    uint32_t count = 1;
+    vk::DescriptorType type = vk::DescriptorType::eUniformBufferDynamic;
+    std::string name;
+  };
+
+  struct ShaderReflection {
+    std::vector<ReflectedBinding> bindings;
+    uint32_t push_constant_size = 0;
+
+    // merges the resources of another stage of the same program
+    void merge(const ShaderReflection& other);
+    uint32_t set_count() const;
+  };
+
+  // walks the SPIR-V instruction stream and collects the descriptor bindings
+  // and the push constant block size
+  // uniform buffers are reported as dynamic since that's how the engine binds them
+  ShaderReflection reflect_spirv(const std::vector<uint32_t>& spirv);
+}    // namespace geg::vulkan
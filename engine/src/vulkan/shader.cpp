@@ -125,11 +125,10 @@ namespace geg::vulkan {
     glslang_initialize_process();
 
     if (!compute) {
+      stage_flags = vk::ShaderStageFlagBits::eAllGraphics;
       auto vert_spv = compile_shader(m_glsl_shader_src, vk::ShaderStageFlagBits::eVertex);
-      vert_module = m_device->vkdevice.createShaderModule({
-          .codeSize = sizeof(uint32_t) * (vert_spv.size()),
-          .pCode = vert_spv.data(),
-      });
+      reflection.merge(reflect_spirv(vert_spv));
+      vert_module = m_device->pipeline_cache().module(vert_spv);
 
       vert_stage_info = vk::PipelineShaderStageCreateInfo{
           .stage = vk::ShaderStageFlagBits::eVertex,
@@ -138,10 +137,8 @@ namespace geg::vulkan {
       };
 
       auto frag_spv = compile_shader(m_glsl_shader_src, vk::ShaderStageFlagBits::eFragment);
-      frag_module = m_device->vkdevice.createShaderModule({
-          .codeSize = sizeof(uint32_t) * frag_spv.size(),
-          .pCode = frag_spv.data(),
-      });
+      reflection.merge(reflect_spirv(frag_spv));
+      frag_module = m_device->pipeline_cache().module(frag_spv);
 
       frag_stage_info = vk::PipelineShaderStageCreateInfo{
           .stage = vk::ShaderStageFlagBits::eFragment,
@@ -149,7 +146,9 @@ namespace geg::vulkan {
           .pName = "main",
       };
     } else {
+      stage_flags = vk::ShaderStageFlagBits::eCompute;
       auto compute_spv = compile_shader(m_glsl_shader_src, vk::ShaderStageFlagBits::eCompute);
+      reflection = reflect_spirv(compute_spv);
       compute_module = m_device->vkdevice.createShaderModule({
           .codeSize = sizeof(uint32_t) * (compute_spv.size()),
           .pCode = compute_spv.data(),
@@ -162,14 +161,42 @@ namespace geg::vulkan {
       };
     }
 
+    build_layouts();
     GEG_CORE_INFO("Shader {0} compiled successfully", m_shader_name);
 
     glslang_finalize_process();
   }
 
+  void Shader::build_layouts() {
+    set_layouts.clear();
+    for (uint32_t set = 0; set < reflection.set_count(); set++) {
+      // sets without bindings still need an (empty) layout to keep the numbering
+      auto builder = m_device->build_descriptor();
+      for (const auto& binding : reflection.bindings) {
+        if (binding.set != set) continue;
+        builder.bind_layout(binding.binding, binding.count, binding.type, stage_flags);
+      }
+
+      set_layouts.push_back(builder.build_layout().value());
+    }
+
+    if (reflection.push_constant_size > 0) {
+      push_constant_range = vk::PushConstantRange{
+          .stageFlags = stage_flags,
+          .offset = 0,
+          .size = reflection.push_constant_size,
+      };
+    }
+  }
+
+  vk::PipelineLayout Shader::pipeline_layout() const {
+    return m_device->pipeline_cache().layout(set_layouts, push_constant_range);
+  }
+
+  // the graphics modules are shared through the pipeline cache, it drops their pipelines
   Shader::~Shader() {
-    m_device->vkdevice.destroyShaderModule(vert_module);
-    m_device->vkdevice.destroyShaderModule(frag_module);
+    m_device->pipeline_cache().release_module(vert_module);
+    m_device->pipeline_cache().release_module(frag_module);
   }
 
   std::vector<uint32_t> Shader::compile_shader(std::string src, vk::ShaderStageFlags stage) {
@@ -3,6 +3,7 @@
 #include <glslang/Include/ResourceLimits.h>
 #include "geg-vulkan.hpp"
 #include "device.hpp"
+#include "shader-reflection.hpp"
 #include "utils/filesystem.hpp"
 
 namespace geg::vulkan {
@@ -21,12 +22,24 @@ namespace geg::vulkan {
     vk::PipelineShaderStageCreateInfo frag_stage_info;
     vk::PipelineShaderStageCreateInfo compute_stage_info;
 
+    // derived from the compiled SPIR-V, indexed by set number
+    // every binding is visible to all stages of the program so sets built
+    // for one pass stay compatible with other passes using the same layout
+    ShaderReflection reflection;
+    vk::ShaderStageFlags stage_flags;
+    std::vector<vk::DescriptorSetLayout> set_layouts;
+    std::optional<vk::PushConstantRange> push_constant_range;
+
+    // owned by the device pipeline cache, shared with every shader with the same sets
+    vk::PipelineLayout pipeline_layout() const;
+
   private:
     std::shared_ptr<Device> m_device;
     std::string m_shader_path;
     std::string m_shader_name;
     std::string m_glsl_shader_src;
 
+    void build_layouts();
     static std::vector<uint32_t> compile_shader(std::string src, vk::ShaderStageFlags stage);
   };
 }    // namespace geg::vulkan
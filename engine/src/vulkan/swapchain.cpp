@@ -22,6 +22,7 @@ namespace geg::vulkan {
         m_device->physical_device.getSurfaceCapabilitiesKHR(m_device->surface);
 
     auto [width, height] = m_window->dimensions();
+    m_window_extent = vk::Extent2D{.width = width, .height = height};
     if (surface_capabilities.currentExtent.width == std::numeric_limits<uint32_t>::max()) {
       m_extent.width = std::clamp(
           width,
@@ -68,8 +69,9 @@ namespace geg::vulkan {
     vk::SurfaceCapabilitiesKHR surface_capabilities =
         m_device->physical_device.getSurfaceCapabilitiesKHR(m_device->surface);
 
+    // the window is only queried on the main thread, the size is handed in on recreation
     vk::Extent2D new_extent;
-    auto [width, height] = m_window->dimensions();
+    const auto [width, height] = m_window_extent;
     if (surface_capabilities.currentExtent.width == std::numeric_limits<uint32_t>::max()) {
       new_extent.width = std::clamp(
           width,
@@ -142,7 +144,9 @@ namespace geg::vulkan {
     GEG_CORE_INFO("created swapchain with w: {}, h: {}", m_extent.width, m_extent.height);
   }
 
-  void Swapchain::recreate(std::optional<vk::PresentModeKHR> present_mode) {
+  void Swapchain::recreate(
+      vk::Extent2D window_extent, std::optional<vk::PresentModeKHR> present_mode) {
+    m_window_extent = window_extent;
     if (present_mode.has_value()) m_present_mode = present_mode.value();
     create_swapchain();
   }
@@ -15,7 +15,7 @@ namespace geg::vulkan {
     Swapchain(Swapchain &&) = delete;
     Swapchain &operator=(Swapchain &&) = delete;
 
-    void recreate(std::optional<vk::PresentModeKHR> present_mode);
+    void recreate(vk::Extent2D window_extent, std::optional<vk::PresentModeKHR> present_mode);
     vk::PresentModeKHR present_mode() const { return m_present_mode; }
 
     auto format() const { return m_surface_format.format; }
@@ -36,6 +36,7 @@ namespace geg::vulkan {
     vk::SurfaceFormatKHR m_surface_format;
     vk::PresentModeKHR m_present_mode;
     vk::Extent2D m_extent;
+    vk::Extent2D m_window_extent;
 
     uint32_t m_min_image_count = 0;
 
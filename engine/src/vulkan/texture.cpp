@@ -1,6 +1,7 @@
 #include "texture.hpp"
 #include <vulkan/vulkan_enums.hpp>
 
+#include "assets/cooked-assets.hpp"
 #include "stb_image.h"
 #include "vk_mem_alloc.h"
 
@@ -52,6 +53,47 @@ namespace geg::vulkan {
     stbi_image_free(img_data);
   };
 
+  Texture::Texture(
+      std::shared_ptr<Device> device,
+      const cooked::TextureView& cooked,
+      std::string image_name):
+      m_name(std::move(image_name)),
+      m_format(cooked.format), m_channels(4), m_device(device),
+      mipmap_levels(static_cast<uint32_t>(cooked.levels.size())) {
+    m_width = static_cast<int32_t>(cooked.width);
+    m_height = static_cast<int32_t>(cooked.height);
+    m_size = cooked.levels[0].size;
+    create_texture();
+
+    std::vector<vk::BufferImageCopy> regions;
+    regions.reserve(mipmap_levels);
+    for (uint32_t i = 0; i < mipmap_levels; i++) {
+      const auto& level = cooked.levels[i];
+      regions.push_back({
+          .bufferOffset = level.offset,
+          .bufferRowLength = 0,
+          .bufferImageHeight = 0,
+          .imageSubresource{
+              .aspectMask = vk::ImageAspectFlagBits::eColor,
+              .mipLevel = i,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+          .imageExtent = {.width = level.width, .height = level.height, .depth = 1},
+      });
+    }
+
+    m_device->upload_levels_to_image(
+        image,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        m_format,
+        regions,
+        cooked.data.data(),
+        cooked.data.size(),
+        mipmap_levels);
+    m_layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+  }
+
   Texture::Texture(std::shared_ptr<Device> device, glm::vec<4, uint8_t> color):
       m_name("dummy"), m_format(vk::Format::eR8G8B8A8Unorm), m_channels(4), m_device(device) {
     m_width = 1;
@@ -287,6 +329,7 @@ namespace geg::vulkan {
         vk::ShaderStageFlagBits::eCompute);
 
     if (new_layout == vk::ImageLayout::eGeneral) {
+      m_device->free_descriptor_set(write_descriptor_set);
       write_descriptor_set = mips_discriptor_builder.build().value().first;
     }
 
@@ -306,6 +349,7 @@ namespace geg::vulkan {
                 vk::ShaderStageFlagBits::eAllGraphics | vk::ShaderStageFlagBits::eCompute)
             .build()
             .value();
+    m_device->free_descriptor_set(descriptor_set);
     descriptor_set = set;
     descriptor_set_layout = layout;
 
@@ -314,8 +358,13 @@ namespace geg::vulkan {
 
   Texture::~Texture() {
     GEG_CORE_WARN("destroying texture: {}", m_name);
-    vmaDestroyImage(m_device->allocator, image, m_alloc);
-    m_device->vkdevice.destroy(image_view);
-    m_device->vkdevice.destroy(m_sampler);
+    // frames in flight may still sample it, the device destroys it once they are done
+    m_device->free_descriptor_set(descriptor_set);
+    m_device->free_descriptor_set(write_descriptor_set);
+    for (const auto view : mips_views)
+      m_device->destroy_image_view(view);
+    m_device->destroy_image_view(image_view);
+    m_device->destroy_sampler(m_sampler);
+    m_device->destroy_image(image, m_alloc);
   }
 }    // namespace geg::vulkan
@@ -5,6 +5,10 @@
 #include "vk_mem_alloc.h"
 #include "utils/filesystem.hpp"
 
+namespace geg::cooked {
+  struct TextureView;
+}
+
 namespace geg::vulkan {
   class Texture {
   public:
@@ -15,6 +19,11 @@ namespace geg::vulkan {
         vk::Format format,
         uint32_t _mipmap_levels = 1);
 
+    // every level comes from the cooked file, nothing is decoded or generated
+    Texture(
+        std::shared_ptr<Device> device,
+        const cooked::TextureView& cooked,
+        std::string image_name);
     Texture(std::shared_ptr<Device> device, glm::vec<4, uint8_t> color);
     Texture(std::shared_ptr<Device> device, uint32_t width, uint32_t height, vk::Format format, uint32_t _mipmap_levels = 1);
     Texture(Texture&) = delete;
@@ -29,7 +38,12 @@ namespace geg::vulkan {
     vk::ImageView image_view;
 
     std::string name() const { return m_name; }
+    // bytes of the base level
+    size_t size() const { return m_size; }
     void transition_layout(vk::ImageLayout new_layout);
+    vk::DescriptorImageInfo descriptor_info() const {
+      return {.sampler = m_sampler, .imageView = image_view, .imageLayout = m_layout};
+    }
 
   private:
     void upload_data(const void* img_data);
@@ -39,6 +39,7 @@ namespace geg::vulkan {
   }
 
   UniformBuffer::~UniformBuffer() {
-    vmaDestroyBuffer(m_device->allocator, m_buff, m_alloc);
+    m_device->free_descriptor_set(descriptor_set);
+    m_device->destroy_buffer(m_buff, m_alloc);
   }
 }    // namespace geg::vulkan
@@ -16,6 +16,10 @@ namespace geg::vulkan {
     vk::DescriptorSet descriptor_set;
 
     uint32_t frame_offset(uint32_t frame_index) const { return frame_index * m_padded_size; }
+    // one frame worth of the buffer, meant to be bound with a dynamic offset
+    vk::DescriptorBufferInfo descriptor_info() const {
+      return {.buffer = m_buff, .offset = 0, .range = m_padded_size};
+    }
     void write_at_frame(const void* data, size_t size, uint32_t frame_index) {
       void* void_mapping_addr = nullptr;
       vmaMapMemory(m_device->allocator, m_alloc, &void_mapping_addr);
@@ -1,4 +1,6 @@
 #include "assets/asset-manager.hpp"
+#include "assets/scene-file.hpp"
+#include "assets/static-batching.hpp"
 #include "core/app.hpp"
 #include "core/layer.hpp"
 #include "debug/inspector.hpp"
@@ -14,12 +16,21 @@ public:
 
   void on_attach() override {
     auto& asset_manager = geg::AssetManager::get();
-    asset_manager.load_scene(&scene,
-      "/home/thegeeko/3d-models/gltf/2.0/DamagedHelmet/glTF/DamagedHelmet.gltf");
-    asset_manager.load_scene(
-        &scene, "/home/thegeeko/3d-models/gltf/2.0/SciFiHelmet/glTF/SciFiHelmet.gltf");
-    //asset_manager.load_scene(
-    //    &scene, "assets/meshes/teapot.gltf");
+    asset_manager.set_vertex_format(geg::vulkan::VertexFormat::Quantized);
+
+    // the imported helmets are cached, delete the file to import them again
+    const geg::fs::path cache = "assets/cache/helmets.gegs";
+    if (!geg::fs::exists(cache) || !geg::load_scene_file(&scene, cache)) {
+      asset_manager.load_scene(&scene,
+        "/home/thegeeko/3d-models/gltf/2.0/DamagedHelmet/glTF/DamagedHelmet.gltf");
+      asset_manager.load_scene(
+          &scene, "/home/thegeeko/3d-models/gltf/2.0/SciFiHelmet/glTF/SciFiHelmet.gltf");
+      //asset_manager.load_scene(
+      //    &scene, "assets/meshes/teapot.gltf");
+      // the cache keeps the batches so loading it doesn't bake again
+      geg::bake_static_batches(scene);
+      geg::save_scene_file(scene, cache);
+    }
 
 
     light = scene.create_entity("light");
@@ -27,8 +38,12 @@ public:
         .light_color = {1.0f, 1.0f, 1.0f, 300.0f},
     });
 
-    geg::TextureId env_texture =
-        asset_manager.enqueue_texture("assets/envmap.hdr", vk::Format::eR32G32B32A32Sfloat, 6);
+    // `geg-cook assets assets/cooked` writes the env map bc6h compressed with its mip chain
+    const geg::fs::path cooked_env = "assets/cooked/envmap.hdr.bc6h.ktx2";
+    geg::TextureId env_texture = asset_manager.enqueue_texture(
+        geg::fs::exists(cooked_env) ? cooked_env : "assets/envmap.hdr",
+        vk::Format::eR32G32B32A32Sfloat,
+        6);
     geg::Entity env_map = scene.create_entity("env map");
     env_map.add_component<cmps::EnvMap>(cmps::EnvMap{
         .env_map = env_texture,
@@ -37,12 +52,10 @@ public:
 
   void on_detach() override {}
   void update(float ts, geg::CameraPositionerInterface* cam) override {
-    scene_hierarchy.draw_panel();
-
     // light follow cam
     light.get_component<cmps::Transform>().translation = cam->position();
   };
-  void ui(float ts) override{};
+  void ui(float ts) override { scene_hierarchy.draw_panel(); };
   void on_event(geg::Event& event) override{};
 
 private: